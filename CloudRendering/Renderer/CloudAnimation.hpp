@@ -0,0 +1,205 @@
+// Cloud motion by advecting the cached field through a curl-noise flow
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+
+#include "SharedTypes.h"
+#include "NoiseTable.hpp"
+#include "FBm.hpp"
+#include "SIMD.hpp"
+#include "ThreadPool.hpp"
+
+/**
+ Moves the clouds without regenerating them. A low resolution velocity field, a constant wind plus the curl of
+ a slowly changing noise potential, is rebuilt every frame; the cached density map is only resampled through it.
+ As in a flow map, two phases advect the map for up to `period` seconds each, half a period apart, and are
+ cross-faded so each one restarts while its weight is 0. The curl keeps the flow divergence free, so the clouds
+ swirl instead of bunching up. `advect` is the CPU side of the resampling `draw_skydome` does per fragment.
+ */
+namespace CloudAnimation {
+
+    struct FlowParameters {
+        uint32_t resolution;        // velocity texels per side
+        float    wind_u;            // uv per second
+        float    wind_v;
+        float    curl_strength;     // uv per second per unit potential gradient
+        float    curl_cells;        // potential lattice cells across the map
+        float    curl_drift;        // lattice cells per second the potential's layers slide by
+        float    period;            // seconds a phase advects before it restarts
+    };
+
+    constexpr FlowParameters default_flow = { 64, 0.004f, 0.0015f, 0.006f, 3.0f, 0.05f, 8.0f };
+
+    /**
+     Phases of the two advections at `time` seconds
+     */
+    inline CloudFlowFrame flow_frame(double time, float period) {
+        double cycles = time / (double)period;
+        float phase0 = (float)(cycles - std::floor(cycles));
+        float phase1 = phase0 + 0.5f;
+        if ( phase1 >= 1.0f ) phase1 -= 1.0f;
+
+        float weight0 = 1.0f - std::fabs(2.0f * phase0 - 1.0f);
+        return { { phase0 * period, phase1 * period }, { weight0, 1.0f - weight0 } };
+    }
+
+    /**
+     What the sampler of `draw_skydome` returns: bilinear at uv, texel centers at (i + 0.5) / size, clamped to the edge
+     */
+    inline float sample_bilinear(const float* map, uint32_t width, uint32_t height, size_t row_pitch,
+                                 size_t stride, float u, float v)
+    {
+        float x = std::clamp(u * (float)width - 0.5f, 0.0f, (float)(width - 1));
+        float y = std::clamp(v * (float)height - 0.5f, 0.0f, (float)(height - 1));
+        uint32_t x0 = (uint32_t)x, y0 = (uint32_t)y;
+        uint32_t x1 = std::min(x0 + 1, width - 1), y1 = std::min(y0 + 1, height - 1);
+        float fx = x - (float)x0, fy = y - (float)y0;
+
+        auto at = [&](uint32_t i, uint32_t j) { return map[j * row_pitch + i * stride]; };
+        float top = at(x0, y0) + (at(x1, y0) - at(x0, y0)) * fx;
+        float bottom = at(x0, y1) + (at(x1, y1) - at(x0, y1)) * fx;
+        return top + (bottom - top) * fy;
+    }
+
+
+    /**
+     Wind plus curl noise velocities on a `resolution`^2 grid over the map, interleaved u, v as RG32Float texels
+     */
+    class VelocityField {
+    private:
+        FlowParameters params;
+        NoiseTable::GradientTable g;
+        std::vector<float> potential;   // (resolution + 2)^2, one texel of halo for the central differences
+        std::vector<float> velocity;
+
+        /** keeps the potential's lattice coordinates positive, as `Fractal` expects */
+        static constexpr float origin = 1024.0f;
+
+    public:
+        VelocityField(FlowParameters const& params, uint32_t seed)
+            : params(params),
+              // a seed of its own, so the flow does not follow the clouds' lattice
+              g(NoiseTable::make_gradient_table(NoiseTable::make(seed ^ 0x9E3779B9u))),
+              potential((size_t)(params.resolution + 2) * (params.resolution + 2)),
+              velocity((size_t)params.resolution * params.resolution * 2)
+        {
+            update(0.0);
+        }
+
+        /**
+         Rebuild the field for `time` seconds. Two layers of potential slide apart, so the swirls change shape
+         rather than translate.
+         */
+        template <class V = Simd::f32x8>
+        void update(double time) {
+            const uint32_t n = params.resolution;
+            const uint32_t side = n + 2;
+            const float cells_per_texel = params.curl_cells / (float)n;
+            const float drift = (float)std::fmod(time * params.curl_drift, (double)NoiseTable::period);
+            const Fractal::FBm<Fractal::Perlin, 2> fbm;
+
+            for ( uint32_t y = 0; y < side; y += 1 ) {
+                float* row = potential.data() + (size_t)y * side;
+                float sy = ((float)y - 0.5f) * cells_per_texel + origin;
+                for ( uint32_t x = 0; x < side; x += V::width ) {
+                    V sx = (Simd::ramp<V>((float)x) - V { 0.5f }) * V { cells_per_texel } + V { origin };
+                    V p = fbm(sx + V { drift }, sy, g) + fbm(sx + V { 37.0f }, sy + 17.0f + drift, g);
+                    alignas(64) float lanes[V::width];
+                    p.store(lanes);
+                    for ( uint32_t i = 0; i < V::width && x + i < side; i += 1 ) row[x + i] = lanes[i];
+                }
+            }
+
+            // (d/dy, -d/dx) of the potential, in lattice units so the strength does not depend on the resolution
+            const float scale = params.curl_strength / (2.0f * cells_per_texel);
+            for ( uint32_t y = 0; y < n; y += 1 )
+                for ( uint32_t x = 0; x < n; x += 1 ) {
+                    const float* c = potential.data() + (size_t)(y + 1) * side + (x + 1);
+                    float* out = velocity.data() + ((size_t)y * n + x) * 2;
+                    out[0] = params.wind_u + (c[side] - c[-(ptrdiff_t)side]) * scale;
+                    out[1] = params.wind_v - (c[1] - c[-1]) * scale;
+                }
+        }
+
+        /** velocity at uv, as the shader samples the uploaded field */
+        inline void sample(float u, float v, float& du, float& dv) const {
+            const uint32_t n = params.resolution;
+            du = sample_bilinear(velocity.data(), n, n, (size_t)n * 2, 2, u, v);
+            dv = sample_bilinear(velocity.data() + 1, n, n, (size_t)n * 2, 2, u, v);
+        }
+
+        inline const float* data() const { return velocity.data(); }
+        inline uint32_t get_resolution() const { return params.resolution; }
+        inline FlowParameters const& get_parameters() const { return params; }
+    };
+
+
+    /**
+     `sample_bilinear` for `V::width` points, `map` holding fewer than 2^24 floats so indices stay exact
+     */
+    template <class V>
+    inline V sample_bilinear(const float* map, uint32_t width, uint32_t height, size_t row_pitch, V u, V v) {
+        V x = min(max(u * V { (float)width } - V { 0.5f }, V { 0.0f }), V { (float)(width - 1) });
+        V y = min(max(v * V { (float)height } - V { 0.5f }, V { 0.0f }), V { (float)(height - 1) });
+        V x0 = floor(x), y0 = floor(y);
+        V fx = x - x0, fy = y - y0;
+        V x1 = min(x0 + V { 1.0f }, V { (float)(width - 1) });
+        V row0 = y0 * V { (float)row_pitch };
+        V row1 = min(y0 + V { 1.0f }, V { (float)(height - 1) }) * V { (float)row_pitch };
+
+        V a = gather(map, row0 + x0), b = gather(map, row0 + x1);
+        V c = gather(map, row1 + x0), d = gather(map, row1 + x1);
+        V top = fma(b - a, fx, a);
+        V bottom = fma(d - c, fx, c);
+        return fma(bottom - top, fy, top);
+    }
+
+    /**
+     Resample `base` through `field` for `frame` into `out`, both `width` x `height` with `row_pitch` floats per row.
+     Each row first interpolates the velocity rows above and below it, leaving one gather per lane and component.
+     */
+    template <class V = Simd::f32x8>
+    inline void advect(ThreadPool& pool, const float* base, float* out, uint32_t width, uint32_t height, size_t row_pitch,
+                       VelocityField const& field, CloudFlowFrame const& frame,
+                       uint32_t tile_width = 256, uint32_t tile_height = 16)
+    {
+        const uint32_t n = field.get_resolution();
+        parallel_for_2d(pool, width, height, tile_width, tile_height, [&](size_t x0, size_t y0, size_t x1, size_t y1) {
+            thread_local std::vector<float> row_velocity;
+            row_velocity.resize((size_t)n * 2);
+            float* du_row = row_velocity.data();
+            float* dv_row = du_row + n;
+
+            for ( size_t y = y0; y < y1; y += 1 ) {
+                float v = ((float)y + 0.5f) / (float)height;
+                for ( uint32_t i = 0; i < n; i += 1 )
+                    field.sample(((float)i + 0.5f) / (float)n, v, du_row[i], dv_row[i]);
+
+                float* row = out + y * row_pitch;
+                for ( size_t x = x0; x < x1; x += V::width ) {
+                    V u = (Simd::ramp<V>((float)x) + V { 0.5f }) * V { 1.0f / (float)width };
+                    // the row's velocities are already at their texel centers, only the horizontal lerp is left
+                    V du = sample_bilinear(du_row, n, 1, n, u, V { 0.5f });
+                    V dv = sample_bilinear(dv_row, n, 1, n, u, V { 0.5f });
+                    V vv { v };
+
+                    V d = V { frame.weight[0] } * sample_bilinear(base, width, height, row_pitch,
+                                                                  fma(du, V { -frame.advect[0] }, u), fma(dv, V { -frame.advect[0] }, vv));
+                    d = fma(V { frame.weight[1] }, sample_bilinear(base, width, height, row_pitch,
+                                                                   fma(du, V { -frame.advect[1] }, u), fma(dv, V { -frame.advect[1] }, vv)), d);
+                    if ( x + V::width <= x1 ) {
+                        d.store(row + x);
+                    } else {
+                        alignas(64) float tail[V::width];
+                        d.store(tail);
+                        for ( size_t i = 0; x + i < x1; i += 1 ) row[x + i] = tail[i];
+                    }
+                }
+            }
+        });
+    }
+}
@@ -0,0 +1,233 @@
+// Storage formats of the cloud density and normal maps
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <numbers>
+
+#include "SharedTypes.h"
+#include "NormalMap.hpp"
+#include "VertexQuantization.hpp"
+#include "SIMD.hpp"
+#include "ThreadPool.hpp"
+
+/**
+ The formats the cloud maps can be stored in, the CPU side of `encode_cloud_density` and `encode_cloud_normal`
+ in Shaders.metal, and what each costs in memory and precision.
+ Densities are expected in [0, 1]; `Unorm8` clamps them and adds a dither of one step peak to peak before rounding,
+ so smooth gradients do not band. Normals use the `NormalMap` encodings.
+ */
+namespace CloudEncoding {
+
+    enum class DensityFormat : uint32_t {
+        Float32,        // R32Float
+        Half,           // R16Float
+        Unorm8,         // R8Unorm, dithered
+    };
+
+    enum class NormalFormat : uint32_t {
+        XYZ8 = CloudNormalXYZ,                          // RGBA8Snorm
+        Octahedral8 = CloudNormalOctahedral,            // RG8Snorm
+        HemiOctahedral8 = CloudNormalHemiOctahedral,    // RG8Snorm, z > 0 only
+    };
+
+    inline uint32_t bytes_per_texel(DensityFormat f) {
+        switch ( f ) {
+            case DensityFormat::Half:   return 2;
+            case DensityFormat::Unorm8: return 1;
+            default:                    return 4;
+        }
+    }
+
+    inline uint32_t bytes_per_texel(NormalFormat f) {
+        return f == NormalFormat::XYZ8 ? 4 : 2;
+    }
+
+    inline const char* name(DensityFormat f) {
+        switch ( f ) {
+            case DensityFormat::Half:   return "R16Float";
+            case DensityFormat::Unorm8: return "R8Unorm";
+            default:                    return "R32Float";
+        }
+    }
+
+    inline const char* name(NormalFormat f) {
+        switch ( f ) {
+            case NormalFormat::Octahedral8:     return "RG8Snorm octahedral";
+            case NormalFormat::HemiOctahedral8: return "RG8Snorm hemi-octahedral";
+            default:                            return "RGBA8Snorm";
+        }
+    }
+
+    /** what the kernels need to know about the formats */
+    inline CloudMapEncoding map_encoding(DensityFormat density, NormalFormat normal) {
+        return { density == DensityFormat::Unorm8 ? 1.0f / 255.0f : 0.0f, (uint32_t)normal };
+    }
+
+    /** largest difference encoding a density in [0, 1] can make */
+    inline float density_tolerance(DensityFormat f) {
+        switch ( f ) {
+            case DensityFormat::Half:   return 1.0f / 4096.0f;     // half a step of the [0.5, 1) binade
+            case DensityFormat::Unorm8: return 1.0f / 255.0f;      // half a step of rounding plus half of dither
+            default:                    return 0.0f;
+        }
+    }
+
+
+    /**
+     Interleaved gradient noise (Jimenez, "Next Generation Post Processing in Call of Duty: Advanced Warfare"),
+     in [-0.5, 0.5). Neighboring texels get well spread values, so the dither reads as fine grain.
+     */
+    inline float dither(uint32_t x, uint32_t y) {
+        float t = 0.06711056f * (float)x + 0.00583715f * (float)y;
+        t = 52.9829189f * (t - std::floor(t));
+        return t - std::floor(t) - 0.5f;
+    }
+
+    template <class V>
+    inline V dither(V x, float y) {
+        V t = fma(x, V { 0.06711056f }, V { 0.00583715f * y });
+        t = (t - floor(t)) * V { 52.9829189f };
+        return t - floor(t) - V { 0.5f };
+    }
+
+
+    /**
+     Encode densities [x_begin, x_begin + n) of row `y` into `out`, `bytes_per_texel(format)` bytes each
+     */
+    template <class V = Simd::f32x8>
+    inline void encode_density_row(const float* in, uint8_t* out, uint32_t n, uint32_t x_begin, uint32_t y, DensityFormat format) {
+        uint32_t i = 0;
+        if ( format == DensityFormat::Unorm8 ) {
+            // texel columns stay exact integers in a float up to 2^24
+            V x = Simd::ramp<V>((float)x_begin);
+            for ( ; i + V::width <= n; i += V::width, x = x + V { (float)V::width } ) {
+                V d = fma(dither(x, (float)y), V { 1.0f / 255.0f }, V::load(in + i));
+                pack_unorm8(min(max(d, V { 0.0f }), V { 1.0f }), out + i);
+            }
+            for ( ; i < n; i += 1 ) {
+                float d = std::clamp(in[i] + dither(x_begin + i, y) / 255.0f, 0.0f, 1.0f);
+                out[i] = (uint8_t)std::nearbyint(d * 255.0f);
+            }
+        } else if ( format == DensityFormat::Half ) {
+            uint16_t* half = reinterpret_cast<uint16_t*>(out);
+            if constexpr ( V::has_half )
+                for ( ; i + V::width <= n; i += V::width )
+                    pack_half(V::load(in + i), half + i);
+            for ( ; i < n; i += 1 ) half[i] = Quantization::float_to_half(in[i]);
+        } else {
+            std::copy_n(in, n, reinterpret_cast<float*>(out));
+        }
+    }
+
+    template <class V = Simd::f32x8>
+    inline void decode_density_row(const uint8_t* in, float* out, uint32_t n, DensityFormat format) {
+        uint32_t i = 0;
+        if ( format == DensityFormat::Unorm8 ) {
+            for ( ; i + V::width <= n; i += V::width ) V::unpack_unorm8(in + i).store(out + i);
+            for ( ; i < n; i += 1 ) out[i] = (float)in[i] / 255.0f;
+        } else if ( format == DensityFormat::Half ) {
+            const uint16_t* half = reinterpret_cast<const uint16_t*>(in);
+            if constexpr ( V::has_half )
+                for ( ; i + V::width <= n; i += V::width ) V::unpack_half(half + i).store(out + i);
+            for ( ; i < n; i += 1 ) out[i] = Quantization::half_to_float(half[i]);
+        } else {
+            std::copy_n(reinterpret_cast<const float*>(in), n, out);
+        }
+    }
+
+    /**
+     A `width` x `height` map, `pitch` floats per row, as tightly packed texels of `format`
+     */
+    template <class V = Simd::f32x8>
+    inline std::vector<uint8_t> encode_density(ThreadPool& pool, const float* map, size_t pitch, uint32_t width, uint32_t height,
+                                               DensityFormat format)
+    {
+        const size_t row_bytes = (size_t)width * bytes_per_texel(format);
+        std::vector<uint8_t> texels(row_bytes * height);
+        parallel_for(pool, height, [&](size_t y) {
+            encode_density_row<V>(map + y * pitch, texels.data() + y * row_bytes, width, 0, (uint32_t)y, format);
+        });
+        return texels;
+    }
+
+    template <class V = Simd::f32x8>
+    inline void decode_density(ThreadPool& pool, const uint8_t* texels, uint32_t width, uint32_t height, DensityFormat format,
+                               float* map, size_t pitch)
+    {
+        const size_t row_bytes = (size_t)width * bytes_per_texel(format);
+        parallel_for(pool, height, [&](size_t y) {
+            decode_density_row<V>(texels + y * row_bytes, map + y * pitch, width, format);
+        });
+    }
+
+
+    struct DensityError {
+        double max_abs_error = 0.0;
+        double rms_error = 0.0;
+    };
+
+    inline DensityError density_error(const float* a, const float* b, size_t count) {
+        DensityError e;
+        double squares = 0.0;
+        for ( size_t i = 0; i < count; i += 1 ) {
+            double d = (double)a[i] - (double)b[i];
+            e.max_abs_error = std::max(e.max_abs_error, std::fabs(d));
+            squares += d * d;
+        }
+        e.rms_error = count ? std::sqrt(squares / (double)count) : 0.0;
+        return e;
+    }
+
+    struct NormalError {
+        double max_degrees = 0.0;
+        double mean_degrees = 0.0;
+    };
+
+    /** angle between `exact` and the decoded `texels` of `Encoding` */
+    template <class Encoding>
+    inline NormalError normal_error(const NormalMap::Normal* exact, const typename Encoding::Texel* texels, size_t count) {
+        NormalError e;
+        double total = 0.0;
+        for ( size_t i = 0; i < count; i += 1 ) {
+            // `XYZ8` decodes to a vector within rounding of unit length, only its direction counts
+            NormalMap::Normal d = Encoding::decode(texels[i]);
+            double length = std::sqrt((double)d.x * d.x + (double)d.y * d.y + (double)d.z * d.z);
+            double c = std::clamp(((double)exact[i].x * d.x + (double)exact[i].y * d.y + (double)exact[i].z * d.z) / length, -1.0, 1.0);
+            double degrees = std::acos(c) * (180.0 / std::numbers::pi);
+            e.max_degrees = std::max(e.max_degrees, degrees);
+            total += degrees;
+        }
+        e.mean_degrees = count ? total / (double)count : 0.0;
+        return e;
+    }
+
+
+    /**
+     Bytes of the density and normal maps at `width` x `height`, each with `levels` mip levels
+     */
+    struct MemoryReport {
+        size_t density_bytes = 0;
+        size_t normal_bytes = 0;
+
+        inline size_t total() const { return density_bytes + normal_bytes; }
+    };
+
+    inline MemoryReport memory(uint32_t width, uint32_t height, uint32_t density_levels, uint32_t normal_levels,
+                               DensityFormat density, NormalFormat normal)
+    {
+        auto chain = [&](uint32_t levels, uint32_t bytes) {
+            size_t total = 0;
+            uint32_t w = width, h = height;
+            for ( uint32_t i = 0; i < levels; i += 1 ) {
+                total += (size_t)w * h * bytes;
+                w = std::max(w / 2, 1u), h = std::max(h / 2, 1u);
+            }
+            return total;
+        };
+        return { chain(density_levels, bytes_per_texel(density)), chain(normal_levels, bytes_per_texel(normal)) };
+    }
+}
@@ -0,0 +1,102 @@
+// Parameter keyed cache of the generated cloud field
+#pragma once
+
+#include <vector>
+#include <bit>
+#include <cstdint>
+#include <cstddef>
+
+#include "SharedTypes.h"
+#include "Hash.hpp"
+#include "CloudNoise.hpp"
+#include "ThreadPool.hpp"
+
+/**
+ Identity of a generated cloud field: every input of `generate_cloud_density_map` and the resolution
+ */
+inline uint64_t cloud_field_key(CloudFieldParameters const& params, uint32_t width, uint32_t height) {
+    uint64_t h = Hash::default_seed;
+    h = Hash::combine(h, params.seed);
+    h = Hash::combine(h, params.octaves);
+    h = Hash::combine(h, std::bit_cast<uint32_t>(params.grid_size));
+    h = Hash::combine(h, std::bit_cast<uint32_t>(params.gaussian_peak));
+    h = Hash::combine(h, std::bit_cast<uint32_t>(params.gaussian_center));
+    h = Hash::combine(h, std::bit_cast<uint32_t>(params.gaussian_width));
+    h = Hash::combine(h, std::bit_cast<uint32_t>(params.fall_off_top_width));
+    h = Hash::combine(h, std::bit_cast<uint32_t>(params.fall_off_epsilon));
+    h = Hash::combine(h, width);
+    h = Hash::combine(h, height);
+    return h;
+}
+
+/**
+ Runs a generator only when the key of the requested field differs from the one last generated.
+ The generator is any callable taking (CloudFieldParameters const&, width, height),
+ so the renderer can encode GPU work and tests can use `CpuCloudField`.
+ */
+class CloudFieldCache {
+private:
+    uint64_t key = 0;
+    bool valid = false;
+    size_t hits = 0;
+    size_t misses = 0;
+
+public:
+    struct Stats {
+        size_t hits = 0;
+        size_t misses = 0;
+
+        inline double hit_ratio() const { return hits + misses ? (double)hits / (double)(hits + misses) : 0.0; }
+    };
+
+    /**
+     Generate the field for `params` at `width` x `height` unless it is already current.
+     Returns whether `generate` ran. A generator that throws leaves the cache invalid.
+     */
+    template <class Generate>
+    bool update(CloudFieldParameters const& params, uint32_t width, uint32_t height, Generate&& generate) {
+        uint64_t requested = cloud_field_key(params, width, height);
+        if ( valid && requested == key ) {
+            hits += 1;
+            return false;
+        }
+
+        valid = false;
+        generate(params, width, height);
+        key = requested;
+        valid = true;
+        misses += 1;
+        return true;
+    }
+
+    /** force the next `update` to regenerate, e.g. after the textures were recreated */
+    inline void invalidate() { valid = false; }
+
+    inline Stats get_stats() const { return { hits, misses }; }
+};
+
+/**
+ Density field generated on the CPU, the headless counterpart of the renderer's density texture
+ */
+class CpuCloudField {
+private:
+    ThreadPool& pool;
+    std::vector<float> density;
+    uint32_t width = 0;
+    uint32_t height = 0;
+
+public:
+    explicit CpuCloudField(ThreadPool& pool) : pool(pool) {}
+
+    void operator()(CloudFieldParameters const& params, uint32_t w, uint32_t h) {
+        width = w;
+        height = h;
+        density.resize((size_t)w * h);
+        CloudNoise::generate_tiled(pool, density.data(), w, h, w, params,
+                                   CloudNoise::make_gradient_table(NoiseTable::make(params.seed)));
+    }
+
+    inline const float* data() const { return density.data(); }
+    inline uint32_t get_width() const { return width; }
+    inline uint32_t get_height() const { return height; }
+};
@@ -0,0 +1,241 @@
+// Octave layers of the cloud field, kept so parameter changes only evaluate the octaves they add
+#pragma once
+
+#include <vector>
+#include <bit>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+
+#include "SharedTypes.h"
+#include "Hash.hpp"
+#include "CloudNoise.hpp"
+#include "FBm.hpp"
+#include "SIMD.hpp"
+#include "ThreadPool.hpp"
+
+/**
+ 2 octaves at every texel, so the map stays bit for bit what `CloudNoise::generate` writes. A shift of 1 takes
+ 4 times fewer texels, but leaves the densities up to 1e-3 from the exact field at a 128 texel grid, 1.3e-3 with
+ the gaussian narrowed to 0.5 (CloudLayerBench)
+ */
+constexpr CloudBaseBand default_base_band = { 2, 0 };
+
+/** base band texels per side for a `size` texel side: (size - 1) >> shift, and one more for the right neighbor */
+inline uint32_t cloud_base_size(uint32_t size, uint32_t shift) {
+    return ((size - 1) >> shift) + 2;
+}
+
+/** everything a base band depends on: the lattice, the resolution and the band */
+inline uint64_t cloud_base_key(CloudFieldParameters const& params, uint32_t width, uint32_t height, CloudBaseBand const& band) {
+    uint64_t key = Hash::default_seed;
+    key = Hash::combine(key, params.seed);
+    key = Hash::combine(key, std::bit_cast<uint32_t>(params.grid_size));
+    key = Hash::combine(key, width);
+    key = Hash::combine(key, height);
+    key = Hash::combine(key, std::min(band.octaves, params.octaves));
+    key = Hash::combine(key, band.shift);
+    return key;
+}
+
+/**
+ Density field generated on the CPU like `CpuCloudField`, keeping the noise it evaluated in two layers:
+ the base band, the sum of the first `band.octaves` octaves every 2^`band.shift` texels, and the full resolution
+ sum of every octave so far, started from the base band interpolated bilinearly. Changing the shaping gaussian
+ or the fall-off only reshapes the sum; adding octaves evaluates those alone; removing some restarts the sum from
+ the base band. Only the seed, the grid size and the resolution invalidate the base band.
+ With a shift of 0 the octaves are added in the order `Fractal::FBm` adds them, so the map is bit for bit what
+ `CloudNoise::generate` writes; `generate_cloud_maps` reads the same band from its texture on the GPU.
+ */
+template <class V = Simd::f32x8>
+class CloudLayerCache {
+public:
+    struct Stats {
+        size_t generations = 0;
+        size_t octaves_evaluated = 0;   // over the whole map, each base band octave counting once whatever its shift
+        size_t octaves_reused = 0;      // taken from the sum instead of evaluated
+    };
+
+private:
+    ThreadPool& pool;
+    CloudBaseBand band;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint64_t lattice = 0;
+    bool valid = false;
+
+    NoiseTable::GradientTable g;
+    std::vector<float> base;                    // base_pitch x base_height, the first base_count octaves
+    uint32_t base_width = 0, base_height = 0;
+    size_t base_pitch = 0;
+    uint32_t base_count = 0;
+    std::vector<float> sum;                     // full resolution, the first sum_count octaves, stale while that is 0
+    uint32_t sum_count = 0;
+    std::vector<float> density;
+    Stats stats;
+
+    /** rows per parallel band, as `NormalMap::generate` splits the map */
+    static constexpr uint32_t band_height = 16;
+
+    /** everything the base band and the sum depend on, whatever the octave count */
+    static uint64_t lattice_key(CloudFieldParameters const& params, uint32_t w, uint32_t h) {
+        uint64_t key = Hash::default_seed;
+        key = Hash::combine(key, params.seed);
+        key = Hash::combine(key, std::bit_cast<uint32_t>(params.grid_size));
+        key = Hash::combine(key, w);
+        key = Hash::combine(key, h);
+        return key;
+    }
+
+    /** the first `octaves` octaves at texels (i << shift, j << shift), whole vectors to the padded pitch */
+    void evaluate_base(uint32_t octaves, float grid_size) {
+        const float scale = 1.f / grid_size;
+        const float spacing = (float)(1u << band.shift);
+        Fractal::dispatch_octaves<Fractal::Perlin>({ Fractal::BasisKind::Perlin, octaves, 2.0f, 0.5f }, [&](auto const& fbm) {
+            parallel_for_2d(pool, base_width, base_height, base_width, band_height, [&](size_t, size_t j0, size_t, size_t j1) {
+                for ( uint32_t j = (uint32_t)j0; j < j1; j += 1 ) {
+                    float sy = ((float)(j << band.shift) + 0.5f) * scale;
+                    for ( uint32_t i = 0; i < base_pitch; i += V::width )
+                        fbm((Simd::ramp<V>((float)i) * V { spacing } + V { 0.5f }) * V { scale }, sy, g).store(base.data() + j * base_pitch + i);
+                }
+            });
+        });
+    }
+
+    /** the base band at every texel: a copy without a shift, bilinear between its texels otherwise */
+    void expand_base() {
+        const uint32_t shift = band.shift, mask = (1u << shift) - 1;
+        const float step = 1.f / (float)(1u << shift);
+        parallel_for_2d(pool, width, height, width, band_height, [&](size_t, size_t y0, size_t, size_t y1) {
+            std::vector<float> row(base_pitch);
+            for ( uint32_t y = (uint32_t)y0; y < y1; y += 1 ) {
+                float* out = sum.data() + (size_t)y * width;
+                const float* top = base.data() + (size_t)(y >> shift) * base_pitch;
+                if ( shift == 0 ) {
+                    std::copy_n(top, width, out);
+                    continue;
+                }
+                const float* bottom = top + base_pitch;
+                float ty = (float)(y & mask) * step;
+                for ( size_t i = 0; i < base_pitch; i += 1 ) row[i] = top[i] + (bottom[i] - top[i]) * ty;
+                for ( uint32_t x = 0; x < width; x += 1 ) {
+                    uint32_t i = x >> shift;
+                    out[x] = row[i] + (row[i + 1] - row[i]) * ((float)(x & mask) * step);
+                }
+            }
+        });
+    }
+
+    /** octaves sum_count .. octaves - 1 into the sum, each fused onto it as `Fractal::FBm` adds its octaves */
+    void add_octaves(uint32_t octaves, float grid_size) {
+        const uint32_t first = sum_count;
+        parallel_for_2d(pool, width, height, width, band_height, [&](size_t, size_t y0, size_t, size_t y1) {
+            const float scale = 1.f / grid_size;
+            for ( uint32_t y = (uint32_t)y0; y < y1; y += 1 ) {
+                float* row = sum.data() + (size_t)y * width;
+                float sy = ((float)y + 0.5f) * scale;
+                for ( uint32_t x = 0; x + V::width <= width; x += V::width ) {
+                    V sx = (Simd::ramp<V>((float)x) + V { 0.5f }) * V { scale };
+                    V s = V::load(row + x);
+                    for ( uint32_t i = first; i < octaves; i += 1 ) {
+                        float frequency = std::ldexp(1.0f, (int)i);
+                        s = fma(Fractal::Perlin::evaluate(sx * V { frequency }, sy * frequency, g), V { std::ldexp(1.0f, -(int)i) }, s);
+                    }
+                    s.store(row + x);
+                }
+            }
+        });
+    }
+
+    /**
+     `CloudNoise::density` of every texel from the sum. Runs of vectors the fall-off trims have no partial sum
+     of their octave count and are evaluated, one octave dispatch per run, as is the scalar tail of each row.
+     */
+    void reshape(CloudFieldParameters const& params) {
+        parallel_for_2d(pool, width, height, width, band_height, [&](size_t, size_t y0, size_t, size_t y1) {
+            const float scale = 1.f / params.grid_size;
+            for ( uint32_t y = (uint32_t)y0; y < y1; y += 1 ) {
+                float* out = density.data() + (size_t)y * width;
+                const float* row = sum.data() + (size_t)y * width;
+                const float sy = ((float)y + 0.5f) * scale;
+                uint32_t x = CloudNoise::for_each_octave_run<V>(0, width, y, width, height, params, [&](uint32_t begin, uint32_t end, uint32_t octaves) {
+                    if ( octaves == CloudNoise::hidden ) {
+                        std::fill(out + begin, out + end, 0.0f);
+                    } else if ( octaves == sum_count ) {
+                        for ( uint32_t i = begin; i < end; i += V::width )
+                            CloudNoise::shape(V::load(row + i), i, y, width, height, params).store(out + i);
+                    } else {
+                        Fractal::dispatch_octaves<Fractal::Perlin>({ Fractal::BasisKind::Perlin, octaves, 2.0f, 0.5f }, [&](auto const& fbm) {
+                            for ( uint32_t i = begin; i < end; i += V::width ) {
+                                V sx = (Simd::ramp<V>((float)i) + V { 0.5f }) * V { scale };
+                                CloudNoise::shape(fbm(sx, sy, g), i, y, width, height, params).store(out + i);
+                            }
+                        });
+                    }
+                });
+                for ( ; x < width; x += 1 )
+                    out[x] = CloudNoise::density(x, y, width, height, params, g);
+            }
+        });
+    }
+
+public:
+    explicit CloudLayerCache(ThreadPool& pool, CloudBaseBand band = default_base_band)
+        : pool(pool), band({ std::max(band.octaves, 1u), band.shift }) {}
+
+    /** generate the field for `params` at `w` x `h`, a generator for `CloudFieldCache` */
+    void operator()(CloudFieldParameters const& params, uint32_t w, uint32_t h) {
+        uint64_t key = lattice_key(params, w, h);
+        if ( !valid || key != lattice ) {
+            width = w;
+            height = h;
+            g = CloudNoise::make_gradient_table(NoiseTable::make(params.seed));
+            base_width = cloud_base_size(w, band.shift);
+            base_height = cloud_base_size(h, band.shift);
+            base_pitch = (base_width + V::width - 1) / V::width * V::width;
+            base.assign(base_pitch * base_height, 0.0f);
+            base_count = 0;
+            sum.resize((size_t)w * h);
+            sum_count = 0;
+            density.resize((size_t)w * h);
+            lattice = key;
+            valid = true;
+        }
+
+        const uint32_t n = params.octaves;
+        const uint32_t base_octaves = std::min(band.octaves, n);
+        bool fresh_base = base_count != base_octaves;
+        if ( fresh_base ) {
+            evaluate_base(base_octaves, params.grid_size);
+            base_count = base_octaves;
+            sum_count = 0;
+            stats.octaves_evaluated += base_octaves;
+        }
+
+        if ( sum_count == 0 || sum_count > n ) {
+            expand_base();
+            sum_count = base_count;
+            if ( !fresh_base ) stats.octaves_reused += base_count;
+        } else {
+            stats.octaves_reused += sum_count;
+        }
+        if ( sum_count < n ) {
+            add_octaves(n, params.grid_size);
+            stats.octaves_evaluated += n - sum_count;
+            sum_count = n;
+        }
+
+        reshape(params);
+        stats.generations += 1;
+    }
+
+    /** bytes held by the base band and the sum, the density map aside */
+    size_t layer_bytes() const { return (base.size() + sum.size()) * sizeof(float); }
+
+    inline CloudBaseBand const& get_band() const { return band; }
+    inline const float* data() const { return density.data(); }
+    inline uint32_t get_width() const { return width; }
+    inline uint32_t get_height() const { return height; }
+    inline Stats const& get_stats() const { return stats; }
+};
@@ -0,0 +1,97 @@
+// CPU implementation of the cloud density and normal kernels
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+
+#include "SharedTypes.h"
+#include "CloudNoise.hpp"
+#include "NormalMap.hpp"
+#include "SIMD.hpp"
+#include "ThreadPool.hpp"
+
+/**
+ The density map together with the normal map derived from it by a 3x3 Sobel filter.
+ `generate_two_pass` mirrors `generate_cloud_density_map` followed by `generate_normal_map`;
+ `generate_fused` mirrors `generate_cloud_maps`, which evaluates each tile's densities plus a one texel halo
+ into local storage and takes the normals from there, so the full density map is written once and never read back.
+ Both clamp neighbors to the map edge and store normals in a `NormalMap` encoding.
+ */
+namespace CloudMaps {
+
+    /** matches CLOUD_MAP_TILE_SIZE, the shader's threadgroup tile */
+    constexpr uint32_t gpu_tile_size = CLOUD_MAP_TILE_SIZE;
+
+    /** 256 x 64 texels plus halo: a 67 KB local copy, 4% of the densities evaluated twice */
+    constexpr uint32_t default_tile_width = 256;
+    constexpr uint32_t default_tile_height = 64;
+
+    /**
+     Density then normals, each over the whole map: the normal pass reads every density back
+     */
+    template <class V = Simd::f32x8, class Encoding = NormalMap::XYZ8>
+    inline void generate_two_pass(ThreadPool& pool, float* density, typename Encoding::Texel* normals, uint32_t width, uint32_t height,
+                                  CloudFieldParameters const& params, NoiseTable::GradientTable const& g,
+                                  uint32_t tile_width = default_tile_width, uint32_t tile_height = default_tile_height)
+    {
+        CloudNoise::generate_tiled<V>(pool, density, width, height, width, params, g, tile_width, tile_height);
+        NormalMap::generate<V, Encoding>(pool, density, width, width, height, normals, width, NormalMap::Border::Clamp);
+    }
+
+    /**
+     Densities and normals of the tile [x0, x1) x [y0, y1): its densities and halo go to a local buffer,
+     the tile's own texels are copied out and its normals are taken from the local buffer.
+     `fbm` is what `Fractal::dispatch` picked for `CloudNoise::fbm_config(params)`.
+     */
+    template <class V = Simd::f32x8, class Encoding = NormalMap::XYZ8, class Fbm>
+    inline void generate_fused_tile(float* density, typename Encoding::Texel* normals, uint32_t width, uint32_t height,
+                                    CloudFieldParameters const& params, Fbm const& fbm, NoiseTable::GradientTable const& g,
+                                    uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1)
+    {
+        // the halo is clamped to the map, so at an edge it is one texel narrower
+        uint32_t lx0 = x0 > 0 ? x0 - 1 : 0, lx1 = std::min(x1 + 1, width);
+        uint32_t ly0 = y0 > 0 ? y0 - 1 : 0, ly1 = std::min(y1 + 1, height);
+        size_t pitch = lx1 - lx0;
+
+        thread_local std::vector<float> local;
+        local.resize(pitch * (ly1 - ly0));
+
+        for ( uint32_t y = ly0; y < ly1; y += 1 ) {
+            float* row = local.data() + (y - ly0) * pitch - lx0;
+            auto [first, last] = CloudNoise::clip_span(CloudNoise::visible_span(y, width, height, params), lx0, lx1);
+            // whole vectors from lx0, as `CloudNoise::generate_region` snaps them
+            first = lx0 + (first - lx0) / V::width * V::width;
+            last = std::min<uint32_t>(lx0 + (last - lx0 + V::width - 1) / V::width * V::width, lx1);
+            std::fill(row + lx0, row + first, 0.0f);
+            uint32_t x = CloudNoise::density_row<V>(row, first, last, y, width, height, params, fbm, g);
+            for ( ; x < last; x += 1 )
+                row[x] = CloudNoise::density(x, y, width, height, params, g);
+            std::fill(row + last, row + lx1, 0.0f);
+        }
+
+        for ( size_t y = y0; y < y1; y += 1 )
+            std::copy_n(local.data() + (y - ly0) * pitch + (x0 - lx0), x1 - x0, density + y * width + x0);
+        // clamping inside the local copy only ever happens at the map's own edges
+        NormalMap::generate_region<V, Encoding>(local.data(), pitch, (uint32_t)pitch, ly1 - ly0, normals + (size_t)y0 * width + x0, width,
+                                                x0 - lx0, y0 - ly0, x1 - lx0, y1 - ly0, NormalMap::Border::Clamp);
+    }
+
+    /**
+     One pass over tiles, each through `generate_fused_tile`
+     */
+    template <class V = Simd::f32x8, class Encoding = NormalMap::XYZ8>
+    inline void generate_fused(ThreadPool& pool, float* density, typename Encoding::Texel* normals, uint32_t width, uint32_t height,
+                               CloudFieldParameters const& params, NoiseTable::GradientTable const& g,
+                               uint32_t tile_width = default_tile_width, uint32_t tile_height = default_tile_height)
+    {
+        Fractal::dispatch(CloudNoise::fbm_config(params), [&](auto const& fbm) {
+            parallel_for_2d(pool, width, height, tile_width, tile_height, [&](size_t x0, size_t y0, size_t x1, size_t y1) {
+                generate_fused_tile<V, Encoding>(density, normals, width, height, params, fbm, g,
+                                                 (uint32_t)x0, (uint32_t)y0, (uint32_t)x1, (uint32_t)y1);
+            });
+        });
+    }
+}
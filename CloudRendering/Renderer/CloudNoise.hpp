@@ -0,0 +1,352 @@
+// CPU implementation of the cloud density kernel
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <utility>
+
+#include "SharedTypes.h"
+#include "NoiseTable.hpp"
+#include "FBm.hpp"
+#include "SIMD.hpp"
+#include "ThreadPool.hpp"
+
+/**
+ Mirrors `generate_cloud_density_map` in Shaders.metal so cloud maps can be generated and checked without a GPU.
+ The scalar functions follow the shader line by line and are the reference;
+ the templated ones evaluate `V::width` texels of a row per call through a `Fractal::FBm` picked for the octave count.
+ */
+namespace CloudNoise {
+
+    /**
+     The field the renderer draws by default; a `fall_off_epsilon` above 0 generates only the visible disc
+     */
+    inline CloudFieldParameters default_parameters(float fall_off_epsilon = 0.0f) {
+        return { 1u, 8u, 128.f, 1.0f, 1.0f, .6f, 0.8f, fall_off_epsilon };
+    }
+
+    using NoiseTable::GradientTable;
+    using NoiseTable::make_gradient_table;
+
+
+    // Scalar reference
+
+    inline float gaussian(float x, float peak, float center, float width) {
+        return peak * std::exp(-(x - center) * (x - center) / (2 * width * width));
+    }
+
+    inline float fall_off(float x, float top_width) {
+        if ( x < top_width ) return 1.0f;
+        return gaussian(x - top_width, 1.0f, 0.0f, 0.8f * (1.0f - top_width));
+    }
+
+    // Circular domain: what the fall-off hides, mirrored by `visible_octaves` and `generate_cloud_maps` in Shaders.metal
+
+    /** largest magnitude of the 2D Perlin basis with unit gradients */
+    constexpr float perlin_bound = 0.70710678f;
+
+    /**
+     Distance to the center, in radii, beyond which `gaussian_peak` times the fall-off is below `fall_off_epsilon`,
+     so every density is written as 0; infinite when `fall_off_epsilon` is 0
+     */
+    inline float visible_radius(CloudFieldParameters const& params) {
+        if ( !(params.fall_off_epsilon > 0.0f) ) return INFINITY;
+        float peak = std::fabs(params.gaussian_peak);
+        if ( peak <= params.fall_off_epsilon ) return -1.0f;
+        float sigma = 0.8f * (1.0f - params.fall_off_top_width);
+        return params.fall_off_top_width + sigma * std::sqrt(2.0f * std::log(peak / params.fall_off_epsilon));
+    }
+
+    /**
+     Octaves a texel with fall-off `f` needs: octaves k .. N - 1 move the sum by at most 2 `perlin_bound` (2^-k - 2^-N),
+     and the shaping gaussian moves with the sum by at most peak e^-1/2 / width, so the ones left out change
+     the density by at most `fall_off_epsilon`
+     */
+    inline uint32_t visible_octaves(float f, CloudFieldParameters const& params) {
+        const uint32_t n = params.octaves;
+        if ( !(params.fall_off_epsilon > 0.0f) || n <= 1 ) return n;
+        float slope = std::fabs(params.gaussian_peak) * 0.60653066f / params.gaussian_width;
+        float tail = params.fall_off_epsilon / (2.0f * perlin_bound * slope * f) + std::ldexp(1.0f, -(int)n);
+        if ( tail >= 1.0f ) return 1;
+        return std::clamp((uint32_t)std::ceil(-std::log2(tail)), 1u, n);
+    }
+
+    /**
+     Texels [first, second) of row `y` within `visible_radius`, one texel wider on each side than the exact span;
+     the texels outside are all 0
+     */
+    inline std::pair<uint32_t, uint32_t> visible_span(uint32_t y, uint32_t width, uint32_t height, CloudFieldParameters const& params) {
+        // before any arithmetic: the infinite radius times width / 2 == 0 would be NaN
+        if ( !(params.fall_off_epsilon > 0.0f) ) return { 0, width };
+        float r = visible_radius(params) * (float)(width / 2);
+        if ( r == INFINITY ) return { 0, width };
+
+        float dy = (float)height / 2.f - (float)y;
+        if ( r < 0.0f || std::fabs(dy) > r + 1.0f ) return { 0, 0 };
+        float half = std::sqrt(std::max(r * r - dy * dy, 0.0f)) + 1.0f;
+        float first = std::max(std::floor((float)width / 2.f - half), 0.0f);
+        float last = std::min(std::ceil((float)width / 2.f + half) + 1.0f, (float)width);
+        return { (uint32_t)first, (uint32_t)std::max(first, last) };
+    }
+
+
+    inline float fade(float t) {
+        return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+    }
+
+    inline float mix(float a, float b, float t) {
+        return a + (b - a) * t;
+    }
+
+    inline float perlin_2D(float px, float py, float grid_size, GradientTable const& g) {
+        uint32_t left = (uint32_t)std::floor(px / grid_size) & (NoiseTable::period - 1);
+        uint32_t top = (uint32_t)std::floor(py / grid_size) & (NoiseTable::period - 1);
+
+        // both tables are doubled, so left + 1 and top + 1 need no wrap
+        uint32_t aa = left + (uint32_t)g.permutation[top];
+        uint32_t ab = aa + 1;
+        uint32_t ba = left + (uint32_t)g.permutation[top + 1];
+        uint32_t bb = ba + 1;
+
+        float x = std::fmod(px, grid_size) / grid_size;
+        float y = std::fmod(py, grid_size) / grid_size;
+
+        float top_row = mix(g.x[aa] * x + g.y[aa] * y, g.x[ab] * (x - 1.f) + g.y[ab] * y, fade(x));
+        float bottom_row = mix(g.x[ba] * x + g.y[ba] * (y - 1.f), g.x[bb] * (x - 1.f) + g.y[bb] * (y - 1.f), fade(x));
+        return mix(top_row, bottom_row, fade(y));
+    }
+
+    /**
+     Density of texel (x, y) of a `width` x `height` map
+     */
+    inline float density(uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+                         CloudFieldParameters const& params, GradientTable const& g)
+    {
+        float dx = (float)width / 2.f - (float)x;
+        float dy = (float)height / 2.f - (float)y;
+        float distance_to_center = std::sqrt(dx * dx + dy * dy) / (float)(width / 2);
+        float f = fall_off(distance_to_center, params.fall_off_top_width);
+        if ( distance_to_center > visible_radius(params) ) return 0.0f;
+
+        float sum = 0.0f;
+        float frequency = 1.0f;
+        float amplitude = 1.0f;
+
+        const uint32_t octaves = visible_octaves(f, params);
+        for ( uint32_t i = 0; i < octaves; i += 1 ) {
+            sum += perlin_2D(((float)x + 0.5f) * frequency, ((float)y + 0.5f) * frequency, params.grid_size, g) * amplitude;
+            amplitude *= 0.5f;
+            frequency *= 2.0f;
+        }
+
+        float result = gaussian(sum, params.gaussian_peak, params.gaussian_center, params.gaussian_width);
+        return result * f;
+    }
+
+
+    // SIMD
+
+    /**
+     The shader's octave sum: Perlin, lacunarity 2, gain 1/2
+     */
+    inline Fractal::Config fbm_config(CloudFieldParameters const& params) {
+        return { Fractal::BasisKind::Perlin, params.octaves, 2.0f, 0.5f };
+    }
+
+    template <class V>
+    inline V gaussian(V x, float peak, float center, float width) {
+        V d = x - V { center };
+        return V { peak } * exp(d * d * V { -1.f / (2 * width * width) });
+    }
+
+    /** what `vector_octaves` returns for texels the fall-off hides */
+    constexpr uint32_t hidden = ~0u;
+
+    /**
+     Octaves texels (x, y) .. (x + V::width - 1, y) need. The lane nearest the center sees the least fall-off
+     and decides for all of them; `params.octaves` when `fall_off_epsilon` is 0.
+     */
+    template <class V>
+    inline uint32_t vector_octaves(uint32_t x, uint32_t y, uint32_t width, uint32_t height, CloudFieldParameters const& params) {
+        if ( !(params.fall_off_epsilon > 0.0f) ) return params.octaves;
+
+        float nx = std::clamp((float)width / 2.f, (float)x, (float)(x + V::width - 1)) - (float)width / 2.f;
+        float ny = (float)height / 2.f - (float)y;
+        float nearest = std::sqrt(nx * nx + ny * ny) / (float)(width / 2);
+        if ( nearest > visible_radius(params) ) return hidden;
+        return visible_octaves(fall_off(nearest, params.fall_off_top_width), params);
+    }
+
+    /**
+     Densities of texels (x, y) .. (x + V::width - 1, y) from their octave sums: the shaping gaussian and the fall-off
+     */
+    template <class V>
+    inline V shape(V sum, uint32_t x, uint32_t y, uint32_t width, uint32_t height, CloudFieldParameters const& params) {
+        V result = gaussian(sum, params.gaussian_peak, params.gaussian_center, params.gaussian_width);
+
+        V dx = V { (float)width / 2.f } - Simd::ramp<V>((float)x);
+        float dy = (float)height / 2.f - (float)y;
+        V distance_to_center = sqrt(fma(dx, dx, V { dy * dy })) / V { (float)(width / 2) };
+
+        float top_width = params.fall_off_top_width;
+        V outside = distance_to_center >= V { top_width };
+        if ( any(outside) )
+            result = select(outside, result, result * gaussian(distance_to_center - V { top_width }, 1.0f, 0.0f, 0.8f * (1.0f - top_width)));
+        return result;
+    }
+
+    /**
+     Split the whole vectors of row `y` from `x` up to `last` into runs of the same `vector_octaves`, and call
+     `f(begin, end, octaves)` once per run; returns where the whole vectors end, for the scalar tail.
+     Up to the vector holding the center the vectors get nearer to it, after it farther, so on either side
+     each octave count covers one stretch of vectors and a binary search finds where the run ends.
+     */
+    template <class V, class F>
+    inline uint32_t for_each_octave_run(uint32_t x, uint32_t last, uint32_t y, uint32_t width, uint32_t height,
+                                        CloudFieldParameters const& params, F&& f)
+    {
+        while ( x + V::width <= last ) {
+            uint32_t octaves = vector_octaves<V>(x, y, width, height, params);
+            uint32_t side = (last - x) / V::width;
+            float ahead = (float)width / 2.f - (float)(x + V::width - 1);
+            if ( ahead > 0.0f ) side = std::min(side, (uint32_t)std::ceil(ahead / (float)V::width) + 1);
+
+            // the run is the first `lo` vectors, often the whole side
+            uint32_t lo = 1, hi = side;
+            if ( vector_octaves<V>(x + (side - 1) * V::width, y, width, height, params) == octaves ) lo = side;
+            while ( lo < hi ) {
+                uint32_t mid = (lo + hi + 1) / 2;
+                if ( vector_octaves<V>(x + (mid - 1) * V::width, y, width, height, params) == octaves ) lo = mid;
+                else hi = mid - 1;
+            }
+            uint32_t end = x + lo * V::width;
+            f(x, end, octaves);
+            x = end;
+        }
+        return x;
+    }
+
+    /**
+     Densities of the whole vectors of row `y` from `x` up to `last` into `row`, indexed by x; returns where they end.
+     `fbm` is what `Fractal::dispatch` picked for `fbm_config(params)`, and each run the fall-off trims dispatches
+     its octave count once, not once per vector.
+     */
+    template <class V, class Fbm>
+    inline uint32_t density_row(float* row, uint32_t x, uint32_t last, uint32_t y, uint32_t width, uint32_t height,
+                                CloudFieldParameters const& params, Fbm const& fbm, GradientTable const& g)
+    {
+        const float scale = 1.f / params.grid_size;
+        const float sy = ((float)y + 0.5f) * scale;
+        auto run = [&](uint32_t begin, uint32_t end, auto const& sum) {
+            for ( uint32_t i = begin; i < end; i += V::width ) {
+                V sx = (Simd::ramp<V>((float)i) + V { 0.5f }) * V { scale };
+                shape(sum(sx, sy, g), i, y, width, height, params).store(row + i);
+            }
+        };
+        return for_each_octave_run<V>(x, last, y, width, height, params, [&](uint32_t begin, uint32_t end, uint32_t octaves) {
+            if ( octaves == hidden )
+                std::fill(row + begin, row + end, 0.0f);
+            else if ( octaves < params.octaves )
+                Fractal::dispatch_octaves<Fractal::Perlin>({ Fractal::BasisKind::Perlin, octaves, 2.0f, 0.5f },
+                                                           [&](auto const& trimmed) { run(begin, end, trimmed); });
+            else
+                run(begin, end, fbm);
+        });
+    }
+
+
+    /** `span` clipped to [x_begin, x_end), empty spans collapsing to x_begin */
+    inline std::pair<uint32_t, uint32_t> clip_span(std::pair<uint32_t, uint32_t> span, uint32_t x_begin, uint32_t x_end) {
+        uint32_t first = std::clamp(span.first, x_begin, x_end);
+        uint32_t last = std::clamp(span.second, first, x_end);
+        return { first, last };
+    }
+
+
+    /**
+     Fill a `width` x `height` map, `row_pitch` floats apart, with the scalar reference
+     */
+    inline void generate_scalar(float* out, uint32_t width, uint32_t height, size_t row_pitch,
+                                CloudFieldParameters const& params, GradientTable const& g)
+    {
+        for ( uint32_t y = 0; y < height; y += 1 )
+            for ( uint32_t x = 0; x < width; x += 1 )
+                out[y * row_pitch + x] = density(x, y, width, height, params, g);
+    }
+
+    /**
+     Fill the texels [x_begin, x_end) x [y_begin, y_end) of a `width` x `height` map, `V::width` at a time
+     */
+    template <class V = Simd::f32x8>
+    inline void generate_region(float* out, uint32_t width, uint32_t height, size_t row_pitch,
+                                uint32_t x_begin, uint32_t y_begin, uint32_t x_end, uint32_t y_end,
+                                CloudFieldParameters const& params, GradientTable const& g)
+    {
+        Fractal::dispatch(fbm_config(params), [&](auto const& fbm) {
+            for ( uint32_t y = y_begin; y < y_end; y += 1 ) {
+                float* row = out + y * row_pitch;
+                auto [first, last] = clip_span(visible_span(y, width, height, params), x_begin, x_end);
+                // whole vectors from x_begin, so the octaves each vector keeps do not depend on the span
+                first = x_begin + (first - x_begin) / V::width * V::width;
+                last = std::min<uint32_t>(x_begin + (last - x_begin + V::width - 1) / V::width * V::width, x_end);
+                std::fill(row + x_begin, row + first, 0.0f);
+                uint32_t x = density_row<V>(row, first, last, y, width, height, params, fbm, g);
+                for ( ; x < last; x += 1 )
+                    row[x] = density(x, y, width, height, params, g);
+                std::fill(row + last, row + x_end, 0.0f);
+            }
+        });
+    }
+
+    template <class V = Simd::f32x8>
+    inline void generate(float* out, uint32_t width, uint32_t height, size_t row_pitch,
+                         CloudFieldParameters const& params, GradientTable const& g)
+    {
+        generate_region<V>(out, width, height, row_pitch, 0, 0, width, height, params, g);
+    }
+
+    /** 256 x 16 floats: 16 KB of output per tile, so a tile stays in L1 until a later pass reads it back */
+    constexpr uint32_t default_tile_width = 256;
+    constexpr uint32_t default_tile_height = 16;
+
+    /**
+     Generate the map in tiles spread over `pool`, writing straight into `out`, `row_pitch` floats per row.
+     Tile widths that are a multiple of `V::width` keep every store full width.
+     */
+    template <class V = Simd::f32x8>
+    inline void generate_tiled(ThreadPool& pool, float* out, uint32_t width, uint32_t height, size_t row_pitch,
+                               CloudFieldParameters const& params, GradientTable const& g,
+                               uint32_t tile_width = default_tile_width, uint32_t tile_height = default_tile_height)
+    {
+        parallel_for_2d(pool, width, height, tile_width, tile_height, [&](size_t x0, size_t y0, size_t x1, size_t y1) {
+            generate_region<V>(out, width, height, row_pitch, (uint32_t)x0, (uint32_t)y0, (uint32_t)x1, (uint32_t)y1, params, g);
+        });
+    }
+
+
+    /**
+     Largest and mean absolute difference between two maps
+     */
+    struct Comparison {
+        double max_abs_error = 0.0;
+        double mean_abs_error = 0.0;
+    };
+
+    inline Comparison compare(const float* a, size_t a_row_pitch, const float* b, size_t b_row_pitch,
+                              uint32_t width, uint32_t height)
+    {
+        Comparison c;
+        double total = 0.0;
+        for ( uint32_t y = 0; y < height; y += 1 )
+            for ( uint32_t x = 0; x < width; x += 1 ) {
+                double e = std::fabs((double)a[y * a_row_pitch + x] - (double)b[y * b_row_pitch + x]);
+                c.max_abs_error = std::max(c.max_abs_error, e);
+                total += e;
+            }
+        c.mean_abs_error = width && height ? total / ((double)width * (double)height) : 0.0;
+        return c;
+    }
+}
@@ -0,0 +1,215 @@
+// Time-sliced regeneration of the cloud maps
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <chrono>
+#include <utility>
+#include <algorithm>
+
+#include "SharedTypes.h"
+#include "CloudFieldCache.hpp"
+#include "CloudMaps.hpp"
+#include "NormalMap.hpp"
+#include "ThreadPool.hpp"
+
+/**
+ Spreads a regeneration of the cloud maps over several frames. The maps are double buffered: frames keep drawing
+ the front field while slices of tiles are generated into the back one, and the two swap once the last tile is done,
+ so what is displayed is always one consistent field. `TimeSlicer` sizes each slice to the frame budget from the
+ measured cost of the previous slices; the renderer feeds it GPU times, `CpuAmortizedCloudField` wall clock times.
+ */
+namespace CloudRegeneration {
+
+    struct Budget {
+        double   milliseconds;      // of generation per frame
+        uint32_t min_tiles;         // per slice, so a regeneration always progresses
+        uint32_t max_tiles;
+        uint32_t max_frames;        // slices a regeneration may take, overriding the other bounds; 0 for no deadline
+    };
+
+    /** half a second at 60 Hz at most, however slow the tiles turn out */
+    constexpr Budget default_budget = { 2.0, 1, ~0u, 30 };
+
+    /**
+     Hands out consecutive ranges of a regeneration's tiles, as many per frame as the budget allows
+     */
+    class TimeSlicer {
+    private:
+        Budget budget;
+        uint32_t tile_count = 0;
+        uint32_t next = 0;
+        uint32_t slices = 0;
+        double tile_milliseconds = 0.0;     // running estimate, 0 until a slice was measured
+
+        /** weight of the newest measurement, low enough that one slow frame does not halve the next slice */
+        static constexpr double smoothing = 0.25;
+
+    public:
+        explicit TimeSlicer(Budget const& budget = default_budget) : budget(budget) {}
+
+        /** begin a regeneration of `tiles` tiles, dropping any unfinished one; the cost estimate is kept */
+        inline void start(uint32_t tiles) {
+            tile_count = tiles;
+            next = 0;
+            slices = 0;
+        }
+
+        inline bool active() const { return next < tile_count; }
+
+        /**
+         Tiles [first, second) to generate this frame. Before anything was measured only `min_tiles` are handed out,
+         unless the slices left before `max_frames` need more: the deadline wins over the time budget.
+         */
+        std::pair<uint32_t, uint32_t> plan() {
+            double fit = tile_milliseconds > 0.0 ? std::floor(budget.milliseconds / tile_milliseconds) : 0.0;
+            uint32_t n = (uint32_t)std::clamp(fit, (double)budget.min_tiles, (double)budget.max_tiles);
+            if ( budget.max_frames > 0 ) {
+                uint32_t slices_left = budget.max_frames > slices ? budget.max_frames - slices : 1;
+                n = std::max(n, (tile_count - next + slices_left - 1) / slices_left);
+            }
+            n = std::min(n, tile_count - next);
+
+            std::pair<uint32_t, uint32_t> slice { next, next + n };
+            next += n;
+            slices += 1;
+            return slice;
+        }
+
+        /** cost of a finished slice of `tiles` tiles */
+        void report(uint32_t tiles, double milliseconds) {
+            if ( tiles == 0 ) return;
+            double per_tile = milliseconds / (double)tiles;
+            tile_milliseconds = tile_milliseconds > 0.0 ? tile_milliseconds + smoothing * (per_tile - tile_milliseconds) : per_tile;
+        }
+
+        inline double progress() const { return tile_count ? (double)next / (double)tile_count : 1.0; }
+        inline uint32_t get_slices() const { return slices; }
+        inline double get_tile_milliseconds() const { return tile_milliseconds; }
+        inline Budget const& get_budget() const { return budget; }
+        inline void set_budget(Budget const& b) { budget = b; }
+    };
+
+
+    /**
+     Percentiles of a run of frame times
+     */
+    struct FrameTimeSummary {
+        size_t frames = 0;
+        double p50 = 0.0;
+        double p90 = 0.0;
+        double p99 = 0.0;
+        double max = 0.0;
+    };
+
+    inline FrameTimeSummary summarize(std::vector<double> milliseconds) {
+        FrameTimeSummary s;
+        s.frames = milliseconds.size();
+        if ( milliseconds.empty() ) return s;
+
+        std::sort(milliseconds.begin(), milliseconds.end());
+        // nearest rank
+        auto at = [&](double p) { return milliseconds[std::min(milliseconds.size() - 1, (size_t)std::ceil(p * (double)milliseconds.size()) - 1)]; };
+        s.p50 = at(0.50), s.p90 = at(0.90), s.p99 = at(0.99), s.max = milliseconds.back();
+        return s;
+    }
+
+
+    /**
+     Density and normal maps generated on the CPU a slice of `CloudMaps` tiles per `step`, the headless
+     counterpart of the renderer's amortized regeneration. The very first field has nothing to replace
+     and is generated at once.
+     */
+    template <class V = Simd::f32x8, class Encoding = NormalMap::XYZ8>
+    class CpuAmortizedCloudField {
+    private:
+        struct Maps {
+            std::vector<float> density;
+            std::vector<typename Encoding::Texel> normals;
+            uint64_t key = 0;
+            bool valid = false;
+        };
+
+        ThreadPool& pool;
+        uint32_t width, height;
+        uint32_t tile_width, tile_height;
+        uint32_t tiles_x, tiles_y;
+        Maps buffers[2];
+        uint32_t front = 0;
+
+        TimeSlicer slicer;
+        CloudFieldParameters pending {};
+        uint64_t pending_key = 0;
+        NoiseTable::GradientTable g;
+
+        inline Maps& back() { return buffers[front ^ 1]; }
+
+        void generate_tiles(uint32_t first, uint32_t last) {
+            Maps& m = back();
+            Fractal::dispatch(CloudNoise::fbm_config(pending), [&](auto const& fbm) {
+                parallel_for(pool, last - first, [&](size_t i) {
+                    uint32_t tile = first + (uint32_t)i;
+                    uint32_t x0 = tile % tiles_x * tile_width, y0 = tile / tiles_x * tile_height;
+                    CloudMaps::generate_fused_tile<V, Encoding>(m.density.data(), m.normals.data(), width, height, pending, fbm, g,
+                                                                x0, y0, std::min(x0 + tile_width, width), std::min(y0 + tile_height, height));
+                });
+            });
+        }
+
+    public:
+        CpuAmortizedCloudField(ThreadPool& pool, uint32_t width, uint32_t height, Budget const& budget = default_budget,
+                               uint32_t tile_width = CloudMaps::default_tile_width, uint32_t tile_height = CloudMaps::default_tile_height)
+            : pool(pool), width(width), height(height), tile_width(tile_width), tile_height(tile_height),
+              tiles_x((width + tile_width - 1) / tile_width), tiles_y((height + tile_height - 1) / tile_height),
+              slicer(budget)
+        {
+            for ( Maps& m : buffers ) {
+                m.density.resize((size_t)width * height);
+                m.normals.resize((size_t)width * height);
+            }
+        }
+
+        /**
+         Ask for the field of `params`. Returns whether a regeneration started; one already running
+         for other parameters is abandoned.
+         */
+        bool request(CloudFieldParameters const& params) {
+            uint64_t key = cloud_field_key(params, width, height);
+            if ( slicer.active() ? key == pending_key : buffers[front].valid && key == buffers[front].key ) return false;
+
+            pending = params;
+            pending_key = key;
+            g = CloudNoise::make_gradient_table(NoiseTable::make(params.seed));
+            slicer.start(tiles_x * tiles_y);
+            if ( !buffers[front].valid ) while ( slicer.active() ) step();
+            return true;
+        }
+
+        /**
+         Generate this frame's slice. Returns whether it completed the field and the buffers swapped.
+         */
+        bool step() {
+            if ( !slicer.active() ) return false;
+
+            auto [first, last] = slicer.plan();
+            auto begin = std::chrono::steady_clock::now();
+            generate_tiles(first, last);
+            slicer.report(last - first, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count());
+
+            if ( slicer.active() ) return false;
+            back().key = pending_key;
+            back().valid = true;
+            front ^= 1;
+            return true;
+        }
+
+        inline bool regenerating() const { return slicer.active(); }
+        inline TimeSlicer const& get_slicer() const { return slicer; }
+        inline const float* density() const { return buffers[front].density.data(); }
+        inline const typename Encoding::Texel* normals() const { return buffers[front].normals.data(); }
+        inline uint32_t get_width() const { return width; }
+        inline uint32_t get_height() const { return height; }
+    };
+}
@@ -0,0 +1,445 @@
+// Sparse virtual texturing of the cloud density map
+#pragma once
+
+#include <vector>
+#include <bit>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <simd/simd.h>
+
+#include "SharedTypes.h"
+#include "CloudNoise.hpp"
+#include "CloudFieldCache.hpp"
+#include "SIMD.hpp"
+#include "ThreadPool.hpp"
+
+/**
+ The density map as a mip pyramid of pages of which only the ones the camera sees are generated.
+ `Feedback` walks the dome's triangles through the view and lists the pages and levels their uvs cover;
+ `VirtualCloudField` keeps up to one atlas full of pages resident, evicting the least recently used, and maintains
+ the indirection table `draw_skydome_virtual` looks pages up in. A page missing at one level falls back to its
+ finest resident ancestor, and the single page of the coarsest level is always resident.
+ */
+namespace VirtualTexture {
+
+    /** texels around each page copied from its neighbors, so bilinear filtering never reads another slot */
+    constexpr uint32_t border = 1;
+
+    struct Config {
+        uint32_t virtual_size;      // texels per side of level 0, a power of two
+        uint32_t page_size;         // texels per side of a page, a power of two dividing `virtual_size`
+        uint32_t slots_x;           // atlas size in pages
+        uint32_t slots_y;
+    };
+
+    /** a 16384^2 field, 384 resident pages of 130^2: 6.5M texels, room for what a 1080p view of the dome samples */
+    constexpr Config default_config = { 16384, 128, 24, 16 };
+
+    inline uint32_t level_count(Config const& c) {
+        return (uint32_t)std::countr_zero(c.virtual_size / c.page_size) + 1;
+    }
+
+    inline uint32_t pages_per_side(Config const& c, uint32_t level) {
+        return (c.virtual_size >> level) / c.page_size;
+    }
+
+    inline CloudVirtualLayout make_layout(Config const& c) {
+        CloudVirtualLayout layout {};
+        layout.virtual_size = c.virtual_size;
+        layout.page_size = c.page_size;
+        layout.slot_size = c.page_size + 2 * border;
+        // a config of more levels keeps the finest CLOUD_VIRTUAL_MAX_LEVELS, the coarsest of them then has several pages
+        layout.levels = std::min<uint32_t>(level_count(c), CLOUD_VIRTUAL_MAX_LEVELS);
+        uint32_t offset = 0;
+        for ( uint32_t l = 0; l < layout.levels; l += 1 ) {
+            layout.level_offset[l] = offset;
+            offset += pages_per_side(c, l) * pages_per_side(c, l);
+        }
+        return layout;
+    }
+
+    /** pages of every level together, the length of the indirection table */
+    inline uint32_t page_count(CloudVirtualLayout const& layout) {
+        uint32_t last = (layout.virtual_size >> (layout.levels - 1)) / layout.page_size;
+        return layout.level_offset[layout.levels - 1] + last * last;
+    }
+
+    inline uint32_t pack_entry(uint32_t slot_x, uint32_t slot_y, uint32_t level) {
+        return slot_x | slot_y << 12 | level << 24;
+    }
+
+    /**
+     `params`, made for a `base_size` map, on a `virtual_size` one: the same clouds, with an octave of detail
+     for every doubling of the resolution
+     */
+    inline CloudFieldParameters virtual_parameters(CloudFieldParameters params, uint32_t base_size, uint32_t virtual_size) {
+        uint32_t doublings = (uint32_t)std::countr_zero(virtual_size / base_size);
+        params.grid_size *= (float)(virtual_size / base_size);
+        params.octaves += doublings;
+        return params;
+    }
+
+    /**
+     Parameters of level `level`: the level 0 field at half the resolution per level, minus the octave each halving hides
+     */
+    inline CloudFieldParameters level_parameters(CloudFieldParameters params, uint32_t level) {
+        params.grid_size /= (float)(1u << level);
+        params.octaves = params.octaves > level ? params.octaves - level : 1;
+        return params;
+    }
+
+    /**
+     Level closest to one texel per pixel, `texel_area` level 0 texels covering `pixel_area` pixels.
+     Rounds like the shader's selection, so the feedback asks for the pages the fragments read.
+     */
+    inline uint32_t select_level(float texel_area, float pixel_area, uint32_t levels) {
+        if ( !(pixel_area > 0.0f) || !(texel_area > 0.0f) ) return 0;
+        float lod = 0.5f * std::log2(texel_area / pixel_area);
+        return (uint32_t)std::clamp(std::floor(lod + 0.5f), 0.0f, (float)(levels - 1));
+    }
+
+
+    /**
+     CPU feedback pass: which pages the dome's visible triangles sample, at the level their screen size asks for.
+     Triangles entirely outside one clip plane are skipped; one crossing the camera plane asks for level 0.
+     Each triangle requests every page under its uv bounds, widened by `uv_dilation` for anything that
+     displaces the lookups, such as the flow of `CloudAnimation`.
+     */
+    class Feedback {
+    private:
+        std::vector<uint32_t> marks;    // frame stamp per page, so nothing has to be cleared
+        uint32_t stamp = 0;
+        std::vector<uint32_t> pages;
+
+    public:
+        std::vector<uint32_t> const& collect(Vertex const* vertices, uint32_t const* indices, size_t index_count,
+                                             simd::float4x4 const& clip, float viewport_width, float viewport_height,
+                                             CloudVirtualLayout const& layout, float uv_dilation = 0.0f)
+        {
+            marks.resize(page_count(layout), 0);
+            stamp += 1;
+            if ( stamp == 0 ) {
+                std::fill(marks.begin(), marks.end(), 0);
+                stamp = 1;
+            }
+            pages.clear();
+
+            const float texels = (float)layout.virtual_size;
+            for ( size_t t = 0; t + 2 < index_count; t += 3 ) {
+                Vertex const* v[3] = { &vertices[indices[t]], &vertices[indices[t + 1]], &vertices[indices[t + 2]] };
+                simd::float4 c[3];
+                for ( int i = 0; i < 3; i += 1 )
+                    c[i] = clip * simd::make_float4(v[i]->position.x, v[i]->position.y, v[i]->position.z, 1.0f);
+
+                // outside if all three corners are beyond the same plane, z in [0, w] as in Metal
+                auto beyond = [&](auto outside) { return outside(c[0]) && outside(c[1]) && outside(c[2]); };
+                if ( beyond([](simd::float4 p) { return p.x < -p.w; }) || beyond([](simd::float4 p) { return p.x > p.w; }) ||
+                     beyond([](simd::float4 p) { return p.y < -p.w; }) || beyond([](simd::float4 p) { return p.y > p.w; }) ||
+                     beyond([](simd::float4 p) { return p.z < 0.0f; }) || beyond([](simd::float4 p) { return p.z > p.w; }) )
+                    continue;
+
+                simd::float2 uv0 = v[0]->uv, uv1 = v[1]->uv, uv2 = v[2]->uv;
+                float texel_area = 0.5f * std::fabs((uv1.x - uv0.x) * (uv2.y - uv0.y) - (uv2.x - uv0.x) * (uv1.y - uv0.y)) * texels * texels;
+
+                uint32_t level = 0;
+                if ( c[0].w > 1e-6f && c[1].w > 1e-6f && c[2].w > 1e-6f ) {
+                    float px[3], py[3];
+                    for ( int i = 0; i < 3; i += 1 ) {
+                        px[i] = c[i].x / c[i].w * 0.5f * viewport_width;
+                        py[i] = c[i].y / c[i].w * 0.5f * viewport_height;
+                    }
+                    float pixel_area = 0.5f * std::fabs((px[1] - px[0]) * (py[2] - py[0]) - (px[2] - px[0]) * (py[1] - py[0]));
+                    level = select_level(texel_area, pixel_area, layout.levels);
+                }
+
+                float u_min = std::min({ uv0.x, uv1.x, uv2.x }) - uv_dilation, u_max = std::max({ uv0.x, uv1.x, uv2.x }) + uv_dilation;
+                float v_min = std::min({ uv0.y, uv1.y, uv2.y }) - uv_dilation, v_max = std::max({ uv0.y, uv1.y, uv2.y }) + uv_dilation;
+
+                uint32_t n = (layout.virtual_size >> level) / layout.page_size;
+                auto page = [n](float f) { return (uint32_t)std::clamp(f * (float)n, 0.0f, (float)(n - 1)); };
+                for ( uint32_t y = page(v_min); y <= page(v_max); y += 1 )
+                    for ( uint32_t x = page(u_min); x <= page(u_max); x += 1 ) {
+                        uint32_t index = layout.level_offset[level] + y * n + x;
+                        if ( marks[index] == stamp ) continue;
+                        marks[index] = stamp;
+                        pages.push_back(index);
+                    }
+            }
+            return pages;
+        }
+    };
+
+
+    /**
+     Resident pages of the virtual density map: a CPU atlas the renderer uploads, an LRU over its slots,
+     and the indirection table. `update` generates missing pages in parallel, coarsest first, up to a per-frame budget.
+     */
+    class VirtualCloudField {
+    public:
+        struct Stats {
+            size_t requested = 0;       // pages asked for
+            size_t hits = 0;            // already resident
+            size_t misses = 0;          // generated
+            size_t deferred = 0;        // missing, left for a later frame by the budget
+            size_t evictions = 0;
+            size_t resident = 0;
+
+            inline double hit_ratio() const { return requested ? (double)hits / (double)requested : 0.0; }
+
+            inline Stats& operator+=(Stats const& s) {
+                requested += s.requested, hits += s.hits, misses += s.misses;
+                deferred += s.deferred, evictions += s.evictions, resident = s.resident;
+                return *this;
+            }
+        };
+
+    private:
+        static constexpr uint32_t none = ~0u;
+
+        Config config;
+        CloudVirtualLayout layout;
+        uint32_t atlas_width;
+        uint32_t atlas_height;
+        std::vector<float> atlas;
+
+        CloudFieldParameters params {};
+        uint64_t params_key = 0;
+        NoiseTable::GradientTable g;
+
+        std::vector<uint32_t> indirection;
+        std::vector<uint32_t> page_slot;        // slot of each page, or `none`
+        std::vector<uint32_t> page_level;       // level of each page index
+
+        // slots in least to most recently used order, as an intrusive list; the pinned root slot is not in it
+        struct Slot {
+            uint32_t page = none;
+            uint64_t last_used = 0;
+            uint32_t prev = none, next = none;
+        };
+        std::vector<Slot> slots;
+        uint32_t lru_head = none, lru_tail = none;
+        uint32_t root_slot = 0;
+        uint64_t frame = 0;
+
+        std::vector<uint32_t> dirty_slots;
+        bool indirection_dirty = true;
+        Stats last;
+        Stats total;
+
+        inline uint32_t root_page() const { return layout.level_offset[layout.levels - 1]; }
+
+        inline uint32_t page_x(uint32_t page) const { return (page - layout.level_offset[page_level[page]]) % pages_per_side(config, page_level[page]); }
+        inline uint32_t page_y(uint32_t page) const { return (page - layout.level_offset[page_level[page]]) / pages_per_side(config, page_level[page]); }
+
+        void unlink(uint32_t s) {
+            Slot& slot = slots[s];
+            (slot.prev == none ? lru_head : slots[slot.prev].next) = slot.next;
+            (slot.next == none ? lru_tail : slots[slot.next].prev) = slot.prev;
+            slot.prev = slot.next = none;
+        }
+
+        void push_back(uint32_t s) {
+            slots[s].prev = lru_tail;
+            slots[s].next = none;
+            (lru_tail == none ? lru_head : slots[lru_tail].next) = s;
+            lru_tail = s;
+        }
+
+        inline void touch(uint32_t s) {
+            slots[s].last_used = frame;
+            if ( s == root_slot ) return;
+            unlink(s);
+            push_back(s);
+        }
+
+        /**
+         Densities of `page` and its border into its slot, neighbors past the map edge clamped to it
+         */
+        template <class V = Simd::f32x8>
+        void generate_page(uint32_t page, uint32_t s) {
+            const uint32_t level = page_level[page];
+            const uint32_t size = config.virtual_size >> level;
+            const uint32_t ps = config.page_size, side = layout.slot_size;
+            CloudFieldParameters p = level_parameters(params, level);
+            float* out = atlas.data() + (size_t)(s / config.slots_x) * side * atlas_width + (s % config.slots_x) * side;
+
+            // texels x0 - 1 .. x0 + ps of the level, clipped to the map
+            const int64_t x0 = (int64_t)page_x(page) * ps - border, y0 = (int64_t)page_y(page) * ps - border;
+            const uint32_t first = (uint32_t)std::max<int64_t>(x0, 0);
+            const uint32_t last = (uint32_t)std::min<int64_t>(x0 + side, size);
+
+            Fractal::dispatch(CloudNoise::fbm_config(p), [&](auto const& fbm) {
+                for ( uint32_t j = 0; j < side; j += 1 ) {
+                    uint32_t y = (uint32_t)std::clamp<int64_t>(y0 + j, 0, size - 1);
+                    float* row = out + (size_t)j * atlas_width;
+                    auto [visible_first, visible_last] = CloudNoise::clip_span(CloudNoise::visible_span(y, size, size, p), first, last);
+                    std::fill(row + (first - x0), row + (visible_first - x0), 0.0f);
+                    uint32_t x = CloudNoise::density_row<V>(row - x0, visible_first, visible_last, y, size, size, p, fbm, g);
+                    for ( ; x < visible_last; x += 1 )
+                        row[x - x0] = CloudNoise::density(x, y, size, size, p, g);
+                    std::fill(row + (visible_last - x0), row + (last - x0), 0.0f);
+                    if ( x0 < 0 ) row[0] = row[1];
+                    if ( x0 + side > size ) row[side - 1] = row[side - 2];
+                }
+            });
+        }
+
+        void rebuild_indirection() {
+            // coarsest first: a page that is not resident inherits its parent's entry
+            for ( uint32_t l = layout.levels; l-- > 0; ) {
+                uint32_t n = pages_per_side(config, l);
+                for ( uint32_t y = 0; y < n; y += 1 )
+                    for ( uint32_t x = 0; x < n; x += 1 ) {
+                        uint32_t index = layout.level_offset[l] + y * n + x;
+                        uint32_t s = page_slot[index];
+                        if ( s != none )
+                            indirection[index] = pack_entry(s % config.slots_x, s / config.slots_x, l);
+                        else if ( l + 1 < layout.levels )
+                            indirection[index] = indirection[layout.level_offset[l + 1] + (y / 2) * (n / 2) + x / 2];
+                        else
+                            // only when `make_layout` clamped the levels: the coarsest has several pages and no parent
+                            indirection[index] = indirection[root_page()];
+                    }
+            }
+            indirection_dirty = true;
+        }
+
+    public:
+        VirtualCloudField(Config const& config, CloudFieldParameters const& params)
+            : config(config),
+              layout(make_layout(config)),
+              atlas_width(config.slots_x * (config.page_size + 2 * border)),
+              atlas_height(config.slots_y * (config.page_size + 2 * border)),
+              atlas((size_t)atlas_width * atlas_height, 0.0f),
+              indirection(page_count(layout), 0),
+              page_slot(page_count(layout), none),
+              page_level(page_count(layout)),
+              slots((size_t)config.slots_x * config.slots_y)
+        {
+            for ( uint32_t l = 0; l < layout.levels; l += 1 ) {
+                uint32_t end = l + 1 < layout.levels ? layout.level_offset[l + 1] : page_count(layout);
+                std::fill(page_level.begin() + layout.level_offset[l], page_level.begin() + end, l);
+            }
+            for ( uint32_t s = 0; s < slots.size(); s += 1 )
+                if ( s != root_slot ) push_back(s);
+            set_parameters(params);
+        }
+
+        /**
+         Switch to the field of `params`, given for level 0. A change flushes every page but the regenerated root.
+         */
+        void set_parameters(CloudFieldParameters const& p) {
+            uint64_t key = cloud_field_key(p, config.virtual_size, config.virtual_size);
+            if ( key == params_key && slots[root_slot].page != none ) return;
+
+            params = p;
+            params_key = key;
+            g = CloudNoise::make_gradient_table(NoiseTable::make(p.seed));
+
+            std::fill(page_slot.begin(), page_slot.end(), none);
+            for ( Slot& s : slots ) s.page = none;
+            slots[root_slot].page = root_page();
+            page_slot[root_page()] = root_slot;
+
+            dirty_slots.push_back(root_slot);
+            generate_page(root_page(), root_slot);
+            rebuild_indirection();
+        }
+
+        /**
+         Make the pages of `requested`, as `Feedback` lists them, resident. At most `max_new_pages` are generated,
+         coarsest first; the others wait for a later frame and are drawn from their ancestors until then.
+         */
+        Stats update(std::vector<uint32_t> const& requested, ThreadPool& pool, size_t max_new_pages) {
+            frame += 1;
+            Stats s;
+            s.requested = requested.size();
+
+            std::vector<uint32_t> missing;
+            for ( uint32_t page : requested ) {
+                if ( page_slot[page] != none ) {
+                    touch(page_slot[page]);
+                    s.hits += 1;
+                } else {
+                    missing.push_back(page);
+                }
+            }
+            // higher indices are coarser levels
+            std::sort(missing.begin(), missing.end(), std::greater<uint32_t>());
+
+            std::vector<std::pair<uint32_t, uint32_t>> jobs;     // page, slot
+            for ( uint32_t page : missing ) {
+                // the front is the least recently used; if it was used this frame, so was every slot
+                if ( jobs.size() == max_new_pages || lru_head == none || slots[lru_head].last_used == frame ) {
+                    s.deferred += 1;
+                    continue;
+                }
+                uint32_t slot = lru_head;
+                if ( slots[slot].page != none ) {
+                    page_slot[slots[slot].page] = none;
+                    s.evictions += 1;
+                }
+                slots[slot].page = page;
+                page_slot[page] = slot;
+                touch(slot);
+                jobs.push_back({ page, slot });
+                dirty_slots.push_back(slot);
+            }
+            s.misses = jobs.size();
+
+            parallel_for(pool, jobs.size(), [&](size_t i) { generate_page(jobs[i].first, jobs[i].second); });
+            if ( !jobs.empty() ) rebuild_indirection();
+
+            for ( Slot const& slot : slots ) s.resident += slot.page != none;
+            last = s;
+            total += s;
+            return s;
+        }
+
+        /**
+         Density at uv through the indirection table at `level`, as `draw_skydome_virtual` samples it
+         */
+        float sample(float u, float v, uint32_t level) const {
+            level = std::min(level, layout.levels - 1);
+            u = std::clamp(u, 0.0f, 1.0f), v = std::clamp(v, 0.0f, 1.0f);
+            uint32_t n = pages_per_side(config, level);
+            uint32_t px = std::min((uint32_t)(u * (float)n), n - 1), py = std::min((uint32_t)(v * (float)n), n - 1);
+            uint32_t entry = indirection[layout.level_offset[level] + py * n + px];
+
+            uint32_t resident_level = entry >> 24;
+            float rn = (float)pages_per_side(config, resident_level);
+            float fu = u * rn, fv = v * rn;
+            fu -= std::min(std::floor(fu), rn - 1.0f), fv -= std::min(std::floor(fv), rn - 1.0f);
+
+            // texel centers of the slot at i + 0.5, as a pixel coordinate sampler reads them
+            float x = (float)((entry & 0xFFF) * layout.slot_size + border) + fu * (float)config.page_size - 0.5f;
+            float y = (float)((entry >> 12 & 0xFFF) * layout.slot_size + border) + fv * (float)config.page_size - 0.5f;
+            uint32_t x0 = (uint32_t)x, y0 = (uint32_t)y;
+            float tx = x - (float)x0, ty = y - (float)y0;
+            const float* a = atlas.data() + (size_t)y0 * atlas_width + x0;
+            float top = a[0] + (a[1] - a[0]) * tx;
+            float bottom = a[atlas_width] + (a[atlas_width + 1] - a[atlas_width]) * tx;
+            return top + (bottom - top) * ty;
+        }
+
+        /** top left texel of slot `s` in the atlas */
+        inline uint32_t slot_x(uint32_t s) const { return s % config.slots_x * layout.slot_size; }
+        inline uint32_t slot_y(uint32_t s) const { return s / config.slots_x * layout.slot_size; }
+
+        /** slots written, and whether the indirection table changed, since the last `clear_dirty` */
+        inline std::vector<uint32_t> const& get_dirty_slots() const { return dirty_slots; }
+        inline bool is_indirection_dirty() const { return indirection_dirty; }
+        inline void clear_dirty() { dirty_slots.clear(); indirection_dirty = false; }
+
+        inline const float* atlas_data() const { return atlas.data(); }
+        inline uint32_t get_atlas_width() const { return atlas_width; }
+        inline uint32_t get_atlas_height() const { return atlas_height; }
+        inline std::vector<uint32_t> const& get_indirection() const { return indirection; }
+        inline CloudVirtualLayout const& get_layout() const { return layout; }
+        inline Stats const& get_last_stats() const { return last; }
+        inline Stats const& get_total_stats() const { return total; }
+    };
+}
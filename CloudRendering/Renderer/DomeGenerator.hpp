@@ -0,0 +1,144 @@
+// Procedural skydome mesh
+#pragma once
+
+#include <cmath>
+#include <numbers>
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#include <simd/simd.h>
+
+#include "SharedTypes.h"
+#include "Mesh.hpp"
+
+namespace DomeGenerator {
+
+    /**
+     Shape and texture mapping of the dome. The defaults reproduce Assets/hemisphere.obj:
+     a squashed hemisphere reaching slightly below the horizon, textured through a stereographic
+     projection of the unit hemisphere onto the disc `generate_cloud_density_map` fills
+     (fitted to the asset's uvs, median deviation 0.002).
+     */
+    struct DomeShape {
+        float radius = 0.993674f;           // horizontal semi-axis
+        float height = 0.446913f;           // vertical semi-axis
+        float max_polar_angle = 1.598693f;  // radians from the zenith, a little past pi / 2
+
+        float uv_scale = 0.402700f;         // uv distance per unit of tan(polar / 2)
+        float uv_rotation = -1.679800f;     // radians between +x and the texture's u axis
+        simd::float2 uv_center = simd::make_float2(0.490011f, 0.501134f);
+    };
+
+    /**
+     Vertex on the dome at `polar` radians from the zenith and `azimuth` radians around it from +x.
+     Normals face the centre, where the camera sits, like the asset's.
+     */
+    inline Vertex make_vertex(float polar, float azimuth, DomeShape const& shape) {
+        float s = std::sin(polar), c = std::cos(polar);
+        float ca = std::cos(azimuth), sa = std::sin(azimuth);
+
+        Vertex v {};
+        v.position = simd::make_float3(shape.radius * s * ca, shape.height * c, shape.radius * s * sa);
+
+        // ellipsoid gradient, flipped inwards
+        simd::float3 n = simd::make_float3(-s * ca / shape.radius, -c / shape.height, -s * sa / shape.radius);
+        float len = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+        v.normal = simd::make_float3(n.x / len, n.y / len, n.z / len);
+
+        float t = std::tan(polar * 0.5f);
+        float x = t * ca, y = t * sa;
+        float cr = std::cos(shape.uv_rotation), sr = std::sin(shape.uv_rotation);
+        v.uv = simd::make_float2(shape.uv_center.x + shape.uv_scale * (cr * x - sr * y),
+                                 shape.uv_center.y + shape.uv_scale * (sr * x + cr * y));
+        return v;
+    }
+
+    /**
+     Latitude / longitude dome: a zenith vertex, `rings` rings down to the horizon, `segments` vertices per ring.
+     Produces segments * (2 * rings - 1) triangles. The stereographic uvs are continuous across
+     azimuth 0 / 2pi, so rings wrap without a seam column.
+     */
+    inline Mesh uv_sphere(uint32_t rings, uint32_t segments, DomeShape const& shape = DomeShape {}) {
+        Mesh mesh;
+        if ( rings == 0 || segments < 3 ) return mesh;
+
+        mesh.vertices.reserve(1 + (size_t)rings * segments);
+        mesh.indices.reserve((size_t)segments * (2 * rings - 1) * 3);
+
+        mesh.vertices.push_back(make_vertex(0.0f, 0.0f, shape));
+        for ( uint32_t r = 1; r <= rings; r += 1 ) {
+            float polar = shape.max_polar_angle * (float)r / (float)rings;
+            for ( uint32_t s = 0; s < segments; s += 1 )
+                mesh.vertices.push_back(make_vertex(polar, 2.0f * std::numbers::pi_v<float> * (float)s / (float)segments, shape));
+        }
+
+        auto ring_vertex = [&](uint32_t ring, uint32_t segment) {
+            return 1 + (ring - 1) * segments + segment % segments;
+        };
+
+        // winding matches the asset: (b - a) x (c - a) faces the centre
+        for ( uint32_t s = 0; s < segments; s += 1 ) {
+            mesh.indices.insert(mesh.indices.end(), { 0, ring_vertex(1, s), ring_vertex(1, s + 1) });
+        }
+        for ( uint32_t r = 1; r < rings; r += 1 ) {
+            for ( uint32_t s = 0; s < segments; s += 1 ) {
+                uint32_t a = ring_vertex(r, s), b = ring_vertex(r, s + 1);
+                uint32_t c = ring_vertex(r + 1, s), d = ring_vertex(r + 1, s + 1);
+                mesh.indices.insert(mesh.indices.end(), { a, c, b });
+                mesh.indices.insert(mesh.indices.end(), { b, c, d });
+            }
+        }
+        return mesh;
+    }
+
+    /**
+     Geodesic dome: the upper four faces of an octahedron, each split into 4 `subdivisions` times
+     and projected onto the sphere, giving 4 * 4^subdivisions near-uniform triangles.
+     The polar angle is then stretched so the rim lands on `max_polar_angle`.
+     */
+    inline Mesh geodesic(uint32_t subdivisions, DomeShape const& shape = DomeShape {}) {
+        std::vector<simd::float3> points = {
+            simd::make_float3(0, 1, 0),
+            simd::make_float3(1, 0, 0), simd::make_float3(0, 0, 1),
+            simd::make_float3(-1, 0, 0), simd::make_float3(0, 0, -1),
+        };
+        std::vector<uint32_t> triangles = { 0, 1, 2,  0, 2, 3,  0, 3, 4,  0, 4, 1 };
+
+        for ( uint32_t level = 0; level < subdivisions; level += 1 ) {
+            std::unordered_map<uint64_t, uint32_t> midpoints;
+            auto midpoint = [&](uint32_t a, uint32_t b) {
+                uint64_t key = a < b ? ((uint64_t)a << 32 | b) : ((uint64_t)b << 32 | a);
+                auto it = midpoints.find(key);
+                if ( it != midpoints.end() ) return it->second;
+
+                simd::float3 m = points[a] + points[b];
+                float len = std::sqrt(m.x * m.x + m.y * m.y + m.z * m.z);
+                points.push_back(simd::make_float3(m.x / len, m.y / len, m.z / len));
+                uint32_t index = (uint32_t)points.size() - 1;
+                midpoints.emplace(key, index);
+                return index;
+            };
+
+            std::vector<uint32_t> next;
+            next.reserve(triangles.size() * 4);
+            for ( size_t t = 0; t < triangles.size(); t += 3 ) {
+                uint32_t a = triangles[t], b = triangles[t + 1], c = triangles[t + 2];
+                uint32_t ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+                next.insert(next.end(), { a, ab, ca,  ab, b, bc,  ca, bc, c,  ab, bc, ca });
+            }
+            triangles.swap(next);
+        }
+
+        Mesh mesh;
+        mesh.vertices.reserve(points.size());
+        for ( simd::float3 p : points ) {
+            float polar = std::acos(std::fmax(-1.0f, std::fmin(1.0f, p.y))) * shape.max_polar_angle / (0.5f * std::numbers::pi_v<float>);
+            float azimuth = std::atan2(p.z, p.x);
+            mesh.vertices.push_back(make_vertex(polar, azimuth, shape));
+        }
+
+        // the octahedron faces above are already wound to face the centre, like the asset
+        mesh.indices = std::move(triangles);
+        return mesh;
+    }
+}
@@ -0,0 +1,273 @@
+// Compile-time specialized fractal noise
+#pragma once
+
+#include <ratio>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+
+#include "NoiseTable.hpp"
+#include "SIMD.hpp"
+
+/**
+ Fractal Brownian motion over Perlin, simplex and value noise, all hashed through a `NoiseTable::GradientTable`.
+ `FBm` fixes basis, octave count, lacunarity and gain at compile time, so the octave loop unrolls and every
+ frequency and amplitude is a constant; `dispatch` maps a runtime `Config` onto those instantiations.
+ Bases and sums evaluate `V::width` points of one row, x per lane and y shared, in lattice cells.
+ Coordinates are expected to be non-negative.
+ */
+namespace Fractal {
+
+    using NoiseTable::GradientTable;
+
+    template <class V>
+    inline V fade(V t) {
+        return t * t * t * fma(t, fma(t, V { 6.0f }, V { -15.0f }), V { 10.0f });
+    }
+
+    inline float fade(float t) {
+        return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+    }
+
+    /** x mod 256 for non-negative integral x held in float lanes */
+    template <class V>
+    inline V wrap_lattice(V i) {
+        return i - floor(i * V { 1.f / NoiseTable::period }) * V { (float)NoiseTable::period };
+    }
+
+
+    /**
+     Gradient noise as in the density shader, roughly in [-0.7, 0.7]
+     */
+    struct Perlin {
+        template <class V>
+        static inline V evaluate(V sx, float sy, GradientTable const& g) {
+            V left = floor(sx);
+            float top = std::floor(sy);
+            V x = sx - left;
+            float y = sy - top;
+
+            // the row's hash is shared by every lane
+            uint32_t row = (uint32_t)top & (NoiseTable::period - 1);
+            V column = wrap_lattice(left);
+            V aa = column + V { g.permutation[row] };
+            V ba = column + V { g.permutation[row + 1] };
+            V ab = aa + V { 1.f };
+            V bb = ba + V { 1.f };
+
+            V x1 = x - V { 1.f };
+            V gy = V { y }, gy1 = V { y - 1.f };
+            V n_aa = fma(gather(g.x, aa), x, gather(g.y, aa) * gy);
+            V n_ab = fma(gather(g.x, ab), x1, gather(g.y, ab) * gy);
+            V n_ba = fma(gather(g.x, ba), x, gather(g.y, ba) * gy1);
+            V n_bb = fma(gather(g.x, bb), x1, gather(g.y, bb) * gy1);
+
+            V u = fade(x);
+            V top_row = fma(n_ab - n_aa, u, n_aa);
+            V bottom_row = fma(n_bb - n_ba, u, n_ba);
+            return fma(bottom_row - top_row, V { fade(y) }, top_row);
+        }
+    };
+
+    /**
+     2D simplex noise (Gustavson's formulation), in [-1, 1]
+     */
+    struct Simplex {
+        static constexpr float skew = 0.36602540378f;       // (sqrt(3) - 1) / 2
+        static constexpr float unskew = 0.21132486540f;     // (3 - sqrt(3)) / 6
+
+        template <class V>
+        static inline V corner(V index, V x, V y, GradientTable const& g) {
+            V t = max(V { 0.5f } - x * x - y * y, V { 0.0f });
+            t = t * t;
+            return t * t * fma(gather(g.x, index), x, gather(g.y, index) * y);
+        }
+
+        template <class V>
+        static inline V evaluate(V sx, float sy, GradientTable const& g) {
+            V py { sy };
+            V s = (sx + py) * V { skew };
+            V i = floor(sx + s), j = floor(py + s);
+            V t = (i + j) * V { unskew };
+            V x0 = sx - (i - t), y0 = py - (j - t);
+
+            // which triangle of the skewed cell the point is in
+            V lower = y0 < x0;
+            V i1 = select(lower, V { 0.0f }, V { 1.0f });
+            V j1 = V { 1.0f } - i1;
+
+            V x1 = x0 - i1 + V { unskew }, y1 = y0 - j1 + V { unskew };
+            V x2 = x0 - V { 1.0f - 2.0f * unskew }, y2 = y0 - V { 1.0f - 2.0f * unskew };
+
+            V ii = wrap_lattice(i), jj = wrap_lattice(j);
+            V g0 = ii + gather(g.permutation, jj);
+            V g1 = ii + i1 + gather(g.permutation, jj + j1);
+            V g2 = ii + V { 1.0f } + gather(g.permutation, jj + V { 1.0f });
+
+            // Gustavson's 70 assumes gradients of length sqrt(2), these are unit length
+            return V { 99.0f } * (corner(g0, x0, y0, g) + corner(g1, x1, y1, g) + corner(g2, x2, y2, g));
+        }
+    };
+
+    /**
+     Faded bilinear blend of one random value per lattice corner, in [-1, 1]
+     */
+    struct Value {
+        template <class V>
+        static inline V evaluate(V sx, float sy, GradientTable const& g) {
+            V left = floor(sx);
+            float top = std::floor(sy);
+            V x = sx - left;
+            float y = sy - top;
+
+            uint32_t row = (uint32_t)top & (NoiseTable::period - 1);
+            V column = wrap_lattice(left);
+            V aa = column + V { g.permutation[row] };
+            V ba = column + V { g.permutation[row + 1] };
+
+            // a second permutation lookup turns the corner index into its value
+            V v_aa = gather(g.permutation, aa);
+            V v_ab = gather(g.permutation, aa + V { 1.f });
+            V v_ba = gather(g.permutation, ba);
+            V v_bb = gather(g.permutation, ba + V { 1.f });
+
+            V u = fade(x);
+            V top_row = fma(v_ab - v_aa, u, v_aa);
+            V bottom_row = fma(v_bb - v_ba, u, v_ba);
+            V v = fma(bottom_row - top_row, V { fade(y) }, top_row);
+            return fma(v, V { 2.0f / 255.0f }, V { -1.0f });
+        }
+    };
+
+
+    /**
+     Sum of `Octaves` octaves of `Basis`, each `Lacunarity` times the frequency and `Gain` times the amplitude
+     of the previous one. The ratios are `std::ratio` so the parameters stay integral template arguments.
+     */
+    template <class Basis, uint32_t Octaves, class Lacunarity = std::ratio<2>, class Gain = std::ratio<1, 2>>
+    struct FBm {
+        static_assert(Octaves > 0, "an fBm needs at least one octave");
+
+        static constexpr uint32_t octaves = Octaves;
+        static constexpr float lacunarity = (float)Lacunarity::num / (float)Lacunarity::den;
+        static constexpr float gain = (float)Gain::num / (float)Gain::den;
+
+        template <class V>
+        inline V operator()(V x, float y, GradientTable const& g) const {
+            return sum(x, y, g, std::make_integer_sequence<uint32_t, Octaves> {});
+        }
+
+    private:
+        static constexpr float power(float base, uint32_t n) {
+            float p = 1.0f;
+            for ( uint32_t i = 0; i < n; i += 1 ) p *= base;
+            return p;
+        }
+
+        template <uint32_t I> static constexpr float frequency = power(lacunarity, I);
+        template <uint32_t I> static constexpr float amplitude = power(gain, I);
+
+        template <class V, uint32_t... I>
+        static inline V sum(V x, float y, GradientTable const& g, std::integer_sequence<uint32_t, I...>) {
+            V s { 0.0f };
+            ((s = fma(Basis::evaluate(x * V { frequency<I> }, y * frequency<I>, g), V { amplitude<I> }, s)), ...);
+            return s;
+        }
+    };
+
+    /**
+     `FBm` with its parameters read at run time, for configurations that were not instantiated
+     */
+    template <class Basis>
+    struct DynamicFBm {
+        uint32_t octaves;
+        float lacunarity;
+        float gain;
+
+        template <class V>
+        inline V operator()(V x, float y, GradientTable const& g) const {
+            V s { 0.0f };
+            float frequency = 1.0f;
+            float amplitude = 1.0f;
+            for ( uint32_t i = 0; i < octaves; i += 1 ) {
+                s = fma(Basis::evaluate(x * V { frequency }, y * frequency, g), V { amplitude }, s);
+                frequency *= lacunarity;
+                amplitude *= gain;
+            }
+            return s;
+        }
+    };
+
+
+    enum class BasisKind : uint32_t { Perlin, Simplex, Value };
+
+    struct Config {
+        BasisKind basis = BasisKind::Perlin;
+        uint32_t octaves = 8;
+        float lacunarity = 2.0f;
+        float gain = 0.5f;
+    };
+
+    /** octave counts instantiated for lacunarity 2 and gain 1/2 */
+    constexpr uint32_t max_instantiated_octaves = 8;
+
+    template <class Basis, class F>
+    inline decltype(auto) dispatch_octaves(Config const& config, F&& f) {
+        if ( config.lacunarity == 2.0f && config.gain == 0.5f ) {
+            switch ( config.octaves ) {
+                case 1: return f(FBm<Basis, 1> {});
+                case 2: return f(FBm<Basis, 2> {});
+                case 3: return f(FBm<Basis, 3> {});
+                case 4: return f(FBm<Basis, 4> {});
+                case 5: return f(FBm<Basis, 5> {});
+                case 6: return f(FBm<Basis, 6> {});
+                case 7: return f(FBm<Basis, 7> {});
+                case 8: return f(FBm<Basis, 8> {});
+                default: break;
+            }
+        }
+        return f(DynamicFBm<Basis> { config.octaves, config.lacunarity, config.gain });
+    }
+
+    /**
+     Call `f` once with the fBm functor for `config`: an `FBm` instantiation for the common
+     configurations, a `DynamicFBm` otherwise. Branching happens here, once, not per texel.
+     */
+    template <class F>
+    inline decltype(auto) dispatch(Config const& config, F&& f) {
+        switch ( config.basis ) {
+            case BasisKind::Simplex: return dispatch_octaves<Simplex>(config, f);
+            case BasisKind::Value:   return dispatch_octaves<Value>(config, f);
+            case BasisKind::Perlin:
+            default:                 return dispatch_octaves<Perlin>(config, f);
+        }
+    }
+
+
+    /**
+     Fill [x_begin, x_end) x [y_begin, y_end) of a map, `row_pitch` floats per row, with `fbm` sampled at
+     texel centers, `grid_size` texels per lattice cell of the first octave
+     */
+    template <class V = Simd::f32x8, class Fbm>
+    inline void generate_region(Fbm const& fbm, float* out, size_t row_pitch,
+                                uint32_t x_begin, uint32_t y_begin, uint32_t x_end, uint32_t y_end,
+                                float grid_size, GradientTable const& g)
+    {
+        const float scale = 1.0f / grid_size;
+        for ( uint32_t y = y_begin; y < y_end; y += 1 ) {
+            float* row = out + y * row_pitch;
+            float sy = ((float)y + 0.5f) * scale;
+            for ( uint32_t x = x_begin; x < x_end; x += V::width ) {
+                V sx = (Simd::ramp<V>((float)x) + V { 0.5f }) * V { scale };
+                if ( x + V::width <= x_end ) {
+                    fbm(sx, sy, g).store(row + x);
+                } else {
+                    alignas(64) float tail[V::width];
+                    fbm(sx, sy, g).store(tail);
+                    for ( uint32_t i = 0; x + i < x_end; i += 1 ) row[x + i] = tail[i];
+                }
+            }
+        }
+    }
+}
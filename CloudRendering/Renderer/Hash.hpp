@@ -0,0 +1,63 @@
+// Non-cryptographic hashing for cache keys
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+namespace Hash {
+
+    constexpr uint64_t default_seed = 0x9E3779B97F4A7C15ull;
+
+    /**
+     64 bit finalizer (MurmurHash3 fmix64)
+     */
+    inline uint64_t mix(uint64_t h) {
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ull;
+        h ^= h >> 33;
+        return h;
+    }
+
+    /**
+     Fold `value` into `seed`
+     */
+    inline uint64_t combine(uint64_t seed, uint64_t value) {
+        return mix(seed ^ (value + 0x9E3779B97F4A7C15ull + (seed << 6) + (seed >> 2)));
+    }
+
+    /**
+     Hash a byte range 8 bytes at a time, fast enough to fingerprint multi-megabyte assets on startup
+     */
+    inline uint64_t bytes(const void* data, size_t size, uint64_t seed = default_seed) {
+        // an empty range may come with a null pointer, which memcpy must not be handed even for 0 bytes
+        if ( size == 0 ) return seed;
+
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        uint64_t h = seed ^ (size * 0x87C37B91114253D5ull);
+
+        size_t i = 0;
+        for ( ; i + 8 <= size; i += 8 ) {
+            uint64_t word;
+            memcpy(&word, p + i, 8);
+            h ^= mix(word);
+            h = (h << 27 | h >> 37) * 0x4CF5AD432745937Full + 0x52DCE729ull;
+        }
+
+        uint64_t tail = 0;
+        memcpy(&tail, p + i, size - i);
+        h ^= mix(tail);
+
+        return mix(h);
+    }
+
+    /**
+     Hash the object representation of a trivially copyable value
+     */
+    template <class T>
+    inline uint64_t value(T const& v, uint64_t seed = default_seed) {
+        return bytes(&v, sizeof(T), seed);
+    }
+}
@@ -0,0 +1,100 @@
+// Read-only memory mapped file
+#pragma once
+
+#include <string>
+#include <utility>
+#include <cstddef>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ RAII wrapper around a read-only `mmap` of a whole file.
+ The mapping stays valid for the lifetime of the object.
+ */
+class MappedFile {
+private:
+    int fd = -1;
+    void* address = nullptr;
+    size_t length = 0;
+
+    void close_mapping() {
+        if ( address != nullptr ) munmap(address, length);
+        if ( fd >= 0 ) close(fd);
+        fd = -1;
+        address = nullptr;
+        length = 0;
+    }
+
+public:
+    MappedFile() = default;
+
+    explicit MappedFile( std::string const& file_path ) {
+        fd = open(file_path.c_str(), O_RDONLY);
+        if ( fd < 0 ) return;
+
+        struct stat st;
+        if ( fstat(fd, &st) != 0 ) {
+            close_mapping();
+            return;
+        }
+
+        length = (size_t)st.st_size;
+        // mmap rejects zero-length mappings, an empty file is still a valid open file
+        if ( length == 0 ) return;
+
+        void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if ( p == MAP_FAILED ) {
+            close_mapping();
+            return;
+        }
+        address = p;
+
+        // the whole file is going to be scanned front to back
+        // the advice values are enumerators, not flags, so each needs a call of its own
+        madvise(address, length, MADV_SEQUENTIAL);
+        madvise(address, length, MADV_WILLNEED);
+    }
+
+    ~MappedFile() { close_mapping(); }
+
+    MappedFile( MappedFile const& ) = delete;
+    MappedFile& operator=( MappedFile const& ) = delete;
+
+    MappedFile( MappedFile&& other ) noexcept
+        : fd(std::exchange(other.fd, -1)),
+          address(std::exchange(other.address, nullptr)),
+          length(std::exchange(other.length, 0)) {}
+
+    MappedFile& operator=( MappedFile&& other ) noexcept {
+        if ( this != &other ) {
+            close_mapping();
+            fd = std::exchange(other.fd, -1);
+            address = std::exchange(other.address, nullptr);
+            length = std::exchange(other.length, 0);
+        }
+        return *this;
+    }
+
+    inline bool is_open() const { return fd >= 0; }
+
+    inline const char* data() const { return static_cast<const char*>(address); }
+
+    inline size_t size() const { return length; }
+};
+
+
+/**
+ Create an empty file with a unique name next to `path`, for writers that fill a file then rename it over `path`,
+ so concurrent writers never share one. Returns its name, or an empty string if it could not be created.
+ */
+inline std::string create_temporary_beside( std::string const& path ) {
+    std::string name = path + ".XXXXXX";
+    int fd = mkstemp(name.data());
+    if ( fd < 0 ) return {};
+    // mkstemp creates the file private to its owner, the final file should be as readable as any other
+    fchmod(fd, 0644);
+    close(fd);
+    return name;
+}
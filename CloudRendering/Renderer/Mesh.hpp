@@ -0,0 +1,42 @@
+// In-memory indexed triangle mesh
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "SharedTypes.h"
+
+/**
+ Owned vertex and index arrays, with the same accessors as `ObjLoader`
+ so generated and processed meshes can be uploaded the same way as loaded ones
+ */
+struct Mesh {
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+
+    Mesh() = default;
+
+    /** copy the arrays out of any mesh source exposing the `ObjLoader` accessors */
+    template <class Source>
+    static Mesh copy_of(Source& source) {
+        Mesh m;
+        m.vertices.assign(source.get_vertices_data(), source.get_vertices_data() + source.get_vertices_count());
+        m.indices.assign(source.get_indices_data(), source.get_indices_data() + source.get_indices_count());
+        return m;
+    }
+
+    // vertices
+    inline size_t get_vertices_data_size() { return vertices.size() * sizeof(Vertex); }
+
+    inline Vertex* get_vertices_data() { return vertices.data(); }
+
+    inline size_t get_vertices_count() { return vertices.size(); }
+
+    // indices
+    inline size_t get_indices_data_size() { return indices.size() * sizeof(uint32_t); }
+
+    inline uint32_t* get_indices_data() { return indices.data(); }
+
+    inline size_t get_indices_count() { return indices.size(); }
+};
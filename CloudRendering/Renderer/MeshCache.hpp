@@ -0,0 +1,220 @@
+// Binary mesh cache (.crmesh)
+#pragma once
+
+#include <string>
+#include <memory>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <system_error>
+
+#include "SharedTypes.h"
+#include "MappedFile.hpp"
+#include "ObjLoader.hpp"
+#include "Hash.hpp"
+#include "MeshOptimizer.hpp"
+
+/**
+ On-disk layout of a .crmesh file:
+
+     CRMeshHeader
+     padding to 16 bytes
+     Vertex[vertex_count]         exactly as declared in SharedTypes.h
+     padding to 16 bytes
+     uint32_t[index_count]
+
+ Both blobs can be handed to `newBuffer` straight from the mapped pages.
+ Since version 2 the indices are ordered for the vertex cache and the vertices for fetch locality.
+ */
+struct CRMeshHeader {
+    static constexpr char     expected_magic[8] = { 'C', 'R', 'M', 'E', 'S', 'H', '\0', '\0' };
+    static constexpr uint32_t current_version = 2;
+    static constexpr uint64_t blob_alignment = 16;
+
+    char     magic[8];
+    uint32_t version;
+    uint32_t vertex_stride;     // sizeof(Vertex) of the writer
+    uint64_t vertex_count;
+    uint64_t index_count;
+    uint64_t vertex_offset;
+    uint64_t index_offset;
+    uint64_t source_size;
+    int64_t  source_mtime;
+    uint64_t source_hash;       // Hash::bytes over the whole source file
+};
+
+/**
+ Mesh loaded through a .crmesh cache, regenerated from the OBJ whenever the source changes.
+ Mirrors the accessors of `ObjLoader` so it can be used in its place.
+ */
+class CachedMesh {
+private:
+    MappedFile file;
+    const CRMeshHeader* header = nullptr;
+    // only used when the cache could not be written
+    std::unique_ptr<ObjLoader> fallback;
+
+    bool cache_hit = false;
+    double milliseconds = 0.0;
+
+    static inline uint64_t align_up(uint64_t x, uint64_t a) { return (x + a - 1) / a * a; }
+
+    static int64_t mtime_of(std::string const& path) {
+        std::error_code ec;
+        auto t = std::filesystem::last_write_time(path, ec);
+        return ec ? 0 : (int64_t)t.time_since_epoch().count();
+    }
+
+    /** overwrite the header's `source_mtime` in place, best effort */
+    static void store_source_mtime(std::string const& cache_path, int64_t mtime) {
+        int fd = open(cache_path.c_str(), O_WRONLY);
+        if ( fd < 0 ) return;
+        pwrite(fd, &mtime, sizeof(mtime), offsetof(CRMeshHeader, source_mtime));
+        close(fd);
+    }
+
+    /**
+     Map `cache_path` and check it describes `source_path`.
+     Size and mtime matching is trusted, otherwise the source content is hashed and compared.
+     */
+    bool open_cache(std::string const& cache_path, std::string const& source_path) {
+        MappedFile mapped { cache_path };
+        if ( !mapped.is_open() || mapped.size() < sizeof(CRMeshHeader) ) return false;
+
+        auto h = reinterpret_cast<const CRMeshHeader*>(mapped.data());
+        if ( memcmp(h->magic, CRMeshHeader::expected_magic, sizeof(h->magic)) != 0 ||
+             h->version != CRMeshHeader::current_version ||
+             h->vertex_stride != sizeof(Vertex) ||
+             h->vertex_offset % CRMeshHeader::blob_alignment != 0 ||
+             h->index_offset % CRMeshHeader::blob_alignment != 0 ||
+             h->vertex_offset + h->vertex_count * sizeof(Vertex) > mapped.size() ||
+             h->index_offset + h->index_count * sizeof(uint32_t) > mapped.size() )
+            return false;
+
+        std::error_code ec;
+        uint64_t source_size = std::filesystem::file_size(source_path, ec);
+        if ( ec ) return false;
+
+        if ( h->source_size != source_size ) return false;
+        int64_t source_mtime = mtime_of(source_path);
+        if ( h->source_mtime != source_mtime ) {
+            // touched but maybe not modified
+            MappedFile source { source_path };
+            if ( !source.is_open() || Hash::bytes(source.data(), source.size()) != h->source_hash ) return false;
+            // same content: record the new mtime so the next start trusts it instead of hashing again
+            store_source_mtime(cache_path, source_mtime);
+        }
+
+        file = std::move(mapped);
+        header = h;
+        return true;
+    }
+
+public:
+    /**
+     Write a .crmesh file. The file is written to a uniquely named file next to `cache_path` then renamed over it,
+     so a concurrent reader never maps a half written cache and concurrent writers never interleave.
+     */
+    static bool write(std::string const& cache_path, std::string const& source_path,
+                      const Vertex* vertices, size_t vertex_count,
+                      const uint32_t* indices, size_t index_count)
+    {
+        MappedFile source { source_path };
+        if ( !source.is_open() ) return false;
+
+        CRMeshHeader h {};
+        memcpy(h.magic, CRMeshHeader::expected_magic, sizeof(h.magic));
+        h.version = CRMeshHeader::current_version;
+        h.vertex_stride = sizeof(Vertex);
+        h.vertex_count = vertex_count;
+        h.index_count = index_count;
+        h.vertex_offset = align_up(sizeof(CRMeshHeader), CRMeshHeader::blob_alignment);
+        h.index_offset = align_up(h.vertex_offset + vertex_count * sizeof(Vertex), CRMeshHeader::blob_alignment);
+        h.source_size = source.size();
+        h.source_mtime = mtime_of(source_path);
+        h.source_hash = Hash::bytes(source.data(), source.size());
+
+        std::error_code ec;
+        std::filesystem::create_directories(std::filesystem::path(cache_path).parent_path(), ec);
+
+        std::string tmp_path = create_temporary_beside(cache_path);
+        if ( tmp_path.empty() ) return false;
+        {
+            std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+
+            const char zeros[CRMeshHeader::blob_alignment] = {};
+            out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+            out.write(zeros, (std::streamsize)(h.vertex_offset - sizeof(h)));
+            out.write(reinterpret_cast<const char*>(vertices), (std::streamsize)(vertex_count * sizeof(Vertex)));
+            out.write(zeros, (std::streamsize)(h.index_offset - h.vertex_offset - vertex_count * sizeof(Vertex)));
+            out.write(reinterpret_cast<const char*>(indices), (std::streamsize)(index_count * sizeof(uint32_t)));
+            out.close();
+            if ( !out ) {
+                std::filesystem::remove(tmp_path, ec);
+                return false;
+            }
+        }
+
+        std::filesystem::rename(tmp_path, cache_path, ec);
+        if ( !ec ) return true;
+        std::filesystem::remove(tmp_path, ec);
+        return false;
+    }
+
+    /**
+     Map `cache_path` if it is up to date with `obj_path`, otherwise parse the OBJ and rebuild the cache
+     */
+    CachedMesh( std::string& obj_path, std::string const& cache_path ) {
+        auto start = std::chrono::steady_clock::now();
+
+        cache_hit = open_cache(cache_path, obj_path);
+        if ( !cache_hit ) {
+            auto mesh = std::make_unique<ObjLoader>(obj_path);
+            // reordering is paid once here, every warm start maps the optimized layout
+            MeshOptimizer::optimize_vertex_cache(mesh->get_indices_data(), mesh->get_indices_count(),
+                                                 mesh->get_vertices_count());
+            MeshOptimizer::optimize_vertex_fetch(mesh->get_vertices_data(), mesh->get_vertices_count(),
+                                                 mesh->get_indices_data(), mesh->get_indices_count());
+            bool written = write(cache_path, obj_path,
+                                 mesh->get_vertices_data(), mesh->get_vertices_count(),
+                                 mesh->get_indices_data(), mesh->get_indices_count());
+
+            if ( !written || !open_cache(cache_path, obj_path) ) {
+                std::cerr << "Cannot write mesh cache \"" << cache_path << "\", using parsed mesh" << std::endl;
+                fallback = std::move(mesh);
+            }
+        }
+
+        milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    /** whether the mesh came from an up to date cache without touching the OBJ parser */
+    inline bool is_cache_hit() const { return cache_hit; }
+
+    /** wall time spent in the constructor */
+    inline double get_load_milliseconds() const { return milliseconds; }
+
+    // vertices, read only: a cache hit hands out the mapped pages of the file
+    inline size_t get_vertices_data_size() const { return get_vertices_count() * sizeof(Vertex); }
+
+    inline const Vertex* get_vertices_data() const {
+        if ( fallback ) return fallback->get_vertices_data();
+        return reinterpret_cast<const Vertex*>(file.data() + header->vertex_offset);
+    }
+
+    inline size_t get_vertices_count() const { return fallback ? fallback->get_vertices_count() : header->vertex_count; }
+
+    // indices
+    inline size_t get_indices_data_size() const { return get_indices_count() * sizeof(uint32_t); }
+
+    inline const uint32_t* get_indices_data() const {
+        if ( fallback ) return fallback->get_indices_data();
+        return reinterpret_cast<const uint32_t*>(file.data() + header->index_offset);
+    }
+
+    inline size_t get_indices_count() const { return fallback ? fallback->get_indices_count() : header->index_count; }
+};
@@ -0,0 +1,212 @@
+// Index and vertex reordering for the post-transform vertex cache
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+
+namespace MeshOptimizer {
+
+    /**
+     Result of running an index buffer through a simulated post-transform cache
+     */
+    struct CacheStats {
+        size_t triangles = 0;
+        size_t referenced_vertices = 0;
+        size_t transforms = 0;      // cache misses, i.e. vertex shader invocations
+
+        /** average cache miss ratio: transforms per triangle, 0.5 is the ideal for a large regular mesh */
+        inline double acmr() const { return triangles ? (double)transforms / (double)triangles : 0.0; }
+
+        /** average transform to vertex ratio: 1.0 means every vertex is shaded exactly once */
+        inline double atvr() const { return referenced_vertices ? (double)transforms / (double)referenced_vertices : 0.0; }
+    };
+
+    /**
+     Simulate a FIFO post-transform cache of `cache_size` entries, the model most GPUs are closest to
+     */
+    inline CacheStats simulate_fifo_cache(const uint32_t* indices, size_t index_count,
+                                          size_t vertex_count, size_t cache_size = 16)
+    {
+        CacheStats stats;
+        stats.triangles = index_count / 3;
+
+        // time stamp a vertex entered the cache; it is still cached while younger than cache_size insertions
+        std::vector<size_t> inserted_at(vertex_count, 0);
+        std::vector<bool> referenced(vertex_count, false);
+        size_t clock = cache_size + 1;
+
+        for ( size_t i = 0; i < index_count; i += 1 ) {
+            uint32_t v = indices[i];
+            if ( !referenced[v] ) {
+                referenced[v] = true;
+                stats.referenced_vertices += 1;
+            }
+            if ( clock - inserted_at[v] > cache_size ) {
+                inserted_at[v] = clock;
+                clock += 1;
+                stats.transforms += 1;
+            }
+        }
+        return stats;
+    }
+
+    /**
+     Reorder triangles for post-transform cache locality using Forsyth's linear-speed greedy algorithm:
+     repeatedly emit the triangle whose vertices score highest under a simulated LRU cache,
+     favouring recently used vertices and vertices with few remaining triangles.
+     */
+    inline void optimize_vertex_cache(uint32_t* indices, size_t index_count, size_t vertex_count,
+                                      size_t cache_size = 32)
+    {
+        constexpr float cache_decay_power = 1.5f;
+        constexpr float last_triangle_score = 0.75f;
+        constexpr float valence_boost_scale = 2.0f;
+        constexpr float valence_boost_power = 0.5f;
+
+        size_t triangle_count = index_count / 3;
+        if ( triangle_count == 0 || cache_size < 4 ) return;
+
+        // vertex -> adjacent triangles, in compressed rows
+        std::vector<uint32_t> remaining_valence(vertex_count, 0);
+        for ( size_t i = 0; i < triangle_count * 3; i += 1 ) remaining_valence[indices[i]] += 1;
+
+        std::vector<uint32_t> adjacency_offset(vertex_count + 1, 0);
+        for ( size_t v = 0; v < vertex_count; v += 1 )
+            adjacency_offset[v + 1] = adjacency_offset[v] + remaining_valence[v];
+
+        std::vector<uint32_t> adjacency(triangle_count * 3);
+        {
+            std::vector<uint32_t> fill(adjacency_offset.begin(), adjacency_offset.end() - 1);
+            for ( size_t t = 0; t < triangle_count; t += 1 )
+                for ( size_t k = 0; k < 3; k += 1 )
+                    adjacency[fill[indices[t * 3 + k]]++] = (uint32_t)t;
+        }
+
+        auto vertex_score = [&](int cache_position, uint32_t valence) -> float {
+            if ( valence == 0 ) return -1.0f;
+
+            float score = 0.0f;
+            if ( cache_position >= 0 ) {
+                if ( cache_position < 3 ) {
+                    score = last_triangle_score;
+                } else {
+                    float scaler = 1.0f / (float)(cache_size - 3);
+                    score = std::pow(1.0f - (float)(cache_position - 3) * scaler, cache_decay_power);
+                }
+            }
+            return score + valence_boost_scale * std::pow((float)valence, -valence_boost_power);
+        };
+
+        std::vector<int> cache_position(vertex_count, -1);
+        std::vector<float> score(vertex_count);
+        for ( size_t v = 0; v < vertex_count; v += 1 ) score[v] = vertex_score(-1, remaining_valence[v]);
+
+        std::vector<float> triangle_score(triangle_count);
+        for ( size_t t = 0; t < triangle_count; t += 1 )
+            triangle_score[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+
+        std::vector<bool> emitted(triangle_count, false);
+        std::vector<uint32_t> output(triangle_count * 3);
+
+        // LRU cache with three spare slots for the vertices of the triangle being pushed in
+        std::vector<uint32_t> cache, next_cache;
+        cache.reserve(cache_size + 3);
+        next_cache.reserve(cache_size + 3);
+
+        size_t scan_cursor = 0;
+        int64_t best = 0;
+        for ( size_t t = 1; t < triangle_count; t += 1 )
+            if ( triangle_score[t] > triangle_score[best] ) best = (int64_t)t;
+
+        for ( size_t emitted_count = 0; emitted_count < triangle_count; emitted_count += 1 ) {
+            if ( best < 0 ) {
+                // nothing adjacent to the cache: fall back to the next unemitted triangle in input order
+                while ( emitted[scan_cursor] ) scan_cursor += 1;
+                best = (int64_t)scan_cursor;
+            }
+
+            const uint32_t* tri = indices + best * 3;
+            emitted[best] = true;
+            output[emitted_count * 3] = tri[0];
+            output[emitted_count * 3 + 1] = tri[1];
+            output[emitted_count * 3 + 2] = tri[2];
+
+            // push the triangle's vertices to the front of the cache
+            next_cache.clear();
+            for ( size_t k = 0; k < 3; k += 1 ) {
+                uint32_t v = tri[k];
+                next_cache.push_back(v);
+
+                // retire the triangle from the vertex's adjacency so valence reflects only what is left
+                uint32_t* begin = adjacency.data() + adjacency_offset[v];
+                uint32_t* end = begin + remaining_valence[v];
+                uint32_t* it = std::find(begin, end, (uint32_t)best);
+                if ( it != end ) {
+                    std::swap(*it, *(end - 1));
+                    remaining_valence[v] -= 1;
+                }
+            }
+            for ( uint32_t v : cache )
+                if ( v != tri[0] && v != tri[1] && v != tri[2] ) next_cache.push_back(v);
+
+            // vertices falling out of the cache lose their position score
+            for ( size_t i = cache_size; i < next_cache.size(); i += 1 ) {
+                uint32_t v = next_cache[i];
+                cache_position[v] = -1;
+                score[v] = vertex_score(-1, remaining_valence[v]);
+            }
+            if ( next_cache.size() > cache_size ) next_cache.resize(cache_size);
+            std::swap(cache, next_cache);
+
+            // rescore cached vertices and their live triangles, picking the next best among them
+            for ( size_t i = 0; i < cache.size(); i += 1 ) {
+                uint32_t v = cache[i];
+                cache_position[v] = (int)i;
+                score[v] = vertex_score((int)i, remaining_valence[v]);
+            }
+
+            best = -1;
+            float best_score = -1.0f;
+            for ( uint32_t v : cache ) {
+                const uint32_t* adjacent = adjacency.data() + adjacency_offset[v];
+                for ( uint32_t a = 0; a < remaining_valence[v]; a += 1 ) {
+                    uint32_t t = adjacent[a];
+                    float s = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+                    triangle_score[t] = s;
+                    if ( s > best_score ) {
+                        best_score = s;
+                        best = (int64_t)t;
+                    }
+                }
+            }
+        }
+
+        std::copy(output.begin(), output.end(), indices);
+    }
+
+    /**
+     Reorder vertices into first-use order of the index buffer so vertex fetch streams through memory,
+     and remap the indices. Vertices never referenced are kept, after all referenced ones.
+     */
+    template <class V>
+    inline void optimize_vertex_fetch(V* vertices, size_t vertex_count, uint32_t* indices, size_t index_count) {
+        constexpr uint32_t unassigned = UINT32_MAX;
+        std::vector<uint32_t> remap(vertex_count, unassigned);
+
+        uint32_t next = 0;
+        for ( size_t i = 0; i < index_count; i += 1 ) {
+            uint32_t& r = remap[indices[i]];
+            if ( r == unassigned ) r = next++;
+            indices[i] = r;
+        }
+        for ( size_t v = 0; v < vertex_count; v += 1 )
+            if ( remap[v] == unassigned ) remap[v] = next++;
+
+        std::vector<V> reordered(vertex_count);
+        for ( size_t v = 0; v < vertex_count; v += 1 ) reordered[remap[v]] = vertices[v];
+        std::copy(reordered.begin(), reordered.end(), vertices);
+    }
+}
@@ -0,0 +1,307 @@
+// Quadric error metric simplification and LOD chains
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <simd/simd.h>
+
+#include "SharedTypes.h"
+#include "Mesh.hpp"
+
+namespace MeshSimplifier {
+
+    /**
+     Symmetric 4x4 plane quadric (Garland & Heckbert), stored as its upper triangle
+     */
+    struct Quadric {
+        double a2 = 0, ab = 0, ac = 0, ad = 0;
+        double b2 = 0, bc = 0, bd = 0;
+        double c2 = 0, cd = 0;
+        double d2 = 0;
+
+        /** quadric of the plane n.p + d = 0 scaled by `weight` */
+        static Quadric plane(double a, double b, double c, double d, double weight) {
+            Quadric q;
+            q.a2 = a * a * weight; q.ab = a * b * weight; q.ac = a * c * weight; q.ad = a * d * weight;
+            q.b2 = b * b * weight; q.bc = b * c * weight; q.bd = b * d * weight;
+            q.c2 = c * c * weight; q.cd = c * d * weight;
+            q.d2 = d * d * weight;
+            return q;
+        }
+
+        Quadric& operator+=( Quadric const& o ) {
+            a2 += o.a2; ab += o.ab; ac += o.ac; ad += o.ad;
+            b2 += o.b2; bc += o.bc; bd += o.bd;
+            c2 += o.c2; cd += o.cd;
+            d2 += o.d2;
+            return *this;
+        }
+
+        /** weighted sum of squared distances from p to the accumulated planes */
+        double evaluate(simd::float3 p) const {
+            double x = p.x, y = p.y, z = p.z;
+            return a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+                 + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+                 + c2 * z * z + 2 * cd * z
+                 + d2;
+        }
+    };
+
+    struct Options {
+        /** stop once the index count is at or below this */
+        size_t target_index_count = 0;
+        /** never accept a collapse whose geometric error (mesh units) exceeds this */
+        float max_error = INFINITY;
+        /**
+         weight of the uv / normal difference between the two ends of an edge, added to the collapse cost
+         so edges across attribute discontinuities are collapsed last
+         */
+        float attribute_weight = 0.01f;
+        /** weight of the planes pinning open boundaries, such as the dome's rim, in place */
+        float boundary_weight = 10.0f;
+    };
+
+    struct Result {
+        std::vector<uint32_t> indices;  // indexes the input vertex array
+        float error = 0.0f;             // bound on the distance to the input surface's planes, in mesh units
+    };
+
+    /**
+     Simplify by half-edge collapses ordered by quadric error.
+     Every collapse moves a vertex onto an existing neighbour, so the result indexes the unchanged input
+     vertices and keeps their uv and normal: coarser levels can share the full resolution vertex buffer.
+     Collapses that would flip a triangle are rejected.
+     */
+    inline Result simplify(const Vertex* vertices, size_t vertex_count,
+                           const uint32_t* input_indices, size_t index_count, Options const& options)
+    {
+        Result result;
+        result.indices.assign(input_indices, input_indices + index_count);
+        std::vector<uint32_t>& indices = result.indices;
+
+        auto position = [&](uint32_t v) { return vertices[v].position; };
+        auto face_normal = [&](uint32_t a, uint32_t b, uint32_t c) {
+            return simd::cross(position(b) - position(a), position(c) - position(a));
+        };
+
+        // quadrics from the input faces, unweighted so sqrt(cost) bounds the distance to the original planes
+        std::vector<Quadric> quadrics(vertex_count);
+        for ( size_t t = 0; t + 2 < index_count; t += 3 ) {
+            uint32_t a = indices[t], b = indices[t + 1], c = indices[t + 2];
+            simd::float3 n = face_normal(a, b, c);
+            double len = std::sqrt((double)simd::dot(n, n));
+            if ( len == 0.0 ) continue;
+            double nx = n.x / len, ny = n.y / len, nz = n.z / len;
+            double d = -(nx * position(a).x + ny * position(a).y + nz * position(a).z);
+            Quadric q = Quadric::plane(nx, ny, nz, d, 1.0);
+            quadrics[a] += q; quadrics[b] += q; quadrics[c] += q;
+        }
+
+        struct Edge {
+            uint32_t from, to;
+            float cost;
+        };
+
+        std::vector<uint32_t> remap(vertex_count);
+        std::vector<uint8_t> locked(vertex_count);
+        std::vector<uint8_t> boundary(vertex_count);
+        std::vector<uint32_t> adjacency_offset(vertex_count + 1), adjacency;
+        std::vector<Edge> edges;
+        bool boundary_quadrics_added = false;
+
+        while ( indices.size() > options.target_index_count ) {
+            size_t triangle_count = indices.size() / 3;
+
+            // vertex -> triangles
+            std::fill(adjacency_offset.begin(), adjacency_offset.end(), 0);
+            for ( uint32_t v : indices ) adjacency_offset[v + 1] += 1;
+            for ( size_t v = 0; v < vertex_count; v += 1 ) adjacency_offset[v + 1] += adjacency_offset[v];
+            adjacency.resize(indices.size());
+            {
+                std::vector<uint32_t> fill(adjacency_offset.begin(), adjacency_offset.end() - 1);
+                for ( size_t t = 0; t < triangle_count; t += 1 )
+                    for ( size_t k = 0; k < 3; k += 1 ) adjacency[fill[indices[t * 3 + k]]++] = (uint32_t)t;
+            }
+
+            // directed edges; an edge with no twin lies on an open boundary
+            edges.clear();
+            std::fill(boundary.begin(), boundary.end(), 0);
+            auto has_directed_edge = [&](uint32_t a, uint32_t b) {
+                for ( uint32_t i = adjacency_offset[a]; i < adjacency_offset[a + 1]; i += 1 ) {
+                    const uint32_t* tri = indices.data() + adjacency[i] * 3;
+                    for ( size_t k = 0; k < 3; k += 1 )
+                        if ( tri[k] == a && tri[(k + 1) % 3] == b ) return true;
+                }
+                return false;
+            };
+            for ( size_t t = 0; t < triangle_count; t += 1 ) {
+                for ( size_t k = 0; k < 3; k += 1 ) {
+                    uint32_t a = indices[t * 3 + k], b = indices[t * 3 + (k + 1) % 3];
+                    if ( !has_directed_edge(b, a) ) {
+                        boundary[a] = boundary[b] = 1;
+                        edges.push_back({ a, b, 0 });
+                        edges.push_back({ b, a, 0 });
+                    } else if ( a < b ) {
+                        edges.push_back({ a, b, 0 });
+                        edges.push_back({ b, a, 0 });
+                    }
+                }
+            }
+
+            // pin the original rim with planes perpendicular to its faces, once
+            if ( !boundary_quadrics_added ) {
+                boundary_quadrics_added = true;
+                for ( size_t t = 0; t < triangle_count; t += 1 ) {
+                    for ( size_t k = 0; k < 3; k += 1 ) {
+                        uint32_t a = indices[t * 3 + k], b = indices[t * 3 + (k + 1) % 3];
+                        if ( has_directed_edge(b, a) ) continue;
+                        simd::float3 n = face_normal(indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2]);
+                        simd::float3 e = position(b) - position(a);
+                        simd::float3 m = simd::cross(e, n);
+                        double len = std::sqrt((double)simd::dot(m, m));
+                        if ( len == 0.0 ) continue;
+                        double mx = m.x / len, my = m.y / len, mz = m.z / len;
+                        double d = -(mx * position(a).x + my * position(a).y + mz * position(a).z);
+                        Quadric q = Quadric::plane(mx, my, mz, d, options.boundary_weight);
+                        quadrics[a] += q; quadrics[b] += q;
+                    }
+                }
+            }
+
+            auto is_open_edge = [&](uint32_t a, uint32_t b) {
+                return !has_directed_edge(b, a) || !has_directed_edge(a, b);
+            };
+
+            for ( Edge& e : edges ) {
+                Quadric q = quadrics[e.from];
+                q += quadrics[e.to];
+                double cost = q.evaluate(position(e.to));
+
+                Vertex const& u = vertices[e.from];
+                Vertex const& v = vertices[e.to];
+                simd::float2 duv = u.uv - v.uv;
+                simd::float3 dn = u.normal - v.normal;
+                cost += options.attribute_weight * (duv.x * duv.x + duv.y * duv.y + simd::dot(dn, dn));
+
+                // a rim vertex may only slide along the rim
+                if ( boundary[e.from] && !(boundary[e.to] && is_open_edge(e.from, e.to)) ) cost = INFINITY;
+                e.cost = (float)cost;
+            }
+            std::sort(edges.begin(), edges.end(), [](Edge const& a, Edge const& b) { return a.cost < b.cost; });
+
+            for ( size_t v = 0; v < vertex_count; v += 1 ) remap[v] = (uint32_t)v;
+            std::fill(locked.begin(), locked.end(), 0);
+
+            // each pass removes at most a fraction of what is left so costs stay representative
+            size_t triangles_to_remove = (indices.size() - options.target_index_count) / 3;
+            size_t pass_budget = std::max<size_t>(1, std::min(triangles_to_remove, triangle_count / 6 + 1));
+            size_t removed = 0;
+            float max_error_sq = options.max_error * options.max_error;
+
+            for ( Edge const& e : edges ) {
+                if ( removed >= pass_budget ) break;
+                if ( e.cost > max_error_sq || std::isinf(e.cost) ) break;
+                if ( locked[e.from] || locked[e.to] ) continue;
+
+                // reject collapses that flip, or turn by more than ~75 degrees, a surviving triangle around `from`
+                bool flips = false;
+                size_t collapsing = 0;
+                for ( uint32_t i = adjacency_offset[e.from]; i < adjacency_offset[e.from + 1] && !flips; i += 1 ) {
+                    const uint32_t* tri = indices.data() + adjacency[i] * 3;
+                    if ( tri[0] == e.to || tri[1] == e.to || tri[2] == e.to ) {
+                        collapsing += 1;
+                        continue;
+                    }
+                    uint32_t moved[3] = { tri[0], tri[1], tri[2] };
+                    for ( uint32_t& m : moved ) if ( m == e.from ) m = e.to;
+                    simd::float3 before = face_normal(tri[0], tri[1], tri[2]);
+                    simd::float3 after = face_normal(moved[0], moved[1], moved[2]);
+                    float limit = 0.25f * std::sqrt(simd::dot(before, before) * simd::dot(after, after));
+                    if ( simd::dot(before, after) <= limit ) flips = true;
+                }
+                if ( flips || collapsing == 0 ) continue;
+
+                remap[e.from] = e.to;
+                quadrics[e.to] += quadrics[e.from];
+                result.error = std::max(result.error, std::sqrt(std::max(e.cost, 0.0f)));
+                removed += collapsing;
+
+                // the 1-ring of both ends changes, keep it stable for the rest of the pass
+                for ( uint32_t end : { e.from, e.to } )
+                    for ( uint32_t i = adjacency_offset[end]; i < adjacency_offset[end + 1]; i += 1 ) {
+                        const uint32_t* tri = indices.data() + adjacency[i] * 3;
+                        locked[tri[0]] = locked[tri[1]] = locked[tri[2]] = 1;
+                    }
+            }
+
+            if ( removed == 0 ) break;
+
+            // apply the pass and drop collapsed triangles
+            size_t write = 0;
+            for ( size_t t = 0; t < triangle_count; t += 1 ) {
+                uint32_t a = remap[indices[t * 3]], b = remap[indices[t * 3 + 1]], c = remap[indices[t * 3 + 2]];
+                if ( a == b || b == c || c == a ) continue;
+                indices[write++] = a;
+                indices[write++] = b;
+                indices[write++] = c;
+            }
+            indices.resize(write);
+        }
+
+        return result;
+    }
+
+    /**
+     One level of detail: a range of a shared index buffer over the full resolution vertices
+     */
+    struct Lod {
+        size_t index_offset = 0;
+        size_t index_count = 0;
+        float error = 0.0f;
+    };
+
+    /**
+     Level 0 is the input; every further level targets `ratio` of the previous index count.
+     Stops early when a level no longer shrinks. `indices` receives all levels back to back.
+     */
+    inline std::vector<Lod> build_lod_chain(Mesh& mesh, size_t max_levels, float ratio,
+                                            std::vector<uint32_t>& indices)
+    {
+        std::vector<Lod> lods;
+        indices.assign(mesh.indices.begin(), mesh.indices.end());
+        lods.push_back({ 0, mesh.indices.size(), 0.0f });
+
+        std::vector<uint32_t> previous = mesh.indices;
+        float error = 0.0f;
+        for ( size_t level = 1; level < max_levels; level += 1 ) {
+            Options options;
+            options.target_index_count = (size_t)((float)previous.size() * ratio) / 3 * 3;
+            Result r = simplify(mesh.vertices.data(), mesh.vertices.size(), previous.data(), previous.size(), options);
+            if ( r.indices.size() >= previous.size() || r.indices.empty() ) break;
+
+            // errors accumulate across levels since each starts from the previous one
+            error += r.error;
+            lods.push_back({ indices.size(), r.indices.size(), error });
+            indices.insert(indices.end(), r.indices.begin(), r.indices.end());
+            previous = std::move(r.indices);
+        }
+        return lods;
+    }
+
+    /**
+     Coarsest level whose geometric error, projected at `view_distance` through a vertical field of view `fov_y`
+     onto a target `target_height` pixels tall, stays within `max_pixel_error`
+     */
+    inline size_t select_lod(std::vector<Lod> const& lods, float target_height, float fov_y,
+                             float view_distance, float max_pixel_error)
+    {
+        float pixels_per_unit = target_height * 0.5f / (std::tan(fov_y * 0.5f) * view_distance);
+        size_t selected = 0;
+        for ( size_t i = 0; i < lods.size(); i += 1 )
+            if ( lods[i].error * pixels_per_unit <= max_pixel_error ) selected = i;
+        return selected;
+    }
+}
@@ -0,0 +1,309 @@
+// Meshlet clustering and CPU-side cluster culling
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+#include <bit>
+#include <algorithm>
+#include <simd/simd.h>
+
+#include "SharedTypes.h"
+#include "SIMD.hpp"
+
+namespace Meshlets {
+
+    constexpr size_t max_vertices = 64;
+    constexpr size_t max_triangles = 124;
+
+    /**
+     Range of `MeshletSet::indices` forming one cluster
+     */
+    struct Meshlet {
+        uint32_t index_offset;
+        uint32_t index_count;
+        uint32_t vertex_count;      // unique vertices referenced
+    };
+
+    /**
+     Bounding sphere and backface cone of a meshlet.
+     The cluster faces away from a camera at `eye` when
+     dot(center - eye, cone_axis) >= cone_cutoff * length(center - eye) + radius
+     */
+    struct Bounds {
+        simd::float3 center;
+        float radius;
+        simd::float3 cone_axis;
+        float cone_cutoff;          // sin of the cone half angle, > 1 when the cone cannot cull
+    };
+
+    /**
+     Meshlets of one index buffer, with their bounds stored a lane-width at a time for `cull`
+     */
+    struct MeshletSet {
+        std::vector<Meshlet> meshlets;
+        std::vector<uint32_t> indices;      // meshlet ordered, still indexing the source vertices
+
+        // structure of arrays, zero padded to a multiple of 4
+        std::vector<float> center_x, center_y, center_z, radius;
+        std::vector<float> axis_x, axis_y, axis_z, cutoff;
+
+        inline size_t size() const { return meshlets.size(); }
+
+        inline Bounds bounds(size_t i) const {
+            return { simd::make_float3(center_x[i], center_y[i], center_z[i]), radius[i],
+                     simd::make_float3(axis_x[i], axis_y[i], axis_z[i]), cutoff[i] };
+        }
+    };
+
+    /**
+     Sphere around the vertices of a meshlet and the cone containing its front face normals,
+     with triangles wound so that (b - a) x (c - a) points toward the viewer
+     */
+    inline Bounds compute_bounds(const Vertex* vertices, const uint32_t* indices, size_t index_count) {
+        Bounds b {};
+        if ( index_count == 0 ) return b;
+
+        simd::float3 lo = vertices[indices[0]].position, hi = lo;
+        for ( size_t i = 1; i < index_count; i += 1 ) {
+            lo = simd::min(lo, vertices[indices[i]].position);
+            hi = simd::max(hi, vertices[indices[i]].position);
+        }
+        b.center = (lo + hi) * 0.5f;
+        for ( size_t i = 0; i < index_count; i += 1 )
+            b.radius = std::max(b.radius, simd::distance(b.center, vertices[indices[i]].position));
+
+        std::vector<simd::float3> normals;
+        normals.reserve(index_count / 3);
+        simd::float3 sum = simd::make_float3(0.f, 0.f, 0.f);
+        for ( size_t i = 0; i + 2 < index_count; i += 3 ) {
+            simd::float3 a = vertices[indices[i]].position;
+            simd::float3 n = simd::cross(vertices[indices[i + 1]].position - a, vertices[indices[i + 2]].position - a);
+            float area = simd::length(n);
+            if ( area == 0.f ) continue;
+            normals.push_back(n * (1.f / area));
+            sum = sum + normals.back();
+        }
+
+        // no cull unless every normal lies within ~84 degrees of the axis
+        b.cone_axis = simd::make_float3(0.f, 0.f, 1.f);
+        b.cone_cutoff = 2.f;
+        float sum_length = simd::length(sum);
+        if ( normals.empty() || sum_length == 0.f ) return b;
+
+        b.cone_axis = sum * (1.f / sum_length);
+        float min_dot = 1.f;
+        for ( simd::float3 const& n : normals ) min_dot = std::min(min_dot, simd::dot(n, b.cone_axis));
+        if ( min_dot > 0.1f ) b.cone_cutoff = std::sqrt(1.f - min_dot * min_dot);
+        return b;
+    }
+
+    /**
+     Partition a triangle list into meshlets of at most `vertex_limit` vertices and `triangle_limit` triangles.
+     Each meshlet grows greedily from a seed triangle, preferring neighbours that add the fewest new vertices
+     and then the ones closest to the meshlet's centroid, which keeps clusters round and their bounds tight.
+     */
+    inline MeshletSet build(const Vertex* vertices, size_t vertex_count,
+                            const uint32_t* indices, size_t index_count,
+                            size_t vertex_limit = max_vertices, size_t triangle_limit = max_triangles)
+    {
+        MeshletSet set;
+        size_t triangle_count = index_count / 3;
+        if ( triangle_count == 0 || vertex_limit < 3 || triangle_limit == 0 ) return set;
+
+        // vertex -> adjacent triangles, in compressed rows
+        std::vector<uint32_t> adjacency_offset(vertex_count + 1, 0);
+        for ( size_t i = 0; i < triangle_count * 3; i += 1 ) adjacency_offset[indices[i] + 1] += 1;
+        for ( size_t v = 0; v < vertex_count; v += 1 ) adjacency_offset[v + 1] += adjacency_offset[v];
+
+        std::vector<uint32_t> adjacency(triangle_count * 3);
+        {
+            std::vector<uint32_t> fill(adjacency_offset.begin(), adjacency_offset.end() - 1);
+            for ( size_t t = 0; t < triangle_count; t += 1 )
+                for ( size_t k = 0; k < 3; k += 1 )
+                    adjacency[fill[indices[t * 3 + k]]++] = (uint32_t)t;
+        }
+
+        std::vector<simd::float3> centroid(triangle_count);
+        for ( size_t t = 0; t < triangle_count; t += 1 )
+            centroid[t] = (vertices[indices[t * 3]].position + vertices[indices[t * 3 + 1]].position
+                           + vertices[indices[t * 3 + 2]].position) * (1.f / 3.f);
+
+        constexpr uint32_t none = UINT32_MAX;
+        std::vector<bool> emitted(triangle_count, false);
+        std::vector<uint32_t> owner(vertex_count, none);     // meshlet currently holding the vertex
+        std::vector<uint32_t> meshlet_vertices;
+        meshlet_vertices.reserve(vertex_limit);
+        set.indices.reserve(triangle_count * 3);
+
+        size_t scan_cursor = 0;
+        Meshlet current { 0, 0, 0 };
+        simd::float3 centroid_sum = simd::make_float3(0.f, 0.f, 0.f);
+
+        auto new_vertex_count = [&](size_t t) {
+            uint32_t id = (uint32_t)set.meshlets.size();
+            return (owner[indices[t * 3]] != id) + (owner[indices[t * 3 + 1]] != id) + (owner[indices[t * 3 + 2]] != id);
+        };
+
+        for ( size_t emitted_count = 0; emitted_count < triangle_count; emitted_count += 1 ) {
+            // best unemitted triangle touching the meshlet
+            size_t best = none;
+            int best_new = 4;
+            float best_distance = INFINITY;
+            if ( current.index_count / 3 < triangle_limit ) {
+                simd::float3 center = current.index_count ? centroid_sum * (3.f / (float)current.index_count) : centroid_sum;
+                for ( uint32_t v : meshlet_vertices ) {
+                    for ( uint32_t a = adjacency_offset[v]; a < adjacency_offset[v + 1]; a += 1 ) {
+                        uint32_t t = adjacency[a];
+                        if ( emitted[t] ) continue;
+                        int added = new_vertex_count(t);
+                        if ( meshlet_vertices.size() + added > vertex_limit ) continue;
+                        float d = simd::distance(centroid[t], center);
+                        if ( added < best_new || (added == best_new && d < best_distance) ) {
+                            best = t;
+                            best_new = added;
+                            best_distance = d;
+                        }
+                    }
+                }
+            }
+
+            if ( best == none ) {
+                // meshlet is full or has no free neighbour: close it and seed the next one in input order
+                if ( current.index_count ) {
+                    current.vertex_count = (uint32_t)meshlet_vertices.size();
+                    set.meshlets.push_back(current);
+                }
+                while ( emitted[scan_cursor] ) scan_cursor += 1;
+                best = scan_cursor;
+                current = { (uint32_t)set.indices.size(), 0, 0 };
+                meshlet_vertices.clear();
+                centroid_sum = simd::make_float3(0.f, 0.f, 0.f);
+            }
+
+            uint32_t id = (uint32_t)set.meshlets.size();
+            for ( size_t k = 0; k < 3; k += 1 ) {
+                uint32_t v = indices[best * 3 + k];
+                if ( owner[v] != id ) {
+                    owner[v] = id;
+                    meshlet_vertices.push_back(v);
+                }
+                set.indices.push_back(v);
+            }
+            emitted[best] = true;
+            current.index_count += 3;
+            centroid_sum = centroid_sum + centroid[best];
+        }
+        current.vertex_count = (uint32_t)meshlet_vertices.size();
+        set.meshlets.push_back(current);
+
+        size_t padded = (set.meshlets.size() + 3) / 4 * 4;
+        for ( auto* lane : { &set.center_x, &set.center_y, &set.center_z, &set.radius,
+                             &set.axis_x, &set.axis_y, &set.axis_z, &set.cutoff } )
+            lane->assign(padded, 0.f);
+
+        for ( size_t i = 0; i < set.meshlets.size(); i += 1 ) {
+            Meshlet const& m = set.meshlets[i];
+            Bounds b = compute_bounds(vertices, set.indices.data() + m.index_offset, m.index_count);
+            set.center_x[i] = b.center.x;
+            set.center_y[i] = b.center.y;
+            set.center_z[i] = b.center.z;
+            set.radius[i] = b.radius;
+            set.axis_x[i] = b.cone_axis.x;
+            set.axis_y[i] = b.cone_axis.y;
+            set.axis_z[i] = b.cone_axis.z;
+            set.cutoff[i] = b.cone_cutoff;
+        }
+        return set;
+    }
+
+    /**
+     The six clip planes of `clip` (model to Metal clip space, z in [0, w]) as normalized
+     (n, d) with n . p + d >= 0 inside. Degenerate planes, e.g. the far plane of a projection with
+     z_near = 0, are replaced by one that accepts everything.
+     */
+    inline void frustum_planes(simd::float4x4 const& clip, simd::float4 planes[6]) {
+        auto row = [&](int r) {
+            return simd::make_float4(clip.columns[0][r], clip.columns[1][r], clip.columns[2][r], clip.columns[3][r]);
+        };
+        simd::float4 x = row(0), y = row(1), z = row(2), w = row(3);
+        simd::float4 p[6] = { w + x, w + x * -1.f, w + y, w + y * -1.f, z, w + z * -1.f };
+
+        for ( int i = 0; i < 6; i += 1 ) {
+            float n = std::sqrt(p[i].x * p[i].x + p[i].y * p[i].y + p[i].z * p[i].z);
+            planes[i] = n > 1e-6f ? p[i] * (1.f / n) : simd::make_float4(0.f, 0.f, 0.f, 1.f);
+        }
+    }
+
+    /**
+     Counters of one `cull` call
+     */
+    struct CullStats {
+        size_t meshlets = 0;
+        size_t visible_meshlets = 0;
+        size_t triangles = 0;
+        size_t submitted_triangles = 0;
+
+        /** fraction of triangles that did not have to be submitted */
+        inline double reduction() const { return triangles ? 1.0 - (double)submitted_triangles / (double)triangles : 0.0; }
+    };
+
+    /**
+     Test four meshlets at a time against the frustum of `clip` and the backface cones as seen from `eye`,
+     both in the mesh's model space, and append the indices of the survivors to `out`.
+     `out` must hold `set.indices.size()` entries. Returns the number of indices written.
+     */
+    inline size_t cull(MeshletSet const& set, simd::float4x4 const& clip, simd::float3 eye,
+                       uint32_t* out, CullStats* stats = nullptr)
+    {
+        using Simd::f32x4;
+
+        simd::float4 planes[6];
+        frustum_planes(clip, planes);
+
+        f32x4 ex { eye.x }, ey { eye.y }, ez { eye.z };
+        size_t written = 0, visible = 0;
+
+        for ( size_t g = 0; g < set.center_x.size(); g += 4 ) {
+            f32x4 cx = f32x4::load(&set.center_x[g]);
+            f32x4 cy = f32x4::load(&set.center_y[g]);
+            f32x4 cz = f32x4::load(&set.center_z[g]);
+            f32x4 r = f32x4::load(&set.radius[g]);
+            f32x4 neg_r = f32x4 { 0.f } - r;
+
+            // inside every plane, up to the radius
+            f32x4 keep = f32x4 { 0.f } < f32x4 { 1.f };
+            for ( int i = 0; i < 6; i += 1 ) {
+                f32x4 d = fma(cx, f32x4 { planes[i].x }, fma(cy, f32x4 { planes[i].y },
+                          fma(cz, f32x4 { planes[i].z }, f32x4 { planes[i].w })));
+                keep = keep & (d >= neg_r);
+            }
+
+            // and not entirely back facing
+            f32x4 vx = cx - ex, vy = cy - ey, vz = cz - ez;
+            f32x4 dist = sqrt(fma(vx, vx, fma(vy, vy, vz * vz)));
+            f32x4 along = fma(vx, f32x4::load(&set.axis_x[g]),
+                          fma(vy, f32x4::load(&set.axis_y[g]), vz * f32x4::load(&set.axis_z[g])));
+            keep = keep & (along < fma(f32x4::load(&set.cutoff[g]), dist, r));
+
+            for ( uint32_t bits = bitmask(keep); bits; bits &= bits - 1 ) {
+                size_t i = g + (size_t)std::countr_zero(bits);
+                if ( i >= set.meshlets.size() ) break;
+                Meshlet const& m = set.meshlets[i];
+                std::memcpy(out + written, set.indices.data() + m.index_offset, m.index_count * sizeof(uint32_t));
+                written += m.index_count;
+                visible += 1;
+            }
+        }
+
+        if ( stats ) {
+            stats->meshlets = set.meshlets.size();
+            stats->visible_meshlets = visible;
+            stats->triangles = set.indices.size() / 3;
+            stats->submitted_triangles = written / 3;
+        }
+        return written;
+    }
+}
@@ -0,0 +1,192 @@
+// Mip pyramids of single channel float maps
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <numbers>
+
+#include "SharedTypes.h"
+#include "SIMD.hpp"
+#include "ThreadPool.hpp"
+
+/**
+ CPU reference of the renderer's mip generation: the filters `downsample_mip` in Shaders.metal applies,
+ and a trilinear sampler to measure what a chain buys.
+ Every level is floor(previous / 2) per side, at least 1, like Metal's; borders clamp to the edge.
+ */
+namespace MipChain {
+
+    enum class Filter : uint32_t {
+        None,       // a single level
+        Box,        // 2x2 average
+        Kaiser,     // 8 tap Kaiser windowed sinc: sharper than the box and aliases less
+    };
+
+    inline uint32_t level_count(uint32_t width, uint32_t height) {
+        uint32_t largest = std::max(width, height), n = 1;
+        while ( largest >> n ) n += 1;
+        return n;
+    }
+
+    /** zeroth order modified Bessel function of the first kind */
+    inline double bessel_i0(double x) {
+        double sum = 1.0, term = 1.0;
+        for ( int k = 1; k < 32; k += 1 ) {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    /**
+     Weights of `filter`, normalized to 1. Kaiser uses a half band sinc over 8 taps, `beta` trading ringing for sharpness.
+     */
+    inline MipKernel kernel(Filter filter, double beta = 4.0) {
+        MipKernel k {};
+        if ( filter != Filter::Kaiser ) {
+            k.taps = 2;
+            k.weights[0] = k.weights[1] = 0.5f;
+            return k;
+        }
+
+        k.taps = 8;
+        double w[8], total = 0.0;
+        for ( uint32_t i = 0; i < k.taps; i += 1 ) {
+            // distance from the output texel center, in source texels
+            double d = (double)i - 3.5;
+            double x = std::numbers::pi * d / 2.0;
+            double r = d / 4.0;
+            w[i] = std::sin(x) / x * bessel_i0(beta * std::sqrt(1.0 - r * r)) / bessel_i0(beta);
+            total += w[i];
+        }
+        for ( uint32_t i = 0; i < k.taps; i += 1 ) k.weights[i] = (float)(w[i] / total);
+        return k;
+    }
+
+    /**
+     Decimate a `src_width` x `src_height` map into `dst`, one output row per `pool` job.
+     The vertical pass runs `V::width` source texels at a time, the horizontal one `gather`s every other texel.
+     */
+    template <class V = Simd::f32x8>
+    inline void downsample(const float* src, uint32_t src_width, uint32_t src_height, size_t src_pitch,
+                           float* dst, uint32_t dst_width, uint32_t dst_height, size_t dst_pitch,
+                           MipKernel const& k, ThreadPool& pool)
+    {
+        const int first = 1 - (int)k.taps / 2;
+        const int last_x = (int)src_width - 1;
+        const int last_y = (int)src_height - 1;
+
+        parallel_for(pool, dst_height, [&](size_t y) {
+            const float* rows[8];
+            for ( uint32_t i = 0; i < k.taps; i += 1 )
+                rows[i] = src + (size_t)std::clamp(2 * (int)y + first + (int)i, 0, last_y) * src_pitch;
+
+            std::vector<float> column(src_width);
+            uint32_t x = 0;
+            for ( ; x + V::width <= src_width; x += V::width ) {
+                V s { 0.0f };
+                for ( uint32_t i = 0; i < k.taps; i += 1 )
+                    s = fma(V::load(rows[i] + x), V { k.weights[i] }, s);
+                s.store(column.data() + x);
+            }
+            for ( ; x < src_width; x += 1 ) {
+                float s = 0.0f;
+                for ( uint32_t i = 0; i < k.taps; i += 1 ) s += rows[i][x] * k.weights[i];
+                column[x] = s;
+            }
+
+            float* out = dst + y * dst_pitch;
+            // outputs whose taps all fall inside the row need no clamping
+            uint32_t inside_begin = (uint32_t)std::max(0, (1 - first) / 2);
+            int last_inside = last_x - first - (int)k.taps + 1;
+            uint32_t inside_end = last_inside < 0 ? 0 : std::min((uint32_t)(last_inside / 2 + 1), dst_width);
+            auto clamped = [&](uint32_t ox) {
+                float s = 0.0f;
+                for ( uint32_t i = 0; i < k.taps; i += 1 )
+                    s += column[std::clamp(2 * (int)ox + first + (int)i, 0, last_x)] * k.weights[i];
+                out[ox] = s;
+            };
+
+            uint32_t ox = 0;
+            for ( ; ox < std::min(inside_begin, dst_width); ox += 1 ) clamped(ox);
+            for ( ; ox + V::width <= inside_end; ox += V::width ) {
+                V index = fma(Simd::ramp<V>(0.0f), V { 2.0f }, V { (float)(2 * (int)ox + first) });
+                V s { 0.0f };
+                for ( uint32_t i = 0; i < k.taps; i += 1 )
+                    s = fma(gather(column.data(), index + V { (float)i }), V { k.weights[i] }, s);
+                s.store(out + ox);
+            }
+            for ( ; ox < dst_width; ox += 1 ) clamped(ox);
+        });
+    }
+
+
+    struct Level {
+        uint32_t width;
+        uint32_t height;
+        size_t offset;      // floats from the start of the pyramid, rows are tightly packed
+    };
+
+    /**
+     A map and its whole mip chain in one allocation
+     */
+    class Pyramid {
+    private:
+        std::vector<Level> levels;
+        std::vector<float> texels;
+
+    public:
+        Pyramid(const float* base, uint32_t width, uint32_t height, size_t row_pitch, Filter filter, ThreadPool& pool) {
+            uint32_t count = filter == Filter::None ? 1 : level_count(width, height);
+            size_t total = 0;
+            for ( uint32_t i = 0, w = width, h = height; i < count; i += 1, w = std::max(1u, w / 2), h = std::max(1u, h / 2) ) {
+                levels.push_back({ w, h, total });
+                total += (size_t)w * h;
+            }
+            texels.resize(total);
+
+            for ( uint32_t y = 0; y < height; y += 1 )
+                std::copy(base + y * row_pitch, base + y * row_pitch + width, texels.data() + (size_t)y * width);
+
+            MipKernel k = kernel(filter);
+            for ( uint32_t i = 1; i < count; i += 1 ) {
+                Level const& s = levels[i - 1];
+                Level const& d = levels[i];
+                downsample(texels.data() + s.offset, s.width, s.height, s.width,
+                           texels.data() + d.offset, d.width, d.height, d.width, k, pool);
+            }
+        }
+
+        inline size_t get_level_count() const { return levels.size(); }
+        inline Level const& get_level(size_t i) const { return levels[i]; }
+        inline const float* data(size_t i) const { return texels.data() + levels[i].offset; }
+        inline size_t size_bytes() const { return texels.size() * sizeof(float); }
+    };
+
+    /** bilinear sample of level `i` at normalized (u, v), clamped to the edge */
+    inline float sample_bilinear(Pyramid const& p, size_t i, float u, float v) {
+        Level const& l = p.get_level(i);
+        const float* t = p.data(i);
+        float x = std::clamp(u * (float)l.width - 0.5f, 0.0f, (float)(l.width - 1));
+        float y = std::clamp(v * (float)l.height - 0.5f, 0.0f, (float)(l.height - 1));
+        uint32_t x0 = (uint32_t)x, y0 = (uint32_t)y;
+        uint32_t x1 = std::min(x0 + 1, l.width - 1), y1 = std::min(y0 + 1, l.height - 1);
+        float fx = x - (float)x0, fy = y - (float)y0;
+        float top = t[y0 * l.width + x0] + (t[y0 * l.width + x1] - t[y0 * l.width + x0]) * fx;
+        float bottom = t[y1 * l.width + x0] + (t[y1 * l.width + x1] - t[y1 * l.width + x0]) * fx;
+        return top + (bottom - top) * fy;
+    }
+
+    /** trilinear sample, `lod` being log2 of the footprint in level 0 texels */
+    inline float sample_trilinear(Pyramid const& p, float u, float v, float lod) {
+        float l = std::clamp(lod, 0.0f, (float)(p.get_level_count() - 1));
+        size_t i = (size_t)l;
+        float f = l - (float)i;
+        float a = sample_bilinear(p, i, u, v);
+        if ( f == 0.0f || i + 1 >= p.get_level_count() ) return a;
+        return a + (sample_bilinear(p, i + 1, u, v) - a) * f;
+    }
+}
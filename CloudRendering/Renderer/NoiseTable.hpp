@@ -0,0 +1,72 @@
+// Seeded permutation and gradient table of the cloud noise
+#pragma once
+
+#include <random>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <numbers>
+
+#include "SharedTypes.h"
+
+/**
+ Builds the `CloudNoiseTable` both the density shader and `CloudNoise` read.
+ The generator is spelled out with `std::minstd_rand` rather than distributions or `std::shuffle`,
+ whose output differs between standard libraries, so a seed gives the same clouds everywhere.
+ */
+namespace NoiseTable {
+
+    /** lattice cells before the noise repeats */
+    constexpr uint32_t period = 256;
+
+    static_assert(sizeof(CloudNoiseTable::permutation) == 2 * period);
+    static_assert(sizeof(CloudNoiseTable::gradients) / sizeof(CloudNoiseTable::gradients[0]) == 2 * period);
+
+    /**
+     Fisher-Yates shuffled permutation over `period` evenly spaced unit gradients, turned by a seeded angle
+     */
+    inline CloudNoiseTable make(uint32_t seed) {
+        CloudNoiseTable table;
+        std::minstd_rand rng { seed };
+
+        uint8_t p[period];
+        for ( uint32_t i = 0; i < period; i += 1 ) p[i] = (uint8_t)i;
+        for ( uint32_t i = period - 1; i > 0; i -= 1 ) {
+            uint32_t j = (uint32_t)(rng() % (i + 1));
+            std::swap(p[i], p[j]);
+        }
+
+        // the permutation already scrambles which corner gets which direction
+        float rotation = (float)rng() / (float)std::minstd_rand::max() * 2 * std::numbers::pi_v<float> / (float)period;
+        for ( uint32_t i = 0; i < 2 * period; i += 1 ) {
+            table.permutation[i] = p[i % period];
+            float theta = rotation + 2 * std::numbers::pi_v<float> * (float)table.permutation[i] / (float)period;
+            table.gradients[i] = simd_float2 { std::cos(theta), std::sin(theta) };
+        }
+        return table;
+    }
+
+    /**
+     `CloudNoiseTable` widened to floats for the CPU, so `gather` can read permutation entries like gradients
+     */
+    struct GradientTable {
+        alignas(64) float x[2 * period];
+        alignas(64) float y[2 * period];
+        alignas(64) float permutation[2 * period];
+    };
+
+    inline GradientTable make_gradient_table(CloudNoiseTable const& table) {
+        GradientTable g;
+        for ( size_t i = 0; i < 2 * period; i += 1 ) {
+            g.x[i] = table.gradients[i][0];
+            g.y[i] = table.gradients[i][1];
+            g.permutation[i] = (float)table.permutation[i];
+        }
+        return g;
+    }
+
+    /** index into `gradients` of lattice corner (x, y), as the shader computes it */
+    inline uint32_t corner(CloudNoiseTable const& table, uint32_t x, uint32_t y) {
+        return (x & (period - 1)) + table.permutation[y & (period - 1)];
+    }
+}
@@ -0,0 +1,299 @@
+// Sobel normal maps from height maps
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+
+#include "SIMD.hpp"
+#include "ThreadPool.hpp"
+#include "VertexQuantization.hpp"
+
+/**
+ Normals of a height map by a 3x3 Sobel filter, as `sobel_normal` in Shaders.metal:
+ n = normalize(-Gx, Gy, 1), Gx and Gy being the Sobel derivatives along the row and down the columns.
+ How a normal is stored is an encoding policy: `XYZ8`, `Octahedral8` and `HemiOctahedral8` are the texture formats,
+ `Unpacked` keeps the floats for measuring the others.
+
+ `reference` reads the 3x3 neighborhood of every texel. `generate_region` uses that the Sobel kernels are separable:
+ per output row it smooths (1 2 1) and differences (-1 0 1) the three source rows down the columns once,
+ `V::width` columns at a time, then finishes both derivatives along the row from those two strips.
+ */
+namespace NormalMap {
+
+    /** what a neighbor outside the map reads */
+    enum class Border : uint32_t {
+        Clamp,      // the nearest edge texel
+        Wrap,       // the opposite edge, for tiling height maps
+    };
+
+    inline uint32_t border_index(int64_t i, uint32_t n, Border border) {
+        if ( border == Border::Wrap ) {
+            int64_t m = i % (int64_t)n;
+            return (uint32_t)(m < 0 ? m + n : m);
+        }
+        return (uint32_t)std::clamp<int64_t>(i, 0, (int64_t)n - 1);
+    }
+
+    /** rounds to nearest even, like `Simd::pack_snorm8` */
+    inline uint32_t pack_snorm8(float x) {
+        return (uint32_t)(int32_t)std::nearbyint(std::clamp(x, -1.0f, 1.0f) * 127.0f) & 0xFF;
+    }
+
+    inline float unpack_snorm8(uint32_t byte) {
+        return std::max((float)(int8_t)(uint8_t)byte / 127.0f, -1.0f);
+    }
+
+    struct Normal {
+        float x, y, z;
+    };
+
+    /**
+     Sobel normal of the center of `p`, `p[x][y]` being the height at offset (x - 1, y - 1)
+     */
+    inline Normal sobel_normal(const float p[3][3]) {
+        float nx = -(p[2][2] - p[0][2] + 2 * (p[2][1] - p[0][1]) + p[2][0] - p[0][0]);
+        float ny = -(p[0][0] - p[0][2] + 2 * (p[1][0] - p[1][2]) + p[2][0] - p[2][2]);
+        float nz = 1.0f;
+        float inv = 1.0f / std::sqrt(nx * nx + ny * ny + nz * nz);
+        return { nx * inv, ny * inv, nz * inv };
+    }
+
+
+    /**
+     RGBA8Snorm, w = 0: the layout `generate_normal_map` has always written
+     */
+    struct XYZ8 {
+        using Texel = uint32_t;
+
+        static inline Texel encode(Normal n) {
+            return pack_snorm8(n.x) | pack_snorm8(n.y) << 8 | pack_snorm8(n.z) << 16;
+        }
+        static inline Normal decode(Texel t) {
+            return { unpack_snorm8(t), unpack_snorm8(t >> 8), unpack_snorm8(t >> 16) };
+        }
+        template <class V>
+        static inline void encode(V x, V y, V z, Texel* out) {
+            pack_snorm8(x, y, z, V { 0.0f }, out);
+        }
+        template <class V>
+        static inline void decode(const Texel* in, V& x, V& y, V& z) {
+            V w;
+            V::unpack_snorm8(in, x, y, z, w);
+        }
+    };
+
+    /**
+     RG8Snorm holding the octahedral map of the whole sphere, as `Quantization::octahedral_encode`
+     */
+    struct Octahedral8 {
+        using Texel = uint16_t;
+
+        static inline Texel encode(Normal n) {
+            simd::float2 e = Quantization::octahedral_encode(simd::make_float3(n.x, n.y, n.z));
+            return (Texel)(pack_snorm8(e.x) | pack_snorm8(e.y) << 8);
+        }
+        static inline Normal decode(Texel t) {
+            simd::float3 n = Quantization::octahedral_decode(simd::make_float2(unpack_snorm8(t), unpack_snorm8((uint32_t)t >> 8)));
+            return { n.x, n.y, n.z };
+        }
+
+        /** +1 or -1 per lane, +1 for zero */
+        template <class V>
+        static inline V sign_of(V x) { return select(x < V { 0.0f }, V { 1.0f }, V { -1.0f }); }
+
+        template <class V>
+        static inline void encode(V x, V y, V z, Texel* out) {
+            V inv = V { 1.0f } / (abs(x) + abs(y) + abs(z));
+            V ex = x * inv, ey = y * inv;
+            V lower = z < V { 0.0f };
+            if ( any(lower) ) {
+                V fx = (V { 1.0f } - abs(ey)) * sign_of(ex);
+                V fy = (V { 1.0f } - abs(ex)) * sign_of(ey);
+                ex = select(lower, ex, fx);
+                ey = select(lower, ey, fy);
+            }
+            pack_snorm8(ex, ey, out);
+        }
+        template <class V>
+        static inline void decode(const Texel* in, V& x, V& y, V& z) {
+            V::unpack_snorm8(in, x, y);
+            z = V { 1.0f } - abs(x) - abs(y);
+            V lower = z < V { 0.0f };
+            if ( any(lower) ) {
+                V fx = (V { 1.0f } - abs(y)) * sign_of(x);
+                V fy = (V { 1.0f } - abs(x)) * sign_of(y);
+                x = select(lower, x, fx);
+                y = select(lower, y, fy);
+            }
+            V inv = rsqrt(fma(x, x, fma(y, y, z * z)));
+            x = x * inv, y = y * inv, z = z * inv;
+        }
+    };
+
+    /**
+     RG8Snorm holding the octahedral map of the upper hemisphere only, rotated 45 degrees to fill the square.
+     Height map normals always have z > 0, so this spends the 16 bits on half the directions `Octahedral8` covers.
+     */
+    struct HemiOctahedral8 {
+        using Texel = uint16_t;
+
+        static inline Texel encode(Normal n) {
+            float inv = 1.0f / (std::fabs(n.x) + std::fabs(n.y) + n.z);
+            float px = n.x * inv, py = n.y * inv;
+            return (Texel)(pack_snorm8(px + py) | pack_snorm8(px - py) << 8);
+        }
+        static inline Normal decode(Texel t) {
+            float ex = unpack_snorm8(t), ey = unpack_snorm8((uint32_t)t >> 8);
+            float px = (ex + ey) * 0.5f, py = (ex - ey) * 0.5f;
+            float pz = 1.0f - std::fabs(px) - std::fabs(py);
+            float inv = 1.0f / std::sqrt(px * px + py * py + pz * pz);
+            return { px * inv, py * inv, pz * inv };
+        }
+        template <class V>
+        static inline void encode(V x, V y, V z, Texel* out) {
+            V inv = V { 1.0f } / (abs(x) + abs(y) + z);
+            V px = x * inv, py = y * inv;
+            pack_snorm8(px + py, px - py, out);
+        }
+        template <class V>
+        static inline void decode(const Texel* in, V& x, V& y, V& z) {
+            V ex, ey;
+            V::unpack_snorm8(in, ex, ey);
+            x = (ex + ey) * V { 0.5f };
+            y = (ex - ey) * V { 0.5f };
+            z = V { 1.0f } - abs(x) - abs(y);
+            V inv = rsqrt(fma(x, x, fma(y, y, z * z)));
+            x = x * inv, y = y * inv, z = z * inv;
+        }
+    };
+
+    /**
+     Full precision floats, the baseline the packed encodings are measured against
+     */
+    struct Unpacked {
+        using Texel = Normal;
+
+        static inline Texel encode(Normal n) { return n; }
+        static inline Normal decode(Texel t) { return t; }
+        template <class V>
+        static inline void encode(V x, V y, V z, Texel* out) {
+            alignas(64) float lanes[3][V::width];
+            x.store(lanes[0]), y.store(lanes[1]), z.store(lanes[2]);
+            for ( size_t i = 0; i < V::width; i += 1 ) out[i] = { lanes[0][i], lanes[1][i], lanes[2][i] };
+        }
+    };
+
+
+    /**
+     Naive normals of a `width` x `height` map, `pitch` floats per row, into `out`, `out_pitch` texels per row
+     */
+    template <class Encoding = XYZ8>
+    inline void reference(const float* heights, size_t pitch, uint32_t width, uint32_t height,
+                          typename Encoding::Texel* out, size_t out_pitch, Border border)
+    {
+        for ( uint32_t y = 0; y < height; y += 1 )
+            for ( uint32_t x = 0; x < width; x += 1 ) {
+                float p[3][3];
+                for ( int i = 0; i < 3; i += 1 )
+                    for ( int j = 0; j < 3; j += 1 )
+                        p[i][j] = heights[border_index((int64_t)y + j - 1, height, border) * pitch +
+                                          border_index((int64_t)x + i - 1, width, border)];
+                out[y * out_pitch + x] = Encoding::encode(sobel_normal(p));
+            }
+    }
+
+
+    /**
+     Normals of texels [x_begin, x_end) x [y_begin, y_end) of a `width` x `height` map, `pitch` floats per row.
+     Texel (x, y) goes to out[(y - y_begin) * out_pitch + x - x_begin], so `out` may point into a larger map.
+     */
+    template <class V = Simd::f32x8, class Encoding = XYZ8>
+    inline void generate_region(const float* heights, size_t pitch, uint32_t width, uint32_t height,
+                                typename Encoding::Texel* out, size_t out_pitch,
+                                uint32_t x_begin, uint32_t y_begin, uint32_t x_end, uint32_t y_end, Border border)
+    {
+        if ( x_begin >= x_end || y_begin >= y_end ) return;
+        const size_t n = x_end - x_begin;
+        // whole vectors for the last partial one too, with the halo column on either side
+        const size_t padded = (n + V::width - 1) / V::width * V::width;
+        thread_local std::vector<float> smooth, diff;
+        smooth.assign(padded + 2, 0.0f);
+        diff.assign(padded + 2, 0.0f);
+
+        // smooth[i] and diff[i] belong to column x_begin - 1 + i
+        const uint32_t left = border_index((int64_t)x_begin - 1, width, border);
+        const uint32_t right = border_index((int64_t)x_end, width, border);
+
+        for ( uint32_t y = y_begin; y < y_end; y += 1 ) {
+            const float* above = heights + (size_t)border_index((int64_t)y - 1, height, border) * pitch;
+            const float* row = heights + (size_t)y * pitch;
+            const float* below = heights + (size_t)border_index((int64_t)y + 1, height, border) * pitch;
+
+            // down the columns: 1 2 1 smoothing for Gx, central difference for Gy
+            smooth[0] = above[left] + below[left] + 2.0f * row[left];
+            diff[0] = below[left] - above[left];
+            size_t i = 0;
+            for ( ; i + V::width <= n; i += V::width ) {
+                size_t x = x_begin + i;
+                V a = V::load(above + x), c = V::load(row + x), b = V::load(below + x);
+                fma(c, V { 2.0f }, a + b).store(smooth.data() + 1 + i);
+                (b - a).store(diff.data() + 1 + i);
+            }
+            for ( ; i < n; i += 1 ) {
+                size_t x = x_begin + i;
+                smooth[1 + i] = above[x] + below[x] + 2.0f * row[x];
+                diff[1 + i] = below[x] - above[x];
+            }
+            smooth[n + 1] = above[right] + below[right] + 2.0f * row[right];
+            diff[n + 1] = below[right] - above[right];
+
+            // along the row: central difference for Gx, 1 2 1 smoothing for Gy
+            typename Encoding::Texel* out_row = out + (size_t)(y - y_begin) * out_pitch;
+            for ( i = 0; i < padded; i += V::width ) {
+                V nx = V::load(smooth.data() + i) - V::load(smooth.data() + i + 2);
+                V ny = fma(V::load(diff.data() + i + 1), V { 2.0f }, V::load(diff.data() + i) + V::load(diff.data() + i + 2));
+                V inv = rsqrt(fma(nx, nx, fma(ny, ny, V { 1.0f })));
+                if ( i + V::width <= n ) {
+                    Encoding::encode(nx * inv, ny * inv, inv, out_row + i);
+                } else {
+                    alignas(64) typename Encoding::Texel tail[V::width];
+                    Encoding::encode(nx * inv, ny * inv, inv, tail);
+                    std::copy_n(tail, n - i, out_row + i);
+                }
+            }
+        }
+    }
+
+    /**
+     Decode `count` texels of `Encoding`, `V::width` at a time
+     */
+    template <class V = Simd::f32x8, class Encoding>
+    inline void decode(const typename Encoding::Texel* in, Normal* out, size_t count) {
+        size_t i = 0;
+        for ( ; i + V::width <= count; i += V::width ) {
+            V x, y, z;
+            Encoding::decode(in + i, x, y, z);
+            Unpacked::encode(x, y, z, out + i);
+        }
+        for ( ; i < count; i += 1 ) out[i] = Encoding::decode(in[i]);
+    }
+
+    /** rows per job of `generate` */
+    constexpr uint32_t default_band_height = 32;
+
+    /**
+     Normals of the whole map in bands of rows spread over `pool`
+     */
+    template <class V = Simd::f32x8, class Encoding = XYZ8>
+    inline void generate(ThreadPool& pool, const float* heights, size_t pitch, uint32_t width, uint32_t height,
+                         typename Encoding::Texel* out, size_t out_pitch, Border border, uint32_t band_height = default_band_height)
+    {
+        parallel_for_2d(pool, width, height, width, band_height, [&](size_t x0, size_t y0, size_t x1, size_t y1) {
+            generate_region<V, Encoding>(heights, pitch, width, height, out + y0 * out_pitch, out_pitch,
+                               (uint32_t)x0, (uint32_t)y0, (uint32_t)x1, (uint32_t)y1, border);
+        });
+    }
+}
@@ -7,8 +7,15 @@
 #include <simd/simd.h>
 #include <sstream>
 #include <filesystem>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <algorithm>
 
 #include "SharedTypes.h"
+#include "MappedFile.hpp"
+#include "ThreadPool.hpp"
 
 using namespace std;
 
@@ -22,11 +29,288 @@ static vector<string> split(const string& s, const char delim) {
     return result;
 }
 
+/**
+ Allocation free tokenizer used by the memory mapped parsing path.
+ All functions advance `p` past what they consumed and never read past `end`.
+ */
+namespace ObjParse {
+    inline void skip_spaces(const char*& p, const char* end) {
+        while ( p < end && (*p == ' ' || *p == '\t' || *p == '\r') ) p += 1;
+    }
+
+    inline void skip_token(const char*& p, const char* end) {
+        while ( p < end && *p != ' ' && *p != '\t' && *p != '\r' ) p += 1;
+    }
+
+    /**
+     Locale independent float parsing.
+     Falls back to a hand rolled decimal scanner where the standard library lacks floating point `from_chars`.
+     */
+    inline bool parse_float(const char*& p, const char* end, float& out) {
+        skip_spaces(p, end);
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+        auto [ptr, ec] = from_chars(p, end, out);
+        if ( ec != errc() ) return false;
+        p = ptr;
+        return true;
+#else
+        static constexpr double pow10[] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+            1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18
+        };
+        const char* q = p;
+        bool negative = false;
+        if ( q < end && (*q == '-' || *q == '+') ) negative = *q++ == '-';
+
+        uint64_t mantissa = 0;
+        int digits = 0, exponent = 0;
+        const char* digits_begin = q;
+        for ( ; q < end && *q >= '0' && *q <= '9'; q += 1 ) {
+            if ( digits < 18 ) { mantissa = mantissa * 10 + (uint64_t)(*q - '0'); digits += 1; }
+            else exponent += 1;
+        }
+        if ( q < end && *q == '.' ) {
+            q += 1;
+            for ( ; q < end && *q >= '0' && *q <= '9'; q += 1 ) {
+                if ( digits < 18 ) { mantissa = mantissa * 10 + (uint64_t)(*q - '0'); digits += 1; exponent -= 1; }
+            }
+        }
+        if ( q == digits_begin || (q == digits_begin + 1 && *digits_begin == '.') ) return false;
+
+        if ( q < end && (*q == 'e' || *q == 'E') ) {
+            int e = 0;
+            const char* exp_begin = q + 1;
+            if ( exp_begin < end && *exp_begin == '+' ) exp_begin += 1;
+            auto [ptr, ec] = from_chars(exp_begin, end, e);
+            if ( ec == errc() ) { exponent += e; q = ptr; }
+        }
+
+        double value = (double)mantissa;
+        while ( exponent > 0 ) { int e = exponent > 18 ? 18 : exponent; value *= pow10[e]; exponent -= e; }
+        while ( exponent < 0 ) { int e = -exponent > 18 ? 18 : -exponent; value /= pow10[e]; exponent += e; }
+
+        out = (float)(negative ? -value : value);
+        p = q;
+        return true;
+#endif
+    }
+
+    /**
+     One face corner, OBJ indices as written: 1 based, negative is relative, 0 is absent
+     */
+    struct Corner {
+        int32_t position = 0;
+        int32_t uv = 0;
+        int32_t normal = 0;
+    };
+    
+    /**
+     Parse a face token (`a`, `a/b`, `a//c` or `a/b/c`)
+     */
+    inline bool parse_face_corner(const char*& p, const char* end, Corner& out) {
+        skip_spaces(p, end);
+        out = Corner {};
+        auto [ptr, ec] = from_chars(p, end, out.position);
+        if ( ec != errc() ) return false;
+        p = ptr;
+        
+        if ( p < end && *p == '/' ) {
+            p += 1;
+            auto [uv_ptr, uv_ec] = from_chars(p, end, out.uv);
+            if ( uv_ec == errc() ) p = uv_ptr;
+            
+            if ( p < end && *p == '/' ) {
+                p += 1;
+                auto [n_ptr, n_ec] = from_chars(p, end, out.normal);
+                if ( n_ec == errc() ) p = n_ptr;
+            }
+        }
+        
+        skip_token(p, end);
+        return true;
+    }
+    
+    /**
+     Walk every line in [begin, end) and hand `v`, `vt`, `vn` and `f` records to the callbacks.
+     Polygons are fan triangulated and reported one corner per call, three calls per triangle.
+     */
+    template <class OnPosition, class OnUV, class OnNormal, class OnFaceCorner>
+    inline void for_each_record(const char* begin, const char* end,
+                                OnPosition&& on_position, OnUV&& on_uv, OnNormal&& on_normal, OnFaceCorner&& on_face_corner)
+    {
+        const char* p = begin;
+        while ( p < end ) {
+            const char* line_end = static_cast<const char*>(memchr(p, '\n', (size_t)(end - p)));
+            if ( line_end == nullptr ) line_end = end;
+            
+            skip_spaces(p, line_end);
+            
+            if ( line_end - p >= 2 && p[0] == 'v' && p[1] == ' ' ) {
+                p += 2;
+                float x = 0, y = 0, z = 0;
+                parse_float(p, line_end, x);
+                parse_float(p, line_end, y);
+                parse_float(p, line_end, z);
+                on_position(x, y, z);
+                
+            } else if ( line_end - p >= 3 && p[0] == 'v' && p[1] == 't' && p[2] == ' ' ) {
+                p += 3;
+                float u = 0, v = 0;
+                parse_float(p, line_end, u);
+                parse_float(p, line_end, v);
+                on_uv(u, v);
+                
+            } else if ( line_end - p >= 2 && p[0] == 'f' && p[1] == ' ' ) {
+                p += 2;
+                Corner first, previous, current;
+                int corner_count = 0;
+                while ( parse_face_corner(p, line_end, current) ) {
+                    if ( corner_count == 0 ) first = current;
+                    if ( corner_count >= 2 ) {
+                        on_face_corner(first);
+                        on_face_corner(previous);
+                        on_face_corner(current);
+                    }
+                    previous = current;
+                    corner_count += 1;
+                }
+                
+            } else if ( line_end - p >= 3 && p[0] == 'v' && p[1] == 'n' && p[2] == ' ' ) {
+                p += 3;
+                float x = 0, y = 0, z = 0;
+                parse_float(p, line_end, x);
+                parse_float(p, line_end, y);
+                parse_float(p, line_end, z);
+                on_normal(x, y, z);
+            }
+            
+            p = line_end + 1;
+        }
+    }
+}
+
+/**
+ How `ObjLoader` reads the file from disk
+ */
+enum class ObjParseMode {
+    Stream,     // getline + split, kept as a reference implementation
+    Mapped,     // mmap + in place tokenization, no per line allocation
+    Parallel,   // Mapped, split into newline aligned chunks parsed on worker threads
+    Welded,     // Mapped, one vertex per unique v/vt/vn triplet referenced by the faces
+};
+
+/**
+ Bytes consumed and wall time spent by the last parse
+ */
+struct ObjLoadStats {
+    size_t bytes = 0;
+    double milliseconds = 0.0;
+
+    inline double megabytes_per_second() const {
+        return milliseconds > 0.0 ? (double)bytes / (1024.0 * 1024.0) / (milliseconds / 1000.0) : 0.0;
+    }
+};
+
+/**
+ Result of deduplicating face corners in `ObjParseMode::Welded`
+ */
+struct ObjWeldStats {
+    size_t corners = 0;             // face corners looked up
+    size_t unique_vertices = 0;     // vertices emitted
+    size_t probes = 0;              // table slots visited over all lookups
+    double milliseconds = 0.0;      // time spent hashing and emitting
+    
+    /** corners per emitted vertex */
+    inline double dedup_ratio() const { return unique_vertices ? (double)corners / (double)unique_vertices : 0.0; }
+    
+    inline double average_probe_length() const { return corners ? (double)probes / (double)corners : 0.0; }
+    
+    inline double million_corners_per_second() const {
+        return milliseconds > 0.0 ? (double)corners / 1e6 / (milliseconds / 1000.0) : 0.0;
+    }
+};
+
+/**
+ Open addressing (linear probing) map from a resolved (position, uv, normal) triplet to an output vertex index
+ */
+class VertexWelder {
+private:
+    static constexpr uint32_t empty = UINT32_MAX;
+    
+    struct Slot {
+        uint32_t position, uv, normal;
+        uint32_t vertex;
+    };
+    
+    vector<Slot> slots;
+    size_t mask = 0;
+    size_t count = 0;
+    size_t probe_count = 0;
+    
+    static inline size_t hash(uint32_t position, uint32_t uv, uint32_t normal) {
+        uint64_t h = (uint64_t)position * 0x9E3779B97F4A7C15ull;
+        h ^= ((uint64_t)uv << 32 | normal) * 0xC2B2AE3D27D4EB4Full;
+        h ^= h >> 29;
+        h *= 0xBF58476D1CE4E5B9ull;
+        return (size_t)(h ^ (h >> 32));
+    }
+    
+    void grow() {
+        vector<Slot> old = std::move(slots);
+        slots.assign(old.size() * 2, Slot { empty, empty, empty, empty });
+        mask = slots.size() - 1;
+        for ( Slot const& s : old ) {
+            if ( s.vertex == empty ) continue;
+            size_t i = hash(s.position, s.uv, s.normal) & mask;
+            while ( slots[i].vertex != empty ) i = (i + 1) & mask;
+            slots[i] = s;
+        }
+    }
+    
+public:
+    /** `expected` unique keys fit without rehashing at a load factor of at most 0.5 */
+    explicit VertexWelder( size_t expected ) {
+        size_t capacity = 16;
+        while ( capacity < expected * 2 ) capacity *= 2;
+        slots.assign(capacity, Slot { empty, empty, empty, empty });
+        mask = capacity - 1;
+    }
+    
+    /**
+     Find the vertex for this triplet, or assign it `next_vertex` if it is new.
+     Returns the vertex index and sets `inserted`.
+     */
+    inline uint32_t find_or_insert(uint32_t position, uint32_t uv, uint32_t normal, uint32_t next_vertex, bool& inserted) {
+        if ( (count + 1) * 2 > slots.size() ) grow();
+        
+        size_t i = hash(position, uv, normal) & mask;
+        while ( true ) {
+            probe_count += 1;
+            Slot& s = slots[i];
+            if ( s.vertex == empty ) {
+                s = Slot { position, uv, normal, next_vertex };
+                count += 1;
+                inserted = true;
+                return next_vertex;
+            }
+            if ( s.position == position && s.uv == uv && s.normal == normal ) {
+                inserted = false;
+                return s.vertex;
+            }
+            i = (i + 1) & mask;
+        }
+    }
+    
+    inline size_t probes() const { return probe_count; }
+};
+
 class ObjLoader {
 private:
     ifstream ifs;
     vector<vertex_t> vertices;
     vector<uint32_t> indices;
+    ObjLoadStats stats;
+    ObjWeldStats weld_stats;
     
     void parse_file() {
         string line;
@@ -46,7 +330,7 @@ private:
                 
             } else if ( line_splited[0] == "vt" ) {
                 simd::float2 uv = simd::make_float2( stof(line_splited[1]), stof(line_splited[2]) );
-                vertices[uv_index].uv = uv;
+                if ( uv_index < vertices.size() ) vertices[uv_index].uv = uv;
                 uv_index += 1;
                 
             } else if ( line_splited[0] == "f" ) {
@@ -56,23 +340,254 @@ private:
             } else if ( line_splited[0] == "vn" ) {
                 simd::float3 normal = simd::make_float3(
                     stof(line_splited[1]), stof(line_splited[2]), stof(line_splited[3]) );
-                vertices[normal_index].normal = normal;
+                if ( normal_index < vertices.size() ) vertices[normal_index].normal = normal;
+                normal_index += 1;
+            }
+        }
+    }
+    
+    /**
+     Same semantics as `parse_file`, but tokenizes the mapped bytes in place
+     */
+    void parse_mapped(const char* begin, const char* end) {
+        // one vertex and one triangle line are each at least ~20 bytes, good enough to avoid most regrowth
+        vertices.reserve((size_t)(end - begin) / 64);
+        indices.reserve((size_t)(end - begin) / 32);
+        
+        size_t uv_index = 0;
+        size_t normal_index = 0;
+        
+        ObjParse::for_each_record(begin, end,
+            [&](float x, float y, float z) {
+                vertex_t v {};
+                v.position = simd::make_float3(x, y, z);
+                vertices.push_back(v);
+            },
+            [&](float u, float v) {
+                if ( uv_index < vertices.size() ) vertices[uv_index].uv = simd::make_float2(u, v);
+                uv_index += 1;
+            },
+            [&](float x, float y, float z) {
+                if ( normal_index < vertices.size() ) vertices[normal_index].normal = simd::make_float3(x, y, z);
                 normal_index += 1;
+            },
+            [&](ObjParse::Corner const& corner) {
+                // negative indices count back from the most recent vertex
+                int32_t index = corner.position;
+                indices.push_back(index < 0 ? (uint32_t)((int64_t)vertices.size() + index) : (uint32_t)(index - 1));
+            });
+    }
+    
+    /**
+     Records parsed from one newline aligned slice of the file
+     */
+    struct ObjChunk {
+        vector<simd::float3> positions;
+        vector<simd::float2> uvs;
+        vector<simd::float3> normals;
+        vector<uint32_t> indices;
+        // positions in `indices` holding a chunk relative index that still needs the chunk's vertex base
+        vector<size_t> relative_indices;
+        // chunk positions preceding each vt and vn record, which bound where it may be stored as in `parse_mapped`
+        vector<uint32_t> uv_positions;
+        vector<uint32_t> normal_positions;
+    };
+    
+    /**
+     Split the file into newline aligned chunks, parse them on `pool` and the calling thread,
+     then use prefix sums over the per chunk record counts to place every chunk in the global arrays
+     */
+    void parse_parallel(const char* begin, const char* end, ThreadPool& pool) {
+        // below this a chunk does not amortize handing it to a worker
+        constexpr size_t min_chunk_size = 1 << 20;
+        
+        size_t file_size = (size_t)(end - begin);
+        size_t chunk_count = min<size_t>(pool.size() + 1, max<size_t>(1, file_size / min_chunk_size));
+        
+        if ( chunk_count == 1 ) {
+            parse_mapped(begin, end);
+            return;
+        }
+        
+        // snap chunk boundaries forward to the next line start
+        vector<const char*> bounds(chunk_count + 1);
+        bounds[0] = begin;
+        bounds[chunk_count] = end;
+        for ( size_t i = 1; i < chunk_count; i += 1 ) {
+            const char* p = max(begin + file_size / chunk_count * i, bounds[i - 1]);
+            const char* nl = static_cast<const char*>(memchr(p, '\n', (size_t)(end - p)));
+            bounds[i] = nl == nullptr ? end : nl + 1;
+        }
+        
+        vector<ObjChunk> chunks(chunk_count);
+        parallel_for(pool, chunk_count, [&](size_t c) {
+            ObjChunk& chunk = chunks[c];
+            size_t chunk_size = (size_t)(bounds[c + 1] - bounds[c]);
+            chunk.positions.reserve(chunk_size / 64);
+            chunk.indices.reserve(chunk_size / 32);
+            
+            ObjParse::for_each_record(bounds[c], bounds[c + 1],
+                [&](float x, float y, float z) { chunk.positions.push_back(simd::make_float3(x, y, z)); },
+                [&](float u, float v) {
+                    chunk.uvs.push_back(simd::make_float2(u, v));
+                    chunk.uv_positions.push_back((uint32_t)chunk.positions.size());
+                },
+                [&](float x, float y, float z) {
+                    chunk.normals.push_back(simd::make_float3(x, y, z));
+                    chunk.normal_positions.push_back((uint32_t)chunk.positions.size());
+                },
+                [&](ObjParse::Corner const& corner) {
+                    int32_t index = corner.position;
+                    if ( index < 0 ) {
+                        chunk.relative_indices.push_back(chunk.indices.size());
+                        chunk.indices.push_back((uint32_t)((int64_t)chunk.positions.size() + index));
+                    } else {
+                        chunk.indices.push_back((uint32_t)(index - 1));
+                    }
+                });
+        });
+        
+        // exclusive prefix sums of every record type
+        vector<size_t> position_base(chunk_count + 1, 0), uv_base(chunk_count + 1, 0),
+                       normal_base(chunk_count + 1, 0), index_base(chunk_count + 1, 0);
+        for ( size_t c = 0; c < chunk_count; c += 1 ) {
+            position_base[c + 1] = position_base[c] + chunks[c].positions.size();
+            uv_base[c + 1] = uv_base[c] + chunks[c].uvs.size();
+            normal_base[c + 1] = normal_base[c] + chunks[c].normals.size();
+            index_base[c + 1] = index_base[c] + chunks[c].indices.size();
+        }
+        
+        vertices.assign(position_base[chunk_count], vertex_t {});
+        indices.resize(index_base[chunk_count]);
+        
+        // scatter every chunk into its slot. vt and vn are still assigned to vertices in file order, and like
+        // `parse_mapped` only to vertices whose v record came before them
+        parallel_for(pool, chunk_count, [&](size_t c) {
+            ObjChunk& chunk = chunks[c];
+            for ( size_t i = 0; i < chunk.positions.size(); i += 1 )
+                vertices[position_base[c] + i].position = chunk.positions[i];
+            for ( size_t i = 0; i < chunk.uvs.size(); i += 1 )
+                if ( uv_base[c] + i < position_base[c] + chunk.uv_positions[i] ) vertices[uv_base[c] + i].uv = chunk.uvs[i];
+            for ( size_t i = 0; i < chunk.normals.size(); i += 1 )
+                if ( normal_base[c] + i < position_base[c] + chunk.normal_positions[i] ) vertices[normal_base[c] + i].normal = chunk.normals[i];
+            
+            for ( size_t i : chunk.relative_indices )
+                chunk.indices[i] += (uint32_t)position_base[c];
+            memcpy(indices.data() + index_base[c], chunk.indices.data(), chunk.indices.size() * sizeof(uint32_t));
+            
+            chunk = ObjChunk {};
+        });
+    }
+    
+    /**
+     Gather every attribute array, then emit one vertex per unique (position, uv, normal) triplet
+     referenced by the faces and remap the indices onto them
+     */
+    void parse_welded(const char* begin, const char* end) {
+        constexpr uint32_t absent = UINT32_MAX;
+        
+        vector<simd::float3> positions;
+        vector<simd::float2> uvs;
+        vector<simd::float3> normals;
+        // resolved 0 based triplets, three per triangle
+        vector<uint32_t> corners;
+        positions.reserve((size_t)(end - begin) / 96);
+        corners.reserve((size_t)(end - begin) / 8);
+        
+        auto resolve = [](int32_t index, size_t count) -> uint32_t {
+            if ( index == 0 ) return absent;
+            int64_t resolved = index < 0 ? (int64_t)count + index : (int64_t)index - 1;
+            return resolved >= 0 && resolved < (int64_t)count ? (uint32_t)resolved : absent;
+        };
+        
+        ObjParse::for_each_record(begin, end,
+            [&](float x, float y, float z) { positions.push_back(simd::make_float3(x, y, z)); },
+            [&](float u, float v) { uvs.push_back(simd::make_float2(u, v)); },
+            [&](float x, float y, float z) { normals.push_back(simd::make_float3(x, y, z)); },
+            [&](ObjParse::Corner const& corner) {
+                corners.push_back(resolve(corner.position, positions.size()));
+                corners.push_back(resolve(corner.uv, uvs.size()));
+                corners.push_back(resolve(corner.normal, normals.size()));
+            });
+        
+        auto start = chrono::steady_clock::now();
+        
+        size_t corner_count = corners.size() / 3;
+        // flat shaded meshes split most positions once per adjacent face normal, so size for a few copies of each
+        size_t expected = min(corner_count, 4 * max({ positions.size(), uvs.size(), normals.size() }));
+        VertexWelder welder { expected };
+        vertices.reserve(expected);
+        indices.reserve(corner_count);
+        
+        for ( size_t c = 0; c < corner_count; c += 1 ) {
+            uint32_t position = corners[c * 3], uv = corners[c * 3 + 1], normal = corners[c * 3 + 2];
+            // a face without a valid position cannot be drawn, treat it as degenerate
+            if ( position == absent ) position = 0;
+            
+            bool inserted = false;
+            uint32_t vertex = welder.find_or_insert(position, uv, normal, (uint32_t)vertices.size(), inserted);
+            if ( inserted ) {
+                vertex_t v {};
+                if ( position < positions.size() ) v.position = positions[position];
+                if ( uv != absent ) v.uv = uvs[uv];
+                if ( normal != absent ) v.normal = normals[normal];
+                vertices.push_back(v);
             }
+            indices.push_back(vertex);
         }
+        
+        weld_stats.corners = corner_count;
+        weld_stats.unique_vertices = vertices.size();
+        weld_stats.probes = welder.probes();
+        weld_stats.milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
     }
     
 public:
-    explicit ObjLoader( string& file_path ) : ifs( ifstream() ) {
-        ifs.open(file_path);
+    /**
+     Parse `file_path`. `pool` is only used by `ObjParseMode::Parallel`, which without one
+     starts a pool of one worker per hardware thread for the parse.
+     */
+    explicit ObjLoader( string& file_path, ObjParseMode mode = ObjParseMode::Mapped, ThreadPool* pool = nullptr )
+        : ifs( ifstream() )
+    {
+        auto start = chrono::steady_clock::now();
         
-        if ( ifs.fail() ) {
-            cerr << "cwd: " << filesystem::current_path() << endl;
-            cerr << "Cannot open file \"" << file_path << "\": "<< strerror(errno) << endl;
-            exit(1);
+        if ( mode != ObjParseMode::Stream ) {
+            MappedFile file { file_path };
+            
+            if ( !file.is_open() ) {
+                cerr << "cwd: " << filesystem::current_path() << endl;
+                cerr << "Cannot open file \"" << file_path << "\": "<< strerror(errno) << endl;
+                exit(1);
+            }
+            
+            if ( mode == ObjParseMode::Parallel && pool == nullptr ) {
+                // the calling thread parses a chunk too
+                ThreadPool parse_pool { max(2u, thread::hardware_concurrency()) - 1 };
+                parse_parallel(file.data(), file.data() + file.size(), parse_pool);
+            } else if ( mode == ObjParseMode::Parallel ) {
+                parse_parallel(file.data(), file.data() + file.size(), *pool);
+            } else if ( mode == ObjParseMode::Welded ) {
+                parse_welded(file.data(), file.data() + file.size());
+            } else {
+                parse_mapped(file.data(), file.data() + file.size());
+            }
+            stats.bytes = file.size();
+            
+        } else {
+            ifs.open(file_path);
+            
+            if ( ifs.fail() ) {
+                cerr << "cwd: " << filesystem::current_path() << endl;
+                cerr << "Cannot open file \"" << file_path << "\": "<< strerror(errno) << endl;
+                exit(1);
+            }
+            
+            parse_file();
+            stats.bytes = (size_t)filesystem::file_size(file_path);
         }
         
-        parse_file();
+        stats.milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
     }
     
     void print_loaded_vertices() {
@@ -96,4 +611,10 @@ public:
     inline uint32_t* get_indices_data() { return indices.data(); }
     
     inline size_t get_indices_count() { return indices.size(); }
+    
+    // timing of the parse performed by the constructor
+    inline ObjLoadStats const& get_load_stats() const { return stats; }
+    
+    // deduplication results, only filled by ObjParseMode::Welded
+    inline ObjWeldStats const& get_weld_stats() const { return weld_stats; }
 };
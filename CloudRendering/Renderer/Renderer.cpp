@@ -6,6 +6,20 @@
 #include "Renderer.hpp"
 #include "Util.hpp"
 #include "ObjLoader.hpp"
+#include "MeshCache.hpp"
+#include "VertexQuantization.hpp"
+#include "Mesh.hpp"
+#include "DomeGenerator.hpp"
+#include "MeshSimplifier.hpp"
+#include "MeshOptimizer.hpp"
+#include "Meshlets.hpp"
+#include "ThreadPool.hpp"
+#include "NoiseTable.hpp"
+#include "CloudNoise.hpp"
+#include "CloudEncoding.hpp"
+#include "CloudLayerCache.hpp"
+#include "CloudVirtualTexture.hpp"
+#include "VolumeCache.hpp"
 #include "SharedTypes.h"
 
 #include <Foundation/Foundation.hpp>
@@ -17,17 +31,59 @@
 #include <thread>
 #include <iostream>
 #include <vector>
-#include <random>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 
-/** initialize GPU resources */
+/**
+ Create the device, then start initializing GPU resources on a worker pool.
+ The tasks touch disjoint members and are joined by `finish_startup` before the first frame.
+ */
 Renderer::Renderer() {
+    startup_begin = std::chrono::steady_clock::now();
+
     device = Util::rc(MTL::CreateSystemDefaultDevice());
     shader_library = Util::rc(device->newDefaultLibrary());
     command_queue = Util::rc(device->newCommandQueue());
-    
-    initialize_framebuffer_pipeline();
-    initialize_cloud_generation_resources();
-    initialize_skydome_pipeline();
+    startup_device_milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startup_begin).count();
+
+    worker_pool = std::make_unique<ThreadPool>();
+    startup_pool = std::make_unique<ThreadPool>();
+    startup_tasks = std::make_unique<TaskGroup>(*startup_pool, startup_begin);
+
+    auto run = [this](const char* name, void (Renderer::*initialize)()) {
+        startup_tasks->run(name, [this, initialize] {
+            // worker threads have no autorelease pool of their own
+            auto autorelease_pool = Util::new_scoped<NS::AutoreleasePool>();
+            (this->*initialize)();
+        });
+    };
+    run("framebuffer pipeline", &Renderer::initialize_framebuffer_pipeline);
+    run("cloud generation pipelines", &Renderer::initialize_cloud_generation_pipelines);
+    run("cloud generation resources", &Renderer::initialize_cloud_generation_resources);
+    run("cloud animation", &Renderer::initialize_cloud_animation);
+    run("virtual cloud field", &Renderer::initialize_virtual_cloud_field);
+    run("cloud volumes", &Renderer::load_cloud_volumes);
+    run("skydome mesh", &Renderer::load_skydome_mesh);
+    run("skydome pipeline", &Renderer::initialize_skydome_pipeline);
+}
+
+
+/**
+ Join the startup tasks and report their timings
+ */
+void Renderer::finish_startup() {
+    if ( !startup_tasks ) return;
+
+    startup_tasks->wait();
+    {
+        std::lock_guard lock { published_mutex };
+        startup_timings = startup_tasks->get_timings();
+    }
+    startup_joined_milliseconds = startup_tasks->elapsed_milliseconds();
+    startup_tasks.reset();
+    startup_pool.reset();
 }
 
 
@@ -68,25 +124,90 @@ void Renderer::initialize_framebuffer_pipeline() {
 
 
 /**
- Initialize resouces for the skydome
+ Upload skydome vertices and indices from any mesh exposing the `ObjLoader` accessors
  */
-void Renderer::initialize_skydome_pipeline() {
-    std::string dome_path = get_full_path("Assets/hemisphere.obj");
-    ObjLoader hemisphere { dome_path };
-    
+template <class MeshSource>
+void Renderer::upload_skydome_mesh(MeshSource& hemisphere) {
     skydome_vertex_count = hemisphere.get_vertices_count();
     skydome_index_count = hemisphere.get_indices_count();
     
-    skydome_vertices = Util::rc(device->newBuffer(hemisphere.get_vertices_data(),
-                                                  hemisphere.get_vertices_data_size(),
-                                                  MTL::StorageModeManaged));
+    if ( SKYDOME_PACKED_VERTICES ) {
+        std::vector<PackedVertex> packed;
+        skydome_bounds = Quantization::pack(hemisphere.get_vertices_data(), hemisphere.get_vertices_count(), packed);
+        skydome_vertices = Util::rc(device->newBuffer(packed.data(),
+                                                      packed.size() * sizeof(PackedVertex),
+                                                      MTL::StorageModeManaged));
+    } else {
+        skydome_vertices = Util::rc(device->newBuffer(hemisphere.get_vertices_data(),
+                                                      hemisphere.get_vertices_data_size(),
+                                                      MTL::StorageModeManaged));
+    }
+    
+    // every level indexes the full resolution vertices, only the index buffer grows
+    Mesh full_resolution = Mesh::copy_of(hemisphere);
+    std::vector<uint32_t> lod_indices;
+    skydome_lods = MeshSimplifier::build_lod_chain(full_resolution, SKYDOME_LOD_LEVELS, 0.5f, lod_indices);
+    
+    // simplified levels come out in collapse order; the full resolution one was optimized by its source
+    for ( size_t level = 1; level < skydome_lods.size(); level += 1 )
+        MeshOptimizer::optimize_vertex_cache(lod_indices.data() + skydome_lods[level].index_offset,
+                                             skydome_lods[level].index_count, full_resolution.vertices.size());
+    
+    if ( SKYDOME_MESHLET_CULLING ) {
+        // visible clusters are compacted into a shared buffer each frame, sized for the finest level
+        skydome_meshlets.clear();
+        for ( MeshSimplifier::Lod const& lod : skydome_lods )
+            skydome_meshlets.push_back(Meshlets::build(full_resolution.vertices.data(), full_resolution.vertices.size(),
+                                                       lod_indices.data() + lod.index_offset, lod.index_count));
+        skydome_culled_indices = Util::rc(device->newBuffer(skydome_lods[0].index_count * sizeof(uint32_t),
+                                                            MTL::StorageModeShared));
+    } else {
+        skydome_indices = Util::rc(device->newBuffer(lod_indices.data(),
+                                                     lod_indices.size() * sizeof(uint32_t),
+                                                     MTL::StorageModeManaged));
+    }
     
-    skydome_indices = Util::rc(device->newBuffer(hemisphere.get_indices_data(),
-                                                 hemisphere.get_indices_data_size(),
-                                                 MTL::StorageModeManaged));
+    if ( CLOUD_VIRTUAL_TEXTURE ) {
+        MeshSimplifier::Lod const& lod = skydome_lods[std::min(CLOUD_VIRTUAL_FEEDBACK_LOD, skydome_lods.size() - 1)];
+        skydome_feedback_mesh.vertices = full_resolution.vertices;
+        skydome_feedback_mesh.indices.assign(lod_indices.begin() + lod.index_offset,
+                                             lod_indices.begin() + lod.index_offset + lod.index_count);
+    }
     
-    auto vertex_shader_name = Util::ns_str("transform");
-    auto fragment_shader_name = Util::ns_str("draw_skydome");
+    // the camera sits at the origin, the nearest part of the dome bounds the on-screen error
+    skydome_view_distance = INFINITY;
+    for ( Vertex const& v : full_resolution.vertices )
+        skydome_view_distance = std::min(skydome_view_distance, simd::length(v.position));
+}
+
+
+/**
+ Load or generate the skydome mesh and upload it
+ */
+void Renderer::load_skydome_mesh() {
+    if ( SKYDOME_SOURCE == SkydomeSource::Asset ) {
+        std::string dome_path = get_full_path("Assets/hemisphere.obj");
+        CachedMesh hemisphere { dome_path, get_cache_path("hemisphere.crmesh") };
+        upload_skydome_mesh(hemisphere);
+    } else {
+        Mesh hemisphere = SKYDOME_SOURCE == SkydomeSource::Geodesic
+            ? DomeGenerator::geodesic(SKYDOME_GEODESIC_LEVEL)
+            : DomeGenerator::uv_sphere(SKYDOME_UV_RINGS, SKYDOME_UV_SEGMENTS);
+        // generated in ring or subdivision order, reordered like the .crmesh path does for the asset
+        MeshOptimizer::optimize_vertex_cache(hemisphere.indices.data(), hemisphere.indices.size(), hemisphere.vertices.size());
+        MeshOptimizer::optimize_vertex_fetch(hemisphere.vertices.data(), hemisphere.vertices.size(),
+                                             hemisphere.indices.data(), hemisphere.indices.size());
+        upload_skydome_mesh(hemisphere);
+    }
+}
+
+
+/**
+ Initialize the PSO for the skydome
+ */
+void Renderer::initialize_skydome_pipeline() {
+    auto vertex_shader_name = Util::ns_str(SKYDOME_PACKED_VERTICES ? "transform_packed" : "transform");
+    auto fragment_shader_name = Util::ns_str(CLOUD_VIRTUAL_TEXTURE ? "draw_skydome_virtual" : "draw_skydome");
     auto vertex_shader = Util::scoped(shader_library->newFunction(vertex_shader_name));
     auto fragment_shader = Util::scoped(shader_library->newFunction(fragment_shader_name));
     
@@ -136,69 +257,339 @@ void Renderer::draw_skydome(std::shared_ptr<MTL::CommandBuffer> cmd_buffer,
     simd::float4x4 view_t_i = simd::transpose(simd::inverse(view));
     encoder->setVertexBytes(&view_t_i, sizeof(simd::float4x4), 2);
     
-    simd::float4x4 proj = Math::perspective(Math::radian(100.f), width / height, 0.0f, 100.f);
+    simd::float4x4 proj = Math::perspective(Math::radian(SKYDOME_FOV_DEGREES), width / height, 0.0f, 100.f);
 //    simd::float4x4 proj = simd::float4x4(1.0f);
     
     encoder->setVertexBytes(&proj, sizeof(simd::float4x4), 3);
     
-    encoder->setFragmentTexture(cloud_density_map.get(), 0);
+    if ( SKYDOME_PACKED_VERTICES )
+        encoder->setVertexBytes(&skydome_bounds, sizeof(PackedVertexBounds), 4);
     
     encoder->setFragmentTexture(cloud_density_map.get(), 0);
+    encoder->setFragmentTexture(cloud_velocity_map.get(), 1);
+    encoder->setFragmentBytes(&cloud_flow_frame, sizeof(CloudFlowFrame), 0);
     
-    encoder->drawIndexedPrimitives(MTL::PrimitiveTypeTriangle,
-                                   skydome_index_count,
-                                   MTL::IndexTypeUInt32,
-                                   skydome_indices.get(), 0);
+    if ( CLOUD_VIRTUAL_TEXTURE ) {
+        update_virtual_cloud_field(proj * view, width, height);
+        encoder->setFragmentTexture(cloud_virtual_atlas.get(), 0);
+        encoder->setFragmentBytes(&cloud_virtual_field->get_layout(), sizeof(CloudVirtualLayout), 1);
+        encoder->setFragmentBuffer(cloud_virtual_indirection.get(), 0, 2);
+    }
+    
+    // coarsest level that stays within the pixel error budget at this render target size
+    size_t lod = MeshSimplifier::select_lod(skydome_lods, height, Math::radian(SKYDOME_FOV_DEGREES),
+                                            skydome_view_distance, SKYDOME_LOD_PIXEL_ERROR);
+    
+    if ( SKYDOME_MESHLET_CULLING ) {
+        simd::float3 eye = (simd::inverse(view) * simd::make_float4(0.f, 0.f, 0.f, 1.f)).xyz;
+        size_t culled_index_count = Meshlets::cull(skydome_meshlets[lod], proj * view, eye,
+                                                   static_cast<uint32_t*>(skydome_culled_indices->contents()),
+                                                   &skydome_cull_stats);
+        if ( culled_index_count )
+            encoder->drawIndexedPrimitives(MTL::PrimitiveTypeTriangle,
+                                           culled_index_count,
+                                           MTL::IndexTypeUInt32,
+                                           skydome_culled_indices.get(),
+                                           0);
+    } else {
+        encoder->drawIndexedPrimitives(MTL::PrimitiveTypeTriangle,
+                                       skydome_lods[lod].index_count,
+                                       MTL::IndexTypeUInt32,
+                                       skydome_indices.get(),
+                                       skydome_lods[lod].index_offset * sizeof(uint32_t));
+    }
     encoder->endEncoding();
 }
 
 /**
- Initialize noise generation resources
+ Initialize the noise generation compute PSOs
  */
-void Renderer::initialize_cloud_generation_resources() {
+void Renderer::initialize_cloud_generation_pipelines() {
     /// For density map generation
     {
         auto shader_name = Util::scoped(Util::ns_str("generate_cloud_density_map"));
         auto shader = Util::scoped(shader_library->newFunction(shader_name.get()));
         NS::Error* err;
         gen_density_pso = Util::rc(device->newComputePipelineState(shader.get(), &err));
-        
-        // load GPU buffer
-        std::uniform_real_distribution<float> dist { 0.f, 2 * Math::pi };
-        std::default_random_engine rng;
-        std::vector<float> p;
-        
-        for (int i = 0; i < 128; i += 1)
-            p.push_back(dist(rng));
-        
-        
-        permutations_buffer = Util::rc(device->newBuffer(p.data(), p.size() * sizeof(float), MTL::StorageModeManaged));
+    }
+    
+    /// For normal map generation
+    {
+        auto shader_name = Util::scoped(Util::ns_str("generate_normal_map"));
+        auto shader = Util::scoped(shader_library->newFunction(shader_name.get()));
+        NS::Error* err;
+        gen_normal_pso = Util::rc(device->newComputePipelineState(shader.get(), &err));
+    }
+    
+    /// For fused density and normal map generation
+    {
+        auto shader_name = Util::scoped(Util::ns_str("generate_cloud_maps"));
+        auto shader = Util::scoped(shader_library->newFunction(shader_name.get()));
+        NS::Error* err;
+        gen_maps_pso = Util::rc(device->newComputePipelineState(shader.get(), &err));
+    }
+    
+    /// For the base band of the fused maps
+    {
+        auto shader_name = Util::scoped(Util::ns_str("generate_cloud_base_band"));
+        auto shader = Util::scoped(shader_library->newFunction(shader_name.get()));
+        NS::Error* err;
+        gen_base_band_pso = Util::rc(device->newComputePipelineState(shader.get(), &err));
+    }
+    
+    /// For mip chain generation
+    {
+        auto shader_name = Util::scoped(Util::ns_str("downsample_mip"));
+        auto shader = Util::scoped(shader_library->newFunction(shader_name.get()));
+        NS::Error* err;
+        downsample_mip_pso = Util::rc(device->newComputePipelineState(shader.get(), &err));
+    }
+}
+
+
+/**
+ Texture formats of the cloud maps
+ */
+static MTL::PixelFormat pixel_format(CloudEncoding::DensityFormat format) {
+    switch ( format ) {
+        case CloudEncoding::DensityFormat::Half:    return MTL::PixelFormatR16Float;
+        case CloudEncoding::DensityFormat::Unorm8:  return MTL::PixelFormatR8Unorm;
+        default:                                    return MTL::PixelFormatR32Float;
+    }
+}
+
+static MTL::PixelFormat pixel_format(CloudEncoding::NormalFormat format) {
+    return format == CloudEncoding::NormalFormat::XYZ8 ? MTL::PixelFormatRGBA8Snorm : MTL::PixelFormatRG8Snorm;
+}
+
+
+/**
+ Initialize noise generation resources
+ */
+void Renderer::initialize_cloud_generation_resources() {
+    /// For density map generation
+    {
+        upload_noise_table();
         
         auto cloud_density_map_desc = Util::new_scoped<MTL::TextureDescriptor>();
         cloud_density_map_desc->setWidth(INTERNAL_RESOLUTION_WIDTH);
         cloud_density_map_desc->setHeight(INTERNAL_RESOLUTION_HEIGHT);
         cloud_density_map_desc->setTextureType(MTL::TextureType2D);
         cloud_density_map_desc->setUsage(MTL::TextureUsageShaderRead | MTL::TextureUsageShaderWrite);
-        cloud_density_map_desc->setPixelFormat(MTL::PixelFormatR32Float);
+        cloud_density_map_desc->setPixelFormat(pixel_format(CLOUD_DENSITY_FORMAT));
+        if ( CLOUD_DENSITY_MIP_FILTER != MipChain::Filter::None )
+            cloud_density_map_desc->setMipmapLevelCount(MipChain::level_count(INTERNAL_RESOLUTION_WIDTH, INTERNAL_RESOLUTION_HEIGHT));
         cloud_density_map = Util::rc(device->newTexture(cloud_density_map_desc.get()));
+        cloud_density_mips = new_mip_views(cloud_density_map.get());
+        if ( AMORTIZED_CLOUD_REGENERATION ) {
+            cloud_density_back = Util::rc(device->newTexture(cloud_density_map_desc.get()));
+            cloud_density_back_mips = new_mip_views(cloud_density_back.get());
+        }
     }
     
     /// For normal map generation
     {
-        auto shader_name = Util::scoped(Util::ns_str("generate_normal_map"));
-        auto shader = Util::scoped(shader_library->newFunction(shader_name.get()));
-        NS::Error* err;
-        gen_normal_pso = Util::rc(device->newComputePipelineState(shader.get(), &err));
-        
         auto cloud_normal_map_desc = Util::new_scoped<MTL::TextureDescriptor>();
         cloud_normal_map_desc->setWidth(INTERNAL_RESOLUTION_WIDTH);
         cloud_normal_map_desc->setHeight(INTERNAL_RESOLUTION_HEIGHT);
         cloud_normal_map_desc->setTextureType(MTL::TextureType2D);
         cloud_normal_map_desc->setUsage(MTL::TextureUsageShaderRead | MTL::TextureUsageShaderWrite);
-        cloud_normal_map_desc->setPixelFormat(MTL::PixelFormatRGBA8Snorm);
+        cloud_normal_map_desc->setPixelFormat(pixel_format(CLOUD_NORMAL_FORMAT));
+        if ( CLOUD_NORMAL_MIP_FILTER != MipChain::Filter::None )
+            cloud_normal_map_desc->setMipmapLevelCount(MipChain::level_count(INTERNAL_RESOLUTION_WIDTH, INTERNAL_RESOLUTION_HEIGHT));
         cloud_normal_map = Util::rc(device->newTexture(cloud_normal_map_desc.get()));
+        cloud_normal_mips = new_mip_views(cloud_normal_map.get());
+        if ( AMORTIZED_CLOUD_REGENERATION ) {
+            cloud_normal_back = Util::rc(device->newTexture(cloud_normal_map_desc.get()));
+            cloud_normal_back_mips = new_mip_views(cloud_normal_back.get());
+        }
+    }
+    
+    /// For the base band, only the GPU reads and writes it
+    if ( FUSED_CLOUD_MAPS ) {
+        auto desc = Util::new_scoped<MTL::TextureDescriptor>();
+        desc->setWidth(cloud_base_size(INTERNAL_RESOLUTION_WIDTH, CLOUD_BASE_BAND.shift));
+        desc->setHeight(cloud_base_size(INTERNAL_RESOLUTION_HEIGHT, CLOUD_BASE_BAND.shift));
+        desc->setTextureType(MTL::TextureType2D);
+        desc->setUsage(MTL::TextureUsageShaderRead | MTL::TextureUsageShaderWrite);
+        desc->setPixelFormat(MTL::PixelFormatR32Float);
+        desc->setStorageMode(MTL::StorageModePrivate);
+        cloud_base_band = Util::rc(device->newTexture(desc.get()));
     }
     
+    auto bytes = CloudEncoding::memory(INTERNAL_RESOLUTION_WIDTH, INTERNAL_RESOLUTION_HEIGHT,
+                                       (uint32_t)cloud_density_mips.size(), (uint32_t)cloud_normal_mips.size(),
+                                       CLOUD_DENSITY_FORMAT, CLOUD_NORMAL_FORMAT);
+    std::cout << "Cloud maps: " << CloudEncoding::name(CLOUD_DENSITY_FORMAT) << " density " << bytes.density_bytes / 1024 << " KB, "
+              << CloudEncoding::name(CLOUD_NORMAL_FORMAT) << " normals " << bytes.normal_bytes / 1024 << " KB, allocated "
+              << (cloud_density_map->allocatedSize() + cloud_normal_map->allocatedSize()) / 1024 << " KB";
+    if ( cloud_base_band ) std::cout << ", base band " << cloud_base_band->allocatedSize() / 1024 << " KB";
+    std::cout << std::endl;
+}
+
+
+/**
+ A single level view of every mip level of `texture`, so `downsample_mip` can read one level and write the next
+ */
+std::vector<std::shared_ptr<MTL::Texture>> Renderer::new_mip_views(MTL::Texture* texture) {
+    std::vector<std::shared_ptr<MTL::Texture>> views;
+    for ( NS::UInteger level = 0; level < texture->mipmapLevelCount(); level += 1 )
+        views.push_back(Util::rc(texture->newTextureView(texture->pixelFormat(), MTL::TextureType2D,
+                                                         NS::Range::Make(level, 1), NS::Range::Make(0, 1))));
+    return views;
+}
+
+
+/**
+ Create the velocity field and its texture; without animation the texture stays zero and the map is sampled as is
+ */
+void Renderer::initialize_cloud_animation() {
+    auto desc = Util::new_scoped<MTL::TextureDescriptor>();
+    desc->setWidth(CLOUD_FLOW.resolution);
+    desc->setHeight(CLOUD_FLOW.resolution);
+    desc->setTextureType(MTL::TextureType2D);
+    desc->setUsage(MTL::TextureUsageShaderRead);
+    desc->setPixelFormat(MTL::PixelFormatRG32Float);
+    desc->setStorageMode(MTL::StorageModeManaged);
+    cloud_velocity_map = Util::rc(device->newTexture(desc.get()));
+    
+    std::vector<float> zero((size_t)CLOUD_FLOW.resolution * CLOUD_FLOW.resolution * 2, 0.0f);
+    cloud_velocity_map->replaceRegion(MTL::Region::Make2D(0, 0, CLOUD_FLOW.resolution, CLOUD_FLOW.resolution), 0,
+                                      zero.data(), CLOUD_FLOW.resolution * 2 * sizeof(float));
+    
+    if ( ANIMATE_CLOUDS )
+        cloud_velocity = std::make_unique<CloudAnimation::VelocityField>(CLOUD_FLOW, cloud_parameters.seed);
+}
+
+
+/**
+ Rebuild the velocity field for the current time and upload it, a few thousand noise samples instead of the whole map
+ */
+void Renderer::update_cloud_animation() {
+    if ( !cloud_velocity ) return;
+    
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startup_begin).count();
+    cloud_velocity->update(seconds);
+    cloud_flow_frame = CloudAnimation::flow_frame(seconds, CLOUD_FLOW.period);
+    
+    const uint32_t n = cloud_velocity->get_resolution();
+    cloud_velocity_map->replaceRegion(MTL::Region::Make2D(0, 0, n, n), 0, cloud_velocity->data(), n * 2 * sizeof(float));
+}
+
+
+/**
+ Create the virtual density map with its coarsest page resident, the atlas and the indirection buffer
+ */
+void Renderer::initialize_virtual_cloud_field() {
+    if ( !CLOUD_VIRTUAL_TEXTURE ) return;
+    
+    cloud_virtual_field = std::make_unique<VirtualTexture::VirtualCloudField>(
+        CLOUD_VIRTUAL_CONFIG, VirtualTexture::virtual_parameters(cloud_parameters, INTERNAL_RESOLUTION_WIDTH, CLOUD_VIRTUAL_CONFIG.virtual_size));
+    
+    auto desc = Util::new_scoped<MTL::TextureDescriptor>();
+    desc->setWidth(cloud_virtual_field->get_atlas_width());
+    desc->setHeight(cloud_virtual_field->get_atlas_height());
+    desc->setTextureType(MTL::TextureType2D);
+    desc->setUsage(MTL::TextureUsageShaderRead);
+    desc->setPixelFormat(pixel_format(CLOUD_DENSITY_FORMAT));
+    desc->setStorageMode(MTL::StorageModeManaged);
+    cloud_virtual_atlas = Util::rc(device->newTexture(desc.get()));
+    
+    cloud_virtual_indirection = Util::rc(device->newBuffer(cloud_virtual_field->get_indirection().size() * sizeof(uint32_t),
+                                                           MTL::StorageModeShared));
+    upload_virtual_pages();
+    
+    std::cout << "Virtual cloud field: " << CLOUD_VIRTUAL_CONFIG.virtual_size << "^2 texels, "
+              << cloud_virtual_field->get_layout().levels << " levels, atlas "
+              << cloud_virtual_atlas->allocatedSize() / 1024 << " KB" << std::endl;
+}
+
+
+/**
+ Feedback over the dome for this frame's view, then generate and upload the pages it asked for
+ */
+void Renderer::update_virtual_cloud_field(simd::float4x4 const& clip, float width, float height) {
+    cloud_virtual_field->set_parameters(VirtualTexture::virtual_parameters(cloud_parameters, INTERNAL_RESOLUTION_WIDTH,
+                                                                           CLOUD_VIRTUAL_CONFIG.virtual_size));
+    
+    // the flow moves lookups by up to its largest velocity times a period
+    float dilation = 0.0f;
+    if ( cloud_velocity ) {
+        const float* v = cloud_velocity->data();
+        for ( size_t i = 0; i < (size_t)cloud_velocity->get_resolution() * cloud_velocity->get_resolution(); i += 1 )
+            dilation = std::max(dilation, std::hypot(v[2 * i], v[2 * i + 1]));
+        dilation *= CLOUD_FLOW.period;
+    }
+    
+    auto const& pages = cloud_virtual_feedback.collect(skydome_feedback_mesh.vertices.data(), skydome_feedback_mesh.indices.data(),
+                                                       skydome_feedback_mesh.indices.size(), clip, width, height,
+                                                       cloud_virtual_field->get_layout(), dilation);
+    cloud_virtual_field->update(pages, *worker_pool, CLOUD_VIRTUAL_PAGES_PER_FRAME);
+    upload_virtual_pages();
+}
+
+
+/**
+ Copy the slots written since the last upload into the atlas texture, in its format, and the indirection table
+ */
+void Renderer::upload_virtual_pages() {
+    VirtualTexture::VirtualCloudField& field = *cloud_virtual_field;
+    const uint32_t side = field.get_layout().slot_size;
+    const uint32_t texel_bytes = CloudEncoding::bytes_per_texel(CLOUD_DENSITY_FORMAT);
+    std::vector<uint8_t> texels((size_t)side * side * texel_bytes);
+    
+    for ( uint32_t slot : field.get_dirty_slots() ) {
+        uint32_t x0 = field.slot_x(slot), y0 = field.slot_y(slot);
+        for ( uint32_t y = 0; y < side; y += 1 )
+            CloudEncoding::encode_density_row(field.atlas_data() + (size_t)(y0 + y) * field.get_atlas_width() + x0,
+                                              texels.data() + (size_t)y * side * texel_bytes, side, x0, y0 + y, CLOUD_DENSITY_FORMAT);
+        cloud_virtual_atlas->replaceRegion(MTL::Region::Make2D(x0, y0, side, side), 0, texels.data(), side * texel_bytes);
+    }
+    
+    if ( field.is_indirection_dirty() )
+        std::memcpy(cloud_virtual_indirection->contents(), field.get_indirection().data(), field.get_indirection().size() * sizeof(uint32_t));
+    field.clear_dirty();
+}
+
+
+/**
+ Map the cached 3D noise volumes, baking them on the startup pool the first time, and upload them
+ */
+void Renderer::load_cloud_volumes() {
+    if ( !BAKE_CLOUD_VOLUMES ) return;
+    
+    cloud_shape_volume = upload_cloud_volume(CLOUD_SHAPE_VOLUME, "cloud_shape.crvol");
+    cloud_detail_volume = upload_cloud_volume(CLOUD_DETAIL_VOLUME, "cloud_detail.crvol");
+}
+
+
+std::shared_ptr<MTL::Texture> Renderer::upload_cloud_volume(VolumeNoise::VolumeParameters const& params,
+                                                            std::string const& cache_name) {
+    CachedVolume volume { params, get_cache_path(cache_name), *startup_pool };
+    std::cout << cache_name << ": " << (volume.is_cache_hit() ? "cache hit" : "baked") << " in "
+              << volume.get_load_milliseconds() << " ms" << std::endl;
+    
+    const NS::UInteger n = volume.get_size();
+    auto desc = Util::new_scoped<MTL::TextureDescriptor>();
+    desc->setWidth(n);
+    desc->setHeight(n);
+    desc->setDepth(n);
+    desc->setTextureType(MTL::TextureType3D);
+    desc->setUsage(MTL::TextureUsageShaderRead);
+    desc->setPixelFormat(MTL::PixelFormatRGBA8Unorm);
+    auto texture = Util::rc(device->newTexture(desc.get()));
+    texture->replaceRegion(MTL::Region::Make3D(0, 0, 0, n, n, n), 0, 0, volume.data(), n * 4, n * n * 4);
+    return texture;
+}
+
+
+/**
+ Upload the permutation and gradients for the current seed, the same table `CloudNoise` uses on the CPU
+ */
+void Renderer::upload_noise_table() {
+    CloudNoiseTable table = NoiseTable::make(cloud_parameters.seed);
+    noise_table_buffer = Util::rc(device->newBuffer(&table, sizeof(CloudNoiseTable), MTL::StorageModeManaged));
+    noise_table_seed = cloud_parameters.seed;
 }
 
 
@@ -209,14 +600,28 @@ void Renderer::generate_cloud(std::shared_ptr<MTL::CommandBuffer> command_buffer
     auto encoder = Util::scoped(command_buffer->computeCommandEncoder());
     auto dispatch_size = MTL::Size::Make(INTERNAL_RESOLUTION_WIDTH, INTERNAL_RESOLUTION_HEIGHT, 1);
     simd::uint2 dimension = { INTERNAL_RESOLUTION_WIDTH, INTERNAL_RESOLUTION_HEIGHT };
+    CloudMapEncoding encoding = CloudEncoding::map_encoding(CLOUD_DENSITY_FORMAT, CLOUD_NORMAL_FORMAT);
+    
+    if ( noise_table_seed != cloud_parameters.seed ) upload_noise_table();
+    
+    /// Dispatch `generate_cloud_base_band` if the lattice changed, then `generate_cloud_maps` over every tile
+    if ( FUSED_CLOUD_MAPS ) {
+        encode_cloud_base_band(encoder.get());
+        encode_cloud_map_tiles(encoder.get(), cloud_density_map.get(), cloud_normal_map.get(),
+                               0, (INTERNAL_RESOLUTION_HEIGHT + CLOUD_MAP_TILE_SIZE - 1) / CLOUD_MAP_TILE_SIZE);
+    }
     
     /// Dispatch `generate_cloud_density_map`
-    {
+    if ( !FUSED_CLOUD_MAPS ) {
         encoder->setComputePipelineState(gen_density_pso.get());
         // texture dimension
         encoder->setBytes(&dimension, sizeof(simd::uint2), 0);
-        // permutation array
-        encoder->setBuffer(permutations_buffer.get(), 0, 1);
+        // permutation and gradients
+        encoder->setBuffer(noise_table_buffer.get(), 0, 1);
+        // seed, octaves and shaping
+        encoder->setBytes(&cloud_parameters, sizeof(CloudFieldParameters), 2);
+        // dither and normal layout of the output formats
+        encoder->setBytes(&encoding, sizeof(CloudMapEncoding), 3);
         // output texture
         encoder->setTexture(cloud_density_map.get(), 0);
         
@@ -226,9 +631,10 @@ void Renderer::generate_cloud(std::shared_ptr<MTL::CommandBuffer> command_buffer
     }
     
     /// Dispatch `generate_normal_map`
-    {
+    if ( !FUSED_CLOUD_MAPS ) {
         encoder->setComputePipelineState(gen_normal_pso.get());
         encoder->setBytes(&dimension, sizeof(simd::uint2), 0);
+        encoder->setBytes(&encoding, sizeof(CloudMapEncoding), 1);
         encoder->setTexture(cloud_density_map.get(), 0);
         encoder->setTexture(cloud_normal_map.get(), 1);
         auto threadgroup_size = MTL::Size::Make(gen_normal_pso->threadExecutionWidth(),
@@ -236,10 +642,184 @@ void Renderer::generate_cloud(std::shared_ptr<MTL::CommandBuffer> command_buffer
         encoder->dispatchThreads(dispatch_size, threadgroup_size);
     }
     
+    /// Dispatch `downsample_mip` for every level below the base ones
+    encode_mip_chain(encoder.get(), cloud_density_mips, CLOUD_DENSITY_MIP_FILTER);
+    encode_mip_chain(encoder.get(), cloud_normal_mips, CLOUD_NORMAL_MIP_FILTER);
+    
     encoder->endEncoding();
 }
 
 
+/**
+ Dispatch `generate_cloud_maps` over the rows [first_row, last_row) of tiles, whole tiles so every thread helps fill the halo
+ */
+void Renderer::encode_cloud_map_tiles(MTL::ComputeCommandEncoder* encoder, MTL::Texture* density, MTL::Texture* normals,
+                                      uint32_t first_row, uint32_t last_row)
+{
+    simd::uint2 dimension = { INTERNAL_RESOLUTION_WIDTH, INTERNAL_RESOLUTION_HEIGHT };
+    simd::uint2 tile_offset = { 0, first_row };
+    CloudMapEncoding encoding = CloudEncoding::map_encoding(CLOUD_DENSITY_FORMAT, CLOUD_NORMAL_FORMAT);
+    
+    encoder->setComputePipelineState(gen_maps_pso.get());
+    encoder->setBytes(&dimension, sizeof(simd::uint2), 0);
+    encoder->setBuffer(noise_table_buffer.get(), 0, 1);
+    encoder->setBytes(&cloud_parameters, sizeof(CloudFieldParameters), 2);
+    encoder->setBytes(&encoding, sizeof(CloudMapEncoding), 3);
+    encoder->setBytes(&tile_offset, sizeof(simd::uint2), 4);
+    encoder->setBytes(&CLOUD_BASE_BAND, sizeof(CloudBaseBand), 5);
+    encoder->setTexture(density, 0);
+    encoder->setTexture(normals, 1);
+    encoder->setTexture(cloud_base_band.get(), 2);
+    
+    auto threadgroup_size = MTL::Size::Make(CLOUD_MAP_TILE_SIZE, CLOUD_MAP_TILE_SIZE, 1);
+    auto threadgroups = MTL::Size::Make((INTERNAL_RESOLUTION_WIDTH + CLOUD_MAP_TILE_SIZE - 1) / CLOUD_MAP_TILE_SIZE, last_row - first_row, 1);
+    encoder->dispatchThreadgroups(threadgroups, threadgroup_size);
+}
+
+
+/**
+ Dispatch `generate_cloud_base_band` unless the band already holds the octaves `cloud_parameters` starts from.
+ Within one encoder the dispatches after it see its writes, so the tiles can follow it directly.
+ */
+void Renderer::encode_cloud_base_band(MTL::ComputeCommandEncoder* encoder) {
+    uint64_t key = cloud_base_key(cloud_parameters, INTERNAL_RESOLUTION_WIDTH, INTERNAL_RESOLUTION_HEIGHT, CLOUD_BASE_BAND);
+    if ( cloud_base_band_valid && key == cloud_base_band_key ) return;
+    
+    encoder->setComputePipelineState(gen_base_band_pso.get());
+    encoder->setBuffer(noise_table_buffer.get(), 0, 0);
+    encoder->setBytes(&cloud_parameters, sizeof(CloudFieldParameters), 1);
+    encoder->setBytes(&CLOUD_BASE_BAND, sizeof(CloudBaseBand), 2);
+    encoder->setTexture(cloud_base_band.get(), 0);
+    auto threadgroup_size = MTL::Size::Make(gen_base_band_pso->threadExecutionWidth(),
+                                            gen_base_band_pso->threadExecutionWidth(), 1);
+    encoder->dispatchThreads(MTL::Size::Make(cloud_base_band->width(), cloud_base_band->height(), 1), threadgroup_size);
+    
+    cloud_base_band_key = key;
+    cloud_base_band_valid = true;
+}
+
+
+/**
+ Begin regenerating the maps for `cloud_parameters` into the back textures, dropping an unfinished regeneration.
+ Until anything was generated there is nothing to keep on screen, so the first maps are generated at once.
+ */
+void Renderer::start_cloud_regeneration() {
+    if ( cloud_field_cache.get_stats().misses == 0 ) {
+        std::shared_ptr<MTL::CommandBuffer> command_buffer = Util::rc(command_queue->commandBuffer());
+        generate_cloud(command_buffer);
+        command_buffer->commit();
+        return;
+    }
+    
+    if ( noise_table_seed != cloud_parameters.seed ) upload_noise_table();
+    cloud_regeneration.start((INTERNAL_RESOLUTION_HEIGHT + CLOUD_MAP_TILE_SIZE - 1) / CLOUD_MAP_TILE_SIZE);
+}
+
+
+/**
+ Encode this frame's slice of tile rows in a command buffer of its own, so its GPU time can be measured.
+ The slice that completes the maps also builds their mip chains and swaps them with the displayed ones;
+ the queue runs it before the frame's command buffer, which then already samples the new maps.
+ */
+void Renderer::continue_cloud_regeneration() {
+    if ( !cloud_regeneration.active() ) return;
+    
+    cloud_regeneration_commands = Util::rc(command_queue->commandBuffer());
+    auto encoder = Util::scoped(cloud_regeneration_commands->computeCommandEncoder());
+    auto [first_row, last_row] = cloud_regeneration.plan();
+    encode_cloud_base_band(encoder.get());
+    encode_cloud_map_tiles(encoder.get(), cloud_density_back.get(), cloud_normal_back.get(), first_row, last_row);
+    cloud_regeneration_rows = last_row - first_row;
+    
+    if ( !cloud_regeneration.active() ) {
+        encode_mip_chain(encoder.get(), cloud_density_back_mips, CLOUD_DENSITY_MIP_FILTER);
+        encode_mip_chain(encoder.get(), cloud_normal_back_mips, CLOUD_NORMAL_MIP_FILTER);
+        // the mip chains would inflate the per row estimate
+        cloud_regeneration_rows = 0;
+        
+        std::swap(cloud_density_map, cloud_density_back);
+        std::swap(cloud_normal_map, cloud_normal_back);
+        std::swap(cloud_density_mips, cloud_density_back_mips);
+        std::swap(cloud_normal_mips, cloud_normal_back_mips);
+    }
+    
+    encoder->endEncoding();
+    cloud_regeneration_commands->commit();
+}
+
+
+/**
+ Feed the GPU time of the last slice to the slicer, once the frame it belonged to completed
+ */
+void Renderer::report_cloud_regeneration() {
+    if ( !cloud_regeneration_commands ) return;
+    
+    double milliseconds = (cloud_regeneration_commands->GPUEndTime() - cloud_regeneration_commands->GPUStartTime()) * 1000.0;
+    cloud_regeneration.report(cloud_regeneration_rows, milliseconds);
+    cloud_regeneration_commands.reset();
+}
+
+
+/**
+ Encode one `downsample_mip` dispatch per level, each reading the level above it
+ */
+void Renderer::encode_mip_chain(MTL::ComputeCommandEncoder* encoder,
+                                std::vector<std::shared_ptr<MTL::Texture>> const& mips, MipChain::Filter filter)
+{
+    if ( filter == MipChain::Filter::None ) return;
+    
+    MipKernel kernel = MipChain::kernel(filter);
+    encoder->setComputePipelineState(downsample_mip_pso.get());
+    encoder->setBytes(&kernel, sizeof(MipKernel), 0);
+    
+    auto threadgroup_size = MTL::Size::Make(downsample_mip_pso->threadExecutionWidth(),
+                                            downsample_mip_pso->maxTotalThreadsPerThreadgroup() / downsample_mip_pso->threadExecutionWidth(), 1);
+    for ( size_t level = 1; level < mips.size(); level += 1 ) {
+        encoder->setTexture(mips[level - 1].get(), 0);
+        encoder->setTexture(mips[level].get(), 1);
+        encoder->dispatchThreads(MTL::Size::Make(mips[level]->width(), mips[level]->height(), 1), threadgroup_size);
+    }
+}
+
+
+/**
+ Read the density map back from the GPU and compare it with the CPU implementation
+ */
+void Renderer::verify_cloud_density_on_cpu() {
+    std::shared_ptr<MTL::CommandBuffer> command_buffer = Util::rc(command_queue->commandBuffer());
+    generate_cloud(command_buffer);
+    
+    auto blit = command_buffer->blitCommandEncoder();
+    blit->synchronizeResource(cloud_density_map.get());
+    blit->endEncoding();
+    command_buffer->commit();
+    command_buffer->waitUntilCompleted();
+    
+    ThreadPool& pool = *worker_pool;
+    const uint32_t texel_bytes = CloudEncoding::bytes_per_texel(CLOUD_DENSITY_FORMAT);
+    std::vector<uint8_t> texels((size_t)INTERNAL_RESOLUTION_WIDTH * INTERNAL_RESOLUTION_HEIGHT * texel_bytes);
+    cloud_density_map->getBytes(texels.data(), INTERNAL_RESOLUTION_WIDTH * texel_bytes,
+                                MTL::Region::Make2D(0, 0, INTERNAL_RESOLUTION_WIDTH, INTERNAL_RESOLUTION_HEIGHT), 0);
+    
+    std::vector<float> gpu(INTERNAL_RESOLUTION_WIDTH * INTERNAL_RESOLUTION_HEIGHT);
+    CloudEncoding::decode_density(pool, texels.data(), INTERNAL_RESOLUTION_WIDTH, INTERNAL_RESOLUTION_HEIGHT, CLOUD_DENSITY_FORMAT,
+                                  gpu.data(), INTERNAL_RESOLUTION_WIDTH);
+    
+    // the fused maps start from the base band, which the CPU takes the same way; a one octave band
+    // without a shift is every octave evaluated per texel, as `generate_cloud_density_map` does
+    CloudLayerCache<> cpu { pool, FUSED_CLOUD_MAPS ? CLOUD_BASE_BAND : CloudBaseBand { 1, 0 } };
+    cpu(cloud_parameters, INTERNAL_RESOLUTION_WIDTH, INTERNAL_RESOLUTION_HEIGHT);
+    
+    auto c = CloudNoise::compare(gpu.data(), INTERNAL_RESOLUTION_WIDTH, cpu.data(), INTERNAL_RESOLUTION_WIDTH,
+                                 INTERNAL_RESOLUTION_WIDTH, INTERNAL_RESOLUTION_HEIGHT);
+    // the GPU trims octaves per texel and the CPU per vector, each within the epsilon of the full sum
+    std::cout << "Cloud density, GPU vs CPU: max error " << c.max_abs_error << ", mean error " << c.mean_abs_error
+              << (c.max_abs_error <= CLOUD_CPU_TOLERANCE + CloudEncoding::density_tolerance(CLOUD_DENSITY_FORMAT) + 2 * cloud_parameters.fall_off_epsilon
+                  ? "" : "  (above tolerance)")
+              << std::endl;
+}
+
+
 /**
  Draw texture to framebuffer
  */
@@ -271,21 +851,66 @@ void Renderer::draw_texture_to_screen(std::shared_ptr<MTL::CommandBuffer> comman
 }
 
 
+/**
+ Record the frame time and copy the stats the getters report, under `published_mutex`.
+ `frame_milliseconds` can reallocate here, so a getter must never read it without the lock.
+ */
+void Renderer::publish_frame(double milliseconds) {
+    std::lock_guard lock { published_mutex };
+    if ( frame_milliseconds.size() < FRAME_TIME_HISTORY ) frame_milliseconds.push_back(milliseconds);
+    else frame_milliseconds[frame_count % FRAME_TIME_HISTORY] = milliseconds;
+    frame_count += 1;
+    
+    published_cloud_field_cache_stats = cloud_field_cache.get_stats();
+    if ( cloud_virtual_field ) published_cloud_virtual_stats = cloud_virtual_field->get_total_stats();
+}
+
+
 /** main render loop */
 void Renderer::render_loop() {
+    finish_startup();
+    if ( VERIFY_CLOUD_DENSITY_ON_CPU ) verify_cloud_density_on_cpu();
+    bool first_frame = true;
+    
     while (true) {
         std::shared_ptr<CA::MetalDrawable> drawable = Util::rc(retrieve_next_drawable());
         std::shared_ptr<MTL::CommandBuffer> command_buffer = Util::rc(command_queue->commandBuffer());
         
         auto framebuffer_texture = Util::rc(drawable->texture());
+        auto frame_begin = std::chrono::steady_clock::now();
         
-        generate_cloud(command_buffer);
+        // the field is static unless its parameters change; the virtual texture generates its own pages
+        if ( !CLOUD_VIRTUAL_TEXTURE && AMORTIZED_CLOUD_REGENERATION && FUSED_CLOUD_MAPS ) {
+            cloud_field_cache.update(cloud_parameters, INTERNAL_RESOLUTION_WIDTH, INTERNAL_RESOLUTION_HEIGHT,
+                                     [&](CloudFieldParameters const&, uint32_t, uint32_t) { start_cloud_regeneration(); });
+            continue_cloud_regeneration();
+        } else if ( !CLOUD_VIRTUAL_TEXTURE ) {
+            cloud_field_cache.update(cloud_parameters, INTERNAL_RESOLUTION_WIDTH, INTERNAL_RESOLUTION_HEIGHT,
+                                     [&](CloudFieldParameters const&, uint32_t, uint32_t) { generate_cloud(command_buffer); });
+        }
 //        draw_texture_to_screen(command_buffer, drawable, cloud_density_map, true);
+        update_cloud_animation();
         draw_skydome(command_buffer, framebuffer_texture);
         
         command_buffer->presentDrawable(drawable.get());
         command_buffer->commit();
+        // no frame is in flight when the next one starts, so the CPU may rewrite any buffer or texture
+        // the GPU read last frame (culled indices, velocity map, virtual pages, noise table) without fencing
         command_buffer->waitUntilCompleted();
+        report_cloud_regeneration();
+        
+        publish_frame(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame_begin).count());
+        
+        if ( first_frame ) {
+            first_frame = false;
+            {
+                std::lock_guard lock { published_mutex };
+                time_to_first_frame_milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startup_begin).count();
+            }
+            std::cout << "Startup: device " << startup_device_milliseconds << " ms, tasks joined at "
+                      << startup_joined_milliseconds << " ms, first frame at " << time_to_first_frame_milliseconds << " ms\n";
+            print_task_timings(std::cout, startup_timings);
+        }
 
         std::this_thread::sleep_for(std::chrono::milliseconds(16));
     }
@@ -4,7 +4,24 @@
 #include <QuartzCore/QuartzCore.hpp>
 #include <simd/simd.h>
 #include <thread>
+#include <mutex>
 #include <vector>
+#include <memory>
+#include <chrono>
+
+#include "SharedTypes.h"
+#include "MeshSimplifier.hpp"
+#include "Meshlets.hpp"
+#include "ThreadPool.hpp"
+#include "CloudFieldCache.hpp"
+#include "CloudLayerCache.hpp"
+#include "CloudRegeneration.hpp"
+#include "VolumeNoise.hpp"
+#include "MipChain.hpp"
+#include "CloudEncoding.hpp"
+#include "CloudAnimation.hpp"
+#include "CloudVirtualTexture.hpp"
+#include "Mesh.hpp"
 
 
 class Renderer {
@@ -17,6 +34,9 @@ private:
     std::shared_ptr<MTL::Library> shader_library;
     std::shared_ptr<MTL::CommandQueue> command_queue;
     
+    /// CPU work of the render loop, the virtual texture's pages and the density check, on one set of threads
+    std::unique_ptr<ThreadPool> worker_pool;
+    
     std::shared_ptr<MTL::RenderPipelineState> framebuffer_pso;
     std::shared_ptr<MTL::Buffer> quad_vertices;
     
@@ -34,31 +54,200 @@ private:
     
 /// Perlin noise
     std::shared_ptr<MTL::ComputePipelineState> gen_density_pso;
-    std::shared_ptr<MTL::Buffer> permutations_buffer;
+    std::shared_ptr<MTL::Buffer> noise_table_buffer;     // CloudNoiseTable
+    uint32_t noise_table_seed;
     std::shared_ptr<MTL::Texture> cloud_density_map;
     
     std::shared_ptr<MTL::ComputePipelineState> gen_normal_pso;
     std::shared_ptr<MTL::Texture> cloud_normal_map;
     
+    /// both maps from `generate_cloud_maps` in one pass, instead of a normal pass reading the density map back
+    static constexpr bool FUSED_CLOUD_MAPS = true;
+    std::shared_ptr<MTL::ComputePipelineState> gen_maps_pso;
+    
+    /// the first octaves of the fused maps, read from a texture that is only regenerated when the seed, the grid or
+    /// the resolution change: 16 MB for a 2048^2 map, exact; a shift of 1 takes 4 MB, 1e-3 from the exact field (CloudLayerBench)
+    static constexpr CloudBaseBand CLOUD_BASE_BAND = default_base_band;
+    std::shared_ptr<MTL::ComputePipelineState> gen_base_band_pso;
+    std::shared_ptr<MTL::Texture> cloud_base_band;          // R32Float, cloud_base_size of each side
+    uint64_t cloud_base_band_key = 0;
+    bool cloud_base_band_valid = false;
+    
+    /// how each generated map's mip chain is filtered, `None` keeps it a single level
+    static constexpr MipChain::Filter CLOUD_DENSITY_MIP_FILTER = MipChain::Filter::Kaiser;
+    static constexpr MipChain::Filter CLOUD_NORMAL_MIP_FILTER = MipChain::Filter::Box;
+    
+    /// storage of the generated maps: R16Float density and two channel octahedral normals take 4 bytes per texel instead of 8
+    static constexpr CloudEncoding::DensityFormat CLOUD_DENSITY_FORMAT = CloudEncoding::DensityFormat::Half;
+    static constexpr CloudEncoding::NormalFormat CLOUD_NORMAL_FORMAT = CloudEncoding::NormalFormat::HemiOctahedral8;
+    
+    std::shared_ptr<MTL::ComputePipelineState> downsample_mip_pso;
+    std::vector<std::shared_ptr<MTL::Texture>> cloud_density_mips;      // one view per level
+    std::vector<std::shared_ptr<MTL::Texture>> cloud_normal_mips;
+    
+    /// compare the density map with `CloudNoise` once at startup
+    static constexpr bool VERIFY_CLOUD_DENSITY_ON_CPU = false;
+    /// the shader's fast-math cos, sin and exp against the CPU's
+    static constexpr double CLOUD_CPU_TOLERANCE = 1e-3;
+    
+    /// texels the fall-off dims below this are written as 0 without evaluating the noise, and octaves it hides are
+    /// skipped; 0 evaluates every octave of every texel, the exact field. Opt-in: at the default top width of 0.8,
+    /// 1/1024 skips no texel and 3% of the octaves (Tests/Benchmarks/FallOffBench), too little to pay for itself
+    static constexpr float CLOUD_FALL_OFF_EPSILON = 0.0f;
+    
+    /// the textures are only regenerated when these or the resolution change
+    CloudFieldParameters cloud_parameters = CloudNoise::default_parameters(CLOUD_FALL_OFF_EPSILON);
+    CloudFieldCache cloud_field_cache;
+    
+    void initialize_cloud_generation_pipelines();
     void initialize_cloud_generation_resources();
+    void upload_noise_table();
     void generate_cloud(std::shared_ptr<MTL::CommandBuffer>);
+    std::vector<std::shared_ptr<MTL::Texture>> new_mip_views(MTL::Texture* texture);
+    void encode_mip_chain(MTL::ComputeCommandEncoder* encoder,
+                          std::vector<std::shared_ptr<MTL::Texture>> const& mips, MipChain::Filter filter);
+    void verify_cloud_density_on_cpu();
+    void encode_cloud_map_tiles(MTL::ComputeCommandEncoder* encoder, MTL::Texture* density, MTL::Texture* normals,
+                                uint32_t first_row, uint32_t last_row);
+    void encode_cloud_base_band(MTL::ComputeCommandEncoder* encoder);
+    
+    
+/// Amortized cloud regeneration
+    /// regenerate changed maps a slice of tile rows per frame into a second pair of textures, swapped in once
+    /// complete, instead of all at once in the frame the parameters changed; needs `FUSED_CLOUD_MAPS`
+    static constexpr bool AMORTIZED_CLOUD_REGENERATION = true;
+    /// GPU milliseconds of generation per frame, in rows of CLOUD_MAP_TILE_SIZE tiles; the 128 rows of a 2048^2 map
+    /// are finished within 16 frames, so a change is on screen a quarter second later at 60 Hz at most
+    static constexpr CloudRegeneration::Budget CLOUD_REGENERATION_BUDGET = { 1.0, 1, ~0u, 16 };
+    /// frames the frame time percentiles are taken over
+    static constexpr size_t FRAME_TIME_HISTORY = 600;
+    
+    std::shared_ptr<MTL::Texture> cloud_density_back;       // being regenerated, swapped with the displayed maps
+    std::shared_ptr<MTL::Texture> cloud_normal_back;
+    std::vector<std::shared_ptr<MTL::Texture>> cloud_density_back_mips;
+    std::vector<std::shared_ptr<MTL::Texture>> cloud_normal_back_mips;
+    CloudRegeneration::TimeSlicer cloud_regeneration { CLOUD_REGENERATION_BUDGET };
+    std::shared_ptr<MTL::CommandBuffer> cloud_regeneration_commands;    // last slice, timed once the frame completed
+    uint32_t cloud_regeneration_rows = 0;                               // in that slice, 0 for the finishing one
+    std::vector<double> frame_milliseconds;                             // ring of the last FRAME_TIME_HISTORY frames, published
+    size_t frame_count = 0;
+    
+    void start_cloud_regeneration();
+    void continue_cloud_regeneration();
+    void report_cloud_regeneration();
+    
+    
+/// Cloud animation
+    /// advect the cached density map through a curl noise velocity field, only the velocities are rebuilt per frame
+    static constexpr bool ANIMATE_CLOUDS = true;
+    static constexpr CloudAnimation::FlowParameters CLOUD_FLOW = CloudAnimation::default_flow;
+    
+    std::unique_ptr<CloudAnimation::VelocityField> cloud_velocity;
+    std::shared_ptr<MTL::Texture> cloud_velocity_map;       // RG32Float, rewritten every frame
+    CloudFlowFrame cloud_flow_frame = { { 0.f, 0.f }, { 1.f, 0.f } };
+    
+    void initialize_cloud_animation();
+    void update_cloud_animation();
+    
+    
+/// Virtual cloud texture
+    /// draw the dome from a sparse, page cached density map generated on the CPU where the camera looks,
+    /// instead of the full 2048 x 2048 one
+    static constexpr bool CLOUD_VIRTUAL_TEXTURE = false;
+    /// 16384^2 virtual texels in 128^2 pages, 384 of them resident: 13 MB of R16Float atlas
+    static constexpr VirtualTexture::Config CLOUD_VIRTUAL_CONFIG = VirtualTexture::default_config;
+    /// pages generated per frame at most, the rest are drawn from coarser pages until a later frame
+    static constexpr size_t CLOUD_VIRTUAL_PAGES_PER_FRAME = 32;
+    /// skydome LOD level the feedback pass walks, it only needs the uv footprint
+    static constexpr size_t CLOUD_VIRTUAL_FEEDBACK_LOD = 2;
+    
+    std::unique_ptr<VirtualTexture::VirtualCloudField> cloud_virtual_field;
+    VirtualTexture::Feedback cloud_virtual_feedback;
+    std::shared_ptr<MTL::Texture> cloud_virtual_atlas;
+    std::shared_ptr<MTL::Buffer> cloud_virtual_indirection;
+    Mesh skydome_feedback_mesh;
+    
+    void initialize_virtual_cloud_field();
+    void update_virtual_cloud_field(simd::float4x4 const& clip, float width, float height);
+    void upload_virtual_pages();
+    
+    
+/// Cloud volumes
+    /// tileable 3D noise for volumetric clouds, baked once and then mapped from the caches directory;
+    /// off until a shader samples them, since the first bake delays the first frame
+    static constexpr bool BAKE_CLOUD_VOLUMES = false;
+    static constexpr VolumeNoise::VolumeParameters CLOUD_SHAPE_VOLUME = VolumeNoise::default_shape;
+    static constexpr VolumeNoise::VolumeParameters CLOUD_DETAIL_VOLUME = VolumeNoise::default_detail;
+    
+    std::shared_ptr<MTL::Texture> cloud_shape_volume;
+    std::shared_ptr<MTL::Texture> cloud_detail_volume;
+    
+    void load_cloud_volumes();
+    std::shared_ptr<MTL::Texture> upload_cloud_volume(VolumeNoise::VolumeParameters const& params, std::string const& cache_name);
     
     
 /// Skydome
+    /// upload the dome as 16 byte `PackedVertex` instead of 48 byte `Vertex`
+    static constexpr bool SKYDOME_PACKED_VERTICES = true;
+    
+    /// where the dome mesh comes from: the bundled OBJ (through the .crmesh cache) or generated at startup
+    enum class SkydomeSource { Asset, UVSphere, Geodesic };
+    static constexpr SkydomeSource SKYDOME_SOURCE = SkydomeSource::UVSphere;
+    /// tessellation of the generated dome; 124 x 128 is close to the asset's 31,744 triangles
+    static constexpr uint32_t SKYDOME_UV_RINGS = 124;
+    static constexpr uint32_t SKYDOME_UV_SEGMENTS = 128;
+    /// 4 * 4^level triangles
+    static constexpr uint32_t SKYDOME_GEODESIC_LEVEL = 6;
+    /// simplified levels, each with half the triangles of the previous one
+    static constexpr size_t SKYDOME_LOD_LEVELS = 6;
+    /// largest on-screen geometric error, in pixels, a level may have to be selected
+    static constexpr float SKYDOME_LOD_PIXEL_ERROR = 1.0f;
+    static constexpr float SKYDOME_FOV_DEGREES = 100.f;
+    /// cull meshlets against the view frustum on the CPU and draw only the survivors
+    static constexpr bool SKYDOME_MESHLET_CULLING = true;
+    
     std::shared_ptr<MTL::RenderPipelineState> skydome_pso;
     size_t skydome_vertex_count;
     size_t skydome_index_count;
     std::shared_ptr<MTL::Buffer> skydome_vertices;
     std::shared_ptr<MTL::Buffer> skydome_indices;
+    PackedVertexBounds skydome_bounds;
+    std::vector<MeshSimplifier::Lod> skydome_lods;
+    float skydome_view_distance;
+    std::vector<Meshlets::MeshletSet> skydome_meshlets;     // one set per LOD level
+    std::shared_ptr<MTL::Buffer> skydome_culled_indices;    // rewritten every frame
+    Meshlets::CullStats skydome_cull_stats;                 // last frame
     
+    void load_skydome_mesh();
     void initialize_skydome_pipeline();
+    template <class MeshSource> void upload_skydome_mesh(MeshSource& mesh);
     void draw_skydome(std::shared_ptr<MTL::CommandBuffer>, std::shared_ptr<MTL::Texture>);
     
     
+/// Startup
+    std::chrono::steady_clock::time_point startup_begin;
+    std::unique_ptr<ThreadPool> startup_pool;
+    std::unique_ptr<TaskGroup> startup_tasks;
+    std::vector<TaskTiming> startup_timings;                // published
+    double startup_device_milliseconds = 0.0;    // device, library and queue, before any task starts
+    double startup_joined_milliseconds = 0.0;
+    double time_to_first_frame_milliseconds = 0.0;          // published
+    
+    void finish_startup();
+    
+    
 /// Synchronization
     std::thread renderer_thread;
     void render_loop();
     
+    /// the getters run on other threads while `render_loop` writes: the members marked published are only written,
+    /// and the stats below only copied from the render thread's, under this lock, which the getters take to read them
+    mutable std::mutex published_mutex;
+    CloudFieldCache::Stats published_cloud_field_cache_stats;
+    VirtualTexture::VirtualCloudField::Stats published_cloud_virtual_stats;
+    
+    void publish_frame(double milliseconds);
+    
 public:
     explicit Renderer();
     
@@ -68,6 +257,40 @@ public:
     /** assign core animation metal layer for drawable retrival */
     void set_metal_layer(CA::MetalLayer* layer) { metal_layer = layer; }
 
+    /** per-task startup timings, available once the first frame was drawn */
+    std::vector<TaskTiming> get_startup_timings() const {
+        std::lock_guard lock { published_mutex };
+        return startup_timings;
+    }
+    
+    /** milliseconds from construction until the first frame completed on the GPU, 0 before that */
+    double get_time_to_first_frame_milliseconds() const {
+        std::lock_guard lock { published_mutex };
+        return time_to_first_frame_milliseconds;
+    }
+
+    /** how often the render loop found the cloud field current, and how often it regenerated it, as of the last frame */
+    CloudFieldCache::Stats get_cloud_field_cache_stats() const {
+        std::lock_guard lock { published_mutex };
+        return published_cloud_field_cache_stats;
+    }
+
+    /** percentiles of the wall clock time of recent frames, from command buffer creation until the GPU finished */
+    CloudRegeneration::FrameTimeSummary get_frame_time_summary() const {
+        std::vector<double> frames;
+        {
+            std::lock_guard lock { published_mutex };
+            frames = frame_milliseconds;
+        }
+        return CloudRegeneration::summarize(std::move(frames));
+    }
+    
+    /** page requests, hits, misses and evictions of the virtual cloud texture since startup, as of the last frame */
+    VirtualTexture::VirtualCloudField::Stats get_cloud_virtual_stats() const {
+        std::lock_guard lock { published_mutex };
+        return published_cloud_virtual_stats;
+    }
+    
     /** start the render loop on a different thread */
     void start_render_loop() { renderer_thread = std::thread(&Renderer::render_loop, this); }
 };
@@ -77,3 +300,8 @@ public:
  Helper function for loading files within app bundle
  */
 std::string get_full_path(std::string const& path);
+
+/**
+ Helper function for locating a writable file inside the app's caches directory
+ */
+std::string get_cache_path(std::string const& file_name);
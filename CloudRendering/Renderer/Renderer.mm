@@ -20,3 +20,14 @@ std::string get_full_path(std::string const& path) {
     NSString* fullPath = [[resource_path stringByAppendingString:@"/"] stringByAppendingString:relative_path];
     return std::string([fullPath cStringUsingEncoding:NSUTF8StringEncoding]);
 }
+
+
+std::string get_cache_path(std::string const& file_name) {
+    NSString* caches = [NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES) firstObject];
+    NSString* bundle_id = [[NSBundle mainBundle] bundleIdentifier] ?: @"CloudRendering";
+    NSString* directory = [caches stringByAppendingPathComponent:bundle_id];
+    [[NSFileManager defaultManager] createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:nil error:nil];
+    NSString* name = [[NSString alloc] initWithUTF8String:file_name.c_str()];
+    NSString* full_path = [directory stringByAppendingPathComponent:name];
+    return std::string([full_path cStringUsingEncoding:NSUTF8StringEncoding]);
+}
@@ -0,0 +1,532 @@
+// Portable SIMD lanes for CPU-side kernels
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #include <arm_neon.h>
+    #define CR_SIMD_NEON 1
+#elif defined(__SSE4_1__) || defined(__SSE2__) || defined(_M_X64)
+    #include <immintrin.h>
+    #define CR_SIMD_SSE 1
+    // wider x86 lanes only when the target enables them, e.g. -mavx2 -mfma or -mavx512f
+    #if defined(__AVX2__) && defined(__FMA__)
+        #define CR_SIMD_AVX2 1
+    #endif
+    #if defined(__AVX512F__)
+        #define CR_SIMD_AVX512 1
+    #endif
+#endif
+
+namespace Simd {
+
+    /**
+     Four float lanes: NEON on Apple silicon, SSE on x86, plain arrays elsewhere.
+     Comparisons return a lane mask usable with `select`, `any` and `bitmask`.
+     `gather` reads table[index] per lane and `exp2i` is 2^n for integral n in [-126, 127].
+     `rsqrt` is the hardware estimate refined by one Newton step.
+     `pack_snorm8` rounds x, y, z and w, or x and y, in [-1, 1] to snorm8 and stores one RGBA8Snorm or RG8Snorm texel
+     per lane, x in the low byte; `pack_unorm8` stores one R8Unorm texel per lane from [0, 1]. Both round to nearest even.
+     The static `unpack_*` are their inverses. `pack_half` and `unpack_half` convert to and from binary16 and
+     exist where `has_half` says the target converts in hardware.
+     */
+    struct f32x4 {
+        static constexpr size_t width = 4;
+
+#if CR_SIMD_NEON
+        float32x4_t v;
+        f32x4() = default;
+        f32x4(float32x4_t x) : v(x) {}
+        explicit f32x4(float s) : v(vdupq_n_f32(s)) {}
+
+        static f32x4 load(const float* p) { return vld1q_f32(p); }
+        void store(float* p) const { vst1q_f32(p, v); }
+        static f32x4 from_mask(uint32x4_t m) { return vreinterpretq_f32_u32(m); }
+        uint32x4_t mask() const { return vreinterpretq_u32_f32(v); }
+
+        friend f32x4 operator+(f32x4 a, f32x4 b) { return vaddq_f32(a.v, b.v); }
+        friend f32x4 operator-(f32x4 a, f32x4 b) { return vsubq_f32(a.v, b.v); }
+        friend f32x4 operator*(f32x4 a, f32x4 b) { return vmulq_f32(a.v, b.v); }
+        friend f32x4 operator/(f32x4 a, f32x4 b) { return vdivq_f32(a.v, b.v); }
+        friend f32x4 operator<(f32x4 a, f32x4 b) { return from_mask(vcltq_f32(a.v, b.v)); }
+        friend f32x4 operator>=(f32x4 a, f32x4 b) { return from_mask(vcgeq_f32(a.v, b.v)); }
+        friend f32x4 operator&(f32x4 a, f32x4 b) { return from_mask(vandq_u32(a.mask(), b.mask())); }
+        friend f32x4 operator|(f32x4 a, f32x4 b) { return from_mask(vorrq_u32(a.mask(), b.mask())); }
+        friend f32x4 min(f32x4 a, f32x4 b) { return vminq_f32(a.v, b.v); }
+        friend f32x4 max(f32x4 a, f32x4 b) { return vmaxq_f32(a.v, b.v); }
+        friend f32x4 fma(f32x4 a, f32x4 b, f32x4 c) { return vfmaq_f32(c.v, a.v, b.v); }
+        friend f32x4 floor(f32x4 a) { return vrndmq_f32(a.v); }
+        friend f32x4 abs(f32x4 a) { return vabsq_f32(a.v); }
+        friend f32x4 sqrt(f32x4 a) { return vsqrtq_f32(a.v); }
+        /** lanes of `b` where `m` is set, `a` elsewhere */
+        friend f32x4 select(f32x4 m, f32x4 a, f32x4 b) { return vbslq_f32(m.mask(), b.v, a.v); }
+        friend bool any(f32x4 m) { return vmaxvq_u32(m.mask()) != 0; }
+        friend f32x4 exp2i(f32x4 n) { return vreinterpretq_f32_s32(vshlq_n_s32(vaddq_s32(vcvtq_s32_f32(n.v), vdupq_n_s32(127)), 23)); }
+        friend f32x4 gather(const float* table, f32x4 index) {
+            int32_t i[4];
+            vst1q_s32(i, vcvtq_s32_f32(index.v));
+            float g[4] = { table[i[0]], table[i[1]], table[i[2]], table[i[3]] };
+            return vld1q_f32(g);
+        }
+        friend uint32_t bitmask(f32x4 m) {
+            static const uint32_t bits[4] = { 1, 2, 4, 8 };
+            return vaddvq_u32(vandq_u32(m.mask(), vld1q_u32(bits)));
+        }
+        friend f32x4 rsqrt(f32x4 a) {
+            float32x4_t r = vrsqrteq_f32(a.v);
+            return vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(a.v, r), r));
+        }
+        friend void pack_snorm8(f32x4 x, f32x4 y, f32x4 z, f32x4 w, uint32_t* out) {
+            auto q = [](f32x4 c) {
+                return vandq_u32(vreinterpretq_u32_s32(vcvtnq_s32_f32(vmulq_f32(c.v, vdupq_n_f32(127.0f)))), vdupq_n_u32(0xFF));
+            };
+            uint32x4_t r = vorrq_u32(vorrq_u32(q(x), vshlq_n_u32(q(y), 8)), vorrq_u32(vshlq_n_u32(q(z), 16), vshlq_n_u32(q(w), 24)));
+            vst1q_u32(out, r);
+        }
+        friend void pack_snorm8(f32x4 x, f32x4 y, uint16_t* out) {
+            auto q = [](f32x4 c) {
+                return vandq_u32(vreinterpretq_u32_s32(vcvtnq_s32_f32(vmulq_f32(c.v, vdupq_n_f32(127.0f)))), vdupq_n_u32(0xFF));
+            };
+            vst1_u16(out, vmovn_u32(vorrq_u32(q(x), vshlq_n_u32(q(y), 8))));
+        }
+        friend void pack_unorm8(f32x4 x, uint8_t* out) {
+            uint16x4_t h = vmovn_u32(vcvtnq_u32_f32(vmulq_f32(x.v, vdupq_n_f32(255.0f))));
+            vst1_lane_u32(reinterpret_cast<uint32_t*>(out), vreinterpret_u32_u8(vmovn_u16(vcombine_u16(h, h))), 0);
+        }
+        static f32x4 snorm8(int32x4_t byte_in_top) {
+            return vmaxq_f32(vmulq_f32(vcvtq_f32_s32(vshrq_n_s32(byte_in_top, 24)), vdupq_n_f32(1.0f / 127.0f)), vdupq_n_f32(-1.0f));
+        }
+        static void unpack_snorm8(const uint32_t* in, f32x4& x, f32x4& y, f32x4& z, f32x4& w) {
+            int32x4_t t = vreinterpretq_s32_u32(vld1q_u32(in));
+            x = snorm8(vshlq_n_s32(t, 24)), y = snorm8(vshlq_n_s32(t, 16)), z = snorm8(vshlq_n_s32(t, 8)), w = snorm8(t);
+        }
+        static void unpack_snorm8(const uint16_t* in, f32x4& x, f32x4& y) {
+            int32x4_t t = vreinterpretq_s32_u32(vmovl_u16(vld1_u16(in)));
+            x = snorm8(vshlq_n_s32(t, 24)), y = snorm8(vshlq_n_s32(t, 16));
+        }
+        static f32x4 unpack_unorm8(const uint8_t* in) {
+            uint32_t bytes;
+            std::memcpy(&bytes, in, 4);
+            uint32x4_t t = vmovl_u16(vget_low_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(bytes)))));
+            return vdivq_f32(vcvtq_f32_u32(t), vdupq_n_f32(255.0f));
+        }
+        static constexpr bool has_half = true;
+        friend void pack_half(f32x4 x, uint16_t* out) { vst1_u16(out, vreinterpret_u16_f16(vcvt_f16_f32(x.v))); }
+        static f32x4 unpack_half(const uint16_t* in) { return vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(in))); }
+#elif CR_SIMD_SSE
+        __m128 v;
+        f32x4() = default;
+        f32x4(__m128 x) : v(x) {}
+        explicit f32x4(float s) : v(_mm_set1_ps(s)) {}
+
+        static f32x4 load(const float* p) { return _mm_loadu_ps(p); }
+        void store(float* p) const { _mm_storeu_ps(p, v); }
+
+        friend f32x4 operator+(f32x4 a, f32x4 b) { return _mm_add_ps(a.v, b.v); }
+        friend f32x4 operator-(f32x4 a, f32x4 b) { return _mm_sub_ps(a.v, b.v); }
+        friend f32x4 operator*(f32x4 a, f32x4 b) { return _mm_mul_ps(a.v, b.v); }
+        friend f32x4 operator/(f32x4 a, f32x4 b) { return _mm_div_ps(a.v, b.v); }
+        friend f32x4 operator<(f32x4 a, f32x4 b) { return _mm_cmplt_ps(a.v, b.v); }
+        friend f32x4 operator>=(f32x4 a, f32x4 b) { return _mm_cmpge_ps(a.v, b.v); }
+        friend f32x4 operator&(f32x4 a, f32x4 b) { return _mm_and_ps(a.v, b.v); }
+        friend f32x4 operator|(f32x4 a, f32x4 b) { return _mm_or_ps(a.v, b.v); }
+        friend f32x4 min(f32x4 a, f32x4 b) { return _mm_min_ps(a.v, b.v); }
+        friend f32x4 max(f32x4 a, f32x4 b) { return _mm_max_ps(a.v, b.v); }
+        friend f32x4 fma(f32x4 a, f32x4 b, f32x4 c) { return _mm_add_ps(_mm_mul_ps(a.v, b.v), c.v); }
+    #if defined(__SSE4_1__)
+        friend f32x4 floor(f32x4 a) { return _mm_floor_ps(a.v); }
+    #else
+        friend f32x4 floor(f32x4 a) {
+            __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+            return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a.v), _mm_set1_ps(1.0f)));
+        }
+    #endif
+        friend f32x4 abs(f32x4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+        friend f32x4 sqrt(f32x4 a) { return _mm_sqrt_ps(a.v); }
+        friend f32x4 select(f32x4 m, f32x4 a, f32x4 b) { return _mm_or_ps(_mm_and_ps(m.v, b.v), _mm_andnot_ps(m.v, a.v)); }
+        friend bool any(f32x4 m) { return _mm_movemask_ps(m.v) != 0; }
+        friend uint32_t bitmask(f32x4 m) { return (uint32_t)_mm_movemask_ps(m.v); }
+        friend f32x4 exp2i(f32x4 n) { return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(n.v), _mm_set1_epi32(127)), 23)); }
+        friend f32x4 gather(const float* table, f32x4 index) {
+            alignas(16) int32_t i[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(i), _mm_cvttps_epi32(index.v));
+            return _mm_setr_ps(table[i[0]], table[i[1]], table[i[2]], table[i[3]]);
+        }
+        friend f32x4 rsqrt(f32x4 a) {
+            __m128 r = _mm_rsqrt_ps(a.v);
+            return _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), r), _mm_sub_ps(_mm_set1_ps(3.0f), _mm_mul_ps(_mm_mul_ps(a.v, r), r)));
+        }
+        friend void pack_snorm8(f32x4 x, f32x4 y, f32x4 z, f32x4 w, uint32_t* out) {
+            // the default rounding mode rounds to nearest even
+            auto q = [](f32x4 c) {
+                return _mm_and_si128(_mm_cvtps_epi32(_mm_mul_ps(c.v, _mm_set1_ps(127.0f))), _mm_set1_epi32(0xFF));
+            };
+            __m128i r = _mm_or_si128(_mm_or_si128(q(x), _mm_slli_epi32(q(y), 8)), _mm_or_si128(_mm_slli_epi32(q(z), 16), _mm_slli_epi32(q(w), 24)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), r);
+        }
+        friend void pack_snorm8(f32x4 x, f32x4 y, uint16_t* out) {
+            auto q = [](f32x4 c) { return _mm_and_si128(_mm_cvtps_epi32(_mm_mul_ps(c.v, _mm_set1_ps(127.0f))), _mm_set1_epi32(0xFF)); };
+            __m128i r = _mm_or_si128(q(x), _mm_slli_epi32(q(y), 8));
+            // sign extend the 16 bits so the saturating pack keeps them as they are
+            r = _mm_srai_epi32(_mm_slli_epi32(r, 16), 16);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_packs_epi32(r, r));
+        }
+        friend void pack_unorm8(f32x4 x, uint8_t* out) {
+            __m128i i = _mm_cvtps_epi32(_mm_mul_ps(x.v, _mm_set1_ps(255.0f)));
+            i = _mm_packs_epi32(i, i);
+            int32_t bytes = _mm_cvtsi128_si32(_mm_packus_epi16(i, i));
+            std::memcpy(out, &bytes, 4);
+        }
+        static f32x4 snorm8(__m128i byte_in_top) {
+            __m128 v = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(byte_in_top, 24)), _mm_set1_ps(1.0f / 127.0f));
+            return _mm_max_ps(v, _mm_set1_ps(-1.0f));
+        }
+        static void unpack_snorm8(const uint32_t* in, f32x4& x, f32x4& y, f32x4& z, f32x4& w) {
+            __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+            x = snorm8(_mm_slli_epi32(t, 24)), y = snorm8(_mm_slli_epi32(t, 16)), z = snorm8(_mm_slli_epi32(t, 8)), w = snorm8(t);
+        }
+        static void unpack_snorm8(const uint16_t* in, f32x4& x, f32x4& y) {
+            __m128i t = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(in)), _mm_setzero_si128());
+            x = snorm8(_mm_slli_epi32(t, 24)), y = snorm8(_mm_slli_epi32(t, 16));
+        }
+        static f32x4 unpack_unorm8(const uint8_t* in) {
+            int32_t bytes;
+            std::memcpy(&bytes, in, 4);
+            __m128i t = _mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), _mm_setzero_si128());
+            t = _mm_unpacklo_epi16(t, _mm_setzero_si128());
+            return _mm_div_ps(_mm_cvtepi32_ps(t), _mm_set1_ps(255.0f));
+        }
+    #if defined(__F16C__)
+        static constexpr bool has_half = true;
+        friend void pack_half(f32x4 x, uint16_t* out) {
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_cvtps_ph(x.v, _MM_FROUND_TO_NEAREST_INT));
+        }
+        static f32x4 unpack_half(const uint16_t* in) { return _mm_cvtph_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(in))); }
+    #else
+        static constexpr bool has_half = false;
+    #endif
+#else
+        float v[4];
+        f32x4() = default;
+        explicit f32x4(float s) : v{ s, s, s, s } {}
+
+        static f32x4 load(const float* p) { f32x4 r; for ( int i = 0; i < 4; i += 1 ) r.v[i] = p[i]; return r; }
+        void store(float* p) const { for ( int i = 0; i < 4; i += 1 ) p[i] = v[i]; }
+
+        template <class F> static f32x4 map(f32x4 a, f32x4 b, F f) { f32x4 r; for ( int i = 0; i < 4; i += 1 ) r.v[i] = f(a.v[i], b.v[i]); return r; }
+        static float lane_mask(bool b) { uint32_t m = b ? 0xFFFFFFFFu : 0u; float f; std::memcpy(&f, &m, 4); return f; }
+        static uint32_t bits(float f) { uint32_t m; std::memcpy(&m, &f, 4); return m; }
+
+        friend f32x4 operator+(f32x4 a, f32x4 b) { return map(a, b, [](float x, float y) { return x + y; }); }
+        friend f32x4 operator-(f32x4 a, f32x4 b) { return map(a, b, [](float x, float y) { return x - y; }); }
+        friend f32x4 operator*(f32x4 a, f32x4 b) { return map(a, b, [](float x, float y) { return x * y; }); }
+        friend f32x4 operator/(f32x4 a, f32x4 b) { return map(a, b, [](float x, float y) { return x / y; }); }
+        friend f32x4 operator<(f32x4 a, f32x4 b) { return map(a, b, [](float x, float y) { return lane_mask(x < y); }); }
+        friend f32x4 operator>=(f32x4 a, f32x4 b) { return map(a, b, [](float x, float y) { return lane_mask(x >= y); }); }
+        friend f32x4 operator&(f32x4 a, f32x4 b) { return map(a, b, [](float x, float y) { return lane_mask(bits(x) & bits(y)); }); }
+        friend f32x4 operator|(f32x4 a, f32x4 b) { return map(a, b, [](float x, float y) { return lane_mask(bits(x) | bits(y)); }); }
+        friend f32x4 min(f32x4 a, f32x4 b) { return map(a, b, [](float x, float y) { return std::min(x, y); }); }
+        friend f32x4 max(f32x4 a, f32x4 b) { return map(a, b, [](float x, float y) { return std::max(x, y); }); }
+        friend f32x4 fma(f32x4 a, f32x4 b, f32x4 c) { return a * b + c; }
+        friend f32x4 floor(f32x4 a) { return map(a, a, [](float x, float) { return std::floor(x); }); }
+        friend f32x4 abs(f32x4 a) { return map(a, a, [](float x, float) { return std::fabs(x); }); }
+        friend f32x4 sqrt(f32x4 a) { return map(a, a, [](float x, float) { return std::sqrt(x); }); }
+        friend f32x4 select(f32x4 m, f32x4 a, f32x4 b) { f32x4 r; for ( int i = 0; i < 4; i += 1 ) r.v[i] = bits(m.v[i]) ? b.v[i] : a.v[i]; return r; }
+        friend uint32_t bitmask(f32x4 m) { uint32_t r = 0; for ( int i = 0; i < 4; i += 1 ) r |= (bits(m.v[i]) >> 31) << i; return r; }
+        friend bool any(f32x4 m) { return bitmask(m) != 0; }
+        friend f32x4 exp2i(f32x4 n) { return map(n, n, [](float x, float) { return std::ldexp(1.0f, (int)x); }); }
+        friend f32x4 gather(const float* table, f32x4 index) { return map(index, index, [table](float i, float) { return table[(int)i]; }); }
+        friend f32x4 rsqrt(f32x4 a) { return map(a, a, [](float x, float) { return 1.0f / std::sqrt(x); }); }
+        friend void pack_snorm8(f32x4 x, f32x4 y, f32x4 z, f32x4 w, uint32_t* out) {
+            auto q = [](float c) { return (uint32_t)(int32_t)std::nearbyint(c * 127.0f) & 0xFF; };
+            for ( int i = 0; i < 4; i += 1 ) out[i] = q(x.v[i]) | q(y.v[i]) << 8 | q(z.v[i]) << 16 | q(w.v[i]) << 24;
+        }
+        friend void pack_snorm8(f32x4 x, f32x4 y, uint16_t* out) {
+            auto q = [](float c) { return (uint32_t)(int32_t)std::nearbyint(c * 127.0f) & 0xFF; };
+            for ( int i = 0; i < 4; i += 1 ) out[i] = (uint16_t)(q(x.v[i]) | q(y.v[i]) << 8);
+        }
+        friend void pack_unorm8(f32x4 x, uint8_t* out) {
+            for ( int i = 0; i < 4; i += 1 ) out[i] = (uint8_t)std::nearbyint(x.v[i] * 255.0f);
+        }
+        static float snorm8(uint32_t byte) { return std::max((float)(int8_t)(uint8_t)byte / 127.0f, -1.0f); }
+        static void unpack_snorm8(const uint32_t* in, f32x4& x, f32x4& y, f32x4& z, f32x4& w) {
+            for ( int i = 0; i < 4; i += 1 )
+                x.v[i] = snorm8(in[i]), y.v[i] = snorm8(in[i] >> 8), z.v[i] = snorm8(in[i] >> 16), w.v[i] = snorm8(in[i] >> 24);
+        }
+        static void unpack_snorm8(const uint16_t* in, f32x4& x, f32x4& y) {
+            for ( int i = 0; i < 4; i += 1 ) x.v[i] = snorm8(in[i]), y.v[i] = snorm8((uint32_t)in[i] >> 8);
+        }
+        static f32x4 unpack_unorm8(const uint8_t* in) { f32x4 r; for ( int i = 0; i < 4; i += 1 ) r.v[i] = (float)in[i] / 255.0f; return r; }
+        static constexpr bool has_half = false;
+#endif
+    };
+
+
+    /**
+     Twice the lanes of `T`, for widths the target has no native registers for
+     */
+    template <class T>
+    struct Pair {
+        static constexpr size_t width = 2 * T::width;
+        T lo, hi;
+
+        Pair() = default;
+        Pair(T lo, T hi) : lo(lo), hi(hi) {}
+        explicit Pair(float s) : lo(s), hi(s) {}
+
+        static Pair load(const float* p) { return { T::load(p), T::load(p + T::width) }; }
+        void store(float* p) const { lo.store(p); hi.store(p + T::width); }
+
+        friend Pair operator+(Pair a, Pair b) { return { a.lo + b.lo, a.hi + b.hi }; }
+        friend Pair operator-(Pair a, Pair b) { return { a.lo - b.lo, a.hi - b.hi }; }
+        friend Pair operator*(Pair a, Pair b) { return { a.lo * b.lo, a.hi * b.hi }; }
+        friend Pair operator/(Pair a, Pair b) { return { a.lo / b.lo, a.hi / b.hi }; }
+        friend Pair operator<(Pair a, Pair b) { return { a.lo < b.lo, a.hi < b.hi }; }
+        friend Pair operator>=(Pair a, Pair b) { return { a.lo >= b.lo, a.hi >= b.hi }; }
+        friend Pair operator&(Pair a, Pair b) { return { a.lo & b.lo, a.hi & b.hi }; }
+        friend Pair operator|(Pair a, Pair b) { return { a.lo | b.lo, a.hi | b.hi }; }
+        friend Pair min(Pair a, Pair b) { return { min(a.lo, b.lo), min(a.hi, b.hi) }; }
+        friend Pair max(Pair a, Pair b) { return { max(a.lo, b.lo), max(a.hi, b.hi) }; }
+        friend Pair fma(Pair a, Pair b, Pair c) { return { fma(a.lo, b.lo, c.lo), fma(a.hi, b.hi, c.hi) }; }
+        friend Pair floor(Pair a) { return { floor(a.lo), floor(a.hi) }; }
+        friend Pair abs(Pair a) { return { abs(a.lo), abs(a.hi) }; }
+        friend Pair sqrt(Pair a) { return { sqrt(a.lo), sqrt(a.hi) }; }
+        friend Pair select(Pair m, Pair a, Pair b) { return { select(m.lo, a.lo, b.lo), select(m.hi, a.hi, b.hi) }; }
+        friend bool any(Pair m) { return any(m.lo) || any(m.hi); }
+        friend uint32_t bitmask(Pair m) { return bitmask(m.lo) | bitmask(m.hi) << T::width; }
+        friend Pair exp2i(Pair n) { return { exp2i(n.lo), exp2i(n.hi) }; }
+        friend Pair gather(const float* table, Pair index) { return { gather(table, index.lo), gather(table, index.hi) }; }
+        friend Pair rsqrt(Pair a) { return { rsqrt(a.lo), rsqrt(a.hi) }; }
+        friend void pack_snorm8(Pair x, Pair y, Pair z, Pair w, uint32_t* out) {
+            pack_snorm8(x.lo, y.lo, z.lo, w.lo, out);
+            pack_snorm8(x.hi, y.hi, z.hi, w.hi, out + T::width);
+        }
+        friend void pack_snorm8(Pair x, Pair y, uint16_t* out) {
+            pack_snorm8(x.lo, y.lo, out);
+            pack_snorm8(x.hi, y.hi, out + T::width);
+        }
+        friend void pack_unorm8(Pair x, uint8_t* out) { pack_unorm8(x.lo, out); pack_unorm8(x.hi, out + T::width); }
+        static void unpack_snorm8(const uint32_t* in, Pair& x, Pair& y, Pair& z, Pair& w) {
+            T::unpack_snorm8(in, x.lo, y.lo, z.lo, w.lo);
+            T::unpack_snorm8(in + T::width, x.hi, y.hi, z.hi, w.hi);
+        }
+        static void unpack_snorm8(const uint16_t* in, Pair& x, Pair& y) {
+            T::unpack_snorm8(in, x.lo, y.lo);
+            T::unpack_snorm8(in + T::width, x.hi, y.hi);
+        }
+        static Pair unpack_unorm8(const uint8_t* in) { return { T::unpack_unorm8(in), T::unpack_unorm8(in + T::width) }; }
+        static constexpr bool has_half = T::has_half;
+        friend void pack_half(Pair x, uint16_t* out) { pack_half(x.lo, out); pack_half(x.hi, out + T::width); }
+        static Pair unpack_half(const uint16_t* in) { return { T::unpack_half(in), T::unpack_half(in + T::width) }; }
+    };
+
+
+#if CR_SIMD_AVX2
+    /**
+     Eight float lanes in one AVX2 register
+     */
+    struct f32x8 {
+        static constexpr size_t width = 8;
+        __m256 v;
+
+        f32x8() = default;
+        f32x8(__m256 x) : v(x) {}
+        explicit f32x8(float s) : v(_mm256_set1_ps(s)) {}
+
+        static f32x8 load(const float* p) { return _mm256_loadu_ps(p); }
+        void store(float* p) const { _mm256_storeu_ps(p, v); }
+
+        friend f32x8 operator+(f32x8 a, f32x8 b) { return _mm256_add_ps(a.v, b.v); }
+        friend f32x8 operator-(f32x8 a, f32x8 b) { return _mm256_sub_ps(a.v, b.v); }
+        friend f32x8 operator*(f32x8 a, f32x8 b) { return _mm256_mul_ps(a.v, b.v); }
+        friend f32x8 operator/(f32x8 a, f32x8 b) { return _mm256_div_ps(a.v, b.v); }
+        friend f32x8 operator<(f32x8 a, f32x8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+        friend f32x8 operator>=(f32x8 a, f32x8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ); }
+        friend f32x8 operator&(f32x8 a, f32x8 b) { return _mm256_and_ps(a.v, b.v); }
+        friend f32x8 operator|(f32x8 a, f32x8 b) { return _mm256_or_ps(a.v, b.v); }
+        friend f32x8 min(f32x8 a, f32x8 b) { return _mm256_min_ps(a.v, b.v); }
+        friend f32x8 max(f32x8 a, f32x8 b) { return _mm256_max_ps(a.v, b.v); }
+        friend f32x8 fma(f32x8 a, f32x8 b, f32x8 c) { return _mm256_fmadd_ps(a.v, b.v, c.v); }
+        friend f32x8 floor(f32x8 a) { return _mm256_floor_ps(a.v); }
+        friend f32x8 abs(f32x8 a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+        friend f32x8 sqrt(f32x8 a) { return _mm256_sqrt_ps(a.v); }
+        friend f32x8 select(f32x8 m, f32x8 a, f32x8 b) { return _mm256_blendv_ps(a.v, b.v, m.v); }
+        friend bool any(f32x8 m) { return _mm256_movemask_ps(m.v) != 0; }
+        friend uint32_t bitmask(f32x8 m) { return (uint32_t)_mm256_movemask_ps(m.v); }
+        friend f32x8 exp2i(f32x8 n) { return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(n.v), _mm256_set1_epi32(127)), 23)); }
+        friend f32x8 gather(const float* table, f32x8 index) { return _mm256_i32gather_ps(table, _mm256_cvttps_epi32(index.v), 4); }
+        friend f32x8 rsqrt(f32x8 a) {
+            __m256 r = _mm256_rsqrt_ps(a.v);
+            return _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), r), _mm256_fnmadd_ps(_mm256_mul_ps(a.v, r), r, _mm256_set1_ps(3.0f)));
+        }
+        friend void pack_snorm8(f32x8 x, f32x8 y, f32x8 z, f32x8 w, uint32_t* out) {
+            auto q = [](f32x8 c) {
+                return _mm256_and_si256(_mm256_cvtps_epi32(_mm256_mul_ps(c.v, _mm256_set1_ps(127.0f))), _mm256_set1_epi32(0xFF));
+            };
+            __m256i r = _mm256_or_si256(_mm256_or_si256(q(x), _mm256_slli_epi32(q(y), 8)),
+                                        _mm256_or_si256(_mm256_slli_epi32(q(z), 16), _mm256_slli_epi32(q(w), 24)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), r);
+        }
+        friend void pack_snorm8(f32x8 x, f32x8 y, uint16_t* out) {
+            auto q = [](f32x8 c) { return _mm256_and_si256(_mm256_cvtps_epi32(_mm256_mul_ps(c.v, _mm256_set1_ps(127.0f))), _mm256_set1_epi32(0xFF)); };
+            __m256i r = _mm256_or_si256(q(x), _mm256_slli_epi32(q(y), 8));
+            __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(r), _mm256_extracti128_si256(r, 1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), packed);
+        }
+        friend void pack_unorm8(f32x8 x, uint8_t* out) {
+            __m256i i = _mm256_cvtps_epi32(_mm256_mul_ps(x.v, _mm256_set1_ps(255.0f)));
+            __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(i), _mm256_extracti128_si256(i, 1));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(words, words));
+        }
+        static f32x8 snorm8(__m256i byte_in_top) {
+            __m256 v = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srai_epi32(byte_in_top, 24)), _mm256_set1_ps(1.0f / 127.0f));
+            return _mm256_max_ps(v, _mm256_set1_ps(-1.0f));
+        }
+        static void unpack_snorm8(const uint32_t* in, f32x8& x, f32x8& y, f32x8& z, f32x8& w) {
+            __m256i t = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+            x = snorm8(_mm256_slli_epi32(t, 24)), y = snorm8(_mm256_slli_epi32(t, 16)), z = snorm8(_mm256_slli_epi32(t, 8)), w = snorm8(t);
+        }
+        static void unpack_snorm8(const uint16_t* in, f32x8& x, f32x8& y) {
+            __m256i t = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in)));
+            x = snorm8(_mm256_slli_epi32(t, 24)), y = snorm8(_mm256_slli_epi32(t, 16));
+        }
+        static f32x8 unpack_unorm8(const uint8_t* in) {
+            __m256i t = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(in)));
+            return _mm256_div_ps(_mm256_cvtepi32_ps(t), _mm256_set1_ps(255.0f));
+        }
+    #if defined(__F16C__)
+        static constexpr bool has_half = true;
+        friend void pack_half(f32x8 x, uint16_t* out) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm256_cvtps_ph(x.v, _MM_FROUND_TO_NEAREST_INT));
+        }
+        static f32x8 unpack_half(const uint16_t* in) { return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in))); }
+    #else
+        static constexpr bool has_half = false;
+    #endif
+    };
+#else
+    using f32x8 = Pair<f32x4>;
+#endif
+
+
+#if CR_SIMD_AVX512
+    /**
+     Sixteen float lanes in one AVX-512 register. Masks are kept as all-ones lanes like the narrower types.
+     GCC's unmasked AVX-512 intrinsics merge into `_mm512_undefined_*`, which -Wuninitialized reports at every
+     caller, so the operations that have one use the zero masked form over all lanes instead; it is the same instruction.
+     */
+    struct f32x16 {
+        static constexpr size_t width = 16;
+        static constexpr __mmask16 all = 0xFFFF;
+        __m512 v;
+
+        f32x16() = default;
+        f32x16(__m512 x) : v(x) {}
+        explicit f32x16(float s) : v(_mm512_set1_ps(s)) {}
+
+        static f32x16 load(const float* p) { return _mm512_loadu_ps(p); }
+        void store(float* p) const { _mm512_storeu_ps(p, v); }
+        static f32x16 from_mask(__mmask16 k) { return _mm512_castsi512_ps(_mm512_maskz_set1_epi32(k, -1)); }
+        __mmask16 mask() const { __m512i i = _mm512_castps_si512(v); return _mm512_test_epi32_mask(i, i); }
+
+        friend f32x16 operator+(f32x16 a, f32x16 b) { return _mm512_add_ps(a.v, b.v); }
+        friend f32x16 operator-(f32x16 a, f32x16 b) { return _mm512_sub_ps(a.v, b.v); }
+        friend f32x16 operator*(f32x16 a, f32x16 b) { return _mm512_mul_ps(a.v, b.v); }
+        friend f32x16 operator/(f32x16 a, f32x16 b) { return _mm512_div_ps(a.v, b.v); }
+        friend f32x16 operator<(f32x16 a, f32x16 b) { return from_mask(_mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ)); }
+        friend f32x16 operator>=(f32x16 a, f32x16 b) { return from_mask(_mm512_cmp_ps_mask(a.v, b.v, _CMP_GE_OQ)); }
+        friend f32x16 operator&(f32x16 a, f32x16 b) { return from_mask(a.mask() & b.mask()); }
+        friend f32x16 operator|(f32x16 a, f32x16 b) { return from_mask(a.mask() | b.mask()); }
+        friend f32x16 min(f32x16 a, f32x16 b) { return _mm512_maskz_min_ps(all, a.v, b.v); }
+        friend f32x16 max(f32x16 a, f32x16 b) { return _mm512_maskz_max_ps(all, a.v, b.v); }
+        friend f32x16 fma(f32x16 a, f32x16 b, f32x16 c) { return _mm512_fmadd_ps(a.v, b.v, c.v); }
+        friend f32x16 floor(f32x16 a) { return _mm512_maskz_roundscale_ps(all, a.v, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+        friend f32x16 abs(f32x16 a) { return _mm512_abs_ps(a.v); }
+        friend f32x16 sqrt(f32x16 a) { return _mm512_maskz_sqrt_ps(all, a.v); }
+        friend f32x16 select(f32x16 m, f32x16 a, f32x16 b) { return _mm512_mask_blend_ps(m.mask(), a.v, b.v); }
+        friend bool any(f32x16 m) { return m.mask() != 0; }
+        friend uint32_t bitmask(f32x16 m) { return (uint32_t)m.mask(); }
+        friend f32x16 exp2i(f32x16 n) { return _mm512_castsi512_ps(_mm512_maskz_slli_epi32(all, _mm512_add_epi32(_mm512_maskz_cvttps_epi32(all, n.v), _mm512_set1_epi32(127)), 23)); }
+        friend f32x16 gather(const float* table, f32x16 index) { return _mm512_mask_i32gather_ps(_mm512_setzero_ps(), all, _mm512_maskz_cvttps_epi32(all, index.v), table, 4); }
+        friend f32x16 rsqrt(f32x16 a) {
+            __m512 r = _mm512_maskz_rsqrt14_ps(all, a.v);
+            return _mm512_mul_ps(_mm512_mul_ps(_mm512_set1_ps(0.5f), r), _mm512_fnmadd_ps(_mm512_mul_ps(a.v, r), r, _mm512_set1_ps(3.0f)));
+        }
+        friend void pack_snorm8(f32x16 x, f32x16 y, f32x16 z, f32x16 w, uint32_t* out) {
+            auto q = [](f32x16 c) {
+                return _mm512_and_si512(_mm512_maskz_cvtps_epi32(all, _mm512_mul_ps(c.v, _mm512_set1_ps(127.0f))), _mm512_set1_epi32(0xFF));
+            };
+            __m512i r = _mm512_or_si512(_mm512_or_si512(q(x), _mm512_maskz_slli_epi32(all, q(y), 8)),
+                                        _mm512_or_si512(_mm512_maskz_slli_epi32(all, q(z), 16), _mm512_maskz_slli_epi32(all, q(w), 24)));
+            _mm512_storeu_si512(out, r);
+        }
+        friend void pack_snorm8(f32x16 x, f32x16 y, uint16_t* out) {
+            auto q = [](f32x16 c) { return _mm512_and_si512(_mm512_maskz_cvtps_epi32(all, _mm512_mul_ps(c.v, _mm512_set1_ps(127.0f))), _mm512_set1_epi32(0xFF)); };
+            __m512i r = _mm512_or_si512(q(x), _mm512_maskz_slli_epi32(all, q(y), 8));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm512_maskz_cvtepi32_epi16(all, r));
+        }
+        friend void pack_unorm8(f32x16 x, uint8_t* out) {
+            __m512i i = _mm512_maskz_cvtps_epi32(all, _mm512_mul_ps(x.v, _mm512_set1_ps(255.0f)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm512_maskz_cvtepi32_epi8(all, i));
+        }
+        static f32x16 snorm8(__m512i byte_in_top) {
+            __m512 v = _mm512_mul_ps(_mm512_maskz_cvtepi32_ps(all, _mm512_maskz_srai_epi32(all, byte_in_top, 24)), _mm512_set1_ps(1.0f / 127.0f));
+            return _mm512_maskz_max_ps(all, v, _mm512_set1_ps(-1.0f));
+        }
+        static void unpack_snorm8(const uint32_t* in, f32x16& x, f32x16& y, f32x16& z, f32x16& w) {
+            __m512i t = _mm512_loadu_si512(in);
+            x = snorm8(_mm512_maskz_slli_epi32(all, t, 24)), y = snorm8(_mm512_maskz_slli_epi32(all, t, 16)), z = snorm8(_mm512_maskz_slli_epi32(all, t, 8)), w = snorm8(t);
+        }
+        static void unpack_snorm8(const uint16_t* in, f32x16& x, f32x16& y) {
+            __m512i t = _mm512_maskz_cvtepu16_epi32(all, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in)));
+            x = snorm8(_mm512_maskz_slli_epi32(all, t, 24)), y = snorm8(_mm512_maskz_slli_epi32(all, t, 16));
+        }
+        static f32x16 unpack_unorm8(const uint8_t* in) {
+            __m512i t = _mm512_maskz_cvtepu8_epi32(all, _mm_loadu_si128(reinterpret_cast<const __m128i*>(in)));
+            return _mm512_div_ps(_mm512_maskz_cvtepi32_ps(all, t), _mm512_set1_ps(255.0f));
+        }
+        static constexpr bool has_half = true;
+        friend void pack_half(f32x16 x, uint16_t* out) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm512_maskz_cvtps_ph(all, x.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+        }
+        static f32x16 unpack_half(const uint16_t* in) { return _mm512_maskz_cvtph_ps(all, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in))); }
+    };
+#else
+    using f32x16 = Pair<f32x8>;
+#endif
+
+
+    /**
+     start, start + 1, ... across the lanes
+     */
+    template <class V>
+    inline V ramp(float start) {
+        alignas(64) float lanes[V::width];
+        for ( size_t i = 0; i < V::width; i += 1 ) lanes[i] = start + (float)i;
+        return V::load(lanes);
+    }
+
+    /**
+     e^x to about 2 ulp (Cephes' expf), flushing to 0 below -87
+     */
+    template <class V>
+    inline V exp(V x) {
+        x = min(max(x, V { -87.3f }), V { 88.3f });
+        V n = floor(fma(x, V { 1.44269504088896341f }, V { 0.5f }));
+        // ln 2 split in two so n * ln 2 is subtracted without rounding
+        x = fma(n, V { -0.693359375f }, x);
+        x = fma(n, V { 2.12194440e-4f }, x);
+
+        V p { 1.9875691500e-4f };
+        p = fma(p, x, V { 1.3981999507e-3f });
+        p = fma(p, x, V { 8.3334519073e-3f });
+        p = fma(p, x, V { 4.1665795894e-2f });
+        p = fma(p, x, V { 1.6666665459e-1f });
+        p = fma(p, x, V { 5.0000001201e-1f });
+        p = fma(p, x * x, x + V { 1.0f });
+        return p * exp2i(n);
+    }
+}
@@ -46,6 +46,16 @@ struct VertexOut {
     float2 uv;
 };
 
+inline VertexOut transform_vertex(float3 position, float2 uv, float3 normal,
+                                  float4x4 view, float4x4 view_t_i, float4x4 proj)
+{
+    VertexOut out;
+    out.pos = proj * view * float4(position, 1.0f);
+    out.uv = uv;
+    out.normal = (view_t_i * float4(normal, 1.0f)).xyz;
+    return out;
+}
+
 /**
  Simple vertex transform function
  */
@@ -55,28 +65,104 @@ vertex VertexOut transform(uint id                          [[ vertex_id ]],
                            constant float4x4& view_t_i      [[ buffer(2) ]],
                            constant float4x4& proj          [[ buffer(3) ]])
 {
-    VertexOut out;
     Vertex v = vertices[id];
-    out.pos = proj * view * float4(v.position, 1.0f);
-    out.uv = v.uv;
-    out.normal = (view_t_i * float4(v.normal, 1.0f)).xyz;
-    return out;
+    return transform_vertex(v.position, v.uv, v.normal, view, view_t_i, proj);
+}
+
+/**
+ Octahedral map -> unit vector, mirrors `Quantization::octahedral_decode`
+ */
+inline float3 decode_octahedral(float2 e) {
+    float3 n = float3(e, 1.0f - abs(e.x) - abs(e.y));
+    if (n.z < 0.0f) {
+        n.xy = (1.0f - abs(n.yx)) * select(float2(-1.0f), float2(1.0f), n.xy >= 0.0f);
+    }
+    return normalize(n);
+}
+
+/**
+ Vertex transform function for `PackedVertex`
+ */
+vertex VertexOut transform_packed(uint id                                   [[ vertex_id ]],
+                                  device PackedVertex const* vertices       [[ buffer(0) ]],
+                                  constant float4x4& view                   [[ buffer(1) ]],
+                                  constant float4x4& view_t_i               [[ buffer(2) ]],
+                                  constant float4x4& proj                   [[ buffer(3) ]],
+                                  constant PackedVertexBounds& bounds       [[ buffer(4) ]])
+{
+    device PackedVertex const& v = vertices[id];
+    float3 q = float3(float(v.position[0]), float(v.position[1]), float(v.position[2])) / 65535.0f;
+    float3 position = bounds.min + q * bounds.extent;
+    float2 oct = max(float2(float(v.normal[0]), float(v.normal[1])) / 32767.0f, -1.0f);
+    float2 uv = float2(as_type<half>(v.uv[0]), as_type<half>(v.uv[1]));
+    return transform_vertex(position, uv, decode_octahedral(oct), view, view_t_i, proj);
 }
 
 /**
  Render texture to skydome
  */
-fragment float4 draw_skydome(VertexOut in                           [[ stage_in ]],
-                             texture2d<float, access::sample> tex   [[ texture(0) ]])
+fragment float4 draw_skydome(VertexOut in                                [[ stage_in ]],
+                             constant CloudFlowFrame& flow               [[ buffer(0) ]],
+                             texture2d<float, access::sample> tex        [[ texture(0) ]],
+                             texture2d<float, access::sample> velocity   [[ texture(1) ]])
 {
-    constexpr sampler s { min_filter::linear, mag_filter::linear, coord::normalized };
-    float4 color = tex.sample(s, in.uv);
-    color = float4(float3(color.x * 0.5 + 0.5), 1.0f);
+    constexpr sampler s { min_filter::linear, mag_filter::linear, mip_filter::linear, coord::normalized };
+    
+    // two advection phases of the static map, cross-faded, mirrors `CloudAnimation::advect`
+    float2 v = velocity.sample(s, in.uv).xy;
+    float density = flow.weight[0] * tex.sample(s, in.uv - v * flow.advect[0]).x
+                  + flow.weight[1] * tex.sample(s, in.uv - v * flow.advect[1]).x;
+    float4 color = float4(float3(density * 0.5 + 0.5), 1.0f);
     return color;
 }
 
 
 
+/**
+ Density at `uv` from the virtual texture's atlas at `level`, through the finest resident page covering it.
+ Mirrors `VirtualTexture::VirtualCloudField::sample`.
+ */
+float sample_virtual_density(float2 uv, uint level,
+                             constant CloudVirtualLayout& layout,
+                             device uint const* indirection,
+                             texture2d<float, access::sample> atlas)
+{
+    constexpr sampler s { filter::linear, coord::pixel, address::clamp_to_edge };
+    uv = saturate(uv);
+    uint pages = (layout.virtual_size >> level) / layout.page_size;
+    uint2 page = min(uint2(uv * float(pages)), pages - 1);
+    uint entry = indirection[layout.level_offset[level] + page.y * pages + page.x];
+    
+    uint resident_pages = (layout.virtual_size >> (entry >> 24)) / layout.page_size;
+    float2 p = uv * float(resident_pages);
+    float2 in_page = p - min(floor(p), float(resident_pages - 1));
+    float2 slot = float2(entry & 0xFFF, (entry >> 12) & 0xFFF);
+    return atlas.sample(s, slot * float(layout.slot_size) + 1.0f + in_page * float(layout.page_size)).x;
+}
+
+/**
+ `draw_skydome` reading the sparse virtual density map, the level chosen like `VirtualTexture::select_level`
+ */
+fragment float4 draw_skydome_virtual(VertexOut in                                [[ stage_in ]],
+                                     constant CloudFlowFrame& flow               [[ buffer(0) ]],
+                                     constant CloudVirtualLayout& layout         [[ buffer(1) ]],
+                                     device uint const* indirection              [[ buffer(2) ]],
+                                     texture2d<float, access::sample> atlas      [[ texture(0) ]],
+                                     texture2d<float, access::sample> velocity   [[ texture(1) ]])
+{
+    constexpr sampler s { min_filter::linear, mag_filter::linear, coord::normalized };
+    
+    float2 texels = in.uv * float(layout.virtual_size);
+    float2 dx = dfdx(texels), dy = dfdy(texels);
+    float lod = 0.5f * log2(max(dot(dx, dx), dot(dy, dy)));
+    uint level = uint(clamp(floor(lod + 0.5f), 0.0f, float(layout.levels - 1)));
+    
+    float2 v = velocity.sample(s, in.uv).xy;
+    float density = flow.weight[0] * sample_virtual_density(in.uv - v * flow.advect[0], level, layout, indirection, atlas)
+                  + flow.weight[1] * sample_virtual_density(in.uv - v * flow.advect[1], level, layout, indirection, atlas);
+    return float4(float3(density * 0.5 + 0.5), 1.0f);
+}
+
 /**
  Gaussian bell function
  */
@@ -95,6 +181,30 @@ inline float fall_off(float x, float top_width) {
     }
 }
 
+/**
+ Distance to the center, in radii, beyond which the fall-off hides every density below `fall_off_epsilon`,
+ mirrors `CloudNoise::visible_radius`; only called with an epsilon above 0
+ */
+inline float visible_radius(constant CloudFieldParameters& params) {
+    float peak = abs(params.gaussian_peak);
+    if (peak <= params.fall_off_epsilon) return -1.0f;
+    float sigma = 0.8 * (1.0 - params.fall_off_top_width);
+    return params.fall_off_top_width + sigma * sqrt(2.0 * log(peak / params.fall_off_epsilon));
+}
+
+/**
+ Octaves a density with fall-off `f` needs for the rest to change it by less than `fall_off_epsilon`,
+ mirrors `CloudNoise::visible_octaves`
+ */
+inline uint visible_octaves(float f, constant CloudFieldParameters& params) {
+    uint n = params.octaves;
+    if (params.fall_off_epsilon <= 0.0f || n <= 1) return n;
+    float slope = abs(params.gaussian_peak) * 0.60653066 / params.gaussian_width;
+    float tail = params.fall_off_epsilon / (2.0 * 0.70710678 * slope * f) + ldexp(1.0f, -int(n));
+    if (tail >= 1.0f) return 1;
+    return clamp(uint(ceil(-log2(tail))), 1u, n);
+}
+
 /**
  Perlin's fade function
  */
@@ -102,27 +212,20 @@ inline float fade(float t) {
     return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
 }
 
-float2 gradient(uint2 pos, constant float* perms) {
-    uint i = (pos.x * 8 + pos.y) % 128;
-    float theta = perms[i];
-    return float2(cos(theta), sin(theta));
-}
-
 /**
- 2D perlin noise
+ 2D perlin noise, lattice corners hashed through the seeded noise table
  */
-float perlin_2D(float2 p, constant float* perms)
+float perlin_2D(float2 p, constant CloudNoiseTable& table, float grid_size)
 {
-    float grid_size = 128.f;
-    uint2 top_left      = uint2(floor(p / grid_size));
-    uint2 top_right     = top_left + uint2(1, 0);
-    uint2 bottom_left   = top_left + uint2(0, 1);
-    uint2 bottom_right  = top_left + uint2(1, 1);
+    uint2 cell = uint2(floor(p / grid_size)) & 255;
     
-    float2 aa = gradient(top_left, perms);
-    float2 ab = gradient(top_right, perms);
-    float2 ba = gradient(bottom_left, perms);
-    float2 bb = gradient(bottom_right, perms);
+    // both tables are stored twice, so cell + 1 needs no wrap
+    uint top_left = cell.x + table.permutation[cell.y];
+    uint bottom_left = cell.x + table.permutation[cell.y + 1];
+    float2 aa = table.gradients[top_left];
+    float2 ab = table.gradients[top_left + 1];
+    float2 ba = table.gradients[bottom_left];
+    float2 bb = table.gradients[bottom_left + 1];
     
     float x = fmod(p.x, grid_size) / grid_size;
     float y = fmod(p.y, grid_size) / grid_size;
@@ -137,32 +240,168 @@ float perlin_2D(float2 p, constant float* perms)
 
 
 /**
- Generate cloud dnesity map using 2D perlin noise
+ Octaves `first` .. `last` - 1 of the noise at `p` added onto `sum`, in the order every octave is added
  */
-kernel void generate_cloud_density_map(uint2 pos             [[ thread_position_in_grid ]],
-                                       constant uint2& dim   [[ buffer(0) ]],
-                                       constant float* p     [[ buffer(1) ]],
-                                       texture2d<float, access::write> out [[ texture(0) ]])
+inline float add_octaves(float sum, float2 p, uint first, uint last, constant CloudNoiseTable& noise_table, float grid_size)
 {
-    constexpr uint octave = 8;
-    float sum = 0.0f;
-    float frequency = 1.0f;
-    float amplitude = 1.0f;
-    
-    for(uint i = 0; i < octave; i += 1) {
-        sum += perlin_2D((float2(pos) + 0.5) * frequency, p) * amplitude;
+    float frequency = ldexp(1.0f, int(first));
+    float amplitude = ldexp(1.0f, -int(first));
+    for(uint i = first; i < last; i += 1) {
+        sum += perlin_2D(p * frequency, noise_table, grid_size) * amplitude;
         amplitude *= 0.5;
         frequency *= 2.0;
     }
+    return sum;
+}
 
-    float result = gaussian(sum, 1.0f, 1.0f, .6f);
-    
+/**
+ Fall-off of texel `pos` of a `dim` sized map, or -1 where it hides every density below `fall_off_epsilon`
+ */
+inline float texel_fall_off(uint2 pos, uint2 dim, constant CloudFieldParameters& params)
+{
     float2 center_point = float2(dim) / 2.f;
     float distance_to_center = distance(center_point, float2(pos)) / float(dim.x / 2);
+    if (params.fall_off_epsilon > 0.0f && distance_to_center > visible_radius(params)) return -1.0f;
+    return fall_off(distance_to_center, params.fall_off_top_width);
+}
+
+/**
+ Cloud density of texel `pos` of a `dim` sized map
+ */
+float cloud_density(uint2 pos, uint2 dim, constant CloudNoiseTable& noise_table, constant CloudFieldParameters& params)
+{
+    float f = texel_fall_off(pos, dim, params);
+    if (f < 0.0f) return 0.0f;
     
-    result *= fall_off(distance_to_center, 0.8);
+    float sum = add_octaves(0.0f, float2(pos) + 0.5, 0, visible_octaves(f, params), noise_table, params.grid_size);
+    float result = gaussian(sum, params.gaussian_peak, params.gaussian_center, params.gaussian_width);
+    return result * f;
+}
+
+/**
+ The base band at texel `pos`, bilinear between its texels as `CloudLayerCache::expand_base` interpolates them
+ */
+inline float base_band(uint2 pos, texture2d<float, access::read> base, uint shift)
+{
+    uint2 i = pos >> shift;
+    float2 t = float2(pos & ((1u << shift) - 1)) / float(1u << shift);
+    float left = mix(base.read(i).x, base.read(i + uint2(0, 1)).x, t.y);
+    float right = mix(base.read(i + uint2(1, 0)).x, base.read(i + uint2(1, 1)).x, t.y);
+    return mix(left, right, t.x);
+}
+
+/**
+ `cloud_density` starting from the first `band.octaves` octaves in `base`; a texel the fall-off leaves fewer
+ octaves than that evaluates the ones it keeps
+ */
+float cloud_density(uint2 pos, uint2 dim, constant CloudNoiseTable& noise_table, constant CloudFieldParameters& params,
+                    texture2d<float, access::read> base, constant CloudBaseBand& band)
+{
+    float f = texel_fall_off(pos, dim, params);
+    if (f < 0.0f) return 0.0f;
     
-    out.write(float4(result, 0, 0, 0), pos);
+    uint octaves = visible_octaves(f, params);
+    uint first = min(band.octaves, params.octaves);
+    if (octaves < first) first = 0;
+    float sum = first > 0 ? base_band(pos, base, band.shift) : 0.0f;
+    sum = add_octaves(sum, float2(pos) + 0.5, first, octaves, noise_table, params.grid_size);
+    float result = gaussian(sum, params.gaussian_peak, params.gaussian_center, params.gaussian_width);
+    return result * f;
+}
+
+
+/**
+ Sobel normal of the center of `p`, `p[x][y]` being the height at offset (x - 1, y - 1)
+ */
+float3 sobel_normal(thread float p[3][3])
+{
+    float3 n;
+    n.x = -(p[2][2] - p[0][2] + 2 * (p[2][1] - p[0][1]) + p[2][0] - p[0][0]);
+    n.y = -(p[0][0] - p[0][2] + 2 * (p[1][0] - p[1][2]) + p[2][0] - p[2][2]);
+    n.z = 1.0f;
+    return normalize(n);
+}
+
+
+/**
+ Unit vector -> octahedral map, mirrors `Quantization::octahedral_encode`
+ */
+inline float2 encode_octahedral(float3 n) {
+    float2 e = n.xy / (abs(n.x) + abs(n.y) + abs(n.z));
+    if (n.z < 0.0f) {
+        e = (1.0f - abs(e.yx)) * select(float2(-1.0f), float2(1.0f), e >= 0.0f);
+    }
+    return e;
+}
+
+/**
+ Upper hemisphere octahedral map rotated to fill the square, mirrors `NormalMap::HemiOctahedral8`
+ */
+inline float2 encode_hemi_octahedral(float3 n) {
+    float2 p = n.xy / (abs(n.x) + abs(n.y) + n.z);
+    return float2(p.x + p.y, p.x - p.y);
+}
+
+inline float3 decode_hemi_octahedral(float2 e) {
+    float2 p = float2(e.x + e.y, e.x - e.y) * 0.5f;
+    return normalize(float3(p, 1.0f - abs(p.x) - abs(p.y)));
+}
+
+/**
+ Interleaved gradient noise in [-0.5, 0.5), mirrors `CloudEncoding::dither`
+ */
+inline float dither(uint2 pos) {
+    return fract(52.9829189f * fract(dot(float2(pos), float2(0.06711056f, 0.00583715f)))) - 0.5f;
+}
+
+/**
+ Density as the density map's format wants it, dithered before an 8 bit texture rounds it
+ */
+inline float encode_cloud_density(float density, uint2 pos, constant CloudMapEncoding& encoding) {
+    if (encoding.density_dither == 0.0f) return density;
+    return saturate(density + dither(pos) * encoding.density_dither);
+}
+
+/**
+ Normal in the normal map's layout, xyz or a two channel octahedral map
+ */
+inline float4 encode_cloud_normal(float3 n, constant CloudMapEncoding& encoding) {
+    switch (encoding.normal_encoding) {
+        case CloudNormalOctahedral:     return float4(encode_octahedral(n), 0.0f, 0.0f);
+        case CloudNormalHemiOctahedral: return float4(encode_hemi_octahedral(n), 0.0f, 0.0f);
+        default:                        return float4(n, 0.0f);
+    }
+}
+
+
+/**
+ Generate cloud dnesity map using 2D perlin noise
+ */
+kernel void generate_cloud_density_map(uint2 pos                                   [[ thread_position_in_grid ]],
+                                       constant uint2& dim                         [[ buffer(0) ]],
+                                       constant CloudNoiseTable& noise_table       [[ buffer(1) ]],
+                                       constant CloudFieldParameters& params       [[ buffer(2) ]],
+                                       constant CloudMapEncoding& encoding         [[ buffer(3) ]],
+                                       texture2d<float, access::write> out         [[ texture(0) ]])
+{
+    out.write(float4(encode_cloud_density(cloud_density(pos, dim, noise_table, params), pos, encoding), 0, 0, 0), pos);
+}
+
+
+/**
+ The base band of `generate_cloud_maps`: texel (i, j) is the sum of the first `band.octaves` octaves
+ at texel (i << shift, j << shift) of the map. Dispatch one thread per texel of `base`.
+ */
+kernel void generate_cloud_base_band(uint2 pos                                   [[ thread_position_in_grid ]],
+                                     constant CloudNoiseTable& noise_table       [[ buffer(0) ]],
+                                     constant CloudFieldParameters& params       [[ buffer(1) ]],
+                                     constant CloudBaseBand& band                [[ buffer(2) ]],
+                                     texture2d<float, access::write> base        [[ texture(0) ]])
+{
+    if (pos.x >= base.get_width() || pos.y >= base.get_height()) return;
+    uint octaves = min(band.octaves, params.octaves);
+    float sum = add_octaves(0.0f, float2(pos << band.shift) + 0.5, 0, octaves, noise_table, params.grid_size);
+    base.write(float4(sum, 0, 0, 0), pos);
 }
 
 
@@ -171,25 +410,107 @@ kernel void generate_cloud_density_map(uint2 pos             [[ thread_position_
  */
 kernel void generate_normal_map(uint2           pos [[ thread_position_in_grid ]],
                                 constant uint2& dim [[ buffer(0) ]],
+                                constant CloudMapEncoding& encoding         [[ buffer(1) ]],
                                 texture2d<float, access::sample> height_map [[ texture(0) ]],
                                 texture2d<float, access::write> out         [[ texture(1) ]])
 {
-    // Sobel filter
+    if (pos.x >= dim.x || pos.y >= dim.y) return;
+    
+    // Sobel filter, neighbors outside the map clamped to its edge
     thread float p[3][3];
+    int2 last = int2(dim) - 1;
     for (int x_offset = -1; x_offset <= 1; x_offset += 1) {
         for (int y_offset = -1; y_offset <= 1; y_offset += 1) {
-            int x = pos.x + x_offset, y = pos.y + y_offset;
-            if (!(x >= int(dim.x) || x < 0 || y >= int(dim.y) || y < 0))
-                p[x_offset + 1][y_offset + 1] = height_map.read(uint2(x, y)).x;
+            int2 neighbor = clamp(int2(pos) + int2(x_offset, y_offset), int2(0), last);
+            p[x_offset + 1][y_offset + 1] = height_map.read(uint2(neighbor)).x;
         }
     }
     
-    float3 n;
-    n.x = -(p[2][2] - p[0][2] + 2 * (p[2][1] - p[0][1]) + p[2][0] - p[0][0]);
-    n.y = -(p[0][0] - p[2][0] + 2 * (p[1][0] - p[1][2]) + p[2][0] - p[2][2]);
-    n.z = 1.0f;
+    out.write(encode_cloud_normal(sobel_normal(p), encoding), pos);
+}
+
+
+/**
+ Density and normal maps in one pass. Each threadgroup evaluates the densities of its
+ CLOUD_MAP_TILE_SIZE^2 tile plus a one texel halo into threadgroup memory, then takes the normals from there,
+ so the density map is only written. Neighbors are clamped to the map edge. Dispatch whole threadgroups;
+ `tile_offset` is the first tile of the dispatch, so a regeneration can be split into slices of tiles.
+ The low octaves come from `base`, written by `generate_cloud_base_band` for the same seed and grid.
+ */
+kernel void generate_cloud_maps(uint2 local                                 [[ thread_position_in_threadgroup ]],
+                                uint2 group                                 [[ threadgroup_position_in_grid ]],
+                                constant uint2& dim                         [[ buffer(0) ]],
+                                constant CloudNoiseTable& noise_table       [[ buffer(1) ]],
+                                constant CloudFieldParameters& params       [[ buffer(2) ]],
+                                constant CloudMapEncoding& encoding         [[ buffer(3) ]],
+                                constant uint2& tile_offset                 [[ buffer(4) ]],
+                                constant CloudBaseBand& band                [[ buffer(5) ]],
+                                texture2d<float, access::write> density     [[ texture(0) ]],
+                                texture2d<float, access::write> normals     [[ texture(1) ]],
+                                texture2d<float, access::read> base         [[ texture(2) ]])
+{
+    constexpr int side = CLOUD_MAP_TILE_SIZE + 2;
+    threadgroup float tile[side][side];
+    uint2 tile_origin = (group + tile_offset) * CLOUD_MAP_TILE_SIZE;
+    uint2 pos = tile_origin + local;
+    
+    // a tile the fall-off hides entirely skips its halo, the same branch for every thread of the group
+    if (params.fall_off_epsilon > 0.0f) {
+        float2 center_point = float2(dim) / 2.f;
+        float2 nearest = clamp(center_point, float2(tile_origin) - 1, float2(tile_origin + CLOUD_MAP_TILE_SIZE));
+        if (distance(center_point, nearest) / float(dim.x / 2) > visible_radius(params)) {
+            if (pos.x >= dim.x || pos.y >= dim.y) return;
+            density.write(float4(encode_cloud_density(0.0f, pos, encoding), 0, 0, 0), pos);
+            normals.write(encode_cloud_normal(float3(0, 0, 1), encoding), pos);
+            return;
+        }
+    }
+    
+    // the (side)^2 halo'd tile is filled by the tile's threads, a few texels each
+    int2 origin = int2(tile_origin) - 1;
+    int2 last = int2(dim) - 1;
+    for (uint i = local.y * CLOUD_MAP_TILE_SIZE + local.x; i < uint(side * side); i += CLOUD_MAP_TILE_SIZE * CLOUD_MAP_TILE_SIZE) {
+        int2 t = int2(i % side, i / side);
+        uint2 texel = uint2(clamp(origin + t, int2(0), last));
+        tile[t.y][t.x] = cloud_density(texel, dim, noise_table, params, base, band);
+    }
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+    
+    if (pos.x >= dim.x || pos.y >= dim.y) return;
+    
+    thread float p[3][3];
+    for (int x_offset = 0; x_offset < 3; x_offset += 1)
+        for (int y_offset = 0; y_offset < 3; y_offset += 1)
+            p[x_offset][y_offset] = tile[local.y + y_offset][local.x + x_offset];
+    
+    density.write(float4(encode_cloud_density(p[1][1], pos, encoding), 0, 0, 0), pos);
+    normals.write(encode_cloud_normal(sobel_normal(p), encoding), pos);
+}
+
+
+/**
+ Next mip level from the previous one with a separable 2x decimation filter, mirrors `MipChain::downsample`
+ */
+kernel void downsample_mip(uint2 pos                               [[ thread_position_in_grid ]],
+                           constant MipKernel& filter              [[ buffer(0) ]],
+                           texture2d<float, access::read> src      [[ texture(0) ]],
+                           texture2d<float, access::write> dst     [[ texture(1) ]])
+{
+    int2 last = int2(src.get_width(), src.get_height()) - 1;
+    int2 first = int2(pos) * 2 + 1 - int(filter.taps / 2);
+    
+    float4 sum = 0.0f;
+    for (uint j = 0; j < filter.taps; j += 1) {
+        int y = clamp(first.y + int(j), 0, last.y);
+        float4 row = 0.0f;
+        for (uint i = 0; i < filter.taps; i += 1) {
+            int x = clamp(first.x + int(i), 0, last.x);
+            row += filter.weights[i] * src.read(uint2(x, y));
+        }
+        sum += filter.weights[j] * row;
+    }
     
-    out.write(float4(normalize(n), 0.0f), pos);
+    dst.write(sum, pos);
 }
 
 
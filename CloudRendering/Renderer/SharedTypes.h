@@ -1,5 +1,8 @@
 #pragma once
 #include <simd/simd.h>
+#ifndef __METAL_VERSION__
+#include <stdint.h>
+#endif
 
 typedef struct vertex_t {
     simd_float3 position;
@@ -7,6 +10,109 @@ typedef struct vertex_t {
     simd_float3 normal;
 } Vertex;
 
+/**
+ Compact 16 byte alternative to `Vertex`, see VertexQuantization.hpp for the encoding
+ */
+typedef struct packed_vertex_t {
+    uint16_t position[3];   // unorm16 inside PackedVertexBounds
+    uint16_t padding;
+    int16_t  normal[2];     // octahedral encoding, snorm16
+    uint16_t uv[2];         // IEEE half bits
+} PackedVertex;
+
+/**
+ Dequantization range of `PackedVertex::position`
+ */
+struct PackedVertexBounds {
+    simd_float3 min;
+    simd_float3 extent;
+};
+
+/**
+ Inputs of `generate_cloud_density_map`, mirrored on the CPU by CloudNoise.hpp
+ */
+struct CloudFieldParameters {
+    uint32_t seed;                  // of the noise table
+    uint32_t octaves;
+    float    grid_size;             // texels per noise cell at the first octave
+    float    gaussian_peak;         // density shaping: gaussian(sum, peak, center, width)
+    float    gaussian_center;
+    float    gaussian_width;
+    float    fall_off_top_width;    // vignette: fully dense inside this fraction of the radius
+    float    fall_off_epsilon;      // densities the vignette hides below this are skipped, 0 evaluates every texel
+};
+
+/**
+ Side of the texel tile one `generate_cloud_maps` threadgroup computes, the threadgroup size in each dimension
+ */
+#define CLOUD_MAP_TILE_SIZE 16
+
+/**
+ Low frequency octaves `generate_cloud_maps` reads from a texture instead of evaluating them per texel:
+ the sum of the first `octaves` octaves at texels (i << shift, j << shift), bilinear in between. See CloudLayerCache.hpp
+ */
+struct CloudBaseBand {
+    uint32_t octaves;               // 0 evaluates every octave
+    uint32_t shift;                 // log2 of the spacing of its texels
+};
+
+/**
+ How `generate_cloud_maps` and friends store their results, built by CloudEncoding.hpp
+ */
+enum CloudNormalEncoding {
+    CloudNormalXYZ = 0,                 // RGBA8Snorm x, y, z
+    CloudNormalOctahedral = 1,          // RG8Snorm octahedral map
+    CloudNormalHemiOctahedral = 2,      // RG8Snorm upper hemisphere octahedral map
+};
+
+struct CloudMapEncoding {
+    float    density_dither;        // peak to peak, in density units: one unorm8 step, or 0
+    uint32_t normal_encoding;       // CloudNormalEncoding
+};
+
+/**
+ Lattice hash and gradients of the cloud noise, built from the seed by NoiseTable.hpp.
+ A corner (x, y) uses gradients[(x & 255) + permutation[y & 255]], so the noise repeats every 256 cells.
+ */
+struct CloudNoiseTable {
+    uint8_t     permutation[512];   // a shuffle of 0..255 stored twice, so y + 1 never wraps
+    simd_float2 gradients[512];     // unit gradient of permutation[i], the second hash lookup folded in
+};
+
+/**
+ Separable 2x decimation filter of one mip level, built by MipChain.hpp.
+ Output texel x reads source texels 2x + 1 - taps / 2 + i, clamped to the edge.
+ */
+struct MipKernel {
+    uint32_t taps;
+    float    weights[8];
+};
+
+/**
+ Per-frame advection of the cloud map through its velocity field, built by CloudAnimation.hpp.
+ Phase i samples the map at uv - velocity(uv) * advect[i]; the two samples are blended by weight.
+ */
+struct CloudFlowFrame {
+    float advect[2];    // seconds each phase has advected for
+    float weight[2];    // sum to 1, a phase restarts while its weight is 0
+};
+
+/**
+ Page layout of the sparse virtual cloud density map, built by CloudVirtualTexture.hpp.
+ Level l holds (virtual_size >> l)^2 texels in pages of page_size^2; a resident page fills one slot_size^2 slot
+ of the atlas, its texels surrounded by a border of one. indirection[level_offset[l] + y * pages + x] names the
+ finest resident page covering page (x, y) of level l: slot x in bits 0-11, slot y in bits 12-23, level in bits 24-31.
+ */
+#define CLOUD_VIRTUAL_MAX_LEVELS 16
+
+struct CloudVirtualLayout {
+    uint32_t virtual_size;          // texels per side of level 0
+    uint32_t page_size;
+    uint32_t slot_size;             // page_size + 2
+    uint32_t levels;
+    uint32_t level_offset[CLOUD_VIRTUAL_MAX_LEVELS];
+};
+
 struct SunParameters {
     simd_float3 position;
     float       light_intensity;
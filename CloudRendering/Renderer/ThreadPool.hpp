@@ -0,0 +1,311 @@
+// Work-stealing worker pool, parallel loops and timed task groups
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <exception>
+#include <functional>
+#include <future>
+#include <chrono>
+#include <algorithm>
+#include <ostream>
+#include <iomanip>
+
+/**
+ Work-stealing pool. Every worker owns a deque: it pushes and pops its own jobs at the back
+ and, when that runs dry, steals from the front of the others', so split work stays local
+ and idle workers take the largest, oldest pieces. Threads outside the pool share one extra deque.
+ The destructor finishes every queued job before joining.
+ */
+class ThreadPool {
+private:
+    using Job = std::function<void(size_t)>;
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;     // one per worker, then the external one
+    std::vector<std::thread> workers;
+
+    std::mutex sleep_mutex;
+    std::condition_variable job_available;
+    std::atomic<size_t> queued { 0 };
+    bool stopping = false;
+
+    static inline thread_local const ThreadPool* current_pool = nullptr;
+    static inline thread_local size_t current_worker = 0;
+
+    /** deque of the calling thread */
+    inline size_t own_queue() const { return current_pool == this ? current_worker : workers.size(); }
+
+    bool pop(size_t self, Job& job) {
+        {
+            Queue& q = *queues[self];
+            std::lock_guard lock { q.mutex };
+            if ( !q.jobs.empty() ) {
+                job = std::move(q.jobs.back());
+                q.jobs.pop_back();
+                queued -= 1;
+                return true;
+            }
+        }
+        for ( size_t i = 1; i < queues.size(); i += 1 ) {
+            Queue& victim = *queues[(self + i) % queues.size()];
+            std::lock_guard lock { victim.mutex };
+            if ( !victim.jobs.empty() ) {
+                job = std::move(victim.jobs.front());
+                victim.jobs.pop_front();
+                queued -= 1;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void work(size_t worker) {
+        current_pool = this;
+        current_worker = worker;
+        while ( true ) {
+            Job job;
+            if ( pop(worker, job) ) {
+                job(worker);
+                continue;
+            }
+            std::unique_lock lock { sleep_mutex };
+            job_available.wait(lock, [this] { return stopping || queued > 0; });
+            if ( stopping && queued == 0 ) return;
+        }
+    }
+
+public:
+    /** `thread_count` 0 uses one worker per hardware thread */
+    explicit ThreadPool(unsigned thread_count = 0) {
+        if ( thread_count == 0 ) thread_count = std::max(1u, std::thread::hardware_concurrency());
+        for ( unsigned i = 0; i <= thread_count; i += 1 )
+            queues.push_back(std::make_unique<Queue>());
+        for ( unsigned i = 0; i < thread_count; i += 1 )
+            workers.emplace_back(&ThreadPool::work, this, (size_t)i);
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard lock { sleep_mutex };
+            stopping = true;
+        }
+        job_available.notify_all();
+        for ( auto& t : workers ) t.join();
+    }
+
+    ThreadPool(ThreadPool const&) = delete;
+    ThreadPool& operator=(ThreadPool const&) = delete;
+
+    inline size_t size() const { return workers.size(); }
+
+    /**
+     Queue `job(worker_index)` on the calling thread's deque, without a future
+     */
+    void push(Job job) {
+        {
+            Queue& q = *queues[own_queue()];
+            std::lock_guard lock { q.mutex };
+            q.jobs.push_back(std::move(job));
+        }
+        {
+            std::lock_guard lock { sleep_mutex };
+            queued += 1;
+        }
+        job_available.notify_one();
+    }
+
+    /**
+     Run one queued job on the calling thread, so a thread waiting on the pool can help instead of blocking.
+     Returns false when there was nothing to run.
+     */
+    bool run_one() {
+        Job job;
+        size_t self = own_queue();
+        if ( !pop(self, job) ) return false;
+        job(self);
+        return true;
+    }
+
+    /**
+     Queue `f(worker_index)`. The future rethrows anything `f` throws.
+     */
+    template <class F>
+    std::future<void> submit(F&& f) {
+        auto task = std::make_shared<std::packaged_task<void(size_t)>>(std::forward<F>(f));
+        std::future<void> done = task->get_future();
+        push([task](size_t worker) { (*task)(worker); });
+        return done;
+    }
+};
+
+
+/**
+ Call `body(i)` for every i in [0, count) on `pool` and the calling thread, returning once all calls finished.
+ The range is halved recursively; each half pushed to the splitting thread's deque is what idle workers steal.
+ The first exception thrown by `body` is rethrown here.
+ */
+template <class F>
+void parallel_for(ThreadPool& pool, size_t count, F const& body) {
+    if ( count == 0 ) return;
+
+    struct State {
+        std::atomic<size_t> remaining;
+        std::mutex mutex;
+        std::exception_ptr error;
+        F const* body;
+    };
+    // jobs may still touch the state after the caller saw `remaining` reach 0
+    auto state = std::make_shared<State>();
+    state->remaining = count;
+    state->body = &body;
+
+    auto run_range = std::make_shared<std::function<void(size_t, size_t)>>();
+    *run_range = [&pool, state, weak = std::weak_ptr<std::function<void(size_t, size_t)>>(run_range)](size_t begin, size_t end) {
+        auto self = weak.lock();
+        while ( end - begin > 1 ) {
+            size_t middle = begin + (end - begin) / 2;
+            pool.push([self, middle, end](size_t) { (*self)(middle, end); });
+            end = middle;
+        }
+        try {
+            (*state->body)(begin);
+        } catch ( ... ) {
+            std::lock_guard lock { state->mutex };
+            if ( !state->error ) state->error = std::current_exception();
+        }
+        if ( state->remaining.fetch_sub(1) == 1 ) state->remaining.notify_all();
+    };
+
+    (*run_range)(0, count);
+    while ( true ) {
+        size_t left = state->remaining.load();
+        if ( left == 0 ) break;
+        if ( !pool.run_one() ) state->remaining.wait(left);
+    }
+
+    if ( state->error ) std::rethrow_exception(state->error);
+}
+
+/**
+ Cover a `width` x `height` rectangle with `tile_width` x `tile_height` tiles and call
+ `body(x_begin, y_begin, x_end, y_end)` for each of them through `parallel_for`
+ */
+template <class F>
+void parallel_for_2d(ThreadPool& pool, size_t width, size_t height, size_t tile_width, size_t tile_height, F const& body) {
+    if ( width == 0 || height == 0 ) return;
+    tile_width = std::max<size_t>(tile_width, 1);
+    tile_height = std::max<size_t>(tile_height, 1);
+
+    size_t tiles_x = (width + tile_width - 1) / tile_width;
+    size_t tiles_y = (height + tile_height - 1) / tile_height;
+    parallel_for(pool, tiles_x * tiles_y, [&](size_t tile) {
+        size_t x = tile % tiles_x * tile_width;
+        size_t y = tile / tiles_x * tile_height;
+        body(x, y, std::min(x + tile_width, width), std::min(y + tile_height, height));
+    });
+}
+
+
+/**
+ Wall clock span of one task, relative to the owning `TaskGroup`'s origin
+ */
+struct TaskTiming {
+    std::string name;
+    double start_milliseconds = 0.0;
+    double end_milliseconds = 0.0;
+    size_t worker = 0;
+
+    inline double milliseconds() const { return end_milliseconds - start_milliseconds; }
+};
+
+/**
+ Independent named tasks running on a `ThreadPool`, joined together with per-task timings
+ */
+class TaskGroup {
+private:
+    using clock = std::chrono::steady_clock;
+
+    ThreadPool& pool;
+    clock::time_point origin;
+    std::vector<std::future<void>> pending;
+    std::vector<TaskTiming> timings;
+    std::mutex mutex;
+
+    inline double since_origin(clock::time_point t) const {
+        return std::chrono::duration<double, std::milli>(t - origin).count();
+    }
+
+public:
+    explicit TaskGroup(ThreadPool& pool, clock::time_point origin = clock::now()) : pool(pool), origin(origin) {}
+
+    // queued tasks point back at the group
+    ~TaskGroup() {
+        for ( auto& f : pending )
+            if ( f.valid() ) f.wait();
+    }
+
+    TaskGroup(TaskGroup const&) = delete;
+    TaskGroup& operator=(TaskGroup const&) = delete;
+
+    /** start `f` on the pool */
+    template <class F>
+    void run(std::string name, F&& f) {
+        pending.push_back(pool.submit([this, name = std::move(name), f = std::forward<F>(f)](size_t worker) mutable {
+            TaskTiming timing { name, since_origin(clock::now()), 0.0, worker };
+            f();
+            timing.end_milliseconds = since_origin(clock::now());
+            std::lock_guard lock { mutex };
+            timings.push_back(std::move(timing));
+        }));
+    }
+
+    /** block until every task finished, rethrowing the first failure */
+    void wait() {
+        for ( auto& f : pending ) f.wait();
+        auto futures = std::move(pending);
+        pending.clear();
+        for ( auto& f : futures ) f.get();
+    }
+
+    /** timings of the finished tasks, ordered by start */
+    std::vector<TaskTiming> get_timings() {
+        std::lock_guard lock { mutex };
+        auto sorted = timings;
+        std::sort(sorted.begin(), sorted.end(),
+                  [](TaskTiming const& a, TaskTiming const& b) { return a.start_milliseconds < b.start_milliseconds; });
+        return sorted;
+    }
+
+    /** milliseconds since the origin */
+    inline double elapsed_milliseconds() const { return since_origin(clock::now()); }
+};
+
+/**
+ Print one line per task and mark the one finishing last, which bounds the group's wall time
+ */
+inline void print_task_timings(std::ostream& out, std::vector<TaskTiming> const& timings) {
+    if ( timings.empty() ) return;
+    auto last = std::max_element(timings.begin(), timings.end(),
+                                 [](TaskTiming const& a, TaskTiming const& b) { return a.end_milliseconds < b.end_milliseconds; });
+    double serial = 0.0;
+    for ( TaskTiming const& t : timings ) {
+        serial += t.milliseconds();
+        out << "  " << std::left << std::setw(28) << t.name << std::right << std::fixed << std::setprecision(2)
+            << std::setw(9) << t.start_milliseconds << " -> " << std::setw(9) << t.end_milliseconds
+            << " ms  (" << std::setw(8) << t.milliseconds() << " ms, worker " << t.worker << ")"
+            << (&t == &*last ? "  <- critical path" : "") << "\n";
+    }
+    out << "  " << std::fixed << std::setprecision(2) << serial << " ms of task time in "
+        << last->end_milliseconds << " ms wall" << std::endl;
+}
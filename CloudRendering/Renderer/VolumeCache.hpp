@@ -0,0 +1,162 @@
+// Binary noise volume cache (.crvol)
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <system_error>
+
+#include "MappedFile.hpp"
+#include "VolumeNoise.hpp"
+#include "ThreadPool.hpp"
+
+/**
+ On-disk layout of a .crvol file:
+
+     CRVolumeHeader
+     padding to 4096 bytes
+     uint8_t[data_size]           RGBA8 texels, x fastest then y then z
+
+ The texels start on a page so the mapping can be handed to `replaceRegion` without a copy.
+ */
+struct CRVolumeHeader {
+    static constexpr char     expected_magic[8] = { 'C', 'R', 'V', 'O', 'L', '\0', '\0', '\0' };
+    static constexpr uint32_t current_version = 1;
+    static constexpr uint64_t data_alignment = 4096;
+
+    char     magic[8];
+    uint32_t version;
+    uint32_t bytes_per_texel;
+    uint64_t parameters_key;                // VolumeNoise::key of `parameters`
+    VolumeNoise::VolumeParameters parameters;
+    uint64_t data_offset;
+    uint64_t data_size;
+};
+
+/**
+ Noise volume loaded through a .crvol cache, baked on `pool` whenever the parameters or the format change
+ */
+class CachedVolume {
+private:
+    MappedFile file;
+    const CRVolumeHeader* header = nullptr;
+    // only used when the cache could not be written
+    std::vector<uint8_t> fallback;
+
+    uint32_t volume_size = 0;
+    bool cache_hit = false;
+    double milliseconds = 0.0;
+
+    static inline uint64_t align_up(uint64_t x, uint64_t a) { return (x + a - 1) / a * a; }
+
+    static inline uint64_t data_size_of(VolumeNoise::VolumeParameters const& params) {
+        return (uint64_t)params.size * params.size * params.size * 4;
+    }
+
+    /**
+     Map `cache_path` and check it was baked from exactly `params`
+     */
+    bool open_cache(std::string const& cache_path, VolumeNoise::VolumeParameters const& params) {
+        MappedFile mapped { cache_path };
+        if ( !mapped.is_open() || mapped.size() < sizeof(CRVolumeHeader) ) return false;
+
+        auto h = reinterpret_cast<const CRVolumeHeader*>(mapped.data());
+        if ( memcmp(h->magic, CRVolumeHeader::expected_magic, sizeof(h->magic)) != 0 ||
+             h->version != CRVolumeHeader::current_version ||
+             h->bytes_per_texel != 4 ||
+             h->parameters_key != VolumeNoise::key(params) ||
+             memcmp(&h->parameters, &params, sizeof(params)) != 0 ||
+             h->data_offset % CRVolumeHeader::data_alignment != 0 ||
+             h->data_size != data_size_of(params) ||
+             h->data_offset + h->data_size > mapped.size() )
+            return false;
+
+        file = std::move(mapped);
+        header = h;
+        return true;
+    }
+
+public:
+    /**
+     Write a .crvol file. The file is written to a uniquely named file next to `cache_path` then renamed over it,
+     so a concurrent reader never maps a half written cache and concurrent writers never interleave.
+     */
+    static bool write(std::string const& cache_path, VolumeNoise::VolumeParameters const& params,
+                      std::vector<uint8_t> const& texels)
+    {
+        CRVolumeHeader h {};
+        memcpy(h.magic, CRVolumeHeader::expected_magic, sizeof(h.magic));
+        h.version = CRVolumeHeader::current_version;
+        h.bytes_per_texel = 4;
+        h.parameters_key = VolumeNoise::key(params);
+        h.parameters = params;
+        h.data_offset = align_up(sizeof(CRVolumeHeader), CRVolumeHeader::data_alignment);
+        h.data_size = texels.size();
+
+        std::error_code ec;
+        std::filesystem::create_directories(std::filesystem::path(cache_path).parent_path(), ec);
+
+        std::string tmp_path = create_temporary_beside(cache_path);
+        if ( tmp_path.empty() ) return false;
+        {
+            std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+
+            const char zeros[CRVolumeHeader::data_alignment] = {};
+            out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+            out.write(zeros, (std::streamsize)(h.data_offset - sizeof(h)));
+            out.write(reinterpret_cast<const char*>(texels.data()), (std::streamsize)texels.size());
+            out.close();
+            if ( !out ) {
+                std::filesystem::remove(tmp_path, ec);
+                return false;
+            }
+        }
+
+        std::filesystem::rename(tmp_path, cache_path, ec);
+        if ( !ec ) return true;
+        std::filesystem::remove(tmp_path, ec);
+        return false;
+    }
+
+    /**
+     Map `cache_path` if it holds the volume for `params`, otherwise bake it on `pool` and rebuild the cache
+     */
+    CachedVolume( VolumeNoise::VolumeParameters const& params, std::string const& cache_path, ThreadPool& pool ) {
+        auto start = std::chrono::steady_clock::now();
+
+        volume_size = params.size;
+        cache_hit = open_cache(cache_path, params);
+        if ( !cache_hit ) {
+            auto texels = VolumeNoise::bake(params, pool);
+            bool written = write(cache_path, params, texels);
+
+            if ( !written || !open_cache(cache_path, params) ) {
+                std::cerr << "Cannot write volume cache \"" << cache_path << "\", using baked volume" << std::endl;
+                fallback = std::move(texels);
+            }
+        }
+
+        milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    /** whether the volume came from an up to date cache without baking */
+    inline bool is_cache_hit() const { return cache_hit; }
+
+    /** wall time spent in the constructor */
+    inline double get_load_milliseconds() const { return milliseconds; }
+
+    /** texels per side */
+    inline uint32_t get_size() const { return volume_size; }
+
+    inline const uint8_t* data() const {
+        if ( header ) return reinterpret_cast<const uint8_t*>(file.data() + header->data_offset);
+        return fallback.data();
+    }
+
+    inline size_t size() const { return header ? header->data_size : fallback.size(); }
+};
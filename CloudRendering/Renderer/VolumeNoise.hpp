@@ -0,0 +1,228 @@
+// Tileable 3D Perlin-Worley noise volumes
+#pragma once
+
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+
+#include "Hash.hpp"
+#include "ThreadPool.hpp"
+
+/**
+ Periodic 3D noise for volumetric clouds, after the Perlin-Worley / Worley fBm volumes of
+ Schneider's "Real-time volumetric cloudscapes" (GPU Pro 7). Every function tiles with period 1
+ along each axis, so the baked volumes can be sampled with repeat addressing.
+ */
+namespace VolumeNoise {
+
+    enum class VolumeKind : uint32_t {
+        Shape = 0,      // R Perlin-Worley, GBA Worley fBm at 1x, 2x, 4x frequency
+        Detail = 1,     // RGB Worley fBm at 1x, 2x, 4x frequency, A = 1
+    };
+
+    /**
+     Everything a baked volume depends on. Trivially copyable and padding free, it is written verbatim into cache headers.
+     */
+    struct VolumeParameters {
+        VolumeKind kind;
+        uint32_t seed;
+        uint32_t size;                  // texels per side
+        uint32_t perlin_frequency;      // cells per tile at the first Perlin octave
+        uint32_t perlin_octaves;
+        uint32_t worley_frequency;      // cells per tile of the lowest Worley channel
+    };
+
+    constexpr VolumeParameters default_shape = { VolumeKind::Shape, 1, 128, 4, 7, 4 };
+    constexpr VolumeParameters default_detail = { VolumeKind::Detail, 1, 32, 4, 1, 2 };
+
+    inline uint64_t key(VolumeParameters const& p) {
+        return Hash::value(p);
+    }
+
+    /** uniform float in [0, 1) from a lattice point */
+    inline float lattice_random(uint32_t seed, uint32_t x, uint32_t y, uint32_t z, uint32_t channel) {
+        uint64_t h = Hash::combine(Hash::combine(Hash::combine(Hash::combine(seed, x), y), z), channel);
+        return (float)(h >> 40) * (1.0f / 16777216.0f);
+    }
+
+    inline uint32_t wrap(int64_t i, uint32_t period) {
+        int64_t m = i % (int64_t)period;
+        return (uint32_t)(m < 0 ? m + period : m);
+    }
+
+
+    /**
+     Improved Perlin noise with its lattice wrapped every `period` cells, roughly in [-1, 1]
+     */
+    class PeriodicPerlin {
+    private:
+        std::array<uint8_t, 512> permutation;
+
+        static inline float fade(float t) { return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f); }
+        static inline float lerp(float a, float b, float t) { return a + (b - a) * t; }
+
+        // one of the 12 cube edge directions, four of them repeated
+        static inline float gradient(uint8_t hash, float x, float y, float z) {
+            uint8_t h = hash & 15;
+            float u = h < 8 ? x : y;
+            float v = h < 4 ? y : (h == 12 || h == 14 ? x : z);
+            return ((h & 1) ? -u : u) + ((h & 2) ? -v : v);
+        }
+
+        inline uint8_t hash(uint32_t x, uint32_t y, uint32_t z) const {
+            return permutation[permutation[permutation[x & 255] + (y & 255)] + (z & 255)];
+        }
+
+    public:
+        explicit PeriodicPerlin(uint32_t seed) {
+            for ( uint32_t i = 0; i < 256; i += 1 ) permutation[i] = (uint8_t)i;
+            // Fisher-Yates with the lattice hash as the random source
+            for ( uint32_t i = 255; i > 0; i -= 1 ) {
+                uint32_t j = (uint32_t)(lattice_random(seed, i, 0, 0, 0xFE) * (float)(i + 1));
+                std::swap(permutation[i], permutation[std::min(j, i)]);
+            }
+            for ( uint32_t i = 0; i < 256; i += 1 ) permutation[256 + i] = permutation[i];
+        }
+
+        /** `p` in cells, lattice coordinates taken modulo `period`, which must not exceed 256 */
+        float operator()(float px, float py, float pz, uint32_t period) const {
+            float fx = std::floor(px), fy = std::floor(py), fz = std::floor(pz);
+            float x = px - fx, y = py - fy, z = pz - fz;
+            uint32_t x0 = wrap((int64_t)fx, period), x1 = wrap((int64_t)fx + 1, period);
+            uint32_t y0 = wrap((int64_t)fy, period), y1 = wrap((int64_t)fy + 1, period);
+            uint32_t z0 = wrap((int64_t)fz, period), z1 = wrap((int64_t)fz + 1, period);
+
+            float u = fade(x), v = fade(y), w = fade(z);
+            float c000 = gradient(hash(x0, y0, z0), x, y, z);
+            float c100 = gradient(hash(x1, y0, z0), x - 1, y, z);
+            float c010 = gradient(hash(x0, y1, z0), x, y - 1, z);
+            float c110 = gradient(hash(x1, y1, z0), x - 1, y - 1, z);
+            float c001 = gradient(hash(x0, y0, z1), x, y, z - 1);
+            float c101 = gradient(hash(x1, y0, z1), x - 1, y, z - 1);
+            float c011 = gradient(hash(x0, y1, z1), x, y - 1, z - 1);
+            float c111 = gradient(hash(x1, y1, z1), x - 1, y - 1, z - 1);
+
+            return lerp(lerp(lerp(c000, c100, u), lerp(c010, c110, u), v),
+                        lerp(lerp(c001, c101, u), lerp(c011, c111, u), v), w);
+        }
+
+        /** fBm over `octaves`, each doubling frequency and period so the sum still tiles, in [0, 1] */
+        float fbm(float x, float y, float z, uint32_t frequency, uint32_t octaves) const {
+            float sum = 0.0f, amplitude = 1.0f, total = 0.0f;
+            for ( uint32_t i = 0; i < octaves; i += 1 ) {
+                sum += (*this)(x * (float)frequency, y * (float)frequency, z * (float)frequency, frequency) * amplitude;
+                total += amplitude;
+                amplitude *= 0.5f;
+                frequency *= 2;
+            }
+            return std::clamp(sum / total * 0.5f + 0.5f, 0.0f, 1.0f);
+        }
+    };
+
+
+    /**
+     Cellular noise with one feature point per cell on a `frequency`^3 grid that wraps around
+     */
+    class PeriodicWorley {
+    private:
+        uint32_t frequency;
+        std::vector<float> points;      // xyz per cell, in cells
+
+    public:
+        PeriodicWorley(uint32_t seed, uint32_t frequency) : frequency(frequency), points((size_t)frequency * frequency * frequency * 3) {
+            for ( uint32_t z = 0; z < frequency; z += 1 )
+                for ( uint32_t y = 0; y < frequency; y += 1 )
+                    for ( uint32_t x = 0; x < frequency; x += 1 ) {
+                        float* p = &points[(((size_t)z * frequency + y) * frequency + x) * 3];
+                        p[0] = (float)x + lattice_random(seed ^ frequency, x, y, z, 0);
+                        p[1] = (float)y + lattice_random(seed ^ frequency, x, y, z, 1);
+                        p[2] = (float)z + lattice_random(seed ^ frequency, x, y, z, 2);
+                    }
+        }
+
+        /** 1 at a feature point, falling to 0 one cell away; (x, y, z) in [0, 1) */
+        float operator()(float x, float y, float z) const {
+            float px = x * (float)frequency, py = y * (float)frequency, pz = z * (float)frequency;
+            int64_t cx = (int64_t)std::floor(px), cy = (int64_t)std::floor(py), cz = (int64_t)std::floor(pz);
+
+            float nearest = 1e9f;
+            for ( int64_t dz = -1; dz <= 1; dz += 1 )
+                for ( int64_t dy = -1; dy <= 1; dy += 1 )
+                    for ( int64_t dx = -1; dx <= 1; dx += 1 ) {
+                        uint32_t wx = wrap(cx + dx, frequency), wy = wrap(cy + dy, frequency), wz = wrap(cz + dz, frequency);
+                        const float* p = &points[(((size_t)wz * frequency + wy) * frequency + wx) * 3];
+                        // move the wrapped point next to the sample
+                        float ox = p[0] + (float)(cx + dx - (int64_t)wx);
+                        float oy = p[1] + (float)(cy + dy - (int64_t)wy);
+                        float oz = p[2] + (float)(cz + dz - (int64_t)wz);
+                        float d = (ox - px) * (ox - px) + (oy - py) * (oy - py) + (oz - pz) * (oz - pz);
+                        nearest = std::min(nearest, d);
+                    }
+            return 1.0f - std::min(std::sqrt(nearest), 1.0f);
+        }
+    };
+
+    /** Worley fBm weights of the 1x, 2x and 4x octaves */
+    constexpr float worley_fbm_weights[3] = { 0.625f, 0.25f, 0.125f };
+
+    inline float remap(float x, float from_low, float from_high, float to_low, float to_high) {
+        return to_low + (x - from_low) / (from_high - from_low) * (to_high - to_low);
+    }
+
+    inline uint8_t to_unorm8(float x) {
+        return (uint8_t)std::lround(std::clamp(x, 0.0f, 1.0f) * 255.0f);
+    }
+
+    /**
+     Bake a `size`^3 RGBA8 volume, x fastest then y then z, one z slice per `pool` job
+     */
+    inline std::vector<uint8_t> bake(VolumeParameters const& params, ThreadPool& pool) {
+        const uint32_t n = params.size;
+        std::vector<uint8_t> texels((size_t)n * n * n * 4);
+
+        PeriodicPerlin perlin { params.seed };
+        // the three fBm channels overlap in all but their first and last octave, so each frequency is evaluated once
+        constexpr uint32_t cell_octaves = 5;
+        std::vector<PeriodicWorley> cells;
+        for ( uint32_t i = 0; i < cell_octaves; i += 1 )
+            cells.emplace_back(params.seed, params.worley_frequency << i);
+
+        parallel_for(pool, n, [&](size_t z) {
+            for ( uint32_t y = 0; y < n; y += 1 )
+                for ( uint32_t x = 0; x < n; x += 1 ) {
+                    // texel centers, so the volume tiles without a repeated edge
+                    float u = ((float)x + 0.5f) / (float)n;
+                    float v = ((float)y + 0.5f) / (float)n;
+                    float w = ((float)z + 0.5f) / (float)n;
+
+                    float cell[cell_octaves];
+                    for ( uint32_t i = 0; i < cell_octaves; i += 1 ) cell[i] = cells[i](u, v, w);
+                    auto worley_fbm = [&](uint32_t first) {
+                        return cell[first] * worley_fbm_weights[0] + cell[first + 1] * worley_fbm_weights[1] + cell[first + 2] * worley_fbm_weights[2];
+                    };
+
+                    float g = worley_fbm(0);
+                    float b = worley_fbm(1);
+                    float a = worley_fbm(2);
+                    float r = 1.0f;
+                    if ( params.kind == VolumeKind::Shape ) {
+                        // billowy Perlin, eroded towards the low frequency Worley cells
+                        float p = std::fabs(perlin.fbm(u, v, w, params.perlin_frequency, params.perlin_octaves) * 2.0f - 1.0f);
+                        r = remap(p, 0.0f, 1.0f, g, 1.0f);
+                    } else {
+                        r = g, g = b, b = a, a = 1.0f;
+                    }
+
+                    uint8_t* out = &texels[(((size_t)z * n + y) * n + x) * 4];
+                    out[0] = to_unorm8(r);
+                    out[1] = to_unorm8(g);
+                    out[2] = to_unorm8(b);
+                    out[3] = to_unorm8(a);
+                }
+        });
+        return texels;
+    }
+}
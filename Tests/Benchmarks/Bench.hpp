@@ -0,0 +1,52 @@
+// Timing helpers shared by the benchmarks
+#pragma once
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+/**
+ Benchmarks are plain executables printing one line per measurement; ctest does not run them.
+ Options are `--name value` pairs, read with `option`.
+ */
+namespace Bench {
+
+    struct Timing {
+        double min = 0.0;       // milliseconds
+        double median = 0.0;
+    };
+
+    /** run `body` `repeats` times and keep the fastest and the median wall time */
+    template <class F>
+    inline Timing measure(unsigned repeats, F&& body) {
+        std::vector<double> ms;
+        for ( unsigned i = 0; i < std::max(repeats, 1u); i += 1 ) {
+            auto start = std::chrono::steady_clock::now();
+            body();
+            ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        std::sort(ms.begin(), ms.end());
+        return { ms.front(), ms[ms.size() / 2] };
+    }
+
+    inline double option(int argc, char** argv, const char* name, double fallback) {
+        for ( int i = 1; i + 1 < argc; i += 1 )
+            if ( std::strcmp(argv[i], name) == 0 ) return std::atof(argv[i + 1]);
+        return fallback;
+    }
+
+    inline std::string option(int argc, char** argv, const char* name, std::string const& fallback) {
+        for ( int i = 1; i + 1 < argc; i += 1 )
+            if ( std::strcmp(argv[i], name) == 0 ) return argv[i + 1];
+        return fallback;
+    }
+
+    /** keep the optimizer from dropping a result */
+    template <class T>
+    inline void keep(T const& value) {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+}
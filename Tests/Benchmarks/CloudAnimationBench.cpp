@@ -0,0 +1,45 @@
+// Cost per animated frame: regenerating the density map against updating the flow and advecting the cached map
+//   CloudAnimationBench [--size 2048] [--repeats 5] [--threads <hardware concurrency>]
+#include <iostream>
+#include <iomanip>
+#include <thread>
+
+#include "Bench.hpp"
+#include "CloudAnimation.hpp"
+#include "CloudNoise.hpp"
+
+int main(int argc, char** argv) {
+    unsigned repeats = (unsigned)Bench::option(argc, argv, "--repeats", 5.0);
+    uint32_t size = (uint32_t)Bench::option(argc, argv, "--size", 2048.0);
+    unsigned threads = (unsigned)Bench::option(argc, argv, "--threads", (double)std::max(1u, std::thread::hardware_concurrency()));
+    ThreadPool pool { threads - 1 };
+
+    CloudFieldParameters params = CloudNoise::default_parameters();
+    NoiseTable::GradientTable g = NoiseTable::make_gradient_table(NoiseTable::make(params.seed));
+    std::vector<float> base((size_t)size * size), out((size_t)size * size);
+    CloudAnimation::VelocityField field { CloudAnimation::default_flow, params.seed };
+
+    auto report = [](const char* name, Bench::Timing t) {
+        std::cout << "  " << std::left << std::setw(36) << name << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(10) << t.median << " ms (min " << t.min << ")" << std::endl;
+    };
+
+    std::cout << size << "x" << size << ", " << threads << " threads" << std::endl;
+    report("brute force: regenerate the map", Bench::measure(repeats, [&] {
+        CloudNoise::generate_tiled(pool, base.data(), size, size, size, params, g);
+        Bench::keep(base[0]);
+    }));
+    double time = 0.0;
+    // all the renderer does on the CPU per frame; the GPU resamples while drawing the dome
+    report("flow: update velocities", Bench::measure(repeats, [&] {
+        field.update(time += 1.0 / 60.0);
+        Bench::keep(field.data()[0]);
+    }));
+    report("flow: update + advect on the CPU", Bench::measure(repeats, [&] {
+        field.update(time += 1.0 / 60.0);
+        CloudAnimation::advect(pool, base.data(), out.data(), size, size, size, field,
+                               CloudAnimation::flow_frame(time, CloudAnimation::default_flow.period));
+        Bench::keep(out[0]);
+    }));
+    return 0;
+}
@@ -0,0 +1,92 @@
+// Precision, memory and throughput of each cloud map storage format, on the default cloud field
+//   CloudEncodingBench [--size 2048] [--repeats 5] [--threads <hardware concurrency>]
+#include <iostream>
+#include <iomanip>
+#include <thread>
+
+#include "Bench.hpp"
+#include "CloudEncoding.hpp"
+#include "CloudNoise.hpp"
+#include "MipChain.hpp"
+
+namespace {
+
+    using CloudEncoding::DensityFormat;
+    using CloudEncoding::NormalFormat;
+
+    double megabytes(size_t bytes) { return (double)bytes / (1024.0 * 1024.0); }
+
+    /** normals of `heights` in `Encoding`, timed, against the unencoded ones */
+    template <class Encoding>
+    void normal_row(ThreadPool& pool, const char* name, std::vector<float> const& heights, uint32_t size, unsigned repeats,
+                    std::vector<NormalMap::Normal> const& exact)
+    {
+        std::vector<typename Encoding::Texel> texels((size_t)size * size);
+        Bench::Timing t = Bench::measure(repeats, [&] {
+            NormalMap::generate<Simd::f32x8, Encoding>(pool, heights.data(), size, size, size, texels.data(), size, NormalMap::Border::Clamp);
+            Bench::keep(texels[0]);
+        });
+        CloudEncoding::NormalError e = CloudEncoding::normal_error<Encoding>(exact.data(), texels.data(), texels.size());
+        std::cout << "  " << std::left << std::setw(26) << name << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(9) << t.median << " ms" << std::setw(10) << std::setprecision(3) << e.max_degrees << " deg max"
+                  << std::setw(10) << std::setprecision(4) << e.mean_degrees << " deg mean" << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    uint32_t size = (uint32_t)Bench::option(argc, argv, "--size", 2048.0);
+    unsigned repeats = (unsigned)Bench::option(argc, argv, "--repeats", 5.0);
+    unsigned threads = (unsigned)Bench::option(argc, argv, "--threads", (double)std::max(1u, std::thread::hardware_concurrency()));
+    ThreadPool pool { threads - 1 };
+    const size_t texels = (size_t)size * size;
+    const uint32_t levels = MipChain::level_count(size, size);
+
+    CloudFieldParameters params = CloudNoise::default_parameters();
+    std::vector<float> field(texels);
+    CloudNoise::generate_tiled(pool, field.data(), size, size, size, params, CloudNoise::make_gradient_table(NoiseTable::make(params.seed)));
+
+    std::cout << size << "x" << size << " default cloud field, " << threads << " threads, " << levels << " mip levels" << std::endl;
+    std::cout << "  density                   encode ms  decode ms   max error   rms error  tolerance     MB   with mips" << std::endl;
+    for ( DensityFormat format : { DensityFormat::Float32, DensityFormat::Half, DensityFormat::Unorm8 } ) {
+        std::vector<uint8_t> encoded;
+        Bench::Timing encode = Bench::measure(repeats, [&] {
+            encoded = CloudEncoding::encode_density(pool, field.data(), size, size, size, format);
+            Bench::keep(encoded[0]);
+        });
+        std::vector<float> decoded(texels);
+        Bench::Timing decode = Bench::measure(repeats, [&] {
+            CloudEncoding::decode_density(pool, encoded.data(), size, size, format, decoded.data(), size);
+            Bench::keep(decoded[0]);
+        });
+        CloudEncoding::DensityError e = CloudEncoding::density_error(field.data(), decoded.data(), texels);
+        CloudEncoding::MemoryReport one = CloudEncoding::memory(size, size, 1, 0, format, NormalFormat::XYZ8);
+        CloudEncoding::MemoryReport chain = CloudEncoding::memory(size, size, levels, 0, format, NormalFormat::XYZ8);
+        std::cout << "  " << std::left << std::setw(24) << CloudEncoding::name(format) << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(11) << encode.median << std::setw(11) << decode.median
+                  << std::scientific << std::setprecision(2) << std::setw(12) << e.max_abs_error << std::setw(12) << e.rms_error
+                  << std::setw(11) << CloudEncoding::density_tolerance(format)
+                  << std::fixed << std::setprecision(1) << std::setw(7) << megabytes(one.density_bytes)
+                  << std::setw(12) << megabytes(chain.density_bytes) << std::endl;
+    }
+
+    // Sobel normals of the field, as `generate_cloud_maps` takes them from the densities
+    std::vector<NormalMap::Normal> exact(texels);
+    NormalMap::generate<Simd::f32x8, NormalMap::Unpacked>(pool, field.data(), size, size, size, exact.data(), size, NormalMap::Border::Clamp);
+    std::cout << "  normals" << std::endl;
+    normal_row<NormalMap::XYZ8>(pool, CloudEncoding::name(NormalFormat::XYZ8), field, size, repeats, exact);
+    normal_row<NormalMap::Octahedral8>(pool, CloudEncoding::name(NormalFormat::Octahedral8), field, size, repeats, exact);
+    normal_row<NormalMap::HemiOctahedral8>(pool, CloudEncoding::name(NormalFormat::HemiOctahedral8), field, size, repeats, exact);
+
+    // both maps of every configuration, with and without their mip chains
+    std::cout << "  memory of both maps            MB   with mips   bytes/texel" << std::endl;
+    for ( DensityFormat density : { DensityFormat::Float32, DensityFormat::Half, DensityFormat::Unorm8 } )
+        for ( NormalFormat normal : { NormalFormat::XYZ8, NormalFormat::HemiOctahedral8 } ) {
+            CloudEncoding::MemoryReport one = CloudEncoding::memory(size, size, 1, 1, density, normal);
+            CloudEncoding::MemoryReport chain = CloudEncoding::memory(size, size, levels, levels, density, normal);
+            std::string name = std::string(CloudEncoding::name(density)) + " + " + (normal == NormalFormat::XYZ8 ? "RGBA8" : "RG8");
+            std::cout << "  " << std::left << std::setw(26) << name << std::right << std::fixed << std::setprecision(1)
+                      << std::setw(7) << megabytes(one.total()) << std::setw(12) << megabytes(chain.total())
+                      << std::setw(14) << (double)one.total() / (double)texels << std::endl;
+        }
+    return 0;
+}
@@ -0,0 +1,80 @@
+// Regenerating the density map through CloudLayerCache against from scratch, over a tuning session,
+// and the error and memory of each base band
+//   CloudLayerBench [--size 2048] [--threads <hardware concurrency>]
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <chrono>
+
+#include "Bench.hpp"
+#include "CloudLayerCache.hpp"
+#include "CloudFieldCache.hpp"
+
+int main(int argc, char** argv) {
+    uint32_t size = (uint32_t)Bench::option(argc, argv, "--size", 2048.0);
+    unsigned threads = (unsigned)Bench::option(argc, argv, "--threads", (double)std::max(1u, std::thread::hardware_concurrency()));
+    ThreadPool pool { threads - 1 };
+    const size_t texels = (size_t)size * size;
+
+    auto milliseconds = [](auto f) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+    auto max_error = [&](const float* a, const float* b) {
+        float worst = 0.0f;
+        for ( size_t i = 0; i < texels; i += 1 ) worst = std::max(worst, std::fabs(a[i] - b[i]));
+        return worst;
+    };
+
+    std::cout << size << "x" << size << ", " << threads << " threads" << std::endl;
+
+    struct Step { const char* name; void (*change)(CloudFieldParameters&); };
+    const Step session[] = {
+        { "initial, 8 octaves",     [](CloudFieldParameters&) {} },
+        { "gaussian width",         [](CloudFieldParameters& p) { p.gaussian_width = 0.5f; } },
+        { "gaussian center",        [](CloudFieldParameters& p) { p.gaussian_center = 0.2f; } },
+        { "fall-off top width",     [](CloudFieldParameters& p) { p.fall_off_top_width = 0.6f; } },
+        { "octaves 8 -> 10",        [](CloudFieldParameters& p) { p.octaves = 10; } },
+        { "octaves 10 -> 6",        [](CloudFieldParameters& p) { p.octaves = 6; } },
+        { "octaves 6 -> 8",         [](CloudFieldParameters& p) { p.octaves = 8; } },
+        { "seed",                   [](CloudFieldParameters& p) { p.seed += 1; } },
+    };
+
+    for ( CloudBaseBand band : { default_base_band, CloudBaseBand { 2, 1 } } ) {
+        std::cout << "  band of " << band.octaves << " octaves, shift " << band.shift << std::endl;
+        CpuCloudField full { pool };
+        CloudLayerCache<> layered { pool, band };
+        CloudFieldParameters p = CloudNoise::default_parameters();
+        for ( Step const& step : session ) {
+            step.change(p);
+            double full_ms = milliseconds([&] { full(p, size, size); });
+            size_t before = layered.get_stats().octaves_evaluated;
+            double layered_ms = milliseconds([&] { layered(p, size, size); });
+            std::cout << "    " << std::left << std::setw(22) << step.name << std::right << std::fixed << std::setprecision(1)
+                      << " full " << std::setw(7) << full_ms << " ms, layered " << std::setw(7) << layered_ms << " ms ("
+                      << layered.get_stats().octaves_evaluated - before << " octaves), max error "
+                      << std::scientific << std::setprecision(2) << max_error(full.data(), layered.data()) << std::endl;
+        }
+        std::cout << "    layers " << std::fixed << std::setprecision(1) << (double)layered.layer_bytes() / (1 << 20) << " MB" << std::endl;
+    }
+
+    // error of the bilinear band against the exact sum at the default parameters
+    std::cout << "  band error at the default parameters, max (mean)" << std::endl;
+    CloudFieldParameters p = CloudNoise::default_parameters();
+    CpuCloudField full { pool };
+    full(p, size, size);
+    for ( uint32_t octaves : { 1u, 2u, 3u, 4u } ) {
+        std::cout << "    " << octaves << " octaves:";
+        for ( uint32_t shift : { 1u, 2u, 3u } ) {
+            CloudLayerCache<> layered { pool, { octaves, shift } };
+            layered(p, size, size);
+            double mean = 0.0;
+            for ( size_t i = 0; i < texels; i += 1 ) mean += std::fabs(full.data()[i] - layered.data()[i]);
+            std::cout << "  shift " << shift << " " << std::scientific << std::setprecision(2)
+                      << max_error(full.data(), layered.data()) << " (" << mean / (double)texels << ")";
+        }
+        std::cout << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,48 @@
+// Density and normal maps in two passes against one fused pass with tile halos
+//   CloudMapsBench [--size 2048] [--repeats 3] [--threads <hardware concurrency>]
+#include <iostream>
+#include <iomanip>
+#include <thread>
+
+#include "Bench.hpp"
+#include "CloudMaps.hpp"
+
+int main(int argc, char** argv) {
+    unsigned repeats = (unsigned)Bench::option(argc, argv, "--repeats", 3.0);
+    uint32_t size = (uint32_t)Bench::option(argc, argv, "--size", 2048.0);
+    unsigned threads = (unsigned)Bench::option(argc, argv, "--threads", (double)std::max(1u, std::thread::hardware_concurrency()));
+    ThreadPool pool { threads - 1 };
+
+    CloudFieldParameters params = CloudNoise::default_parameters();
+    NoiseTable::GradientTable g = NoiseTable::make_gradient_table(NoiseTable::make(params.seed));
+    std::vector<float> density((size_t)size * size);
+    std::vector<uint32_t> normals((size_t)size * size);
+    const double texels = (double)size * size;
+
+    // map traffic outside the caches: the two-pass normal pass reads the full density map back,
+    // the fused pass only re-evaluates each tile's halo
+    auto report = [&](const char* name, Bench::Timing t, double map_bytes, double evaluated) {
+        std::cout << "  " << std::left << std::setw(22) << name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(9) << t.median << " ms" << std::setw(8) << map_bytes / (1024.0 * 1024.0) << " MB"
+                  << std::setw(9) << std::setprecision(3) << evaluated / texels << "x densities" << std::endl;
+    };
+
+    std::cout << size << "x" << size << ", " << threads << " threads, XYZ8 normals" << std::endl
+              << "  path                       time  map traffic  evaluated" << std::endl;
+    report("two pass", Bench::measure(repeats, [&] {
+        CloudMaps::generate_two_pass(pool, density.data(), normals.data(), size, size, params, g);
+        Bench::keep(normals[0]);
+    }), texels * (sizeof(float) + sizeof(float) + sizeof(uint32_t)), texels);
+
+    for ( auto [tile_width, tile_height] : { std::pair { CloudMaps::default_tile_width, CloudMaps::default_tile_height },
+                                             std::pair { 64u, 64u }, std::pair { CloudMaps::gpu_tile_size, CloudMaps::gpu_tile_size } } ) {
+        double tiles_x = std::ceil((double)size / tile_width), tiles_y = std::ceil((double)size / tile_height);
+        double evaluated = tiles_x * tiles_y * (tile_width + 2.0) * (tile_height + 2.0);
+        std::string name = "fused " + std::to_string(tile_width) + "x" + std::to_string(tile_height);
+        report(name.c_str(), Bench::measure(repeats, [&] {
+            CloudMaps::generate_fused(pool, density.data(), normals.data(), size, size, params, g, tile_width, tile_height);
+            Bench::keep(normals[0]);
+        }), texels * (sizeof(float) + sizeof(uint32_t)), evaluated);
+    }
+    return 0;
+}
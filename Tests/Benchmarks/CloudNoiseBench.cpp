@@ -0,0 +1,33 @@
+// Single thread density map throughput of the scalar reference and each SIMD width
+//   CloudNoiseBench [--size 2048] [--repeats 3]
+#include <iostream>
+#include <iomanip>
+
+#include "Bench.hpp"
+#include "CloudNoise.hpp"
+
+namespace {
+
+    template <class F>
+    void run(const char* name, uint32_t size, unsigned repeats, F const& generate) {
+        Bench::Timing t = Bench::measure(repeats, generate);
+        std::cout << "  " << std::setw(8) << name << std::setw(10) << std::fixed << std::setprecision(1) << t.median << " ms"
+                  << std::setw(10) << (double)size * size / (t.median * 1000.0) << " Mtexel/s" << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned repeats = (unsigned)Bench::option(argc, argv, "--repeats", 3.0);
+    uint32_t size = (uint32_t)Bench::option(argc, argv, "--size", 2048.0);
+
+    CloudFieldParameters params = CloudNoise::default_parameters();
+    CloudNoise::GradientTable g = CloudNoise::make_gradient_table(NoiseTable::make(params.seed));
+    std::vector<float> map((size_t)size * size);
+
+    std::cout << size << "x" << size << ", " << params.octaves << " octaves, one thread" << std::endl;
+    run("scalar", size, repeats, [&] { CloudNoise::generate_scalar(map.data(), size, size, size, params, g); Bench::keep(map[0]); });
+    run("f32x4", size, repeats, [&] { CloudNoise::generate<Simd::f32x4>(map.data(), size, size, size, params, g); Bench::keep(map[0]); });
+    run("f32x8", size, repeats, [&] { CloudNoise::generate<Simd::f32x8>(map.data(), size, size, size, params, g); Bench::keep(map[0]); });
+    run("f32x16", size, repeats, [&] { CloudNoise::generate<Simd::f32x16>(map.data(), size, size, size, params, g); Bench::keep(map[0]); });
+    return 0;
+}
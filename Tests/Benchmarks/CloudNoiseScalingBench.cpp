@@ -0,0 +1,42 @@
+// Strong scaling of tiled density map generation over thread counts and tile sizes
+//   CloudNoiseScalingBench [--size 2048] [--repeats 3] [--threads <hardware concurrency>]
+#include <iostream>
+#include <iomanip>
+#include <thread>
+
+#include "Bench.hpp"
+#include "CloudNoise.hpp"
+
+int main(int argc, char** argv) {
+    unsigned repeats = (unsigned)Bench::option(argc, argv, "--repeats", 3.0);
+    uint32_t size = (uint32_t)Bench::option(argc, argv, "--size", 2048.0);
+    unsigned max_threads = (unsigned)Bench::option(argc, argv, "--threads", (double)std::max(1u, std::thread::hardware_concurrency()));
+
+    CloudFieldParameters params = CloudNoise::default_parameters();
+    CloudNoise::GradientTable g = CloudNoise::make_gradient_table(NoiseTable::make(params.seed));
+    std::vector<float> map((size_t)size * size);
+
+    const std::pair<uint32_t, uint32_t> tiles[] = { { 64, 16 }, { 256, 16 }, { 256, 64 }, { 1024, 8 }, { size, 1 } };
+
+    std::cout << size << "x" << size << ", milliseconds (speedup over one thread)" << std::endl << "  threads";
+    for ( auto [w, h] : tiles ) std::cout << std::setw(14) << (std::to_string(w) + "x" + std::to_string(h));
+    std::cout << std::endl;
+
+    std::vector<double> single;
+    for ( unsigned threads = 1; threads <= max_threads; threads = threads < max_threads ? std::min(threads * 2, max_threads) : threads + 1 ) {
+        // the calling thread works too
+        ThreadPool pool { threads - 1 };
+        std::cout << std::setw(9) << threads;
+        for ( size_t i = 0; i < std::size(tiles); i += 1 ) {
+            Bench::Timing t = Bench::measure(repeats, [&] {
+                CloudNoise::generate_tiled(pool, map.data(), size, size, size, params, g, tiles[i].first, tiles[i].second);
+                Bench::keep(map[0]);
+            });
+            if ( threads == 1 ) single.push_back(t.median);
+            std::cout << std::setw(7) << std::fixed << std::setprecision(0) << t.median
+                      << " (" << std::setprecision(1) << single[i] / t.median << ")";
+        }
+        std::cout << std::endl;
+    }
+    return 0;
+}
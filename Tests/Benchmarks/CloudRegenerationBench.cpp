@@ -0,0 +1,50 @@
+// Latency and per-frame cost of a parameter change: regenerating the maps at once against time slicing them,
+// with and without a frame deadline
+//   CloudRegenerationBench [--size 2048] [--budget 4] [--frames 16] [--threads <hardware concurrency>]
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <chrono>
+
+#include "Bench.hpp"
+#include "CloudRegeneration.hpp"
+
+int main(int argc, char** argv) {
+    uint32_t size = (uint32_t)Bench::option(argc, argv, "--size", 2048.0);
+    double budget_ms = Bench::option(argc, argv, "--budget", 4.0);
+    uint32_t max_frames = (uint32_t)Bench::option(argc, argv, "--frames", 16.0);
+    unsigned threads = (unsigned)Bench::option(argc, argv, "--threads", (double)std::max(1u, std::thread::hardware_concurrency()));
+    ThreadPool pool { threads - 1 };
+
+    CloudFieldParameters a = CloudNoise::default_parameters(), b = a;
+    b.seed += 1;
+
+    std::cout << size << "x" << size << ", " << budget_ms << " ms per frame, " << threads << " threads" << std::endl;
+
+    auto run = [&](const char* name, CloudRegeneration::Budget budget) {
+        CloudRegeneration::CpuAmortizedCloudField<> field { pool, size, size, budget };
+        field.request(a);
+        // a first change so the slicer's estimate is warm, then the measured one
+        field.request(b);
+        while ( field.regenerating() ) field.step();
+        field.request(a);
+
+        std::vector<double> ms;
+        while ( field.regenerating() ) {
+            auto start = std::chrono::steady_clock::now();
+            field.step();
+            ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        auto s = CloudRegeneration::summarize(ms);
+        double total = 0.0;
+        for ( double m : ms ) total += m;
+        std::cout << "  " << std::left << std::setw(28) << name << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(5) << s.frames << " frames to swap, " << std::setw(9) << s.p50 << " ms p50, "
+                  << std::setw(9) << s.max << " ms max, " << std::setw(9) << total << " ms total" << std::endl;
+    };
+
+    run("at once", { 1e9, ~0u, ~0u, 1 });
+    run("time sliced, no deadline", { budget_ms, 1, ~0u, 0 });
+    run("time sliced, deadline", { budget_ms, 1, ~0u, max_frames });
+    return 0;
+}
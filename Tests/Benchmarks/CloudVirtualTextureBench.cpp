@@ -0,0 +1,70 @@
+// Virtual density map along a camera path: pages generated, hit ratio and CPU time per frame,
+// against generating the whole level 0 field
+//   CloudVirtualTextureBench [--frames 360] [--budget 32] [--threads <hardware concurrency>]
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <chrono>
+
+#include "Bench.hpp"
+#include "Camera.hpp"
+#include "CloudVirtualTexture.hpp"
+#include "DomeGenerator.hpp"
+
+int main(int argc, char** argv) {
+    unsigned frames = (unsigned)Bench::option(argc, argv, "--frames", 360.0);
+    size_t budget = (size_t)Bench::option(argc, argv, "--budget", 32.0);
+    unsigned threads = (unsigned)Bench::option(argc, argv, "--threads", (double)std::max(1u, std::thread::hardware_concurrency()));
+    ThreadPool pool { threads - 1 };
+
+    const VirtualTexture::Config config = VirtualTexture::default_config;
+    CloudFieldParameters params = VirtualTexture::virtual_parameters(CloudNoise::default_parameters(), 2048, config.virtual_size);
+    Mesh dome = DomeGenerator::uv_sphere(64, 128);
+    const float width = 1920.f, height = 1080.f;
+
+    std::cout << config.virtual_size << "^2 virtual texels, " << config.slots_x * config.slots_y << " slots of "
+              << config.page_size << "^2, budget " << budget << " pages per frame, " << threads << " threads" << std::endl;
+
+    auto run = [&](const char* name, auto view) {
+        VirtualTexture::VirtualCloudField field { config, params };
+        VirtualTexture::Feedback fb;
+        std::vector<double> ms;
+        for ( unsigned f = 0; f < frames; f += 1 ) {
+            auto [pitch, yaw] = view(f);
+            auto start = std::chrono::steady_clock::now();
+            auto const& pages = fb.collect(dome.vertices.data(), dome.indices.data(), dome.indices.size(),
+                                           Camera::skydome_clip(pitch, yaw, 100.f, width / height), width, height, field.get_layout());
+            field.update(pages, pool, budget);
+            ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        std::sort(ms.begin(), ms.end());
+        auto const& total = field.get_total_stats();
+        std::cout << "  " << std::left << std::setw(22) << name << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(9) << ms[ms.size() / 2] << " ms median, " << std::setw(8) << ms[ms.size() * 99 / 100] << " ms p99, "
+                  << std::setprecision(1) << std::setw(5) << (double)total.misses / frames << " pages/frame, hit ratio "
+                  << std::setprecision(3) << total.hit_ratio() << ", " << total.evictions << " evictions" << std::endl;
+    };
+
+    run("held view", [](unsigned) { return std::pair { 45.f, 90.f }; });
+    run("pan 1 deg/frame", [](unsigned f) { return std::pair { 30.f, (float)f }; });
+    run("pan 5 deg/frame", [](unsigned f) { return std::pair { 30.f, 5.f * (float)f }; });
+    run("tilt and pan", [](unsigned f) { return std::pair { 10.f + 70.f * (0.5f + 0.5f * std::sin(0.05f * (float)f)), 2.f * (float)f }; });
+
+    // the atlas against a fully resident level 0
+    size_t resident = (size_t)config.slots_x * config.slots_y * (config.page_size + 2) * (config.page_size + 2);
+    std::cout << "  resident texels " << resident << " against " << (size_t)config.virtual_size * config.virtual_size
+              << " for the full level 0 (" << std::setprecision(1)
+              << 100.0 * (double)resident / ((double)config.virtual_size * config.virtual_size) << "%)" << std::endl;
+
+    std::vector<float> row((size_t)config.virtual_size * config.page_size);
+    auto g = CloudNoise::make_gradient_table(NoiseTable::make(params.seed));
+    Bench::Timing strip = Bench::measure(1, [&] {
+        // the default parameters trim nothing, so the first rows cost what any others do
+        CloudNoise::generate_region(row.data(), config.virtual_size, config.virtual_size, config.virtual_size,
+                                    0, 0, config.virtual_size, config.page_size, params, g);
+        Bench::keep(row[0]);
+    });
+    std::cout << "  full level 0, estimated from one row of pages: " << std::setprecision(0)
+              << strip.median * (config.virtual_size / config.page_size) << " ms on one thread" << std::endl;
+    return 0;
+}
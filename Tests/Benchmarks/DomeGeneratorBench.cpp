@@ -0,0 +1,40 @@
+// Skydome generation time against loading the asset
+//   DomeGeneratorBench [--repeats 10]
+#include <iostream>
+#include <iomanip>
+
+#include "Bench.hpp"
+#include "Test.hpp"
+#include "DomeGenerator.hpp"
+#include "MeshCache.hpp"
+
+int main(int argc, char** argv) {
+    unsigned repeats = (unsigned)Bench::option(argc, argv, "--repeats", 10.0);
+
+    auto report = [](std::string const& name, size_t triangles, Bench::Timing t) {
+        std::cout << "  " << std::left << std::setw(26) << name << std::right << std::setw(8) << triangles << " tris"
+                  << std::fixed << std::setprecision(3) << std::setw(10) << t.median << " ms" << std::endl;
+    };
+
+    std::string path = Test::asset("hemisphere.obj");
+    size_t asset_triangles = 0;
+    Bench::Timing stream = Bench::measure(repeats, [&] { ObjLoader m { path, ObjParseMode::Stream }; asset_triangles = m.get_indices_count() / 3; });
+    report("hemisphere.obj stream", asset_triangles, stream);
+    report("hemisphere.obj mapped", asset_triangles, Bench::measure(repeats, [&] { ObjLoader m { path }; Bench::keep(m.get_indices_count()); }));
+
+    Test::ScratchDirectory dir { "domebench" };
+    { CachedMesh warm_up { path, dir.file("hemisphere.crmesh") }; }
+    report("hemisphere.crmesh warm", asset_triangles, Bench::measure(repeats, [&] { CachedMesh m { path, dir.file("hemisphere.crmesh") }; Bench::keep(m.get_indices_count()); }));
+
+    for ( auto [rings, segments] : { std::pair { 31u, 32u }, std::pair { 62u, 64u }, std::pair { 124u, 128u }, std::pair { 248u, 256u } } ) {
+        size_t triangles = 0;
+        Bench::Timing t = Bench::measure(repeats, [&] { Mesh m = DomeGenerator::uv_sphere(rings, segments); triangles = m.indices.size() / 3; });
+        report("uv sphere " + std::to_string(rings) + "x" + std::to_string(segments), triangles, t);
+    }
+    for ( uint32_t level : { 4u, 5u, 6u, 7u } ) {
+        size_t triangles = 0;
+        Bench::Timing t = Bench::measure(repeats, [&] { Mesh m = DomeGenerator::geodesic(level); triangles = m.indices.size() / 3; });
+        report("geodesic level " + std::to_string(level), triangles, t);
+    }
+    return 0;
+}
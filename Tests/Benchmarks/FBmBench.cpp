@@ -0,0 +1,45 @@
+// Throughput of each compile-time fBm instantiation against the runtime octave loop
+//   FBmBench [--size 1024] [--repeats 3]
+#include <iostream>
+#include <iomanip>
+
+#include "Bench.hpp"
+#include "FBm.hpp"
+
+namespace {
+
+    template <class Basis>
+    void run(const char* basis, uint32_t size, unsigned repeats, NoiseTable::GradientTable const& g) {
+        std::vector<float> map((size_t)size * size);
+        auto mtexels = [&](auto const& fbm) {
+            Bench::Timing t = Bench::measure(repeats, [&] {
+                Fractal::generate_region(fbm, map.data(), size, 0, 0, size, size, 128.0f, g);
+                Bench::keep(map[0]);
+            });
+            return (double)size * size / (t.median * 1000.0);
+        };
+
+        [&]<uint32_t... N>(std::integer_sequence<uint32_t, N...>) {
+            ([&] {
+                double fixed = mtexels(Fractal::FBm<Basis, N + 1> {});
+                double dynamic = mtexels(Fractal::DynamicFBm<Basis> { N + 1, 2.0f, 0.5f });
+                std::cout << "  " << std::left << std::setw(8) << basis << std::right << std::setw(3) << N + 1
+                          << std::fixed << std::setprecision(1) << std::setw(11) << fixed << std::setw(11) << dynamic
+                          << std::setw(9) << std::setprecision(2) << fixed / dynamic << "x" << std::endl;
+            }(), ...);
+        }(std::make_integer_sequence<uint32_t, Fractal::max_instantiated_octaves> {});
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned repeats = (unsigned)Bench::option(argc, argv, "--repeats", 3.0);
+    uint32_t size = (uint32_t)Bench::option(argc, argv, "--size", 1024.0);
+    NoiseTable::GradientTable g = NoiseTable::make_gradient_table(NoiseTable::make(1));
+
+    std::cout << size << "x" << size << ", f32x8, one thread, Mtexel/s" << std::endl
+              << "  basis   octaves   FBm<>  DynamicFBm  speedup" << std::endl;
+    run<Fractal::Perlin>("perlin", size, repeats, g);
+    run<Fractal::Simplex>("simplex", size, repeats, g);
+    run<Fractal::Value>("value", size, repeats, g);
+    return 0;
+}
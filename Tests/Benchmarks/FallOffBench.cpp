@@ -0,0 +1,65 @@
+// What the fall-off epsilon trims: texels written as 0, octaves left out, the time it saves and the error it costs,
+// for several vignette widths
+//   FallOffBench [--size 2048] [--repeats 3] [--threads <hardware concurrency>]
+#include <iostream>
+#include <iomanip>
+#include <thread>
+
+#include "Bench.hpp"
+#include "CloudNoise.hpp"
+
+int main(int argc, char** argv) {
+    uint32_t size = (uint32_t)Bench::option(argc, argv, "--size", 2048.0);
+    unsigned repeats = (unsigned)Bench::option(argc, argv, "--repeats", 3.0);
+    unsigned threads = (unsigned)Bench::option(argc, argv, "--threads", (double)std::max(1u, std::thread::hardware_concurrency()));
+    ThreadPool pool { threads - 1 };
+
+    CloudFieldParameters base = CloudNoise::default_parameters();
+    NoiseTable::GradientTable g = NoiseTable::make_gradient_table(NoiseTable::make(base.seed));
+    std::vector<float> exact((size_t)size * size), trimmed((size_t)size * size);
+
+    std::cout << size << "x" << size << ", " << base.octaves << " octaves, " << threads << " threads" << std::endl;
+    std::cout << "  top width  epsilon   texels skipped  octaves skipped        ms    speedup  max error" << std::endl;
+
+    for ( float top_width : { 0.5f, 0.8f, 0.95f } ) {
+        CloudFieldParameters params = base;
+        params.fall_off_top_width = top_width;
+        params.fall_off_epsilon = 0.0f;
+        Bench::Timing reference = Bench::measure(repeats, [&] {
+            CloudNoise::generate_tiled(pool, exact.data(), size, size, size, params, g);
+            Bench::keep(exact[0]);
+        });
+
+        for ( float epsilon : { 0.0f, 1.0f / 4096.0f, 1.0f / 1024.0f, 1.0f / 256.0f } ) {
+            params.fall_off_epsilon = epsilon;
+
+            // as the scalar reference counts them, per texel
+            uint64_t texels = 0, octaves = 0;
+            for ( uint32_t y = 0; y < size; y += 1 ) {
+                auto [first, last] = CloudNoise::visible_span(y, size, size, params);
+                texels += last - first;
+                for ( uint32_t x = first; x < last; x += 1 ) {
+                    float dx = (float)size / 2.f - (float)x, dy = (float)size / 2.f - (float)y;
+                    float f = CloudNoise::fall_off(std::sqrt(dx * dx + dy * dy) / (float)(size / 2), top_width);
+                    octaves += CloudNoise::visible_octaves(f, params);
+                }
+            }
+            const double all = (double)size * size;
+
+            Bench::Timing t = Bench::measure(repeats, [&] {
+                CloudNoise::generate_tiled(pool, trimmed.data(), size, size, size, params, g);
+                Bench::keep(trimmed[0]);
+            });
+            auto c = CloudNoise::compare(exact.data(), size, trimmed.data(), size, size, size);
+
+            std::cout << std::fixed << "  " << std::setprecision(2) << std::setw(9) << top_width
+                      << std::setprecision(6) << std::setw(10) << epsilon
+                      << std::setprecision(1) << std::setw(15) << 100.0 * (1.0 - (double)texels / all) << "%"
+                      << std::setw(16) << 100.0 * (1.0 - (double)octaves / (all * params.octaves)) << "%"
+                      << std::setprecision(2) << std::setw(10) << t.median
+                      << std::setw(10) << reference.median / t.median << "x"
+                      << std::scientific << std::setprecision(2) << std::setw(11) << c.max_abs_error << std::endl;
+        }
+    }
+    return 0;
+}
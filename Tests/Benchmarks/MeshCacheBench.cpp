@@ -0,0 +1,44 @@
+// Skydome mesh startup: OBJ parse, cold .crmesh build, warm .crmesh map
+//   MeshCacheBench [--repeats 10] [--obj path]
+#include <iostream>
+#include <iomanip>
+#include <filesystem>
+
+#include "Bench.hpp"
+#include "Test.hpp"
+#include "MeshCache.hpp"
+
+int main(int argc, char** argv) {
+    unsigned repeats = (unsigned)Bench::option(argc, argv, "--repeats", 10.0);
+    std::string obj = Bench::option(argc, argv, "--obj", Test::asset("hemisphere.obj"));
+
+    Test::ScratchDirectory dir { "crmeshbench" };
+    std::string cache = dir.file("mesh.crmesh");
+
+    auto report = [](const char* name, Bench::Timing t) {
+        std::cout << "  " << std::left << std::setw(22) << name << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(10) << t.median << " ms (min " << t.min << ")" << std::endl;
+    };
+
+    std::cout << obj << std::endl;
+    report("parse (mapped)", Bench::measure(repeats, [&] {
+        ObjLoader mesh { obj };
+        Bench::keep(mesh.get_indices_count());
+    }));
+    report("cold: parse + write", Bench::measure(repeats, [&] {
+        std::filesystem::remove(cache);
+        CachedMesh mesh { obj, cache };
+        Bench::keep(mesh.get_indices_count());
+    }));
+    // a warm start maps the file and hands the pages to newBuffer, which reads them once
+    report("warm: map + read", Bench::measure(repeats, [&] {
+        CachedMesh mesh { obj, cache };
+        uint64_t sum = Hash::bytes(mesh.get_vertices_data(), mesh.get_vertices_data_size());
+        Bench::keep(sum);
+    }));
+    report("warm: map only", Bench::measure(repeats, [&] {
+        CachedMesh mesh { obj, cache };
+        Bench::keep(mesh.get_indices_count());
+    }));
+    return 0;
+}
@@ -0,0 +1,49 @@
+// ACMR and ATVR of the skydome index buffers before and after reordering, for a 16 and a 32 entry FIFO cache
+//   MeshOptimizerBench [--obj path]
+#include <iostream>
+#include <iomanip>
+
+#include "Bench.hpp"
+#include "Test.hpp"
+#include "MeshOptimizer.hpp"
+#include "MeshSimplifier.hpp"
+#include "DomeGenerator.hpp"
+#include "ObjLoader.hpp"
+
+namespace {
+
+    void report(const char* name, std::vector<uint32_t> indices, size_t vertex_count) {
+        auto stats = [&](size_t cache) { return MeshOptimizer::simulate_fifo_cache(indices.data(), indices.size(), vertex_count, cache); };
+        auto b16 = stats(16), b32 = stats(32);
+        Bench::Timing t = Bench::measure(1, [&] { MeshOptimizer::optimize_vertex_cache(indices.data(), indices.size(), vertex_count); });
+        auto a16 = stats(16), a32 = stats(32);
+
+        std::cout << "  " << std::left << std::setw(16) << name << std::right << std::setw(8) << indices.size() / 3 << " tris"
+                  << std::fixed << std::setprecision(3)
+                  << "   ACMR16 " << b16.acmr() << " -> " << a16.acmr() << "   ACMR32 " << b32.acmr() << " -> " << a32.acmr()
+                  << "   ATVR16 " << b16.atvr() << " -> " << a16.atvr()
+                  << std::setprecision(1) << "   " << t.min << " ms" << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string path = Bench::option(argc, argv, "--obj", Test::asset("hemisphere.obj"));
+    ObjLoader obj { path };
+    report("hemisphere.obj", std::vector<uint32_t>(obj.get_indices_data(), obj.get_indices_data() + obj.get_indices_count()),
+           obj.get_vertices_count());
+
+    Mesh dome = DomeGenerator::uv_sphere(124, 128);
+    report("uv sphere", dome.indices, dome.vertices.size());
+    Mesh geodesic = DomeGenerator::geodesic(6);
+    report("geodesic", geodesic.indices, geodesic.vertices.size());
+
+    std::vector<uint32_t> indices;
+    auto lods = MeshSimplifier::build_lod_chain(dome, 6, 0.5f, indices);
+    for ( size_t level = 1; level < lods.size(); level += 1 ) {
+        std::string name = "uv sphere lod " + std::to_string(level);
+        report(name.c_str(), std::vector<uint32_t>(indices.begin() + lods[level].index_offset,
+                                                   indices.begin() + lods[level].index_offset + lods[level].index_count),
+               dome.vertices.size());
+    }
+    return 0;
+}
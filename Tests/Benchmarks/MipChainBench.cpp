@@ -0,0 +1,98 @@
+// Mip chain build time, and what the chain buys the skydome sampler: texture lines touched and error
+// against a gaussian prefiltered reference, for isotropic footprints of 4, 8 and 16 texels
+//   MipChainBench [--size 2048] [--repeats 3] [--threads <hardware concurrency>]
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <unordered_set>
+
+#include "Bench.hpp"
+#include "MipChain.hpp"
+#include "CloudNoise.hpp"
+
+namespace {
+
+    /**
+     Bilinear sample of level `i` that also records the 64 byte lines it reads
+     */
+    float sample_recording(MipChain::Pyramid const& p, size_t i, float u, float v, std::unordered_set<uint64_t>& lines) {
+        MipChain::Level const& l = p.get_level(i);
+        float x = std::clamp(u * (float)l.width - 0.5f, 0.0f, (float)(l.width - 1));
+        float y = std::clamp(v * (float)l.height - 0.5f, 0.0f, (float)(l.height - 1));
+        uint32_t x0 = (uint32_t)x, y0 = (uint32_t)y;
+        for ( uint32_t ty : { y0, std::min(y0 + 1, l.height - 1) } )
+            for ( uint32_t tx : { x0, std::min(x0 + 1, l.width - 1) } )
+                lines.insert((l.offset + (size_t)ty * l.width + tx) * sizeof(float) / 64);
+        return MipChain::sample_bilinear(p, i, u, v);
+    }
+
+    float sample_trilinear_recording(MipChain::Pyramid const& p, float u, float v, float lod, std::unordered_set<uint64_t>& lines) {
+        float l = std::clamp(lod, 0.0f, (float)(p.get_level_count() - 1));
+        size_t i = (size_t)l;
+        float f = l - (float)i;
+        float a = sample_recording(p, i, u, v, lines);
+        if ( f == 0.0f || i + 1 >= p.get_level_count() ) return a;
+        return a + (sample_recording(p, i + 1, u, v, lines) - a) * f;
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned repeats = (unsigned)Bench::option(argc, argv, "--repeats", 3.0);
+    uint32_t size = (uint32_t)Bench::option(argc, argv, "--size", 2048.0);
+    unsigned threads = (unsigned)Bench::option(argc, argv, "--threads", (double)std::max(1u, std::thread::hardware_concurrency()));
+    ThreadPool pool { threads - 1 };
+
+    CloudFieldParameters params = CloudNoise::default_parameters();
+    CloudNoise::GradientTable g = CloudNoise::make_gradient_table(NoiseTable::make(params.seed));
+    std::vector<float> map((size_t)size * size);
+    CloudNoise::generate_tiled(pool, map.data(), size, size, size, params, g);
+
+    const std::pair<MipChain::Filter, const char*> filters[] = {
+        { MipChain::Filter::None, "no mips" }, { MipChain::Filter::Box, "box" }, { MipChain::Filter::Kaiser, "kaiser" } };
+
+    std::cout << size << "x" << size << " density map, " << threads << " threads" << std::endl << "  build" << std::endl;
+    for ( auto [filter, name] : filters ) {
+        size_t bytes = 0;
+        Bench::Timing t = Bench::measure(repeats, [&] {
+            MipChain::Pyramid p { map.data(), size, size, size, filter, pool };
+            bytes = p.size_bytes();
+        });
+        std::cout << "    " << std::left << std::setw(8) << name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(8) << t.median << " ms" << std::setw(8) << (double)bytes / (1024.0 * 1024.0) << " MB" << std::endl;
+    }
+
+    std::cout << "  sampling at random points: distinct 64 B lines read, RMSE against a gaussian prefilter of the footprint" << std::endl;
+    for ( uint32_t footprint : { 4u, 8u, 16u } ) {
+        // sigma of half the footprint, over a window of twice the footprint
+        const int radius = (int)footprint;
+        const double sigma = 0.5 * footprint;
+        std::cout << "    " << std::setw(2) << footprint << "x" << std::setw(2) << std::left << footprint << std::right;
+        for ( auto [filter, name] : filters ) {
+            MipChain::Pyramid p { map.data(), size, size, size, filter, pool };
+            std::unordered_set<uint64_t> lines;
+            std::mt19937 rng { footprint };
+            std::uniform_real_distribution<float> coordinate { (float)radius, (float)(size - radius) };
+            double squared = 0.0;
+            const size_t samples = (size_t)size * size / ((size_t)footprint * footprint);
+            for ( size_t s = 0; s < samples; s += 1 ) {
+                float px = coordinate(rng), py = coordinate(rng);
+                double reference = 0.0, weight = 0.0;
+                for ( int j = -radius; j <= radius; j += 1 )
+                    for ( int i = -radius; i <= radius; i += 1 ) {
+                        int tx = (int)std::floor(px) + i, ty = (int)std::floor(py) + j;
+                        double dx = tx + 0.5 - px, dy = ty + 0.5 - py;
+                        double w = std::exp(-(dx * dx + dy * dy) / (2.0 * sigma * sigma));
+                        reference += w * map[(size_t)ty * size + tx];
+                        weight += w;
+                    }
+                double e = sample_trilinear_recording(p, px / (float)size, py / (float)size, std::log2((float)footprint), lines)
+                         - reference / weight;
+                squared += e * e;
+            }
+            std::cout << "   " << std::setw(7) << name << std::setw(9) << lines.size() << std::setw(9) << std::setprecision(5)
+                      << std::sqrt(squared / (double)samples);
+        }
+        std::cout << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,69 @@
+// Per texel cost of the density kernel's lattice hashing: the original (x * 8 + y) % 128 angle hash with cos and sin
+// at every corner, against the permutation and gradient table
+//   NoiseTableBench [--size 2048] [--repeats 3]
+#include <iostream>
+#include <iomanip>
+
+#include "Bench.hpp"
+#include "CloudNoise.hpp"
+
+namespace {
+
+    /** the shader's noise before NoiseTable, as it was in Shaders.metal */
+    namespace Original {
+        inline simd::float2 gradient(uint32_t x, uint32_t y, const float* angles) {
+            float theta = angles[(x * 8 + y) % 128];
+            return simd::make_float2(std::cos(theta), std::sin(theta));
+        }
+
+        inline float perlin_2D(float px, float py, const float* angles) {
+            const float grid_size = 128.f;
+            uint32_t left = (uint32_t)std::floor(px / grid_size), top = (uint32_t)std::floor(py / grid_size);
+            simd::float2 aa = gradient(left, top, angles), ab = gradient(left + 1, top, angles);
+            simd::float2 ba = gradient(left, top + 1, angles), bb = gradient(left + 1, top + 1, angles);
+            float x = std::fmod(px, grid_size) / grid_size, y = std::fmod(py, grid_size) / grid_size;
+            float top_row = CloudNoise::mix(aa.x * x + aa.y * y, ab.x * (x - 1.f) + ab.y * y, CloudNoise::fade(x));
+            float bottom_row = CloudNoise::mix(ba.x * x + ba.y * (y - 1.f), bb.x * (x - 1.f) + bb.y * (y - 1.f), CloudNoise::fade(x));
+            return CloudNoise::mix(top_row, bottom_row, CloudNoise::fade(y));
+        }
+    }
+
+    template <class F>
+    void run(const char* name, uint32_t size, unsigned repeats, F const& octave_sum) {
+        Bench::Timing t = Bench::measure(repeats, [&] {
+            float total = 0.0f;
+            for ( uint32_t y = 0; y < size; y += 1 )
+                for ( uint32_t x = 0; x < size; x += 1 ) total += octave_sum((float)x + 0.5f, (float)y + 0.5f);
+            Bench::keep(total);
+        });
+        std::cout << "  " << std::left << std::setw(26) << name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(9) << t.median << " ms" << std::setw(8) << (double)size * size / (t.median * 1000.0) << " Mtexel/s"
+                  << std::setw(8) << t.median * 1e6 / ((double)size * size) << " ns/texel" << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned repeats = (unsigned)Bench::option(argc, argv, "--repeats", 3.0);
+    uint32_t size = (uint32_t)Bench::option(argc, argv, "--size", 2048.0);
+
+    std::mt19937 rng { 1 };
+    std::uniform_real_distribution<float> angle { 0.0f, 2.0f * std::numbers::pi_v<float> };
+    float angles[128];
+    for ( float& a : angles ) a = angle(rng);
+    CloudNoise::GradientTable g = CloudNoise::make_gradient_table(NoiseTable::make(1));
+
+    std::cout << size << "x" << size << ", 8 octaves, scalar, one thread" << std::endl;
+    run("angle hash + cos/sin", size, repeats, [&](float x, float y) {
+        float sum = 0.0f, frequency = 1.0f, amplitude = 1.0f;
+        for ( int i = 0; i < 8; i += 1, amplitude *= 0.5f, frequency *= 2.0f )
+            sum += Original::perlin_2D(x * frequency, y * frequency, angles) * amplitude;
+        return sum;
+    });
+    run("permutation table", size, repeats, [&](float x, float y) {
+        float sum = 0.0f, frequency = 1.0f, amplitude = 1.0f;
+        for ( int i = 0; i < 8; i += 1, amplitude *= 0.5f, frequency *= 2.0f )
+            sum += CloudNoise::perlin_2D(x * frequency, y * frequency, 128.f, g) * amplitude;
+        return sum;
+    });
+    return 0;
+}
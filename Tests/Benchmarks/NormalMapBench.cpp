@@ -0,0 +1,56 @@
+// Sobel normal map throughput: the naive 3x3 reference against the separable SIMD path at each width and encoding
+//   NormalMapBench [--size 2048] [--repeats 5]
+#include <iostream>
+#include <iomanip>
+#include <random>
+
+#include "Bench.hpp"
+#include "NormalMap.hpp"
+
+namespace {
+
+    template <class F>
+    void run(const char* name, uint32_t size, unsigned repeats, F const& body) {
+        Bench::Timing t = Bench::measure(repeats, body);
+        std::cout << "  " << std::left << std::setw(26) << name << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(9) << t.median << " ms" << std::setw(8) << std::setprecision(3)
+                  << (double)size * size / (t.median * 1e6) << " Gtexel/s" << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned repeats = (unsigned)Bench::option(argc, argv, "--repeats", 5.0);
+    uint32_t size = (uint32_t)Bench::option(argc, argv, "--size", 2048.0);
+
+    std::mt19937 rng { 1 };
+    std::uniform_real_distribution<float> value { 0.0f, 1.0f };
+    std::vector<float> heights((size_t)size * size);
+    for ( float& h : heights ) h = value(rng);
+    std::vector<uint32_t> xyz((size_t)size * size);
+    std::vector<uint16_t> rg((size_t)size * size);
+    const auto clamp = NormalMap::Border::Clamp;
+
+    std::cout << size << "x" << size << ", one thread" << std::endl;
+    run("naive, XYZ8", size, repeats, [&] { NormalMap::reference(heights.data(), size, size, size, xyz.data(), size, clamp); Bench::keep(xyz[0]); });
+    run("f32x4, XYZ8", size, repeats, [&] {
+        NormalMap::generate_region<Simd::f32x4>(heights.data(), size, size, size, xyz.data(), size, 0, 0, size, size, clamp);
+        Bench::keep(xyz[0]);
+    });
+    run("f32x8, XYZ8", size, repeats, [&] {
+        NormalMap::generate_region<Simd::f32x8>(heights.data(), size, size, size, xyz.data(), size, 0, 0, size, size, clamp);
+        Bench::keep(xyz[0]);
+    });
+    run("f32x16, XYZ8", size, repeats, [&] {
+        NormalMap::generate_region<Simd::f32x16>(heights.data(), size, size, size, xyz.data(), size, 0, 0, size, size, clamp);
+        Bench::keep(xyz[0]);
+    });
+    run("f32x16, Octahedral8", size, repeats, [&] {
+        NormalMap::generate_region<Simd::f32x16, NormalMap::Octahedral8>(heights.data(), size, size, size, rg.data(), size, 0, 0, size, size, clamp);
+        Bench::keep(rg[0]);
+    });
+    run("f32x16, HemiOctahedral8", size, repeats, [&] {
+        NormalMap::generate_region<Simd::f32x16, NormalMap::HemiOctahedral8>(heights.data(), size, size, size, rg.data(), size, 0, 0, size, size, clamp);
+        Bench::keep(rg[0]);
+    });
+    return 0;
+}
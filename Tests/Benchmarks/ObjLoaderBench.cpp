@@ -0,0 +1,51 @@
+// Throughput of the Stream, Mapped and Welded OBJ parsing modes, and how much welding deduplicates
+//   ObjLoaderBench [--triangles 10000000] [--repeats 3] [--obj path]
+#include <iostream>
+#include <iomanip>
+#include <filesystem>
+
+#include "Bench.hpp"
+#include "SyntheticObj.hpp"
+#include "Test.hpp"
+#include "ObjLoader.hpp"
+
+namespace {
+
+    void run(std::string path, const char* label, unsigned repeats) {
+        size_t bytes = (size_t)std::filesystem::file_size(path);
+        std::cout << label << " (" << std::fixed << std::setprecision(1) << (double)bytes / (1024.0 * 1024.0) << " MB)" << std::endl;
+
+        for ( auto [mode, name] : { std::pair { ObjParseMode::Stream, "stream" }, std::pair { ObjParseMode::Mapped, "mapped" },
+                                    std::pair { ObjParseMode::Welded, "welded" } } ) {
+            ObjWeldStats weld;
+            Bench::Timing t = Bench::measure(repeats, [&] {
+                ObjLoader loader { path, mode };
+                Bench::keep(loader.get_indices_count());
+                weld = loader.get_weld_stats();
+            });
+            std::cout << "  " << std::setw(8) << name << std::setw(10) << std::setprecision(1) << t.median << " ms"
+                      << std::setw(9) << std::setprecision(0) << (double)bytes / (1024.0 * 1024.0) / (t.median / 1000.0) << " MB/s";
+            // the weld itself, after the attributes were parsed: the last repeat's
+            if ( mode == ObjParseMode::Welded )
+                std::cout << ", " << weld.corners << " corners to " << weld.unique_vertices << " vertices, dedup "
+                          << std::setprecision(2) << weld.dedup_ratio() << "x, " << weld.average_probe_length() << " probes per corner, "
+                          << std::setprecision(1) << weld.million_corners_per_second() << " M corners/s";
+            std::cout << std::endl;
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned repeats = (unsigned)Bench::option(argc, argv, "--repeats", 3.0);
+    size_t triangles = (size_t)Bench::option(argc, argv, "--triangles", 10e6);
+
+    run(Bench::option(argc, argv, "--obj", Test::asset("hemisphere.obj")), "hemisphere.obj", repeats);
+
+    if ( triangles > 0 ) {
+        Test::ScratchDirectory dir { "objbench" };
+        std::string path = dir.file("synthetic.obj");
+        SyntheticObj::write_grid(path, triangles);
+        run(path, "synthetic grid", repeats);
+    }
+    return 0;
+}
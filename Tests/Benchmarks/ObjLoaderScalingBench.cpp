@@ -0,0 +1,44 @@
+// Strong scaling of ObjParseMode::Parallel over thread counts
+//   ObjLoaderScalingBench [--triangles 10000000] [--threads hardware] [--repeats 3] [--obj path]
+#include <iostream>
+#include <iomanip>
+#include <filesystem>
+#include <thread>
+
+#include "Bench.hpp"
+#include "SyntheticObj.hpp"
+#include "Test.hpp"
+#include "ObjLoader.hpp"
+
+int main(int argc, char** argv) {
+    unsigned repeats = (unsigned)Bench::option(argc, argv, "--repeats", 3.0);
+    unsigned max_threads = (unsigned)Bench::option(argc, argv, "--threads", (double)std::max(1u, std::thread::hardware_concurrency()));
+
+    Test::ScratchDirectory dir { "objscaling" };
+    std::string path = Bench::option(argc, argv, "--obj", std::string());
+    if ( path.empty() ) {
+        path = dir.file("synthetic.obj");
+        SyntheticObj::write_grid(path, (size_t)Bench::option(argc, argv, "--triangles", 10e6));
+    }
+    double megabytes = (double)std::filesystem::file_size(path) / (1024.0 * 1024.0);
+    std::cout << path << " (" << std::fixed << std::setprecision(1) << megabytes << " MB)" << std::endl;
+
+    Bench::Timing mapped = Bench::measure(repeats, [&] {
+        ObjLoader loader { path, ObjParseMode::Mapped };
+        Bench::keep(loader.get_indices_count());
+    });
+    std::cout << "  mapped      " << std::setw(10) << mapped.median << " ms" << std::endl;
+
+    for ( unsigned threads = 1; threads <= max_threads; threads += 1 ) {
+        // the calling thread parses a chunk as well
+        ThreadPool pool { std::max(threads, 2u) - 1 };
+        Bench::Timing t = Bench::measure(repeats, [&] {
+            ObjLoader loader { path, threads == 1 ? ObjParseMode::Mapped : ObjParseMode::Parallel, &pool };
+            Bench::keep(loader.get_indices_count());
+        });
+        std::cout << "  " << std::setw(2) << threads << " threads  " << std::setw(10) << t.median << " ms"
+                  << std::setw(9) << std::setprecision(0) << megabytes / (t.median / 1000.0) << " MB/s"
+                  << std::setw(7) << std::setprecision(2) << mapped.median / t.median << "x" << std::setprecision(1) << std::endl;
+    }
+    return 0;
+}
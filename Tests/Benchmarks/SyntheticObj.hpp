@@ -0,0 +1,40 @@
+// Large generated OBJ files for the loader benchmarks
+#pragma once
+
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <cmath>
+
+namespace SyntheticObj {
+
+    /**
+     Write a displaced grid of at least `triangles` triangles to `path`, with a vt and a vn per vertex and
+     `f a/a/a b/b/b c/c/c` faces, as Blender exports the hemisphere. Returns the file size in bytes.
+     */
+    inline size_t write_grid(std::string const& path, size_t triangles) {
+        size_t side = (size_t)std::ceil(std::sqrt((double)triangles / 2.0)) + 1;
+        FILE* out = std::fopen(path.c_str(), "wb");
+        if ( out == nullptr ) return 0;
+
+        for ( size_t y = 0; y < side; y += 1 )
+            for ( size_t x = 0; x < side; x += 1 )
+                std::fprintf(out, "v %.6f %.6f %.6f\n", (double)x / (double)side, std::sin((double)(x * y) * 1e-3), (double)y / (double)side);
+        for ( size_t y = 0; y < side; y += 1 )
+            for ( size_t x = 0; x < side; x += 1 )
+                std::fprintf(out, "vt %.6f %.6f\n", (double)x / (double)side, (double)y / (double)side);
+        for ( size_t i = 0; i < side * side; i += 1 )
+            std::fprintf(out, "vn 0.000000 1.000000 0.000000\n");
+
+        for ( size_t y = 0; y + 1 < side; y += 1 )
+            for ( size_t x = 0; x + 1 < side; x += 1 ) {
+                size_t a = y * side + x + 1, b = a + 1, c = a + side, d = c + 1;
+                std::fprintf(out, "f %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\n", a, a, a, c, c, c, b, b, b);
+                std::fprintf(out, "f %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\n", b, b, b, c, c, c, d, d, d);
+            }
+
+        size_t size = (size_t)std::ftell(out);
+        std::fclose(out);
+        return size;
+    }
+}
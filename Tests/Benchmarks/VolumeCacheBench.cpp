@@ -0,0 +1,38 @@
+// Cloud volume startup: bake, cold .crvol write, warm .crvol map
+//   VolumeCacheBench [--repeats 3] [--threads <hardware concurrency>]
+#include <iostream>
+#include <iomanip>
+#include <thread>
+
+#include "Bench.hpp"
+#include "Test.hpp"
+#include "VolumeCache.hpp"
+
+int main(int argc, char** argv) {
+    unsigned repeats = (unsigned)Bench::option(argc, argv, "--repeats", 3.0);
+    unsigned threads = (unsigned)Bench::option(argc, argv, "--threads", (double)std::max(1u, std::thread::hardware_concurrency()));
+    ThreadPool pool { threads - 1 };
+
+    Test::ScratchDirectory dir { "crvolbench" };
+    std::string cache = dir.file("volume.crvol");
+
+    auto report = [](const char* name, Bench::Timing t) {
+        std::cout << "  " << std::left << std::setw(22) << name << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(10) << t.median << " ms (min " << t.min << ")" << std::endl;
+    };
+
+    for ( auto [params, name] : { std::pair { VolumeNoise::default_shape, "shape" }, std::pair { VolumeNoise::default_detail, "detail" } } ) {
+        std::cout << name << " " << params.size << "^3, " << threads << " threads" << std::endl;
+        report("cold: bake + write", Bench::measure(repeats, [&] {
+            std::filesystem::remove(cache);
+            CachedVolume volume { params, cache, pool };
+            Bench::keep(volume.size());
+        }));
+        // a warm start maps the file and replaceRegion reads every page once
+        report("warm: map + read", Bench::measure(repeats, [&] {
+            CachedVolume volume { params, cache, pool };
+            Bench::keep(Hash::bytes(volume.data(), volume.size()));
+        }));
+    }
+    return 0;
+}
@@ -0,0 +1,57 @@
+// The skydome camera of Renderer::draw_skydome, for headless tests
+#pragma once
+
+#include <cmath>
+#include <numbers>
+#include <simd/simd.h>
+
+/**
+ Same matrices as `Math` in Util.hpp, which cannot be included here because it pulls in metal-cpp
+ */
+namespace Camera {
+    using namespace simd;
+
+    inline float4x4 scale(float x) {
+        float4x4 ret = float4x4(x);
+        ret.columns[3][3] = 1.0f;
+        return ret;
+    }
+
+    inline float4x4 look_at(float3 eye, float3 at, float3 up) {
+        float4x4 ret;
+        float3 z = normalize(at - eye);
+        float3 x = normalize(cross(up, z));
+        float3 y = cross(z, x);
+        ret.columns[0] = make_float4(x.x, y.x, z.x, 0.f);
+        ret.columns[1] = make_float4(x.y, y.y, z.y, 0.f);
+        ret.columns[2] = make_float4(x.z, y.z, z.z, 0.f);
+        ret.columns[3] = make_float4(-dot(x, eye), -dot(y, eye), -dot(z, eye), 1.0f);
+        return ret;
+    }
+
+    inline float4x4 perspective(float fovy, float aspect_ratio, float z_near, float z_far) {
+        float y_scale = 1 / std::tan(fovy * 0.5f);
+        float x_scale = y_scale / aspect_ratio;
+        float z_scale = z_far / (z_far - z_near);
+        float4x4 ret;
+        ret.columns[0][0] = x_scale;
+        ret.columns[1][1] = y_scale;
+        ret.columns[2][2] = z_scale;
+        ret.columns[2][3] = 1.0f;
+        ret.columns[3][2] = -z_near * z_scale;
+        return ret;
+    }
+
+    inline float radian(float degree) { return degree / 180.f * std::numbers::pi_v<float>; }
+
+    /**
+     Model to clip transform of the dome for a camera at the centre looking `pitch` degrees above the horizon
+     towards `yaw`; draw_skydome uses pitch 45, yaw 90 and a 100 degree field of view.
+     */
+    inline float4x4 skydome_clip(float pitch, float yaw, float fov_degrees = 100.f, float aspect = 1.f) {
+        float3 forward = make_float3(std::cos(radian(pitch)) * std::cos(radian(yaw)), std::sin(radian(pitch)),
+                                     std::cos(radian(pitch)) * std::sin(radian(yaw)));
+        float4x4 view = look_at(make_float3(0.f, 0.f, 0.f), forward, make_float3(0.f, 1.f, 0.f)) * scale(100.f);
+        return perspective(radian(fov_degrees), aspect, 0.0f, 100.f) * view;
+    }
+}
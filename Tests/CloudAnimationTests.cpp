@@ -0,0 +1,143 @@
+#include "Test.hpp"
+#include "CloudAnimation.hpp"
+#include "CloudNoise.hpp"
+
+namespace {
+
+    using CloudAnimation::VelocityField;
+
+    /** texel by texel advection through the scalar samplers, the definition `advect` vectorizes */
+    std::vector<float> naive_advect(std::vector<float> const& base, uint32_t width, uint32_t height,
+                                    VelocityField const& field, CloudFlowFrame const& frame) {
+        std::vector<float> out((size_t)width * height);
+        const uint32_t n = field.get_resolution();
+        for ( uint32_t y = 0; y < height; y += 1 )
+            for ( uint32_t x = 0; x < width; x += 1 ) {
+                float u = ((float)x + 0.5f) / (float)width, v = ((float)y + 0.5f) / (float)height;
+                // velocities at the row's center first, then along it, as advect interpolates them
+                std::vector<float> du_row(n), dv_row(n);
+                for ( uint32_t i = 0; i < n; i += 1 ) field.sample(((float)i + 0.5f) / (float)n, v, du_row[i], dv_row[i]);
+                float du = CloudAnimation::sample_bilinear(du_row.data(), n, 1, n, 1, u, 0.5f);
+                float dv = CloudAnimation::sample_bilinear(dv_row.data(), n, 1, n, 1, u, 0.5f);
+                float d = 0.0f;
+                for ( int p = 0; p < 2; p += 1 )
+                    d += frame.weight[p] * CloudAnimation::sample_bilinear(base.data(), width, height, width, 1,
+                                                                           u - du * frame.advect[p], v - dv * frame.advect[p]);
+                out[(size_t)y * width + x] = d;
+            }
+        return out;
+    }
+
+    std::vector<float> density_map(uint32_t width, uint32_t height) {
+        CloudFieldParameters params = CloudNoise::default_parameters();
+        params.grid_size = 32.0f;
+        NoiseTable::GradientTable g = NoiseTable::make_gradient_table(NoiseTable::make(params.seed));
+        std::vector<float> map((size_t)width * height);
+        CloudNoise::generate(map.data(), width, height, width, params, g);
+        return map;
+    }
+
+    float largest_difference(std::vector<float> const& a, std::vector<float> const& b) {
+        float worst = 0.0f;
+        for ( size_t i = 0; i < a.size(); i += 1 ) worst = std::max(worst, std::fabs(a[i] - b[i]));
+        return worst;
+    }
+}
+
+TEST_CASE(flow_phases_cross_fade_and_stay_bounded) {
+    const float period = CloudAnimation::default_flow.period;
+    bool bounded = true, normalized = true, restarts_hidden = true;
+    float largest_jump = 0.0f;
+    CloudFlowFrame previous = CloudAnimation::flow_frame(0.0, period);
+    for ( double t = 0.0; t < 100.0 * period; t += 0.0137 ) {
+        CloudFlowFrame f = CloudAnimation::flow_frame(t, period);
+        bounded = bounded && f.advect[0] >= 0.0f && f.advect[0] < period && f.advect[1] >= 0.0f && f.advect[1] < period;
+        normalized = normalized && std::fabs(f.weight[0] + f.weight[1] - 1.0f) < 1e-6f;
+        // a phase that jumped back to 0 advection must have been invisible
+        for ( int p = 0; p < 2; p += 1 )
+            if ( f.advect[p] < previous.advect[p] ) restarts_hidden = restarts_hidden && f.weight[p] < 0.01f;
+        largest_jump = std::max(largest_jump, std::fabs(f.weight[0] - previous.weight[0]));
+        previous = f;
+    }
+    CHECK(bounded);
+    CHECK(normalized);
+    CHECK(restarts_hidden);
+    // the weights move continuously
+    CHECK(largest_jump < 0.01f);
+}
+
+TEST_CASE(curl_flow_is_divergence_free) {
+    VelocityField field { CloudAnimation::default_flow, 1 };
+    for ( double t : { 0.0, 3.7, 1000.0 } ) {
+        field.update(t);
+        const uint32_t n = field.get_resolution();
+        const float* vel = field.data();
+        auto at = [&](uint32_t x, uint32_t y, int c) { return vel[((size_t)y * n + x) * 2 + c]; };
+        // the discrete curl of a sampled potential is divergence free up to rounding
+        double divergence = 0.0, curl = 0.0;
+        for ( uint32_t y = 1; y + 1 < n; y += 1 )
+            for ( uint32_t x = 1; x + 1 < n; x += 1 ) {
+                divergence += std::fabs((at(x + 1, y, 0) - at(x - 1, y, 0)) + (at(x, y + 1, 1) - at(x, y - 1, 1)));
+                curl += std::fabs((at(x + 1, y, 1) - at(x - 1, y, 1)) - (at(x, y + 1, 0) - at(x, y - 1, 0)));
+            }
+        CHECK(curl > 0.0);
+        CHECK(divergence < 1e-3 * curl);
+    }
+}
+
+TEST_CASE(velocity_field_changes_shape_over_time) {
+    VelocityField field { CloudAnimation::default_flow, 1 };
+    std::vector<float> start(field.data(), field.data() + field.get_resolution() * field.get_resolution() * 2);
+    field.update(20.0);
+    std::vector<float> later(field.data(), field.data() + start.size());
+    CHECK(largest_difference(start, later) > 1e-4f);
+
+    CloudAnimation::FlowParameters calm = CloudAnimation::default_flow;
+    calm.curl_strength = 0.0f;
+    VelocityField wind { calm, 1 };
+    bool uniform = true;
+    for ( size_t i = 0; i < (size_t)calm.resolution * calm.resolution; i += 1 )
+        uniform = uniform && wind.data()[2 * i] == calm.wind_u && wind.data()[2 * i + 1] == calm.wind_v;
+    CHECK(uniform);
+}
+
+TEST_CASE(simd_advect_matches_naive_resampling) {
+    const uint32_t width = 203, height = 77;
+    std::vector<float> base = density_map(width, height);
+    VelocityField field { CloudAnimation::default_flow, 5 };
+    field.update(12.5);
+    ThreadPool pool { 2 };
+
+    for ( double t : { 0.0, 2.0, 7.9 } ) {
+        CloudFlowFrame frame = CloudAnimation::flow_frame(t, CloudAnimation::default_flow.period);
+        std::vector<float> expected = naive_advect(base, width, height, field, frame);
+        std::vector<float> narrow((size_t)width * height), wide((size_t)width * height);
+        CloudAnimation::advect<Simd::f32x4>(pool, base.data(), narrow.data(), width, height, width, field, frame, 37, 5);
+        CloudAnimation::advect<Simd::f32x16>(pool, base.data(), wide.data(), width, height, width, field, frame);
+        CHECK(largest_difference(expected, narrow) < 1e-5f);
+        CHECK(largest_difference(expected, wide) < 1e-5f);
+    }
+}
+
+TEST_CASE(still_frame_samples_the_map_unchanged_and_wind_translates_it) {
+    const uint32_t size = 128;
+    std::vector<float> base = density_map(size, size);
+    ThreadPool pool { 1 };
+
+    CloudAnimation::FlowParameters calm = CloudAnimation::default_flow;
+    calm.curl_strength = 0.0f;
+    calm.wind_u = 4.0f / (float)size;   // four texels per second
+    calm.wind_v = 0.0f;
+    VelocityField wind { calm, 1 };
+
+    std::vector<float> out((size_t)size * size);
+    CloudAnimation::advect(pool, base.data(), out.data(), size, size, size, wind, CloudFlowFrame { { 0.0f, 0.0f }, { 1.0f, 0.0f } });
+    CHECK(largest_difference(base, out) < 1e-6f);
+
+    // two seconds of wind: every texel reads the one eight to its left, away from the clamped edge
+    CloudAnimation::advect(pool, base.data(), out.data(), size, size, size, wind, CloudFlowFrame { { 2.0f, 0.0f }, { 1.0f, 0.0f } });
+    float worst = 0.0f;
+    for ( uint32_t y = 0; y < size; y += 1 )
+        for ( uint32_t x = 8; x < size; x += 1 ) worst = std::max(worst, std::fabs(out[y * size + x] - base[y * size + x - 8]));
+    CHECK(worst < 1e-4f);
+}
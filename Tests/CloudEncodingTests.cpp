@@ -0,0 +1,213 @@
+#include "Test.hpp"
+#include "CloudEncoding.hpp"
+
+namespace {
+
+    using CloudEncoding::DensityFormat;
+    using CloudEncoding::NormalFormat;
+
+    constexpr DensityFormat density_formats[] = { DensityFormat::Float32, DensityFormat::Half, DensityFormat::Unorm8 };
+
+    /** densities in [0, 1] and a few just outside, which Unorm8 clamps */
+    std::vector<float> random_densities(size_t count, uint32_t seed) {
+        std::mt19937 rng { seed };
+        std::uniform_real_distribution<float> value { -0.02f, 1.02f };
+        std::vector<float> densities(count);
+        for ( float& d : densities ) d = value(rng);
+        return densities;
+    }
+
+    /** the row encoded one texel at a time, so only the scalar tail runs */
+    std::vector<uint8_t> scalar_row(const float* in, uint32_t n, uint32_t x_begin, uint32_t y, DensityFormat format) {
+        const uint32_t bytes = CloudEncoding::bytes_per_texel(format);
+        std::vector<uint8_t> out((size_t)n * bytes);
+        for ( uint32_t i = 0; i < n; i += 1 )
+            CloudEncoding::encode_density_row(in + i, out.data() + (size_t)i * bytes, 1, x_begin + i, y, format);
+        return out;
+    }
+
+    /** rows of every width up to a few vectors, at an offset so the dither columns do not start at 0 */
+    template <class V>
+    bool simd_rows_match_scalar(DensityFormat format) {
+        const uint32_t bytes = CloudEncoding::bytes_per_texel(format);
+        std::vector<float> in = random_densities(80, 7);
+        for ( uint32_t n = 1; n <= 3 * V::width + 3; n += 1 ) {
+            const uint32_t x_begin = 1000 + n, y = 37 * n;
+            std::vector<uint8_t> expected = scalar_row(in.data(), n, x_begin, y, format), actual((size_t)n * bytes);
+            CloudEncoding::encode_density_row<V>(in.data(), actual.data(), n, x_begin, y, format);
+            if ( actual != expected ) {
+                std::cerr << "  encode " << CloudEncoding::name(format) << ", " << V::width << " lanes, " << n << " texels" << std::endl;
+                return false;
+            }
+
+            std::vector<float> decoded(n), reference(n);
+            CloudEncoding::decode_density_row<V>(actual.data(), decoded.data(), n, format);
+            for ( uint32_t i = 0; i < n; i += 1 )
+                CloudEncoding::decode_density_row(actual.data() + (size_t)i * bytes, reference.data() + i, 1, format);
+            if ( decoded != reference ) {
+                std::cerr << "  decode " << CloudEncoding::name(format) << ", " << V::width << " lanes, " << n << " texels" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    NormalMap::Normal unit(float x, float y, float z) {
+        float length = std::sqrt(x * x + y * y + z * z);
+        return { x / length, y / length, z / length };
+    }
+
+    /** normals of the upper hemisphere, the only ones a height map has */
+    std::vector<NormalMap::Normal> random_normals(size_t count, uint32_t seed) {
+        std::mt19937 rng { seed };
+        std::uniform_real_distribution<float> value { -1.0f, 1.0f };
+        std::vector<NormalMap::Normal> normals;
+        while ( normals.size() < count ) {
+            float x = value(rng), y = value(rng), z = value(rng);
+            if ( z > 0.01f && x * x + y * y + z * z <= 1.0f ) normals.push_back(unit(x, y, z));
+        }
+        return normals;
+    }
+
+    template <class Encoding>
+    CloudEncoding::NormalError encoded_normal_error(std::vector<NormalMap::Normal> const& normals) {
+        std::vector<typename Encoding::Texel> texels(normals.size());
+        for ( size_t i = 0; i < normals.size(); i += 1 ) texels[i] = Encoding::encode(normals[i]);
+        return CloudEncoding::normal_error<Encoding>(normals.data(), texels.data(), normals.size());
+    }
+}
+
+TEST_CASE(every_density_format_round_trips_within_its_tolerance) {
+    ThreadPool pool { 3 };
+    // an odd width so each row ends in a scalar tail, and a pitch wider than the map
+    const uint32_t width = 301, height = 67;
+    const size_t pitch = 320;
+    std::vector<float> map = random_densities(pitch * height, 1);
+    for ( float& d : map ) d = std::clamp(d, 0.0f, 1.0f);
+
+    for ( DensityFormat format : density_formats ) {
+        std::vector<uint8_t> texels = CloudEncoding::encode_density(pool, map.data(), pitch, width, height, format);
+        CHECK_EQ(texels.size(), (size_t)width * height * CloudEncoding::bytes_per_texel(format));
+
+        std::vector<float> decoded(pitch * height, NAN);
+        CloudEncoding::decode_density(pool, texels.data(), width, height, format, decoded.data(), pitch);
+        double worst = 0.0;
+        for ( uint32_t y = 0; y < height; y += 1 )
+            for ( uint32_t x = 0; x < width; x += 1 )
+                worst = std::max(worst, (double)std::fabs(decoded[y * pitch + x] - map[y * pitch + x]));
+        if ( !CHECK(worst <= CloudEncoding::density_tolerance(format)) )
+            std::cerr << "  " << CloudEncoding::name(format) << " max error " << worst << std::endl;
+        // the padding past each row is left alone
+        CHECK(std::isnan(decoded[width]));
+    }
+}
+
+TEST_CASE(unorm8_clamps_densities_outside_the_unit_range) {
+    const float in[] = { -0.5f, -0.001f, 1.001f, 7.0f };
+    uint8_t out[4];
+    CloudEncoding::encode_density_row(in, out, 4, 0, 0, DensityFormat::Unorm8);
+    CHECK(out[0] == 0 && out[1] == 0 && out[2] == 255 && out[3] == 255);
+}
+
+TEST_CASE(simd_rows_match_scalar_rows) {
+    for ( DensityFormat format : density_formats ) {
+        CHECK(simd_rows_match_scalar<Simd::f32x4>(format));
+        CHECK(simd_rows_match_scalar<Simd::f32x8>(format));
+        CHECK(simd_rows_match_scalar<Simd::f32x16>(format));
+    }
+}
+
+TEST_CASE(dithered_unorm8_is_unbiased) {
+    ThreadPool pool { 3 };
+    const uint32_t size = 256;
+    CHECK_EQ(CloudEncoding::map_encoding(DensityFormat::Unorm8, NormalFormat::XYZ8).density_dither, 1.0f / 255.0f);
+
+    // plain rounding of each of these is off by 40% of a step, always the same way
+    for ( float level : { 76.4f / 255.0f, 128.4f / 255.0f, 190.6f / 255.0f } ) {
+        std::vector<float> map((size_t)size * size, level);
+        std::vector<uint8_t> texels = CloudEncoding::encode_density(pool, map.data(), size, size, size, DensityFormat::Unorm8);
+        std::vector<float> decoded(map.size());
+        CloudEncoding::decode_density(pool, texels.data(), size, size, DensityFormat::Unorm8, decoded.data(), size);
+
+        double mean = 0.0;
+        for ( size_t i = 0; i < map.size(); i += 1 ) mean += (double)decoded[i] - (double)map[i];
+        mean /= (double)map.size();
+        double rounded = std::nearbyint(level * 255.0f) / 255.0 - level;
+        CHECK(std::fabs(rounded) > 0.25 / 255.0);
+        // within 2% of a step
+        if ( !CHECK(std::fabs(mean) < 0.02 / 255.0) )
+            std::cerr << "  level " << level << " mean error " << mean * 255.0 << " steps" << std::endl;
+    }
+
+    // the dither itself spans one step and averages to 0 over a block
+    double total = 0.0, low = 1.0, high = -1.0;
+    for ( uint32_t y = 0; y < size; y += 1 )
+        for ( uint32_t x = 0; x < size; x += 1 ) {
+            double d = CloudEncoding::dither(x, y);
+            total += d, low = std::min(low, d), high = std::max(high, d);
+        }
+    CHECK(low >= -0.5 && high < 0.5 && high - low > 0.99);
+    CHECK(std::fabs(total / ((double)size * size)) < 0.01);
+}
+
+TEST_CASE(density_error_measures_max_and_rms) {
+    const float a[] = { 0.0f, 0.5f, 1.0f, 0.25f };
+    const float b[] = { 0.0f, 0.25f, 1.0f, 0.5f };
+    CloudEncoding::DensityError e = CloudEncoding::density_error(a, b, 4);
+    CHECK_NEAR(e.max_abs_error, 0.25, 1e-12);
+    CHECK_NEAR(e.rms_error, std::sqrt(2 * 0.0625 / 4), 1e-12);
+
+    CloudEncoding::DensityError none = CloudEncoding::density_error(a, a, 0);
+    CHECK(none.max_abs_error == 0.0 && none.rms_error == 0.0);
+}
+
+TEST_CASE(normal_error_measures_the_angle_of_each_encoding) {
+    // a known angle: (0, 0, 1) against the unpacked normal tilted by 30 degrees
+    NormalMap::Normal exact[] = { { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 1.0f } };
+    NormalMap::Normal tilted[] = { { 0.0f, 0.0f, 1.0f }, { 0.5f, 0.0f, std::sqrt(3.0f) / 2.0f } };
+    CloudEncoding::NormalError known = CloudEncoding::normal_error<NormalMap::Unpacked>(exact, tilted, 2);
+    CHECK_NEAR(known.max_degrees, 30.0, 1e-4);
+    CHECK_NEAR(known.mean_degrees, 15.0, 1e-4);
+
+    // 8 bit encodings stay within a degree; the octahedral maps spread their steps more evenly than xyz
+    std::vector<NormalMap::Normal> normals = random_normals(20000, 3);
+    CloudEncoding::NormalError xyz = encoded_normal_error<NormalMap::XYZ8>(normals);
+    CloudEncoding::NormalError octahedral = encoded_normal_error<NormalMap::Octahedral8>(normals);
+    CloudEncoding::NormalError hemi = encoded_normal_error<NormalMap::HemiOctahedral8>(normals);
+    CHECK(xyz.max_degrees > 0.0 && xyz.max_degrees < 1.0);
+    CHECK(octahedral.max_degrees > 0.0 && octahedral.max_degrees < 1.0);
+    CHECK(hemi.max_degrees > 0.0 && hemi.max_degrees < octahedral.max_degrees);
+    CHECK(hemi.mean_degrees < hemi.max_degrees);
+    // unencoded, only the float rounding acos magnifies next to 1 is left
+    CHECK(encoded_normal_error<NormalMap::Unpacked>(normals).max_degrees < 0.05);
+}
+
+TEST_CASE(memory_matches_the_documented_texel_sizes) {
+    CHECK_EQ(CloudEncoding::bytes_per_texel(DensityFormat::Float32), 4u);
+    CHECK_EQ(CloudEncoding::bytes_per_texel(DensityFormat::Half), 2u);
+    CHECK_EQ(CloudEncoding::bytes_per_texel(DensityFormat::Unorm8), 1u);
+    CHECK_EQ(CloudEncoding::bytes_per_texel(NormalFormat::XYZ8), 4u);
+    CHECK_EQ(CloudEncoding::bytes_per_texel(NormalFormat::Octahedral8), 2u);
+    CHECK_EQ(CloudEncoding::bytes_per_texel(NormalFormat::HemiOctahedral8), 2u);
+
+    const size_t texels = (size_t)2048 * 2048;
+    // the renderer's defaults: 4 bytes per texel, against 8 for R32Float density and RGBA8 normals
+    CloudEncoding::MemoryReport packed = CloudEncoding::memory(2048, 2048, 1, 1, DensityFormat::Half, NormalFormat::HemiOctahedral8);
+    CloudEncoding::MemoryReport wide = CloudEncoding::memory(2048, 2048, 1, 1, DensityFormat::Float32, NormalFormat::XYZ8);
+    CHECK_EQ(packed.density_bytes, 2 * texels);
+    CHECK_EQ(packed.normal_bytes, 2 * texels);
+    CHECK_EQ(packed.total(), 4 * texels);
+    CHECK_EQ(wide.total(), 8 * texels);
+    CHECK_EQ(CloudEncoding::memory(2048, 2048, 1, 1, DensityFormat::Unorm8, NormalFormat::Octahedral8).total(), 3 * texels);
+
+    // a full mip chain adds a third, less the rounding of the 1 x 1 tail
+    CloudEncoding::MemoryReport chain = CloudEncoding::memory(2048, 2048, 12, 12, DensityFormat::Half, NormalFormat::XYZ8);
+    size_t levels = 0;
+    for ( size_t side = 2048; side >= 1; side /= 2 ) levels += side * side;
+    CHECK_EQ(chain.density_bytes, 2 * levels);
+    CHECK_EQ(chain.normal_bytes, 4 * levels);
+
+    // a non square map stops halving its short side at 1: 8x2, 4x1, 2x1, 1x1
+    CHECK_EQ(CloudEncoding::memory(8, 2, 4, 0, DensityFormat::Unorm8, NormalFormat::XYZ8).density_bytes, 16u + 4u + 2u + 1u);
+    CHECK_EQ(CloudEncoding::memory(8, 2, 4, 0, DensityFormat::Unorm8, NormalFormat::XYZ8).normal_bytes, 0u);
+}
@@ -0,0 +1,157 @@
+#include <stdexcept>
+#include <cstring>
+
+#include "Test.hpp"
+#include "CloudFieldCache.hpp"
+
+namespace {
+
+    /** generator that only counts its calls and remembers what it was asked for */
+    struct CountingGenerator {
+        size_t calls = 0;
+        CloudFieldParameters last {};
+        uint32_t width = 0, height = 0;
+
+        void operator()(CloudFieldParameters const& params, uint32_t w, uint32_t h) {
+            calls += 1;
+            last = params;
+            width = w;
+            height = h;
+        }
+    };
+
+    struct FieldChange {
+        const char* name;
+        void (*change)(CloudFieldParameters&);
+    };
+
+    /** one change per field of the key besides the resolution */
+    const FieldChange field_changes[] = {
+        { "seed",               [](CloudFieldParameters& p) { p.seed += 1; } },
+        { "octaves",            [](CloudFieldParameters& p) { p.octaves += 1; } },
+        { "grid_size",          [](CloudFieldParameters& p) { p.grid_size *= 2.0f; } },
+        { "gaussian_peak",      [](CloudFieldParameters& p) { p.gaussian_peak += 0.25f; } },
+        { "gaussian_center",    [](CloudFieldParameters& p) { p.gaussian_center += 0.25f; } },
+        { "gaussian_width",     [](CloudFieldParameters& p) { p.gaussian_width += 0.25f; } },
+        { "fall_off_top_width", [](CloudFieldParameters& p) { p.fall_off_top_width -= 0.25f; } },
+        { "fall_off_epsilon",   [](CloudFieldParameters& p) { p.fall_off_epsilon += 1.0f / 1024.0f; } },
+    };
+}
+
+TEST_CASE(unchanged_parameters_hit_without_generating) {
+    CloudFieldCache cache;
+    CountingGenerator generate;
+    CloudFieldParameters p = CloudNoise::default_parameters();
+
+    CHECK(cache.update(p, 256, 128, generate));
+    CHECK_EQ(generate.calls, 1u);
+    CHECK_EQ(generate.width, 256u);
+    CHECK_EQ(generate.height, 128u);
+    for ( int frame = 0; frame < 10; frame += 1 )
+        CHECK(!cache.update(p, 256, 128, generate));
+
+    CHECK_EQ(generate.calls, 1u);
+    CHECK_EQ(cache.get_stats().hits, 10u);
+    CHECK_EQ(cache.get_stats().misses, 1u);
+    CHECK_NEAR(cache.get_stats().hit_ratio(), 10.0 / 11.0, 1e-12);
+}
+
+TEST_CASE(each_key_field_change_misses_once) {
+    CloudFieldCache cache;
+    CountingGenerator generate;
+    CloudFieldParameters p = CloudNoise::default_parameters();
+    cache.update(p, 256, 256, generate);
+
+    for ( FieldChange const& field : field_changes ) {
+        size_t calls = generate.calls, misses = cache.get_stats().misses, hits = cache.get_stats().hits;
+        field.change(p);
+        bool generated = cache.update(p, 256, 256, generate);
+        // and the next frame with the same parameters is a hit again
+        bool hit_after = !cache.update(p, 256, 256, generate);
+        if ( !CHECK(generated && hit_after && generate.calls == calls + 1 && cache.get_stats().misses == misses + 1
+                    && cache.get_stats().hits == hits + 1) ) {
+            std::cerr << "  field " << field.name << std::endl;
+        }
+        CHECK(std::memcmp(&generate.last, &p, sizeof(p)) == 0);
+    }
+
+    // the resolution is part of the key too
+    size_t calls = generate.calls;
+    CHECK(cache.update(p, 512, 256, generate));
+    CHECK(cache.update(p, 512, 512, generate));
+    CHECK_EQ(generate.calls, calls + 2);
+    CHECK_EQ(generate.width, 512u);
+}
+
+TEST_CASE(setting_a_field_to_its_value_still_hits) {
+    CloudFieldCache cache;
+    CountingGenerator generate;
+    CloudFieldParameters p = CloudNoise::default_parameters();
+    cache.update(p, 256, 256, generate);
+
+    // every field written back with the value it had, as a settings panel does for untouched sliders
+    CloudFieldParameters same = p;
+    same.seed = p.seed;
+    same.octaves = p.octaves;
+    same.grid_size = p.grid_size;
+    same.gaussian_peak = p.gaussian_peak;
+    same.gaussian_center = p.gaussian_center;
+    same.gaussian_width = p.gaussian_width;
+    same.fall_off_top_width = p.fall_off_top_width;
+    same.fall_off_epsilon = p.fall_off_epsilon;
+    CHECK(!cache.update(same, 256, 256, generate));
+
+    // changed and changed back is the field already generated
+    for ( FieldChange const& field : field_changes ) {
+        CloudFieldParameters changed = p;
+        field.change(changed);
+        CHECK(cache.update(changed, 256, 256, generate));
+        CHECK(cache.update(p, 256, 256, generate));
+    }
+    CHECK(!cache.update(p, 256, 256, generate));
+    CHECK_EQ(cache.get_stats().hits, 2u);
+    CHECK_EQ(generate.calls, 1u + 2 * std::size(field_changes));
+}
+
+TEST_CASE(invalidate_and_a_throwing_generator_force_a_miss) {
+    CloudFieldCache cache;
+    CountingGenerator generate;
+    CloudFieldParameters p = CloudNoise::default_parameters();
+    cache.update(p, 64, 64, generate);
+
+    cache.invalidate();
+    CHECK(cache.update(p, 64, 64, generate));
+    CHECK_EQ(generate.calls, 2u);
+
+    bool threw = false;
+    try {
+        cache.update(p, 32, 32, [](CloudFieldParameters const&, uint32_t, uint32_t) { throw std::runtime_error("device lost"); });
+    } catch ( std::runtime_error const& ) {
+        threw = true;
+    }
+    CHECK(threw);
+    // the throw left the cache invalid, so even the field before it is generated again
+    CHECK(cache.update(p, 64, 64, generate));
+    CHECK_EQ(generate.calls, 3u);
+    CHECK_EQ(cache.get_stats().misses, 3u);
+}
+
+TEST_CASE(cpu_field_generates_what_the_cache_asked_for) {
+    ThreadPool pool { 3 };
+    CloudFieldCache cache;
+    CpuCloudField field { pool };
+    CloudFieldParameters p = CloudNoise::default_parameters();
+
+    CHECK(cache.update(p, 96, 80, field));
+    CHECK_EQ(field.get_width(), 96u);
+    CHECK_EQ(field.get_height(), 80u);
+
+    std::vector<float> expected((size_t)96 * 80);
+    CloudNoise::generate_tiled(pool, expected.data(), 96, 80, 96, p, CloudNoise::make_gradient_table(NoiseTable::make(p.seed)));
+    CHECK(std::equal(expected.begin(), expected.end(), field.data()));
+
+    // a hit leaves the field as it was
+    const float* data = field.data();
+    CHECK(!cache.update(p, 96, 80, field));
+    CHECK(field.data() == data);
+}
@@ -0,0 +1,141 @@
+#include "Test.hpp"
+#include "CloudLayerCache.hpp"
+#include "CloudFieldCache.hpp"
+
+namespace {
+
+    /** one parameter at a time, as someone tuning the clouds changes them */
+    std::vector<CloudFieldParameters> tuning_session() {
+        std::vector<CloudFieldParameters> steps;
+        CloudFieldParameters p = CloudNoise::default_parameters();
+        steps.push_back(p);
+        p.gaussian_width = 0.5f;        steps.push_back(p);
+        p.gaussian_center = 0.2f;       steps.push_back(p);
+        p.fall_off_top_width = 0.6f;    steps.push_back(p);
+        p.octaves = 6;                  steps.push_back(p);
+        p.octaves = 8;                  steps.push_back(p);
+        p.octaves = 10;                 steps.push_back(p);
+        p.octaves = 1;                  steps.push_back(p);
+        p.octaves = 8;                  steps.push_back(p);
+        p.seed = 5;                     steps.push_back(p);
+        p.grid_size = 64.0f;            steps.push_back(p);
+        return steps;
+    }
+
+    float largest_difference(const float* a, const float* b, size_t n) {
+        float worst = 0.0f;
+        for ( size_t i = 0; i < n; i += 1 ) worst = std::max(worst, std::fabs(a[i] - b[i]));
+        return worst;
+    }
+}
+
+TEST_CASE(unshifted_band_is_bit_exact_through_a_tuning_session) {
+    ThreadPool pool { 3 };
+    // not a multiple of any vector width, so every row has a scalar tail
+    const uint32_t width = 300, height = 212;
+    for ( float epsilon : { 0.0f, 1.0f / 1024.0f } ) {
+        CloudLayerCache<> layered { pool, { 3, 0 } };
+        CpuCloudField full { pool };
+        for ( CloudFieldParameters p : tuning_session() ) {
+            p.fall_off_epsilon = epsilon;
+            layered(p, width, height);
+            full(p, width, height);
+            if ( !CHECK(std::equal(full.data(), full.data() + (size_t)width * height, layered.data())) ) {
+                std::cerr << "  epsilon " << epsilon << ", " << p.octaves << " octaves, max difference "
+                          << largest_difference(full.data(), layered.data(), (size_t)width * height) << std::endl;
+                break;
+            }
+        }
+    }
+}
+
+TEST_CASE(only_new_octaves_are_evaluated) {
+    ThreadPool pool { 3 };
+    CloudLayerCache<> layered { pool, { 2, 1 } };
+    auto steps = tuning_session();
+    std::vector<size_t> evaluated;
+    size_t before = 0;
+    for ( CloudFieldParameters const& p : steps ) {
+        layered(p, 256, 256);
+        evaluated.push_back(layered.get_stats().octaves_evaluated - before);
+        before = layered.get_stats().octaves_evaluated;
+    }
+    // 8 at first; shaping and fall-off 0; 8 -> 6 restarts from the band; 6 -> 8 and 8 -> 10 add 2;
+    // 10 -> 1 rebuilds a one octave band; 1 -> 8 a two octave band and 6 more; seed and grid size all 8
+    std::vector<size_t> expected = { 8, 0, 0, 0, 4, 2, 2, 1, 8, 8, 8 };
+    CHECK(evaluated == expected);
+    CHECK_EQ(layered.get_stats().generations, steps.size());
+}
+
+TEST_CASE(shifted_band_stays_within_its_measured_error) {
+    ThreadPool pool { 3 };
+    const uint32_t size = 512;
+    CloudFieldParameters p = CloudNoise::default_parameters();
+    CpuCloudField full { pool };
+    full(p, size, size);
+
+    // CloudLayerBench: 1e-3 for a band every other texel at the default 128 texel grid
+    CloudLayerCache<> layered { pool, { 2, 1 } };
+    layered(p, size, size);
+    float error = largest_difference(full.data(), layered.data(), (size_t)size * size);
+    CHECK(error > 0.0f);
+    CHECK(error < 1.1e-3f);
+
+    // a texel on the band's lattice takes the band as it was evaluated
+    bool on_lattice = true;
+    for ( uint32_t y = 0; y < size; y += 2 )
+        for ( uint32_t x = 0; x < size; x += 16 )
+            on_lattice = on_lattice && std::fabs(full.data()[y * size + x] - layered.data()[y * size + x]) < 1e-6f;
+    CHECK(on_lattice);
+
+    // a shift of 2 loses more
+    CloudLayerCache<> coarse { pool, { 2, 2 } };
+    coarse(p, size, size);
+    CHECK(largest_difference(full.data(), coarse.data(), (size_t)size * size) > 2e-3f);
+
+    // the default band has no shift, so the default field is exact
+    CloudLayerCache<> exact { pool };
+    exact(p, size, size);
+    CHECK(std::equal(full.data(), full.data() + (size_t)size * size, exact.data()));
+}
+
+TEST_CASE(layers_take_a_quarter_map_and_a_full_one) {
+    ThreadPool pool { 1 };
+    CloudLayerCache<> layered { pool, { 2, 1 } };
+    CloudFieldParameters p = CloudNoise::default_parameters();
+    p.octaves = 12;
+    layered(p, 1024, 1024);
+    size_t map = (size_t)1024 * 1024 * sizeof(float);
+    CHECK(layered.layer_bytes() >= map + map / 4);
+    CHECK(layered.layer_bytes() < map + map / 4 + map / 50);
+
+    // the default band, one texel wider and taller than the map, and the sum
+    CloudLayerCache<> unshifted { pool };
+    unshifted(p, 1024, 1024);
+    CHECK(unshifted.layer_bytes() >= 2 * map);
+    CHECK(unshifted.layer_bytes() < 2 * map + map / 50);
+}
+
+TEST_CASE(base_key_ignores_what_the_band_does_not_depend_on) {
+    CloudFieldParameters p = CloudNoise::default_parameters(), q = p;
+    const CloudBaseBand band = default_base_band;
+    q.gaussian_width = 0.3f;
+    q.fall_off_top_width = 0.5f;
+    q.octaves = 11;
+    CHECK_EQ(cloud_base_key(p, 2048, 2048, band), cloud_base_key(q, 2048, 2048, band));
+
+    auto differs = [&](auto change) {
+        CloudFieldParameters r = p;
+        change(r);
+        return cloud_base_key(r, 2048, 2048, band) != cloud_base_key(p, 2048, 2048, band);
+    };
+    CHECK(differs([](CloudFieldParameters& r) { r.seed += 1; }));
+    CHECK(differs([](CloudFieldParameters& r) { r.grid_size = 64.0f; }));
+    CHECK(differs([](CloudFieldParameters& r) { r.octaves = 1; }));
+    CHECK(cloud_base_key(p, 1024, 2048, band) != cloud_base_key(p, 2048, 2048, band));
+    CHECK(cloud_base_key(p, 2048, 2048, { 2, 2 }) != cloud_base_key(p, 2048, 2048, band));
+
+    CHECK_EQ(cloud_base_size(2048, 1), 1025u);
+    CHECK_EQ(cloud_base_size(2048, 0), 2049u);
+    CHECK_EQ(cloud_base_size(2049, 1), 1026u);
+}
@@ -0,0 +1,83 @@
+#include "Test.hpp"
+#include "CloudMaps.hpp"
+
+namespace {
+
+    struct Maps {
+        std::vector<float> density;
+        std::vector<uint32_t> normals;
+    };
+
+    Maps two_pass(ThreadPool& pool, uint32_t width, uint32_t height, CloudFieldParameters const& params, NoiseTable::GradientTable const& g) {
+        Maps m { std::vector<float>((size_t)width * height), std::vector<uint32_t>((size_t)width * height) };
+        CloudMaps::generate_two_pass(pool, m.density.data(), m.normals.data(), width, height, params, g);
+        return m;
+    }
+
+    /** largest per component difference between two XYZ8 normal maps, in snorm8 steps */
+    int largest_step(std::vector<uint32_t> const& a, std::vector<uint32_t> const& b) {
+        int worst = 0;
+        for ( size_t i = 0; i < a.size(); i += 1 )
+            for ( int shift : { 0, 8, 16, 24 } )
+                worst = std::max(worst, std::abs((int)(int8_t)(a[i] >> shift) - (int)(int8_t)(b[i] >> shift)));
+        return worst;
+    }
+
+    float largest_difference(std::vector<float> const& a, std::vector<float> const& b) {
+        float worst = 0.0f;
+        for ( size_t i = 0; i < a.size(); i += 1 ) worst = std::max(worst, std::fabs(a[i] - b[i]));
+        return worst;
+    }
+}
+
+TEST_CASE(fused_matches_two_pass_at_any_tiling) {
+    CloudFieldParameters params = CloudNoise::default_parameters();
+    // a small grid so the 3x3 neighborhoods see real slopes at these map sizes
+    params.grid_size = 16.0f;
+    NoiseTable::GradientTable g = NoiseTable::make_gradient_table(NoiseTable::make(params.seed));
+
+    for ( unsigned workers : { 0u, 3u } ) {
+        ThreadPool pool { workers };
+        for ( auto [width, height] : { std::pair { 256u, 256u }, std::pair { 333u, 97u }, std::pair { 5u, 3u } } ) {
+            Maps expected = two_pass(pool, width, height, params, g);
+            for ( auto [tile_width, tile_height] : { std::pair { CloudMaps::default_tile_width, CloudMaps::default_tile_height },
+                                                     std::pair { CloudMaps::gpu_tile_size, CloudMaps::gpu_tile_size },
+                                                     std::pair { 7u, 5u }, std::pair { 1u, 1u } } ) {
+                Maps fused { std::vector<float>((size_t)width * height, -1.0f), std::vector<uint32_t>((size_t)width * height, ~0u) };
+                CloudMaps::generate_fused(pool, fused.density.data(), fused.normals.data(), width, height, params, g, tile_width, tile_height);
+                // the halo makes every tile see the same neighbors the second pass reads; only the vector tails differ
+                bool close = CHECK(largest_difference(fused.density, expected.density) < 1e-6f);
+                close = CHECK(largest_step(fused.normals, expected.normals) <= 1) && close;
+                if ( !close ) std::cerr << "  " << width << "x" << height << ", tile " << tile_width << "x" << tile_height << std::endl;
+            }
+        }
+    }
+}
+
+TEST_CASE(fused_matches_two_pass_with_the_fall_off_trimmed) {
+    CloudFieldParameters params = CloudNoise::default_parameters(1.0f / 1024.0f);
+    params.fall_off_top_width = 0.5f;
+    NoiseTable::GradientTable g = NoiseTable::make_gradient_table(NoiseTable::make(params.seed));
+    ThreadPool pool { 2 };
+
+    Maps expected = two_pass(pool, 300, 300, params, g);
+    Maps fused { std::vector<float>(300 * 300), std::vector<uint32_t>(300 * 300) };
+    CloudMaps::generate_fused(pool, fused.density.data(), fused.normals.data(), 300, 300, params, g, 64, 16);
+    // vectors start at different columns in the two paths, so they may keep different octaves, each within the epsilon
+    CHECK(largest_difference(fused.density, expected.density) <= 2.0f * params.fall_off_epsilon);
+}
+
+TEST_CASE(fused_tile_snaps_trimmed_rows_to_whole_vectors) {
+    // a fall-off steep enough that the rows near the top and bottom have spans starting off the vector grid
+    CloudFieldParameters params = CloudNoise::default_parameters(1.0f / 64.0f);
+    params.fall_off_top_width = 0.95f;
+    NoiseTable::GradientTable g = NoiseTable::make_gradient_table(NoiseTable::make(params.seed));
+    ThreadPool pool { 0 };
+
+    // one tile: its vectors start at column 0 in both paths, so each keeps the same octaves
+    std::vector<float> expected(300 * 300);
+    CloudNoise::generate_tiled(pool, expected.data(), 300, 300, 300, params, g, 1024, 1024);
+    Maps fused { std::vector<float>(300 * 300), std::vector<uint32_t>(300 * 300) };
+    CloudMaps::generate_fused(pool, fused.density.data(), fused.normals.data(), 300, 300, params, g, 1024, 1024);
+    CHECK(fused.density == expected);
+}
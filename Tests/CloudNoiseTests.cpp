@@ -0,0 +1,143 @@
+#include "Test.hpp"
+#include "CloudNoise.hpp"
+
+namespace {
+
+    /** the density map through `V`, and the scalar reference, `width` x `height` */
+    template <class V>
+    CloudNoise::Comparison against_scalar(uint32_t width, uint32_t height, CloudFieldParameters const& params) {
+        CloudNoise::GradientTable g = CloudNoise::make_gradient_table(NoiseTable::make(params.seed));
+        std::vector<float> reference((size_t)width * height), vector((size_t)width * height);
+        CloudNoise::generate_scalar(reference.data(), width, height, width, params, g);
+        CloudNoise::generate<V>(vector.data(), width, height, width, params, g);
+        return CloudNoise::compare(reference.data(), width, vector.data(), width, width, height);
+    }
+
+    /** what VERIFY_CLOUD_DENSITY_ON_CPU accepts against the GPU; the CPU paths must agree far more closely */
+    constexpr double simd_tolerance = 1e-5;
+}
+
+TEST_CASE(simd_matches_scalar_reference) {
+    CloudFieldParameters params = CloudNoise::default_parameters();
+    // 333 is not a multiple of any lane count, so every width also runs its scalar tail
+    for ( auto [width, height] : { std::pair { 256u, 256u }, std::pair { 333u, 129u } } ) {
+        CloudNoise::Comparison c4 = against_scalar<Simd::f32x4>(width, height, params);
+        CloudNoise::Comparison c8 = against_scalar<Simd::f32x8>(width, height, params);
+        CloudNoise::Comparison c16 = against_scalar<Simd::f32x16>(width, height, params);
+        std::cout << "  " << width << "x" << height << " max error f32x4 " << c4.max_abs_error << ", f32x8 "
+                  << c8.max_abs_error << ", f32x16 " << c16.max_abs_error << std::endl;
+        CHECK(c4.max_abs_error < simd_tolerance);
+        CHECK(c8.max_abs_error < simd_tolerance);
+        CHECK(c16.max_abs_error < simd_tolerance);
+    }
+}
+
+TEST_CASE(simd_matches_scalar_across_parameters) {
+    for ( uint32_t octaves : { 1u, 5u, 16u } )
+        for ( uint32_t seed : { 1u, 77u } ) {
+            CloudFieldParameters params = CloudNoise::default_parameters();
+            params.octaves = octaves;
+            params.seed = seed;
+            params.grid_size = octaves == 5 ? 32.f : 128.f;
+            CHECK(against_scalar<Simd::f32x8>(200, 96, params).max_abs_error < simd_tolerance);
+        }
+}
+
+TEST_CASE(simd_density_stays_in_range) {
+    CloudFieldParameters params = CloudNoise::default_parameters();
+    CloudNoise::GradientTable g = CloudNoise::make_gradient_table(NoiseTable::make(params.seed));
+    std::vector<float> map(512 * 512);
+    CloudNoise::generate(map.data(), 512, 512, 512, params, g);
+
+    auto [lo, hi] = std::minmax_element(map.begin(), map.end());
+    CHECK(*lo >= 0.0f);
+    CHECK(*hi <= params.gaussian_peak);
+    // a corner is sqrt(2) radii out, where the fall-off leaves under a thousandth
+    CHECK(map[0] < 1e-3f * params.gaussian_peak);
+}
+
+TEST_CASE(vector_exp_matches_std_exp) {
+    double worst = 0.0;
+    for ( float x = -80.0f; x < 80.0f; x += 0.01337f ) {
+        alignas(64) float lanes[Simd::f32x8::width];
+        Simd::exp(Simd::ramp<Simd::f32x8>(0.0f) * Simd::f32x8 { 0.001f } + Simd::f32x8 { x }).store(lanes);
+        for ( size_t i = 0; i < Simd::f32x8::width; i += 1 ) {
+            double expected = std::exp((double)(x + 0.001f * (float)i));
+            worst = std::max(worst, std::fabs(lanes[i] - expected) / expected);
+        }
+    }
+    std::cout << "  relative error " << worst << std::endl;
+    CHECK(worst < 5e-7);
+}
+
+TEST_CASE(tiled_matches_untiled_at_any_tiling) {
+    CloudFieldParameters params = CloudNoise::default_parameters();
+    CloudNoise::GradientTable g = CloudNoise::make_gradient_table(NoiseTable::make(params.seed));
+    const uint32_t width = 333, height = 150;
+    const size_t pitch = 352;
+    std::vector<float> whole((size_t)width * height);
+    CloudNoise::generate(whole.data(), width, height, width, params, g);
+
+    for ( unsigned workers : { 0u, 3u } ) {
+        ThreadPool pool { workers };
+        for ( auto [tile_width, tile_height] : { std::pair { CloudNoise::default_tile_width, CloudNoise::default_tile_height },
+                                                 std::pair { 64u, 1u }, std::pair { 13u, 7u }, std::pair { 1024u, 1024u } } ) {
+            // a row pitch wider than the map: the padding must be left alone
+            std::vector<float> tiled(pitch * height, -1.0f);
+            CloudNoise::generate_tiled(pool, tiled.data(), width, height, pitch, params, g, tile_width, tile_height);
+
+            bool padding_untouched = true;
+            for ( uint32_t y = 0; y < height; y += 1 )
+                for ( size_t x = width; x < pitch; x += 1 ) padding_untouched = padding_untouched && tiled[y * pitch + x] == -1.0f;
+            CHECK(padding_untouched);
+            // tiles narrower than a vector or not aligned to one take the scalar path at their edges
+            if ( !CHECK(CloudNoise::compare(whole.data(), width, tiled.data(), pitch, width, height).max_abs_error < simd_tolerance) )
+                std::cerr << "  tile " << tile_width << "x" << tile_height << ", " << workers << " workers" << std::endl;
+        }
+    }
+}
+
+TEST_CASE(untrimmed_span_covers_any_width) {
+    CloudFieldParameters params = CloudNoise::default_parameters();
+    params.fall_off_epsilon = 0.0f;
+    // width 1 has width / 2 == 0 radius texels, where the infinite radius must not turn into NaN
+    for ( uint32_t width : { 1u, 2u, 3u, 333u } )
+        for ( uint32_t y : { 0u, 1u } ) {
+            auto [first, last] = CloudNoise::visible_span(y, width, 2, params);
+            if ( !CHECK(first == 0 && last == width) ) std::cerr << "  width " << width << ", row " << y << std::endl;
+        }
+
+    std::vector<float> map(2);
+    CloudNoise::GradientTable g = CloudNoise::make_gradient_table(NoiseTable::make(params.seed));
+    CloudNoise::generate(map.data(), 1, 2, 1, params, g);
+    CHECK(std::isfinite(map[0]) && std::isfinite(map[1]));
+}
+
+TEST_CASE(octave_runs_agree_with_every_vector) {
+    CloudFieldParameters params = CloudNoise::default_parameters();
+    const uint32_t width = 333, height = 150;
+    size_t runs = 0;
+    for ( float top_width : { 0.5f, 0.8f, 0.95f } )
+        for ( float epsilon : { 0.0f, 1.0f / 1024.0f, 1.0f / 64.0f } ) {
+            params.fall_off_top_width = top_width;
+            params.fall_off_epsilon = epsilon;
+            // spans starting on and off the vector grid, on either side of the center and across it
+            for ( auto [first, last] : { std::pair { 0u, width }, std::pair { 5u, 170u }, std::pair { 160u, 333u }, std::pair { 200u, 301u } } )
+                for ( uint32_t y = 0; y < height; y += 7 ) {
+                    uint32_t next = first;
+                    bool agree = true;
+                    uint32_t end = CloudNoise::for_each_octave_run<Simd::f32x8>(first, last, y, width, height, params,
+                                                                                [&](uint32_t begin, uint32_t end, uint32_t octaves) {
+                        agree = agree && begin == next && end > begin;
+                        for ( uint32_t x = begin; x < end; x += 8 )
+                            agree = agree && CloudNoise::vector_octaves<Simd::f32x8>(x, y, width, height, params) == octaves;
+                        next = end;
+                        runs += 1;
+                    });
+                    agree = agree && end == next && end + 8 > last && end <= last;
+                    if ( !CHECK(agree) )
+                        std::cerr << "  top width " << top_width << ", epsilon " << epsilon << ", row " << y << ", span " << first << " .. " << last << std::endl;
+                }
+        }
+    std::cout << "  " << runs << " runs" << std::endl;
+}
@@ -0,0 +1,131 @@
+#include "Test.hpp"
+#include "CloudRegeneration.hpp"
+
+namespace {
+
+    using Field = CloudRegeneration::CpuAmortizedCloudField<>;
+
+    struct Maps {
+        std::vector<float> density;
+        std::vector<uint32_t> normals;
+    };
+
+    /** 64 x 16 tiles, as the fields below use: the tiling decides which texels take the scalar tail */
+    Maps fused(ThreadPool& pool, uint32_t width, uint32_t height, CloudFieldParameters const& params) {
+        Maps m { std::vector<float>((size_t)width * height), std::vector<uint32_t>((size_t)width * height) };
+        CloudMaps::generate_fused(pool, m.density.data(), m.normals.data(), width, height, params,
+                                  NoiseTable::make_gradient_table(NoiseTable::make(params.seed)), 64, 16);
+        return m;
+    }
+
+    bool same_front(Field const& field, Maps const& m) {
+        size_t n = m.density.size();
+        return std::equal(m.density.begin(), m.density.end(), field.density()) &&
+               std::equal(m.normals.begin(), m.normals.end(), field.normals(), field.normals() + n);
+    }
+
+    /** slices a regeneration of `tiles` takes when every tile is reported to cost `tile_milliseconds` */
+    uint32_t slices_to_finish(CloudRegeneration::Budget const& budget, uint32_t tiles, double tile_milliseconds) {
+        CloudRegeneration::TimeSlicer slicer { budget };
+        slicer.start(tiles);
+        uint32_t covered = 0;
+        while ( slicer.active() ) {
+            auto [first, last] = slicer.plan();
+            if ( first != covered || last <= first ) return 0;
+            covered = last;
+            slicer.report(last - first, tile_milliseconds * (last - first));
+        }
+        return covered == tiles ? slicer.get_slices() : 0;
+    }
+}
+
+TEST_CASE(slicer_fits_the_budget_from_measured_cost) {
+    // 0.25 ms tiles in 2 ms: one tile before anything was measured, then 8 per slice
+    CloudRegeneration::Budget budget = { 2.0, 1, ~0u, 0 };
+    CHECK_EQ(slices_to_finish(budget, 1 + 8 * 10, 0.25), 11u);
+    // max_tiles caps a cheap slice
+    budget.max_tiles = 4;
+    CHECK_EQ(slices_to_finish(budget, 1 + 4 * 10, 0.01), 11u);
+}
+
+TEST_CASE(slicer_meets_the_frame_deadline_whatever_the_cost) {
+    const uint32_t tiles = 128;
+    for ( uint32_t max_frames : { 1u, 7u, 16u, 30u } )
+        for ( double tile_milliseconds : { 0.001, 0.1, 10.0, 1000.0 } ) {
+            uint32_t slices = slices_to_finish({ 1.0, 1, ~0u, max_frames }, tiles, tile_milliseconds);
+            if ( !CHECK(slices > 0 && slices <= max_frames) )
+                std::cerr << "  max_frames " << max_frames << ", " << tile_milliseconds << " ms per tile: " << slices << std::endl;
+        }
+
+    // without a deadline, tiles too slow for the budget go one per frame
+    CHECK_EQ(slices_to_finish({ 1.0, 1, ~0u, 0 }, tiles, 10.0), tiles);
+    // the renderer's budget on 128 rows of a 2048^2 map: 8 rows first, as the deadline asks, then the 10 a 1 ms slice fits
+    CHECK_EQ(slices_to_finish({ 1.0, 1, ~0u, 16 }, tiles, 0.1), 1u + 12u);
+}
+
+TEST_CASE(front_is_unchanged_until_the_swap_and_then_matches_fused) {
+    const uint32_t width = 300, height = 200;
+    ThreadPool pool { 3 };
+    CloudFieldParameters a = CloudNoise::default_parameters(), b = a;
+    b.seed += 1;
+    b.gaussian_center = 1.1f;
+    Maps expected_a = fused(pool, width, height, a), expected_b = fused(pool, width, height, b);
+
+    // 64 x 16 tiles: 5 x 13 of them, a slow tile per frame, finished within 8 frames by the deadline
+    Field field { pool, width, height, { 1e-9, 1, ~0u, 8 }, 64, 16 };
+    CHECK(field.request(a));
+    CHECK(!field.regenerating());
+    CHECK(same_front(field, expected_a));
+
+    CHECK(field.request(b));
+    CHECK(!field.request(b));
+    uint32_t steps = 0, swaps = 0;
+    bool unchanged = true;
+    while ( field.regenerating() ) {
+        unchanged = unchanged && same_front(field, expected_a);
+        bool swapped = field.step();
+        steps += 1;
+        swaps += swapped;
+        CHECK(swapped == !field.regenerating());
+    }
+    CHECK(unchanged);
+    CHECK_EQ(swaps, 1u);
+    CHECK_EQ(steps, 8u);
+    CHECK(same_front(field, expected_b));
+
+    // asking for what is displayed starts nothing
+    CHECK(!field.request(b));
+    CHECK(!field.step());
+}
+
+TEST_CASE(new_request_abandons_the_unfinished_regeneration) {
+    const uint32_t width = 256, height = 128;
+    ThreadPool pool { 2 };
+    CloudFieldParameters a = CloudNoise::default_parameters(), b = a, c = a;
+    b.seed = 7;
+    c.seed = 9;
+
+    Field field { pool, width, height, { 1e-9, 1, ~0u, 0 }, 64, 16 };
+    field.request(a);
+    field.request(b);
+    field.step();
+    field.step();
+    CHECK(field.request(c));
+    CHECK_NEAR(field.get_slicer().progress(), 0.0, 1e-12);
+    while ( field.regenerating() ) field.step();
+
+    // every tile of the displayed field is c's, none left from b's slices
+    CHECK(same_front(field, fused(pool, width, height, c)));
+}
+
+TEST_CASE(summary_takes_nearest_rank_percentiles) {
+    std::vector<double> ms;
+    for ( int i = 100; i >= 1; i -= 1 ) ms.push_back((double)i);
+    auto s = CloudRegeneration::summarize(ms);
+    CHECK_EQ(s.frames, 100u);
+    CHECK_EQ(s.p50, 50.0);
+    CHECK_EQ(s.p90, 90.0);
+    CHECK_EQ(s.p99, 99.0);
+    CHECK_EQ(s.max, 100.0);
+    CHECK_EQ(CloudRegeneration::summarize({}).frames, 0u);
+}
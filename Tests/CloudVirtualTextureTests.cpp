@@ -0,0 +1,186 @@
+#include <set>
+
+#include "Test.hpp"
+#include "Camera.hpp"
+#include "CloudVirtualTexture.hpp"
+#include "DomeGenerator.hpp"
+
+namespace {
+
+    /** 1024^2 texels in 32^2 pages, 6 levels, and an atlas of 64 slots: small enough to walk every page */
+    constexpr VirtualTexture::Config small_config = { 1024, 32, 8, 8 };
+
+    CloudFieldParameters small_parameters() {
+        return VirtualTexture::virtual_parameters(CloudNoise::default_parameters(), 256, small_config.virtual_size);
+    }
+
+    /** level of each page index, from the layout's offsets */
+    uint32_t level_of(CloudVirtualLayout const& layout, uint32_t page) {
+        uint32_t l = 0;
+        while ( l + 1 < layout.levels && page >= layout.level_offset[l + 1] ) l += 1;
+        return l;
+    }
+
+    /** pages of the view, a 128^2 viewport keeping one view within the 64 slots and a turn beyond them */
+    std::vector<uint32_t> feedback(VirtualTexture::Feedback& fb, Mesh const& dome, float pitch, float yaw,
+                                   CloudVirtualLayout const& layout) {
+        return fb.collect(dome.vertices.data(), dome.indices.data(), dome.indices.size(),
+                          Camera::skydome_clip(pitch, yaw), 128.f, 128.f, layout);
+    }
+}
+
+TEST_CASE(layout_offsets_cover_every_level_once) {
+    CloudVirtualLayout layout = VirtualTexture::make_layout(small_config);
+    CHECK_EQ(layout.levels, 6u);
+    CHECK_EQ(layout.slot_size, 34u);
+    uint32_t expected = 0;
+    for ( uint32_t l = 0; l < layout.levels; l += 1 ) {
+        CHECK_EQ(layout.level_offset[l], expected);
+        expected += VirtualTexture::pages_per_side(small_config, l) * VirtualTexture::pages_per_side(small_config, l);
+    }
+    CHECK_EQ(VirtualTexture::page_count(layout), expected);
+    CHECK_EQ(VirtualTexture::page_count(layout), 1024u + 256u + 64u + 16u + 4u + 1u);
+
+    // the renderer's default, 8 levels, is well within what the shared layout holds
+    CloudVirtualLayout full = VirtualTexture::make_layout(VirtualTexture::default_config);
+    CHECK_EQ(full.levels, 8u);
+    CHECK(full.levels <= CLOUD_VIRTUAL_MAX_LEVELS);
+}
+
+TEST_CASE(only_the_root_is_resident_before_any_feedback) {
+    VirtualTexture::VirtualCloudField field { small_config, small_parameters() };
+    CloudVirtualLayout const& layout = field.get_layout();
+    auto const& indirection = field.get_indirection();
+
+    // every page falls back to the root, at the coarsest level
+    bool all_root = true;
+    for ( uint32_t entry : indirection ) all_root = all_root && entry == indirection.back() && entry >> 24 == layout.levels - 1;
+    CHECK(all_root);
+    CHECK_EQ(field.get_dirty_slots().size(), 1u);
+}
+
+TEST_CASE(requested_pages_become_resident_and_sample_the_field) {
+    Mesh dome = DomeGenerator::uv_sphere(32, 64);
+    VirtualTexture::Feedback fb;
+    VirtualTexture::VirtualCloudField field { small_config, small_parameters() };
+    CloudVirtualLayout const& layout = field.get_layout();
+    ThreadPool pool { 3 };
+
+    auto pages = feedback(fb, dome, 45.f, 90.f, layout);
+    CHECK(!pages.empty());
+    CHECK(pages.size() < 64);
+    std::set<uint32_t> unique(pages.begin(), pages.end());
+    CHECK_EQ(unique.size(), pages.size());
+
+    auto stats = field.update(pages, pool, ~size_t(0));
+    CHECK_EQ(stats.requested, pages.size());
+    CHECK_EQ(stats.hits + stats.misses, pages.size());
+    CHECK_EQ(stats.deferred, 0u);
+    CHECK_EQ(stats.evictions, 0u);
+
+    // each requested page is drawn from itself, not an ancestor
+    bool direct = true;
+    for ( uint32_t page : pages ) direct = direct && field.get_indirection()[page] >> 24 == level_of(layout, page);
+    CHECK(direct);
+
+    // at texel centers the atlas holds the field of the page's level
+    CloudFieldParameters params = small_parameters();
+    auto g = CloudNoise::make_gradient_table(NoiseTable::make(params.seed));
+    double max_error = 0.0;
+    for ( uint32_t page : pages ) {
+        uint32_t level = level_of(layout, page);
+        uint32_t n = VirtualTexture::pages_per_side(small_config, level), size = small_config.virtual_size >> level;
+        uint32_t px = (page - layout.level_offset[level]) % n, py = (page - layout.level_offset[level]) / n;
+        CloudFieldParameters p = VirtualTexture::level_parameters(params, level);
+        for ( uint32_t ty = 0; ty < small_config.page_size; ty += 7 )
+            for ( uint32_t tx = 0; tx < small_config.page_size; tx += 5 ) {
+                uint32_t x = px * small_config.page_size + tx, y = py * small_config.page_size + ty;
+                float u = ((float)x + 0.5f) / (float)size, v = ((float)y + 0.5f) / (float)size;
+                double error = std::abs(field.sample(u, v, level) - CloudNoise::density(x, y, size, size, p, g));
+                max_error = std::max(max_error, error);
+            }
+    }
+    CHECK(max_error < 1e-4);
+}
+
+TEST_CASE(budget_defers_pages_to_their_ancestors_until_later_frames) {
+    Mesh dome = DomeGenerator::uv_sphere(32, 64);
+    VirtualTexture::Feedback fb;
+    VirtualTexture::VirtualCloudField field { small_config, small_parameters() };
+    CloudVirtualLayout const& layout = field.get_layout();
+    ThreadPool pool { 3 };
+
+    auto pages = feedback(fb, dome, 45.f, 90.f, layout);
+    const size_t budget = 4;
+    auto first = field.update(pages, pool, budget);
+    CHECK_EQ(first.misses, budget);
+    CHECK_EQ(first.deferred, pages.size() - first.hits - budget);
+
+    // deferred pages point at a resident coarser page
+    size_t fallbacks = 0;
+    bool coarser = true;
+    for ( uint32_t page : pages ) {
+        uint32_t resident_level = field.get_indirection()[page] >> 24;
+        if ( resident_level != level_of(layout, page) ) {
+            fallbacks += 1;
+            coarser = coarser && resident_level > level_of(layout, page);
+        }
+    }
+    CHECK_EQ(fallbacks, first.deferred);
+    CHECK(coarser);
+
+    // the same view converges within ceil(missing / budget) frames
+    size_t frames = 1, deferred = first.deferred;
+    for ( ; deferred > 0 && frames < 100; frames += 1 )
+        deferred = field.update(feedback(fb, dome, 45.f, 90.f, layout), pool, budget).deferred;
+    CHECK_EQ(frames, (pages.size() - first.hits + budget - 1) / budget);
+}
+
+TEST_CASE(camera_path_evicts_least_recently_used_and_keeps_the_root) {
+    Mesh dome = DomeGenerator::uv_sphere(32, 64);
+    VirtualTexture::Feedback fb;
+    VirtualTexture::VirtualCloudField field { small_config, small_parameters() };
+    CloudVirtualLayout const& layout = field.get_layout();
+    const uint32_t root = layout.level_offset[layout.levels - 1];
+    ThreadPool pool { 3 };
+
+    // a full turn needs more pages than the 64 slots, so pages of earlier views are evicted
+    size_t max_resident = 0, evictions = 0;
+    bool root_resident = true;
+    for ( float yaw = 0.f; yaw < 360.f; yaw += 15.f ) {
+        auto s = field.update(feedback(fb, dome, 30.f, yaw, layout), pool, ~size_t(0));
+        max_resident = std::max(max_resident, s.resident);
+        evictions += s.evictions;
+        root_resident = root_resident && field.get_indirection()[root] >> 24 == layout.levels - 1;
+    }
+    CHECK(evictions > 0);
+    CHECK_EQ(max_resident, 64u);
+    CHECK(root_resident);
+
+    // a view held still is a hit after its first frame
+    field.update(feedback(fb, dome, 30.f, 0.f, layout), pool, ~size_t(0));
+    auto held = field.update(feedback(fb, dome, 30.f, 0.f, layout), pool, ~size_t(0));
+    CHECK_EQ(held.hits, held.requested);
+    CHECK_EQ(held.hit_ratio(), 1.0);
+}
+
+TEST_CASE(parameter_change_flushes_everything_but_the_root) {
+    Mesh dome = DomeGenerator::uv_sphere(32, 64);
+    VirtualTexture::Feedback fb;
+    VirtualTexture::VirtualCloudField field { small_config, small_parameters() };
+    CloudVirtualLayout const& layout = field.get_layout();
+    ThreadPool pool { 3 };
+
+    field.update(feedback(fb, dome, 45.f, 90.f, layout), pool, ~size_t(0));
+    field.set_parameters(small_parameters());
+    CHECK(field.update(feedback(fb, dome, 45.f, 90.f, layout), pool, ~size_t(0)).misses == 0);
+
+    CloudFieldParameters changed = small_parameters();
+    changed.seed += 1;
+    field.set_parameters(changed);
+    auto pages = feedback(fb, dome, 45.f, 90.f, layout);
+    size_t root_requested = std::count(pages.begin(), pages.end(), layout.level_offset[layout.levels - 1]);
+    auto s = field.update(pages, pool, ~size_t(0));
+    CHECK_EQ(s.hits, root_requested);
+    CHECK_EQ(s.misses, s.requested - root_requested);
+}
@@ -0,0 +1,77 @@
+#include <numbers>
+
+#include "Test.hpp"
+#include "DomeGenerator.hpp"
+#include "ObjLoader.hpp"
+
+namespace {
+
+    /** triangles whose geometric normal (b - a) x (c - a) points towards the origin */
+    size_t inward_triangles(std::vector<Vertex> const& v, std::vector<uint32_t> const& indices) {
+        size_t inward = 0;
+        for ( size_t i = 0; i + 2 < indices.size(); i += 3 ) {
+            simd::float3 a = v[indices[i]].position, b = v[indices[i + 1]].position, c = v[indices[i + 2]].position;
+            if ( simd::dot(simd::cross(b - a, c - a), a + b + c) < 0.0f ) inward += 1;
+        }
+        return inward;
+    }
+}
+
+TEST_CASE(uv_sphere_has_the_documented_counts) {
+    for ( auto [rings, segments] : { std::pair { 1u, 3u }, std::pair { 8u, 16u }, std::pair { 124u, 128u } } ) {
+        Mesh dome = DomeGenerator::uv_sphere(rings, segments);
+        CHECK_EQ(dome.vertices.size(), 1u + (size_t)rings * segments);
+        CHECK_EQ(dome.indices.size() / 3, (size_t)segments * (2 * rings - 1));
+        CHECK(*std::max_element(dome.indices.begin(), dome.indices.end()) < dome.vertices.size());
+    }
+    CHECK(DomeGenerator::uv_sphere(0, 16).indices.empty());
+}
+
+TEST_CASE(geodesic_has_the_documented_counts) {
+    for ( uint32_t level : { 0u, 1u, 4u } ) {
+        Mesh dome = DomeGenerator::geodesic(level);
+        CHECK_EQ(dome.indices.size() / 3, (size_t)4 << (2 * level));
+    }
+}
+
+TEST_CASE(domes_lie_on_the_ellipsoid_and_face_the_centre) {
+    DomeGenerator::DomeShape shape;
+    for ( Mesh const& dome : { DomeGenerator::uv_sphere(32, 48), DomeGenerator::geodesic(4) } ) {
+        float worst = 0.0f;
+        for ( Vertex const& v : dome.vertices ) {
+            float e = v.position.x * v.position.x / (shape.radius * shape.radius) + v.position.y * v.position.y / (shape.height * shape.height) +
+                      v.position.z * v.position.z / (shape.radius * shape.radius);
+            worst = std::max(worst, std::fabs(e - 1.0f));
+            // normals point inwards, like the asset's
+            CHECK(simd::dot(v.normal, v.position) <= 0.0f);
+        }
+        CHECK(worst < 1e-5f);
+        CHECK_EQ(inward_triangles(dome.vertices, dome.indices), dome.indices.size() / 3);
+    }
+
+    // the asset is wound the same way
+    std::string path = Test::asset("hemisphere.obj");
+    ObjLoader obj { path };
+    Mesh asset = Mesh::copy_of(obj);
+    CHECK(inward_triangles(asset.vertices, asset.indices) > asset.indices.size() / 3 * 99 / 100);
+}
+
+TEST_CASE(uvs_match_the_asset) {
+    std::string path = Test::asset("hemisphere.obj");
+    ObjLoader obj { path };
+    DomeGenerator::DomeShape shape;
+
+    // place a generated vertex where each asset vertex is and compare what draw_skydome would sample
+    std::vector<float> deviation;
+    for ( size_t i = 0; i < obj.get_vertices_count(); i += 1 ) {
+        Vertex const& v = obj.get_vertices_data()[i];
+        float polar = std::acos(std::clamp(v.position.y / shape.height, -1.0f, 1.0f));
+        float azimuth = std::atan2(v.position.z, v.position.x);
+        Vertex g = DomeGenerator::make_vertex(polar, azimuth, shape);
+        deviation.push_back(simd::length(g.uv - v.uv));
+    }
+    std::sort(deviation.begin(), deviation.end());
+    float median = deviation[deviation.size() / 2];
+    CHECK(median < 0.005f);
+    std::cout << "  uv deviation median " << median << ", p90 " << deviation[deviation.size() * 9 / 10] << std::endl;
+}
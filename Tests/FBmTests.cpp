@@ -0,0 +1,118 @@
+#include <type_traits>
+
+#include "Test.hpp"
+#include "FBm.hpp"
+
+namespace {
+
+    NoiseTable::GradientTable const& table() {
+        static const NoiseTable::GradientTable g = NoiseTable::make_gradient_table(NoiseTable::make(3));
+        return g;
+    }
+
+    /** largest difference between two fBm functors over a 96 x 40 texel region, 16 texels per cell */
+    template <class V = Simd::f32x8, class A, class B>
+    float largest_difference(A const& a, B const& b) {
+        const uint32_t width = 96, height = 40;
+        std::vector<float> ma(width * height), mb(width * height);
+        Fractal::generate_region<V>(a, ma.data(), width, 0, 0, width, height, 16.0f, table());
+        Fractal::generate_region<V>(b, mb.data(), width, 0, 0, width, height, 16.0f, table());
+        float worst = 0.0f;
+        for ( size_t i = 0; i < ma.size(); i += 1 ) worst = std::max(worst, std::fabs(ma[i] - mb[i]));
+        return worst;
+    }
+
+    template <class Basis>
+    bool instantiations_match_dynamic() {
+        bool all = true;
+        [&]<uint32_t... N>(std::integer_sequence<uint32_t, N...>) {
+            ((all = all && largest_difference(Fractal::FBm<Basis, N + 1> {}, Fractal::DynamicFBm<Basis> { N + 1, 2.0f, 0.5f }) < 1e-6f), ...);
+        }(std::make_integer_sequence<uint32_t, Fractal::max_instantiated_octaves> {});
+        return all;
+    }
+
+    template <class Basis>
+    std::pair<float, float> range_of() {
+        const uint32_t width = 512, height = 512;
+        std::vector<float> map(width * height);
+        Fractal::generate_region(Fractal::FBm<Basis, 1> {}, map.data(), width, 0, 0, width, height, 5.3f, table());
+        auto [lo, hi] = std::minmax_element(map.begin(), map.end());
+        return { *lo, *hi };
+    }
+}
+
+TEST_CASE(instantiations_match_the_dynamic_loop) {
+    CHECK(instantiations_match_dynamic<Fractal::Perlin>());
+    CHECK(instantiations_match_dynamic<Fractal::Simplex>());
+    CHECK(instantiations_match_dynamic<Fractal::Value>());
+}
+
+TEST_CASE(dispatch_picks_an_instantiation_when_there_is_one) {
+    auto octaves_of = [](Fractal::Config const& config) {
+        return Fractal::dispatch(config, []<class F>(F const& fbm) -> int {
+            // FBm<> carries its parameters in its type, DynamicFBm in members
+            if constexpr ( std::is_empty_v<F> ) return (int)F::octaves;
+            else return -(int)fbm.octaves;
+        });
+    };
+    // instantiated configurations report their compile-time octave count, the others a negative runtime one
+    CHECK_EQ(octaves_of({ Fractal::BasisKind::Perlin, 8, 2.0f, 0.5f }), 8);
+    CHECK_EQ(octaves_of({ Fractal::BasisKind::Simplex, 1, 2.0f, 0.5f }), 1);
+    CHECK_EQ(octaves_of({ Fractal::BasisKind::Value, 12, 2.0f, 0.5f }), -12);
+    CHECK_EQ(octaves_of({ Fractal::BasisKind::Perlin, 4, 1.9f, 0.5f }), -4);
+}
+
+TEST_CASE(dispatched_sums_match_the_octave_formula) {
+    for ( Fractal::Config config : { Fractal::Config { Fractal::BasisKind::Perlin, 5, 2.0f, 0.5f },
+                                     Fractal::Config { Fractal::BasisKind::Simplex, 3, 1.9f, 0.6f },
+                                     Fractal::Config { Fractal::BasisKind::Value, 10, 2.0f, 0.5f } } ) {
+        float x = 3.37f, y = 1.61f;
+        float expected = 0.0f, frequency = 1.0f, amplitude = 1.0f;
+        for ( uint32_t i = 0; i < config.octaves; i += 1, frequency *= config.lacunarity, amplitude *= config.gain ) {
+            float one = Fractal::dispatch({ config.basis, 1, 2.0f, 0.5f }, [&](auto const& fbm) {
+                alignas(64) float lanes[Simd::f32x4::width];
+                fbm(Simd::f32x4 { x * frequency }, y * frequency, table()).store(lanes);
+                return lanes[0];
+            });
+            expected += one * amplitude;
+        }
+        float summed = Fractal::dispatch(config, [&](auto const& fbm) {
+            alignas(64) float lanes[Simd::f32x4::width];
+            fbm(Simd::f32x4 { x }, y, table()).store(lanes);
+            return lanes[0];
+        });
+        CHECK_NEAR(summed, expected, 1e-5f);
+    }
+}
+
+TEST_CASE(bases_stay_in_their_documented_range) {
+    auto [perlin_lo, perlin_hi] = range_of<Fractal::Perlin>();
+    auto [simplex_lo, simplex_hi] = range_of<Fractal::Simplex>();
+    auto [value_lo, value_hi] = range_of<Fractal::Value>();
+    std::cout << "  perlin [" << perlin_lo << ", " << perlin_hi << "], simplex [" << simplex_lo << ", " << simplex_hi
+              << "], value [" << value_lo << ", " << value_hi << "]" << std::endl;
+    CHECK(perlin_lo >= -0.7072f && perlin_hi <= 0.7072f);
+    CHECK(simplex_lo >= -1.0f && simplex_hi <= 1.0f);
+    CHECK(value_lo >= -1.0f && value_hi <= 1.0f);
+    // and they are not degenerate
+    CHECK(perlin_hi - perlin_lo > 0.6f && simplex_hi - simplex_lo > 0.6f && value_hi - value_lo > 1.0f);
+}
+
+TEST_CASE(vector_widths_agree_and_tails_stop_at_the_region) {
+    Fractal::FBm<Fractal::Simplex, 4> fbm;
+    CHECK(largest_difference<Simd::f32x4>(fbm, fbm) == 0.0f);
+
+    const uint32_t pitch = 64;
+    std::vector<float> narrow(pitch * 2, -5.0f), wide(pitch * 2, -5.0f);
+    Fractal::generate_region<Simd::f32x4>(fbm, narrow.data(), pitch, 3, 0, 45, 2, 16.0f, table());
+    Fractal::generate_region<Simd::f32x16>(fbm, wide.data(), pitch, 3, 0, 45, 2, 16.0f, table());
+    bool outside_untouched = true, equal = true;
+    for ( uint32_t y = 0; y < 2; y += 1 )
+        for ( uint32_t x = 0; x < pitch; x += 1 ) {
+            bool inside = x >= 3 && x < 45;
+            if ( !inside ) outside_untouched = outside_untouched && narrow[y * pitch + x] == -5.0f && wide[y * pitch + x] == -5.0f;
+            else equal = equal && std::fabs(narrow[y * pitch + x] - wide[y * pitch + x]) < 1e-6f;
+        }
+    CHECK(outside_untouched);
+    CHECK(equal);
+}
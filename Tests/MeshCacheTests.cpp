@@ -0,0 +1,131 @@
+#include <fstream>
+#include <thread>
+#include <atomic>
+
+#include "Test.hpp"
+#include "MeshCache.hpp"
+
+namespace {
+
+    /** a private copy of the hemisphere, so touching and editing it leaves the asset alone */
+    std::string copy_hemisphere(Test::ScratchDirectory const& dir) {
+        std::string path = dir.file("hemisphere.obj");
+        std::filesystem::copy_file(Test::asset("hemisphere.obj"), path);
+        return path;
+    }
+
+    CRMeshHeader read_header(std::string const& path) {
+        CRMeshHeader h {};
+        std::ifstream in { path, std::ios::binary };
+        in.read(reinterpret_cast<char*>(&h), sizeof(h));
+        return h;
+    }
+
+    bool same_vertices(const Vertex* a, const Vertex* b, size_t count) {
+        for ( size_t i = 0; i < count; i += 1 )
+            if ( a[i].position.x != b[i].position.x || a[i].position.y != b[i].position.y || a[i].position.z != b[i].position.z ||
+                 a[i].uv.x != b[i].uv.x || a[i].uv.y != b[i].uv.y ||
+                 a[i].normal.x != b[i].normal.x || a[i].normal.y != b[i].normal.y || a[i].normal.z != b[i].normal.z )
+                return false;
+        return true;
+    }
+}
+
+TEST_CASE(round_trip_maps_what_was_written) {
+    Test::ScratchDirectory dir { "crmesh" };
+    std::string obj = copy_hemisphere(dir), cache = dir.file("hemisphere.crmesh");
+
+    CachedMesh cold { obj, cache };
+    CHECK(!cold.is_cache_hit());
+    CachedMesh warm { obj, cache };
+    CHECK(warm.is_cache_hit());
+
+    ObjLoader parsed { obj };
+    CHECK_EQ(warm.get_vertices_count(), parsed.get_vertices_count());
+    CHECK_EQ(warm.get_indices_count(), parsed.get_indices_count());
+    CHECK_EQ(cold.get_vertices_count(), warm.get_vertices_count());
+    CHECK(same_vertices(cold.get_vertices_data(), warm.get_vertices_data(), warm.get_vertices_count()));
+    CHECK(std::equal(cold.get_indices_data(), cold.get_indices_data() + cold.get_indices_count(), warm.get_indices_data()));
+
+    // both blobs are ready for newBuffer: aligned inside the mapping
+    CHECK_EQ((uintptr_t)warm.get_vertices_data() % CRMeshHeader::blob_alignment, 0u);
+    CHECK_EQ((uintptr_t)warm.get_indices_data() % CRMeshHeader::blob_alignment, 0u);
+
+    // the obj and the cache, no temporary left behind
+    CHECK_EQ(Test::files_in(dir.get_path()), 2u);
+}
+
+TEST_CASE(touched_source_keeps_cache_and_records_mtime) {
+    Test::ScratchDirectory dir { "crmesh" };
+    std::string obj = copy_hemisphere(dir), cache = dir.file("hemisphere.crmesh");
+    { CachedMesh cold { obj, cache }; }
+
+    auto touched = std::filesystem::last_write_time(obj) + std::chrono::seconds(10);
+    std::filesystem::last_write_time(obj, touched);
+    CHECK(read_header(cache).source_mtime != (int64_t)touched.time_since_epoch().count());
+
+    CachedMesh warm { obj, cache };
+    CHECK(warm.is_cache_hit());
+    // the hash matched, so the header now trusts the new mtime
+    CHECK_EQ(read_header(cache).source_mtime, (int64_t)touched.time_since_epoch().count());
+}
+
+TEST_CASE(edited_source_rebuilds_cache) {
+    Test::ScratchDirectory dir { "crmesh" };
+    std::string obj = copy_hemisphere(dir), cache = dir.file("hemisphere.crmesh");
+    uint64_t first_hash;
+    {
+        CachedMesh cold { obj, cache };
+        first_hash = read_header(cache).source_hash;
+    }
+
+    // same size, different content, same mtime: only the hash can tell
+    auto mtime = std::filesystem::last_write_time(obj);
+    {
+        // swap the comment marker of the first line, which leaves the mesh itself unchanged
+        std::fstream f { obj, std::ios::binary | std::ios::in | std::ios::out };
+        char first = 0;
+        f.get(first);
+        f.seekp(0);
+        f.put(first == '#' ? '%' : '#');
+    }
+    std::filesystem::last_write_time(obj, mtime + std::chrono::seconds(1));
+
+    CachedMesh rebuilt { obj, cache };
+    CHECK(!rebuilt.is_cache_hit());
+    CHECK(read_header(cache).source_hash != first_hash);
+}
+
+TEST_CASE(damaged_cache_is_rebuilt) {
+    Test::ScratchDirectory dir { "crmesh" };
+    std::string obj = copy_hemisphere(dir), cache = dir.file("hemisphere.crmesh");
+    { CachedMesh cold { obj, cache }; }
+
+    std::filesystem::resize_file(cache, sizeof(CRMeshHeader) + 64);
+    CachedMesh truncated { obj, cache };
+    CHECK(!truncated.is_cache_hit());
+    CachedMesh rebuilt { obj, cache };
+    CHECK(rebuilt.is_cache_hit());
+}
+
+TEST_CASE(concurrent_writers_do_not_collide) {
+    Test::ScratchDirectory dir { "crmesh" };
+    std::string obj = copy_hemisphere(dir), cache = dir.file("hemisphere.crmesh");
+    ObjLoader parsed { obj };
+
+    std::vector<std::thread> writers;
+    std::atomic<int> written { 0 };
+    for ( int i = 0; i < 4; i += 1 )
+        writers.emplace_back([&] {
+            if ( CachedMesh::write(cache, obj, parsed.get_vertices_data(), parsed.get_vertices_count(),
+                                   parsed.get_indices_data(), parsed.get_indices_count()) )
+                written += 1;
+        });
+    for ( auto& t : writers ) t.join();
+
+    CHECK_EQ(written.load(), 4);
+    CHECK_EQ(Test::files_in(dir.get_path()), 2u);
+    CachedMesh warm { obj, cache };
+    CHECK(warm.is_cache_hit());
+    CHECK(same_vertices(warm.get_vertices_data(), parsed.get_vertices_data(), parsed.get_vertices_count()));
+}
@@ -0,0 +1,94 @@
+#include <array>
+#include <algorithm>
+
+#include "Test.hpp"
+#include "MeshOptimizer.hpp"
+#include "MeshSimplifier.hpp"
+#include "DomeGenerator.hpp"
+#include "ObjLoader.hpp"
+
+namespace {
+
+    /** triangles as sorted vertex triplets, rotated so the smallest index is first to keep the winding */
+    std::vector<std::array<uint32_t, 3>> triangles_of(const uint32_t* indices, size_t count, const uint32_t* remap = nullptr) {
+        std::vector<std::array<uint32_t, 3>> t;
+        for ( size_t i = 0; i + 2 < count; i += 3 ) {
+            std::array<uint32_t, 3> tri { indices[i], indices[i + 1], indices[i + 2] };
+            if ( remap ) for ( uint32_t& v : tri ) v = remap[v];
+            std::rotate(tri.begin(), std::min_element(tri.begin(), tri.end()), tri.end());
+            t.push_back(tri);
+        }
+        std::sort(t.begin(), t.end());
+        return t;
+    }
+
+    double acmr(std::vector<uint32_t> const& indices, size_t vertex_count) {
+        return MeshOptimizer::simulate_fifo_cache(indices.data(), indices.size(), vertex_count).acmr();
+    }
+}
+
+TEST_CASE(fifo_simulator_counts_misses) {
+    // two triangles sharing an edge: 4 transforms with room for the edge, 5 when only the last vertex stays
+    std::vector<uint32_t> quad { 0, 1, 2, 2, 1, 3 };
+    CHECK_EQ(MeshOptimizer::simulate_fifo_cache(quad.data(), quad.size(), 4, 16).transforms, 4u);
+    CHECK_EQ(MeshOptimizer::simulate_fifo_cache(quad.data(), quad.size(), 4, 1).transforms, 5u);
+    CHECK_NEAR(MeshOptimizer::simulate_fifo_cache(quad.data(), quad.size(), 4, 16).atvr(), 1.0, 0.0);
+}
+
+TEST_CASE(vertex_cache_order_keeps_triangles_and_lowers_acmr) {
+    std::string path = Test::asset("hemisphere.obj");
+    ObjLoader obj { path };
+    Mesh sources[] = { Mesh::copy_of(obj), DomeGenerator::uv_sphere(124, 128), DomeGenerator::geodesic(5) };
+
+    for ( Mesh& mesh : sources ) {
+        auto before = triangles_of(mesh.indices.data(), mesh.indices.size());
+        double acmr_before = acmr(mesh.indices, mesh.vertices.size());
+
+        MeshOptimizer::optimize_vertex_cache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+        CHECK(triangles_of(mesh.indices.data(), mesh.indices.size()) == before);
+        double acmr_after = acmr(mesh.indices, mesh.vertices.size());
+        CHECK(acmr_after < acmr_before);
+        // a regular grid cannot go below 0.5; Forsyth lands around 0.7 with the simulated 16 entry FIFO
+        CHECK(acmr_after < 0.8);
+    }
+}
+
+TEST_CASE(vertex_cache_order_helps_every_lod) {
+    Mesh dome = DomeGenerator::uv_sphere(124, 128);
+    std::vector<uint32_t> indices;
+    auto lods = MeshSimplifier::build_lod_chain(dome, 6, 0.5f, indices);
+    CHECK(lods.size() > 2);
+
+    for ( size_t level = 1; level < lods.size(); level += 1 ) {
+        std::vector<uint32_t> lod(indices.begin() + lods[level].index_offset,
+                                  indices.begin() + lods[level].index_offset + lods[level].index_count);
+        double acmr_before = acmr(lod, dome.vertices.size());
+        MeshOptimizer::optimize_vertex_cache(lod.data(), lod.size(), dome.vertices.size());
+        CHECK(acmr(lod, dome.vertices.size()) < acmr_before);
+    }
+}
+
+TEST_CASE(vertex_fetch_order_follows_first_use) {
+    Mesh mesh = DomeGenerator::geodesic(4);
+    MeshOptimizer::optimize_vertex_cache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+    Mesh reordered = mesh;
+    MeshOptimizer::optimize_vertex_fetch(reordered.vertices.data(), reordered.vertices.size(),
+                                         reordered.indices.data(), reordered.indices.size());
+
+    // first uses come out as 0, 1, 2, ...
+    uint32_t next = 0;
+    bool in_order = true;
+    for ( uint32_t i : reordered.indices ) {
+        if ( i == next ) next += 1;
+        else in_order = in_order && i < next;
+    }
+    CHECK(in_order);
+
+    // every corner still points at the same vertex
+    bool same = true;
+    for ( size_t i = 0; i < mesh.indices.size(); i += 1 ) {
+        simd::float3 a = mesh.vertices[mesh.indices[i]].position, b = reordered.vertices[reordered.indices[i]].position;
+        same = same && a.x == b.x && a.y == b.y && a.z == b.z;
+    }
+    CHECK(same);
+}
@@ -0,0 +1,110 @@
+#include <numbers>
+
+#include "Test.hpp"
+#include "MeshSimplifier.hpp"
+#include "DomeGenerator.hpp"
+
+namespace {
+
+    /** radial distance from p to the default dome's ellipsoid */
+    float off_surface(simd::float3 p) {
+        DomeGenerator::DomeShape shape;
+        float t = std::sqrt(p.x * p.x / (shape.radius * shape.radius) + p.y * p.y / (shape.height * shape.height) +
+                            p.z * p.z / (shape.radius * shape.radius));
+        return simd::length(p) * std::fabs(1.0f - 1.0f / t);
+    }
+
+    /** how far the simplified surface strays from the dome, sampled at every triangle's centroid and edge midpoints */
+    float worst_deviation(std::vector<Vertex> const& v, std::vector<uint32_t> const& indices) {
+        float worst = 0.0f;
+        for ( size_t i = 0; i + 2 < indices.size(); i += 3 ) {
+            simd::float3 a = v[indices[i]].position, b = v[indices[i + 1]].position, c = v[indices[i + 2]].position;
+            for ( simd::float3 p : { (a + b + c) / 3.0f, (a + b) * 0.5f, (b + c) * 0.5f, (c + a) * 0.5f } )
+                worst = std::max(worst, off_surface(p));
+        }
+        return worst;
+    }
+}
+
+TEST_CASE(triangle_count_trades_against_error) {
+    Mesh dome = DomeGenerator::uv_sphere(64, 64);
+    float previous_error = 0.0f;
+    size_t previous_count = dome.indices.size();
+
+    for ( float ratio : { 0.5f, 0.25f, 0.125f, 0.0625f, 0.03125f } ) {
+        MeshSimplifier::Options options;
+        options.target_index_count = (size_t)((float)dome.indices.size() * ratio) / 3 * 3;
+        auto r = MeshSimplifier::simplify(dome.vertices.data(), dome.vertices.size(), dome.indices.data(), dome.indices.size(), options);
+
+        CHECK(r.indices.size() <= options.target_index_count);
+        CHECK(r.indices.size() < previous_count);
+        // fewer triangles never come cheaper
+        CHECK(r.error >= previous_error);
+        // the reported error bounds how far the coarse surface sags below the dome, up to the sampling of the check
+        float measured = worst_deviation(dome.vertices, r.indices);
+        CHECK(measured <= r.error * 1.5f + 1e-5f);
+        std::cout << "  " << r.indices.size() / 3 << " triangles: error " << r.error << ", measured " << measured << std::endl;
+
+        previous_error = r.error;
+        previous_count = r.indices.size();
+    }
+}
+
+TEST_CASE(max_error_stops_the_collapses) {
+    Mesh dome = DomeGenerator::uv_sphere(64, 64);
+    size_t previous = dome.indices.size();
+    for ( float max_error : { 1e-4f, 1e-3f, 1e-2f } ) {
+        MeshSimplifier::Options options;
+        options.max_error = max_error;
+        auto r = MeshSimplifier::simplify(dome.vertices.data(), dome.vertices.size(), dome.indices.data(), dome.indices.size(), options);
+        CHECK(r.error <= max_error);
+        CHECK(r.indices.size() <= previous);
+        previous = r.indices.size();
+    }
+    CHECK(previous < dome.indices.size() / 2);
+}
+
+TEST_CASE(simplified_meshes_stay_valid_and_keep_the_rim) {
+    Mesh dome = DomeGenerator::uv_sphere(48, 64);
+    DomeGenerator::DomeShape shape;
+    float rim_y = shape.height * std::cos(shape.max_polar_angle);
+
+    MeshSimplifier::Options options;
+    options.target_index_count = dome.indices.size() / 8 / 3 * 3;
+    auto r = MeshSimplifier::simplify(dome.vertices.data(), dome.vertices.size(), dome.indices.data(), dome.indices.size(), options);
+
+    bool valid = true;
+    float lowest = INFINITY;
+    for ( size_t i = 0; i + 2 < r.indices.size(); i += 3 ) {
+        uint32_t a = r.indices[i], b = r.indices[i + 1], c = r.indices[i + 2];
+        valid = valid && a < dome.vertices.size() && b < dome.vertices.size() && c < dome.vertices.size() && a != b && b != c && c != a;
+        for ( uint32_t v : { a, b, c } ) lowest = std::min(lowest, dome.vertices[v].position.y);
+    }
+    CHECK(valid);
+    // the rim is pinned, so the dome still reaches down to it
+    CHECK_NEAR(lowest, rim_y, 1e-5);
+}
+
+TEST_CASE(lod_chain_and_selection) {
+    Mesh dome = DomeGenerator::uv_sphere(124, 128);
+    std::vector<uint32_t> indices;
+    auto lods = MeshSimplifier::build_lod_chain(dome, 6, 0.5f, indices);
+    CHECK_EQ(lods.size(), 6u);
+    CHECK_EQ(lods[0].index_count, dome.indices.size());
+    for ( size_t i = 1; i < lods.size(); i += 1 ) {
+        CHECK(lods[i].index_count <= lods[i - 1].index_count / 2 + 3);
+        CHECK(lods[i].error >= lods[i - 1].error);
+        CHECK_EQ(lods[i].index_offset, lods[i - 1].index_offset + lods[i - 1].index_count);
+    }
+    CHECK_EQ(indices.size(), lods.back().index_offset + lods.back().index_count);
+
+    // smaller targets may use coarser levels, and never a finer one than a larger target
+    float fov = 100.0f / 180.0f * std::numbers::pi_v<float>;
+    size_t previous = lods.size();
+    for ( float height : { 64.0f, 256.0f, 1024.0f, 4096.0f } ) {
+        size_t level = MeshSimplifier::select_lod(lods, height, fov, 0.45f, 1.0f);
+        CHECK(level <= previous);
+        previous = level;
+    }
+    CHECK(MeshSimplifier::select_lod(lods, 64.0f, fov, 0.45f, 1.0f) > 0);
+}
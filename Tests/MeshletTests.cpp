@@ -0,0 +1,174 @@
+#include <set>
+#include <array>
+#include <iomanip>
+
+#include "Test.hpp"
+#include "Camera.hpp"
+#include "Meshlets.hpp"
+#include "DomeGenerator.hpp"
+#include "ObjLoader.hpp"
+
+namespace {
+
+    using Triangle = std::array<uint32_t, 3>;
+
+    struct Dome {
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+    };
+
+    Dome hemisphere() {
+        std::string path = Test::asset("hemisphere.obj");
+        ObjLoader mesh { path };
+        return { { mesh.get_vertices_data(), mesh.get_vertices_data() + mesh.get_vertices_count() },
+                 { mesh.get_indices_data(), mesh.get_indices_data() + mesh.get_indices_count() } };
+    }
+
+    /** (b - a) x (c - a) points towards `eye`, the convention of Meshlets::compute_bounds */
+    bool front_facing(Dome const& dome, Triangle const& t, simd::float3 eye) {
+        simd::float3 a = dome.vertices[t[0]].position, b = dome.vertices[t[1]].position, c = dome.vertices[t[2]].position;
+        return simd::dot(simd::cross(b - a, c - a), eye - a) > 0.0f;
+    }
+
+    /** strictly inside Metal's clip volume, with a margin against rounding at the planes */
+    bool inside_clip(simd::float4x4 const& clip, simd::float3 p) {
+        simd::float4 c = clip * simd::make_float4(p.x, p.y, p.z, 1.0f);
+        float w = c.w * 0.999f;
+        return w > 0.0f && std::abs(c.x) < w && std::abs(c.y) < w && c.z > 0.0f && c.z < w;
+    }
+
+    std::set<Triangle> submitted(Meshlets::MeshletSet const& set, simd::float4x4 const& clip, simd::float3 eye,
+                                 Meshlets::CullStats* stats = nullptr) {
+        std::vector<uint32_t> out(set.indices.size());
+        size_t count = Meshlets::cull(set, clip, eye, out.data(), stats);
+        std::set<Triangle> triangles;
+        for ( size_t i = 0; i + 2 < count; i += 3 ) triangles.insert({ out[i], out[i + 1], out[i + 2] });
+        return triangles;
+    }
+}
+
+TEST_CASE(meshlets_respect_limits_and_cover_every_triangle_once) {
+    Dome dome = hemisphere();
+    Meshlets::MeshletSet set = Meshlets::build(dome.vertices.data(), dome.vertices.size(),
+                                               dome.indices.data(), dome.indices.size());
+    CHECK(set.size() > 1);
+    CHECK_EQ(set.indices.size(), dome.indices.size());
+
+    std::multiset<Triangle> expected, built;
+    for ( size_t i = 0; i < dome.indices.size(); i += 3 ) expected.insert({ dome.indices[i], dome.indices[i + 1], dome.indices[i + 2] });
+
+    bool within_limits = true, counted = true, contiguous = true;
+    uint32_t next_offset = 0;
+    for ( Meshlets::Meshlet const& m : set.meshlets ) {
+        std::set<uint32_t> unique(set.indices.begin() + m.index_offset, set.indices.begin() + m.index_offset + m.index_count);
+        within_limits = within_limits && m.index_count > 0 && m.index_count / 3 <= Meshlets::max_triangles
+                        && unique.size() <= Meshlets::max_vertices;
+        counted = counted && unique.size() == m.vertex_count;
+        contiguous = contiguous && m.index_offset == next_offset;
+        next_offset = m.index_offset + m.index_count;
+        for ( uint32_t i = m.index_offset; i < m.index_offset + m.index_count; i += 3 )
+            built.insert({ set.indices[i], set.indices[i + 1], set.indices[i + 2] });
+    }
+    CHECK(within_limits);
+    CHECK(counted);
+    CHECK(contiguous);
+    CHECK(built == expected);
+}
+
+TEST_CASE(meshlet_bounds_contain_their_vertices) {
+    Mesh sphere = DomeGenerator::geodesic(4);
+    for ( Dome const& dome : { hemisphere(), Dome { sphere.vertices, sphere.indices } } ) {
+        Meshlets::MeshletSet set = Meshlets::build(dome.vertices.data(), dome.vertices.size(),
+                                                   dome.indices.data(), dome.indices.size());
+        float worst = -INFINITY;
+        for ( size_t i = 0; i < set.size(); i += 1 ) {
+            Meshlets::Bounds b = set.bounds(i);
+            Meshlets::Meshlet const& m = set.meshlets[i];
+            for ( uint32_t k = m.index_offset; k < m.index_offset + m.index_count; k += 1 )
+                worst = std::max(worst, simd::distance(b.center, dome.vertices[set.indices[k]].position) - b.radius);
+        }
+        CHECK(worst <= 1e-4f);
+    }
+}
+
+TEST_CASE(cone_culling_only_rejects_back_facing_clusters) {
+    Dome dome = hemisphere();
+    Meshlets::MeshletSet set = Meshlets::build(dome.vertices.data(), dome.vertices.size(),
+                                               dome.indices.data(), dome.indices.size());
+    // an everything-accepting frustum isolates the cone test
+    simd::float4x4 no_frustum = simd::float4x4(0.0f);
+    no_frustum.columns[3][3] = 1.0f;
+
+    std::mt19937 rng { 7 };
+    std::uniform_real_distribution<float> coordinate { -3.0f, 3.0f };
+    size_t rejected_triangles = 0;
+    bool conservative = true;
+    for ( int i = 0; i < 64 && conservative; i += 1 ) {
+        simd::float3 eye = simd::make_float3(coordinate(rng), coordinate(rng), coordinate(rng));
+        std::set<Triangle> kept = submitted(set, no_frustum, eye);
+        for ( size_t t = 0; t < dome.indices.size(); t += 3 ) {
+            Triangle triangle { dome.indices[t], dome.indices[t + 1], dome.indices[t + 2] };
+            if ( kept.count(triangle) ) continue;
+            rejected_triangles += 1;
+            if ( !CHECK(!front_facing(dome, triangle, eye)) ) {
+                conservative = false;
+                break;
+            }
+        }
+    }
+    // the test is only meaningful if some eyes did see the back of clusters
+    CHECK(rejected_triangles > 0);
+}
+
+TEST_CASE(frustum_culling_keeps_every_visible_triangle) {
+    Dome dome = hemisphere();
+    Meshlets::MeshletSet set = Meshlets::build(dome.vertices.data(), dome.vertices.size(),
+                                               dome.indices.data(), dome.indices.size());
+    simd::float3 eye = simd::make_float3(0.f, 0.f, 0.f);
+
+    for ( float pitch : { 0.f, 20.f, 45.f, 70.f, 89.f } )
+        for ( float yaw = 0.f; yaw < 360.f; yaw += 45.f )
+            for ( float aspect : { 1.f, 16.f / 9.f } ) {
+                simd::float4x4 clip = Camera::skydome_clip(pitch, yaw, 100.f, aspect);
+                std::set<Triangle> kept = submitted(set, clip, eye);
+                size_t missing = 0;
+                for ( size_t t = 0; t < dome.indices.size(); t += 3 ) {
+                    Triangle triangle { dome.indices[t], dome.indices[t + 1], dome.indices[t + 2] };
+                    bool visible = front_facing(dome, triangle, eye) && (inside_clip(clip, dome.vertices[triangle[0]].position)
+                                   || inside_clip(clip, dome.vertices[triangle[1]].position)
+                                   || inside_clip(clip, dome.vertices[triangle[2]].position));
+                    if ( visible && !kept.count(triangle) ) missing += 1;
+                }
+                if ( !CHECK_EQ(missing, 0u) ) {
+                    std::cerr << "  pitch " << pitch << " yaw " << yaw << " aspect " << aspect << std::endl;
+                    return;
+                }
+            }
+}
+
+TEST_CASE(culling_reduces_submitted_triangles_across_orientations) {
+    Dome dome = hemisphere();
+    Meshlets::MeshletSet set = Meshlets::build(dome.vertices.data(), dome.vertices.size(),
+                                               dome.indices.data(), dome.indices.size());
+    simd::float3 eye = simd::make_float3(0.f, 0.f, 0.f);
+
+    std::cout << "  " << set.size() << " meshlets, submitted triangle reduction at 100 deg fov, 16:9" << std::endl;
+    double lowest = 1.0;
+    for ( float pitch : { 10.f, 45.f, 80.f } ) {
+        std::cout << "    pitch " << std::setw(2) << pitch << ":";
+        for ( float yaw = 0.f; yaw < 360.f; yaw += 45.f ) {
+            Meshlets::CullStats stats;
+            submitted(set, Camera::skydome_clip(pitch, yaw, 100.f, 16.f / 9.f), eye, &stats);
+            std::cout << " " << std::fixed << std::setprecision(0) << std::setw(3) << stats.reduction() * 100.0 << "%";
+            lowest = std::min(lowest, stats.reduction());
+        }
+        std::cout << std::endl;
+    }
+    // a 100 degree frustum sees well under half of the dome in any direction
+    CHECK(lowest > 0.3);
+
+    // the view draw_skydome renders
+    Meshlets::CullStats stats;
+    submitted(set, Camera::skydome_clip(45.f, 90.f, 100.f, 16.f / 9.f), eye, &stats);
+    CHECK(stats.visible_meshlets < stats.meshlets);
+}
@@ -0,0 +1,126 @@
+#include "Test.hpp"
+#include "MipChain.hpp"
+#include "CloudNoise.hpp"
+
+namespace {
+
+    /** texel by texel decimation with clamped taps, the definition `downsample` vectorizes */
+    std::vector<float> naive_downsample(std::vector<float> const& src, uint32_t w, uint32_t h, uint32_t dw, uint32_t dh, MipKernel const& k) {
+        const int first = 1 - (int)k.taps / 2;
+        std::vector<float> dst((size_t)dw * dh);
+        for ( uint32_t y = 0; y < dh; y += 1 )
+            for ( uint32_t x = 0; x < dw; x += 1 ) {
+                double s = 0.0;
+                for ( uint32_t j = 0; j < k.taps; j += 1 )
+                    for ( uint32_t i = 0; i < k.taps; i += 1 ) {
+                        int sx = std::clamp(2 * (int)x + first + (int)i, 0, (int)w - 1);
+                        int sy = std::clamp(2 * (int)y + first + (int)j, 0, (int)h - 1);
+                        s += (double)src[(size_t)sy * w + sx] * k.weights[i] * k.weights[j];
+                    }
+                dst[(size_t)y * dw + x] = (float)s;
+            }
+        return dst;
+    }
+
+    std::vector<float> random_map(uint32_t w, uint32_t h, uint32_t seed) {
+        std::mt19937 rng { seed };
+        std::uniform_real_distribution<float> value { 0.0f, 1.0f };
+        std::vector<float> map((size_t)w * h);
+        for ( float& v : map ) v = value(rng);
+        return map;
+    }
+}
+
+TEST_CASE(levels_halve_like_metal) {
+    CHECK_EQ(MipChain::level_count(2048, 2048), 12u);
+    CHECK_EQ(MipChain::level_count(1, 1), 1u);
+    CHECK_EQ(MipChain::level_count(5, 3), 3u);
+
+    ThreadPool pool { 1 };
+    std::vector<float> map = random_map(5, 3, 1);
+    MipChain::Pyramid p { map.data(), 5, 3, 5, MipChain::Filter::Box, pool };
+    CHECK_EQ(p.get_level_count(), 3u);
+    CHECK(p.get_level(1).width == 2 && p.get_level(1).height == 1);
+    CHECK(p.get_level(2).width == 1 && p.get_level(2).height == 1);
+
+    MipChain::Pyramid single { map.data(), 5, 3, 5, MipChain::Filter::None, pool };
+    CHECK_EQ(single.get_level_count(), 1u);
+}
+
+TEST_CASE(kernels_are_normalized_and_symmetric) {
+    for ( MipChain::Filter filter : { MipChain::Filter::Box, MipChain::Filter::Kaiser } ) {
+        MipKernel k = MipChain::kernel(filter);
+        float total = 0.0f;
+        bool symmetric = true;
+        for ( uint32_t i = 0; i < k.taps; i += 1 ) {
+            total += k.weights[i];
+            symmetric = symmetric && std::fabs(k.weights[i] - k.weights[k.taps - 1 - i]) < 1e-7f;
+        }
+        CHECK_NEAR(total, 1.0f, 1e-6f);
+        CHECK(symmetric);
+    }
+}
+
+TEST_CASE(simd_downsample_matches_naive_at_every_size) {
+    ThreadPool pool { 2 };
+    float worst = 0.0f;
+    for ( MipChain::Filter filter : { MipChain::Filter::Box, MipChain::Filter::Kaiser } ) {
+        MipKernel k = MipChain::kernel(filter);
+        for ( uint32_t w = 1; w <= 100; w += 1 ) {
+            uint32_t h = 1 + (w * 7) % 23, dw = std::max(1u, w / 2), dh = std::max(1u, h / 2);
+            std::vector<float> src = random_map(w, h, w);
+            std::vector<float> expected = naive_downsample(src, w, h, dw, dh, k);
+            // pitches wider than the rows, as the pyramid's callers may pass
+            std::vector<float> padded_src((size_t)(w + 3) * h), dst((size_t)(dw + 5) * dh, -1.0f);
+            for ( uint32_t y = 0; y < h; y += 1 ) std::copy_n(&src[(size_t)y * w], w, &padded_src[(size_t)y * (w + 3)]);
+            MipChain::downsample(padded_src.data(), w, h, w + 3, dst.data(), dw, dh, dw + 5, k, pool);
+            for ( uint32_t y = 0; y < dh; y += 1 )
+                for ( uint32_t x = 0; x < dw; x += 1 )
+                    worst = std::max(worst, std::fabs(dst[(size_t)y * (dw + 5) + x] - expected[(size_t)y * dw + x]));
+        }
+    }
+    std::cout << "  largest difference " << worst << std::endl;
+    CHECK(worst < 1e-5f);
+}
+
+TEST_CASE(box_is_the_2x2_average_and_constants_stay_constant) {
+    ThreadPool pool { 1 };
+    std::vector<float> map = random_map(64, 32, 4);
+    MipChain::Pyramid box { map.data(), 64, 32, 64, MipChain::Filter::Box, pool };
+    float worst = 0.0f;
+    for ( uint32_t y = 0; y < 16; y += 1 )
+        for ( uint32_t x = 0; x < 32; x += 1 ) {
+            float average = (map[2 * y * 64 + 2 * x] + map[2 * y * 64 + 2 * x + 1] + map[(2 * y + 1) * 64 + 2 * x] + map[(2 * y + 1) * 64 + 2 * x + 1]) * 0.25f;
+            worst = std::max(worst, std::fabs(box.data(1)[y * 32 + x] - average));
+        }
+    CHECK(worst < 1e-6f);
+
+    std::vector<float> flat(37 * 21, 0.625f);
+    for ( MipChain::Filter filter : { MipChain::Filter::Box, MipChain::Filter::Kaiser } ) {
+        MipChain::Pyramid p { flat.data(), 37, 21, 37, filter, pool };
+        float drift = 0.0f;
+        for ( size_t i = 0; i < p.get_level_count(); i += 1 )
+            for ( size_t t = 0; t < (size_t)p.get_level(i).width * p.get_level(i).height; t += 1 )
+                drift = std::max(drift, std::fabs(p.data(i)[t] - 0.625f));
+        CHECK(drift < 1e-6f);
+    }
+}
+
+TEST_CASE(chain_costs_a_third_more_and_trilinear_blends_levels) {
+    ThreadPool pool { 2 };
+    CloudFieldParameters params = CloudNoise::default_parameters();
+    CloudNoise::GradientTable g = CloudNoise::make_gradient_table(NoiseTable::make(params.seed));
+    std::vector<float> map(512 * 512);
+    CloudNoise::generate(map.data(), 512, 512, 512, params, g);
+
+    MipChain::Pyramid p { map.data(), 512, 512, 512, MipChain::Filter::Kaiser, pool };
+    CHECK_EQ(p.get_level_count(), 10u);
+    double ratio = (double)p.size_bytes() / (512.0 * 512.0 * sizeof(float));
+    CHECK(ratio > 1.33 && ratio < 1.34);
+
+    float u = 0.3712f, v = 0.6431f;
+    CHECK_EQ(MipChain::sample_trilinear(p, u, v, 0.0f), MipChain::sample_bilinear(p, 0, u, v));
+    CHECK_EQ(MipChain::sample_trilinear(p, u, v, 2.0f), MipChain::sample_bilinear(p, 2, u, v));
+    float half = (MipChain::sample_bilinear(p, 2, u, v) + MipChain::sample_bilinear(p, 3, u, v)) * 0.5f;
+    CHECK_NEAR(MipChain::sample_trilinear(p, u, v, 2.5f), half, 1e-6f);
+}
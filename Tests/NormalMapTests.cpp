@@ -0,0 +1,101 @@
+#include "Test.hpp"
+#include "NormalMap.hpp"
+
+namespace {
+
+    std::vector<float> random_heights(uint32_t width, uint32_t height, size_t pitch, uint32_t seed) {
+        std::mt19937 rng { seed };
+        std::uniform_real_distribution<float> value { 0.0f, 1.0f };
+        std::vector<float> map(pitch * height, NAN);
+        for ( uint32_t y = 0; y < height; y += 1 )
+            for ( uint32_t x = 0; x < width; x += 1 ) map[y * pitch + x] = value(rng);
+        return map;
+    }
+
+    /** largest component difference between the SIMD and naive normals of a map, both decoded */
+    template <class V, class Encoding>
+    float against_reference(uint32_t width, uint32_t height, NormalMap::Border border, uint32_t seed) {
+        // padding past each row holds NaN, which would show up in any normal that read it
+        const size_t pitch = width + 5;
+        std::vector<float> heights = random_heights(width, height, pitch, seed);
+        std::vector<typename Encoding::Texel> expected((size_t)width * height), actual((size_t)width * height);
+        NormalMap::reference<Encoding>(heights.data(), pitch, width, height, expected.data(), width, border);
+        NormalMap::generate_region<V, Encoding>(heights.data(), pitch, width, height, actual.data(), width, 0, 0, width, height, border);
+
+        float worst = 0.0f;
+        for ( size_t i = 0; i < expected.size(); i += 1 ) {
+            NormalMap::Normal a = Encoding::decode(expected[i]), b = Encoding::decode(actual[i]);
+            float d = std::max({ std::fabs(a.x - b.x), std::fabs(a.y - b.y), std::fabs(a.z - b.z) });
+            worst = std::isnan(d) ? INFINITY : std::max(worst, d);
+        }
+        return worst;
+    }
+
+    /** one snorm8 step, which rsqrt against 1 / sqrt can move a rounding across */
+    constexpr float one_step = 1.0f / 127.0f + 1e-6f;
+}
+
+TEST_CASE(separable_matches_naive_reference_with_borders) {
+    const std::pair<uint32_t, uint32_t> sizes[] = { { 1, 1 }, { 2, 3 }, { 7, 5 }, { 31, 17 }, { 64, 64 }, { 333, 41 } };
+    for ( NormalMap::Border border : { NormalMap::Border::Clamp, NormalMap::Border::Wrap } )
+        for ( auto [width, height] : sizes ) {
+            float xyz4 = against_reference<Simd::f32x4, NormalMap::XYZ8>(width, height, border, width);
+            float xyz8 = against_reference<Simd::f32x8, NormalMap::XYZ8>(width, height, border, width);
+            float xyz16 = against_reference<Simd::f32x16, NormalMap::XYZ8>(width, height, border, width);
+            float unpacked = against_reference<Simd::f32x8, NormalMap::Unpacked>(width, height, border, width);
+            bool ok = CHECK(xyz4 <= one_step && xyz8 <= one_step && xyz16 <= one_step);
+            ok = CHECK(unpacked < 1e-5f) && ok;
+            if ( !ok ) std::cerr << "  " << width << "x" << height << (border == NormalMap::Border::Wrap ? " wrap" : " clamp") << std::endl;
+        }
+}
+
+TEST_CASE(packed_encodings_match_their_scalar_form) {
+    for ( NormalMap::Border border : { NormalMap::Border::Clamp, NormalMap::Border::Wrap } ) {
+        float octahedral = against_reference<Simd::f32x8, NormalMap::Octahedral8>(333, 41, border, 3);
+        float hemi_octahedral = against_reference<Simd::f32x8, NormalMap::HemiOctahedral8>(333, 41, border, 3);
+        CHECK(octahedral <= 2.0f * one_step);
+        CHECK(hemi_octahedral <= 2.0f * one_step);
+    }
+}
+
+TEST_CASE(flat_and_sloped_maps_have_exact_edge_normals) {
+    const uint32_t width = 19, height = 11;
+    std::vector<NormalMap::Normal> normals(width * height);
+
+    // a flat map is flat at every border texel too: nothing uninitialized leaks in
+    std::vector<float> flat(width * height, 0.25f);
+    for ( NormalMap::Border border : { NormalMap::Border::Clamp, NormalMap::Border::Wrap } ) {
+        NormalMap::generate_region<Simd::f32x8, NormalMap::Unpacked>(flat.data(), width, width, height, normals.data(), width,
+                                                                     0, 0, width, height, border);
+        bool up = std::all_of(normals.begin(), normals.end(), [](NormalMap::Normal n) { return n.x == 0.0f && n.y == 0.0f && std::fabs(n.z - 1.0f) < 1e-6f; });
+        CHECK(up);
+    }
+
+    // a ramp rising along x: Gx = 8 per texel step inside, half of it where clamping repeats the edge column
+    std::vector<float> ramp(width * height);
+    for ( uint32_t y = 0; y < height; y += 1 )
+        for ( uint32_t x = 0; x < width; x += 1 ) ramp[y * width + x] = (float)x * 0.125f;
+    NormalMap::generate_region<Simd::f32x8, NormalMap::Unpacked>(ramp.data(), width, width, height, normals.data(), width,
+                                                                 0, 0, width, height, NormalMap::Border::Clamp);
+    float inside = -1.0f / std::sqrt(2.0f), edge = -0.5f / std::sqrt(1.25f);
+    CHECK_NEAR(normals[5 * width + 9].x, inside, 1e-5f);
+    CHECK_NEAR(normals[0].x, edge, 1e-5f);
+    CHECK_NEAR(normals[(height - 1) * width + width - 1].x, edge, 1e-5f);
+    CHECK_NEAR(normals[0].y, 0.0f, 1e-6f);
+}
+
+TEST_CASE(regions_and_bands_assemble_the_whole_map) {
+    const uint32_t width = 150, height = 70;
+    std::vector<float> heights = random_heights(width, height, width, 11);
+    std::vector<uint32_t> whole(width * height), banded(width * height), pieced(width * height);
+    NormalMap::generate_region(heights.data(), width, width, height, whole.data(), width, 0, 0, width, height, NormalMap::Border::Wrap);
+
+    ThreadPool pool { 3 };
+    NormalMap::generate(pool, heights.data(), width, width, height, banded.data(), width, NormalMap::Border::Wrap, 9);
+    for ( uint32_t y = 0; y < height; y += 13 )
+        for ( uint32_t x = 0; x < width; x += 37 )
+            NormalMap::generate_region(heights.data(), width, width, height, pieced.data() + (size_t)y * width + x, width,
+                                       x, y, std::min(x + 37, width), std::min(y + 13, height), NormalMap::Border::Wrap);
+    CHECK(banded == whole);
+    CHECK(pieced == whole);
+}
@@ -0,0 +1,323 @@
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <unordered_set>
+
+#include "Test.hpp"
+#include "ObjLoader.hpp"
+#include "Hash.hpp"
+
+namespace {
+
+    void write_file(std::string const& path, std::string const& contents) {
+        std::ofstream out { path, std::ios::binary };
+        out << contents;
+    }
+
+    bool same_vertex(vertex_t const& a, vertex_t const& b) {
+        return a.position.x == b.position.x && a.position.y == b.position.y && a.position.z == b.position.z &&
+               a.uv.x == b.uv.x && a.uv.y == b.uv.y &&
+               a.normal.x == b.normal.x && a.normal.y == b.normal.y && a.normal.z == b.normal.z;
+    }
+
+    /** every vertex and index equal, floats compared exactly */
+    bool same_mesh(ObjLoader& a, ObjLoader& b) {
+        if ( a.get_vertices_count() != b.get_vertices_count() || a.get_indices_count() != b.get_indices_count() ) return false;
+        for ( size_t i = 0; i < a.get_vertices_count(); i += 1 )
+            if ( !same_vertex(a.get_vertices_data()[i], b.get_vertices_data()[i]) ) return false;
+        return std::equal(a.get_indices_data(), a.get_indices_data() + a.get_indices_count(), b.get_indices_data());
+    }
+
+    /**
+     Records in the forms both `Stream` and `Mapped` accept: single spaces, triangles, a/b/c corners.
+     Stream leaves unassigned attributes uninitialized, so every vertex gets a vt and a vn.
+     */
+    const char* small_obj =
+        "# exported by hand\n"
+        "v 1.0 2.5 -3.25\n"
+        "v 1e-3 -2.5E+2 0.1\n"
+        "v -0.000001 123456.7 8\n"
+        "v 0 0 0\n"
+        "vt 0.25 0.75\n"
+        "vt 1 0\n"
+        "vt 0.5 0.5\n"
+        "vt 0 1\n"
+        "vn 0 0 1\n"
+        "vn 0.57735 0.57735 0.57735\n"
+        "vn 1 0 0\n"
+        "vn 0 -1 0\n"
+        "s off\n"
+        "f 1/1/1 2/2/2 3/3/3\n"
+        "f 4/4/4 3/3/3 2/2/2\n";
+}
+
+TEST_CASE(mapped_matches_stream_on_hemisphere) {
+    std::string path = Test::asset("hemisphere.obj");
+    ObjLoader stream { path, ObjParseMode::Stream };
+    ObjLoader mapped { path, ObjParseMode::Mapped };
+
+    CHECK(mapped.get_vertices_count() > 0);
+    CHECK_EQ(mapped.get_indices_count() % 3, 0u);
+    CHECK(same_mesh(stream, mapped));
+    CHECK_EQ(mapped.get_load_stats().bytes, stream.get_load_stats().bytes);
+}
+
+TEST_CASE(mapped_matches_stream_on_edge_cases) {
+    Test::ScratchDirectory dir { "obj" };
+    std::string path = dir.file("small.obj");
+    write_file(path, small_obj);
+
+    ObjLoader stream { path, ObjParseMode::Stream };
+    ObjLoader mapped { path, ObjParseMode::Mapped };
+    CHECK_EQ(mapped.get_vertices_count(), 4u);
+    CHECK_EQ(mapped.get_indices_count(), 6u);
+    CHECK(same_mesh(stream, mapped));
+}
+
+TEST_CASE(mapped_resolves_relative_indices) {
+    Test::ScratchDirectory dir { "obj" };
+    std::string path = dir.file("relative.obj");
+    write_file(path, std::string(small_obj) + "f -1 -2 -3\n");
+
+    // Stream has no notion of relative indices, so only Mapped is checked: they count back from the last vertex
+    ObjLoader mapped { path, ObjParseMode::Mapped };
+    std::vector<uint32_t> indices(mapped.get_indices_data() + 6, mapped.get_indices_data() + mapped.get_indices_count());
+    CHECK(indices == std::vector<uint32_t>({ 3, 2, 1 }));
+}
+
+TEST_CASE(mapped_tolerates_crlf_tabs_and_polygons) {
+    Test::ScratchDirectory dir { "obj" };
+    std::string path = dir.file("quad.obj");
+    write_file(path, "v 0 0 0\r\nv 1\t0 0\r\nv 1  1 0\r\nv 0 1 0\r\n\r\nf 1 2 3 4\r\nf 1/1 2/2 3/3\n");
+
+    ObjLoader mapped { path, ObjParseMode::Mapped };
+    CHECK_EQ(mapped.get_vertices_count(), 4u);
+    // the quad is fan triangulated
+    CHECK_EQ(mapped.get_indices_count(), 9u);
+    std::vector<uint32_t> indices(mapped.get_indices_data(), mapped.get_indices_data() + mapped.get_indices_count());
+    CHECK(indices == std::vector<uint32_t>({ 0, 1, 2, 0, 2, 3, 0, 1, 2 }));
+    CHECK_EQ(mapped.get_vertices_data()[2].position.y, 1.0f);
+}
+
+TEST_CASE(parse_float_matches_strtof) {
+    std::mt19937 rng { 1234 };
+    std::uniform_real_distribution<double> mantissa { -1.0, 1.0 };
+    std::uniform_int_distribution<int> exponent { -8, 8 };
+    const char* formats[] = { "%.9g", "%.6f", "%.3e", "%g" };
+
+    for ( int i = 0; i < 20000; i += 1 ) {
+        char text[64];
+        std::snprintf(text, sizeof(text), formats[i % 4], mantissa(rng) * std::pow(10.0, exponent(rng)));
+
+        const char* p = text;
+        float parsed = 0.0f;
+        bool ok = ObjParse::parse_float(p, text + std::strlen(text), parsed);
+        float expected = std::strtof(text, nullptr);
+        if ( !CHECK(ok && parsed == expected) ) {
+            std::cerr << "  text " << text << std::endl;
+            break;
+        }
+        CHECK(p == text + std::strlen(text));
+    }
+}
+
+TEST_CASE(empty_file_maps_to_nothing) {
+    Test::ScratchDirectory dir { "obj" };
+    std::string path = dir.file("empty.obj");
+    write_file(path, "");
+
+    MappedFile file { path };
+    CHECK(file.is_open());
+    CHECK_EQ(file.size(), 0u);
+    // an empty mapping hands out a null pointer, which hashing must accept
+    CHECK_EQ(Hash::bytes(file.data(), file.size(), 42), 42u);
+
+    ObjLoader mapped { path, ObjParseMode::Mapped };
+    CHECK_EQ(mapped.get_vertices_count(), 0u);
+    CHECK_EQ(mapped.get_indices_count(), 0u);
+}
+
+namespace {
+
+    /**
+     More than 1 MB per chunk of records in an order that exercises the vt/vn bounds: vt and vn lines running ahead of
+     the v lines, and more of them than there are positions, as in hemisphere.obj
+     */
+    std::string interleaved_obj(size_t records, uint32_t seed) {
+        std::mt19937 rng { seed };
+        std::string text;
+        size_t positions = 0;
+        char line[96];
+        for ( size_t i = 0; i < records; i += 1 ) {
+            switch ( rng() % 4 ) {
+                case 0: std::snprintf(line, sizeof(line), "v %zu.5 %u %u\n", i, (unsigned)(rng() % 1000), (unsigned)(rng() % 1000)); positions += 1; break;
+                case 1: std::snprintf(line, sizeof(line), "vt 0.%u 0.%u\n", (unsigned)(rng() % 1000), (unsigned)(rng() % 1000)); break;
+                case 2: std::snprintf(line, sizeof(line), "vn %u 0 -%u\n", (unsigned)(rng() % 10), (unsigned)(rng() % 10)); break;
+                default:
+                    if ( positions < 3 ) { line[0] = 0; break; }
+                    std::snprintf(line, sizeof(line), "f %zu %zu -1\n", 1 + rng() % positions, 1 + rng() % positions);
+                    break;
+            }
+            text += line;
+        }
+        return text;
+    }
+}
+
+TEST_CASE(parallel_matches_mapped_on_hemisphere) {
+    std::string path = Test::asset("hemisphere.obj");
+    ThreadPool pool { 3 };
+    ObjLoader mapped { path, ObjParseMode::Mapped };
+    ObjLoader parallel { path, ObjParseMode::Parallel, &pool };
+    CHECK(same_mesh(mapped, parallel));
+}
+
+TEST_CASE(parallel_matches_mapped_across_chunk_boundaries) {
+    Test::ScratchDirectory dir { "obj" };
+    for ( uint32_t seed : { 1u, 2u, 3u } ) {
+        std::string path = dir.file("interleaved.obj");
+        write_file(path, interleaved_obj(300000, seed));
+
+        ObjLoader mapped { path, ObjParseMode::Mapped };
+        for ( unsigned workers : { 1u, 2u, 5u } ) {
+            ThreadPool pool { workers };
+            ObjLoader parallel { path, ObjParseMode::Parallel, &pool };
+            CHECK(same_mesh(mapped, parallel));
+        }
+    }
+}
+
+TEST_CASE(parallel_skips_attributes_ahead_of_their_vertex) {
+    // every vt and vn comes before any v, so neither may land on a vertex, whichever chunk they were parsed in
+    std::string text;
+    for ( int i = 0; i < 60000; i += 1 ) text += "vt 0.125 0.250\nvn 0.000 1.000 0.000\n";
+    for ( int i = 0; i < 60000; i += 1 ) text += "v 1.000000 2.000000 3.000000\n";
+
+    Test::ScratchDirectory dir { "obj" };
+    std::string path = dir.file("ahead.obj");
+    write_file(path, text);
+
+    ThreadPool pool { 3 };
+    ObjLoader parallel { path, ObjParseMode::Parallel, &pool };
+    CHECK_EQ(parallel.get_vertices_count(), 60000u);
+    bool untouched = true;
+    for ( size_t i = 0; i < parallel.get_vertices_count(); i += 1 )
+        untouched = untouched && parallel.get_vertices_data()[i].uv.x == 0.0f && parallel.get_vertices_data()[i].normal.y == 0.0f;
+    CHECK(untouched);
+}
+
+namespace {
+
+    /** every triangle corner of `welded` at the position the same corner of `mapped` has */
+    bool same_corner_positions(ObjLoader& welded, ObjLoader& mapped) {
+        if ( welded.get_indices_count() != mapped.get_indices_count() ) return false;
+        for ( size_t i = 0; i < welded.get_indices_count(); i += 1 ) {
+            simd::float3 a = welded.get_vertices_data()[welded.get_indices_data()[i]].position;
+            simd::float3 b = mapped.get_vertices_data()[mapped.get_indices_data()[i]].position;
+            if ( a.x != b.x || a.y != b.y || a.z != b.z ) return false;
+        }
+        return true;
+    }
+
+    /** unit cube, each face with its own normal and the same four uvs: 8 positions, 24 distinct corners */
+    const char* cube_obj =
+        "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nv 0 0 1\nv 1 0 1\nv 1 1 1\nv 0 1 1\n"
+        "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+        "vn 0 0 -1\nvn 0 0 1\nvn 0 -1 0\nvn 0 1 0\nvn -1 0 0\nvn 1 0 0\n"
+        "f 1/1/1 4/2/1 3/3/1 2/4/1\n"
+        "f 5/1/2 6/2/2 7/3/2 8/4/2\n"
+        "f 1/1/3 2/2/3 6/3/3 5/4/3\n"
+        "f 4/1/4 8/2/4 7/3/4 3/4/4\n"
+        "f 1/1/5 5/2/5 8/3/5 4/4/5\n"
+        "f 2/1/6 3/2/6 7/3/6 6/4/6\n";
+}
+
+TEST_CASE(welded_splits_cube_corners_by_attribute) {
+    Test::ScratchDirectory dir { "obj" };
+    std::string path = dir.file("cube.obj");
+    write_file(path, cube_obj);
+
+    ObjLoader welded { path, ObjParseMode::Welded };
+    ObjLoader mapped { path, ObjParseMode::Mapped };
+    // each corner is shared by three faces with different normals, and within a face by its two triangles
+    CHECK_EQ(welded.get_vertices_count(), 24u);
+    CHECK_EQ(welded.get_indices_count(), 36u);
+    CHECK_EQ(welded.get_weld_stats().corners, 36u);
+    CHECK_EQ(welded.get_weld_stats().unique_vertices, 24u);
+    CHECK_NEAR(welded.get_weld_stats().dedup_ratio(), 1.5, 1e-12);
+    CHECK(same_corner_positions(welded, mapped));
+
+    // the first face's normal and uvs went with its corners
+    vertex_t const& corner = welded.get_vertices_data()[welded.get_indices_data()[1]];
+    CHECK_EQ(corner.normal.z, -1.0f);
+    CHECK_EQ(corner.uv.x, 1.0f);
+    CHECK_EQ(corner.position.y, 1.0f);
+}
+
+TEST_CASE(welded_keeps_one_vertex_per_distinct_hemisphere_corner) {
+    std::string path = Test::asset("hemisphere.obj");
+    ObjLoader welded { path, ObjParseMode::Welded };
+    ObjLoader mapped { path, ObjParseMode::Mapped };
+
+    // hemisphere.obj only has triangles of absolute v/vt/vn corners, so distinct corner tokens are distinct triplets
+    std::ifstream in { path };
+    std::unordered_set<std::string> distinct;
+    size_t corners = 0;
+    std::string line;
+    while ( std::getline(in, line) ) {
+        if ( line.rfind("f ", 0) != 0 ) continue;
+        std::istringstream tokens { line.substr(2) };
+        std::string token;
+        while ( tokens >> token ) {
+            distinct.insert(token);
+            corners += 1;
+        }
+    }
+
+    ObjWeldStats const& stats = welded.get_weld_stats();
+    CHECK_EQ(stats.corners, corners);
+    CHECK_EQ(welded.get_indices_count(), corners);
+    CHECK_EQ(stats.unique_vertices, distinct.size());
+    CHECK_EQ(welded.get_vertices_count(), distinct.size());
+    CHECK(stats.unique_vertices < stats.corners);
+    CHECK(stats.average_probe_length() >= 1.0 && stats.average_probe_length() < 2.0);
+    CHECK(same_corner_positions(welded, mapped));
+}
+
+TEST_CASE(welded_resolves_negative_and_missing_attributes) {
+    Test::ScratchDirectory dir { "obj" };
+    std::string path = dir.file("attributes.obj");
+    write_file(path,
+               "v 0 0 0\nv 1 0 0\nv 0 1 0\n"
+               "vt 0.25 0.5\nvt 0.75 1\n"
+               "vn 0 0 1\n"
+               "f 1 2 3\n"                      // neither
+               "f 1/1 2/2 3/1\n"                // uv only
+               "f 1//1 2//1 3//1\n"             // normal only
+               "f -3/-2/-1 -2/-1/-1 -1/-2/-1\n" // relative: 1/1/1 2/2/1 3/1/1
+               "f 1/1/1 2/2/1 3/1/1\n"          // the same corners again
+               "f 1/9/1 2//1 3/1/1\n");         // an out of range vt is missing, so all three are seen before
+
+    ObjLoader welded { path, ObjParseMode::Welded };
+    ObjLoader mapped { path, ObjParseMode::Mapped };
+    CHECK_EQ(welded.get_vertices_count(), 12u);
+    CHECK_EQ(welded.get_indices_count(), 18u);
+    CHECK(same_corner_positions(welded, mapped));
+
+    std::vector<uint32_t> indices(welded.get_indices_data(), welded.get_indices_data() + welded.get_indices_count());
+    CHECK(std::equal(indices.begin() + 9, indices.begin() + 12, indices.begin() + 12));
+    CHECK_EQ(indices[15], indices[6]);
+    CHECK_EQ(indices[16], indices[7]);
+    CHECK_EQ(indices[17], indices[11]);
+
+    vertex_t const* v = welded.get_vertices_data();
+    // no vt or vn leaves them zero
+    CHECK(v[indices[0]].uv.x == 0.0f && v[indices[0]].normal.z == 0.0f);
+    // uv only
+    CHECK(v[indices[4]].uv.x == 0.75f && v[indices[4]].normal.z == 0.0f);
+    // normal only
+    CHECK(v[indices[7]].uv.y == 0.0f && v[indices[7]].normal.z == 1.0f);
+    // relative indices count back from the last record of each kind
+    CHECK(v[indices[9]].uv.y == 0.5f && v[indices[10]].uv.x == 0.75f && v[indices[11]].normal.z == 1.0f);
+}
@@ -0,0 +1,109 @@
+// Minimal test registry for the renderer's CPU modules
+#pragma once
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <cmath>
+#include <filesystem>
+#include <random>
+
+/**
+ Each test file is its own executable: `TEST_CASE`s register themselves, TestMain.cpp runs them all and exits
+ non-zero when a `CHECK` failed, which is what ctest looks at. Checks report and keep going so one run shows
+ every failure of a case.
+ */
+namespace Test {
+
+    struct Case {
+        const char* name;
+        void (*body)();
+    };
+
+    inline std::vector<Case>& registry() {
+        static std::vector<Case> cases;
+        return cases;
+    }
+
+    inline size_t& failures() {
+        static size_t count = 0;
+        return count;
+    }
+
+    struct Registration {
+        Registration(const char* name, void (*body)()) { registry().push_back({ name, body }); }
+    };
+
+    inline bool check(bool passed, const char* expression, const char* file, int line) {
+        if ( !passed ) {
+            std::cerr << file << ":" << line << ": CHECK(" << expression << ") failed" << std::endl;
+            failures() += 1;
+        }
+        return passed;
+    }
+
+    template <class A, class B>
+    inline bool check_equal(A const& a, B const& b, const char* expression, const char* file, int line) {
+        if ( !(a == b) ) {
+            std::cerr << file << ":" << line << ": CHECK_EQ(" << expression << ") failed: " << a << " != " << b << std::endl;
+            failures() += 1;
+            return false;
+        }
+        return true;
+    }
+
+    inline bool check_near(double a, double b, double tolerance, const char* expression, const char* file, int line) {
+        if ( !(std::fabs(a - b) <= tolerance) ) {
+            std::cerr << file << ":" << line << ": CHECK_NEAR(" << expression << ") failed: " << a << " vs " << b
+                      << ", tolerance " << tolerance << std::endl;
+            failures() += 1;
+            return false;
+        }
+        return true;
+    }
+
+    /** path of a file under Assets/ */
+    inline std::string asset(const char* name) {
+        return std::string(CR_ASSET_DIR) + "/" + name;
+    }
+
+    /**
+     Empty directory under the system temporary directory, removed with the object
+     */
+    class ScratchDirectory {
+    private:
+        std::filesystem::path path;
+
+    public:
+        explicit ScratchDirectory(const char* name) {
+            std::random_device entropy;
+            path = std::filesystem::temp_directory_path() / (std::string("cloud-rendering-") + name + "-" + std::to_string(entropy()));
+            std::filesystem::create_directories(path);
+        }
+
+        ~ScratchDirectory() {
+            std::error_code ignored;
+            std::filesystem::remove_all(path, ignored);
+        }
+
+        ScratchDirectory( ScratchDirectory const& ) = delete;
+        ScratchDirectory& operator=( ScratchDirectory const& ) = delete;
+
+        inline std::string file(const char* name) const { return (path / name).string(); }
+        inline std::filesystem::path const& get_path() const { return path; }
+    };
+
+    /** entries directly in `dir`, e.g. to check a cache left no temporary behind */
+    inline size_t files_in(std::filesystem::path const& dir) {
+        return (size_t)std::distance(std::filesystem::directory_iterator(dir), std::filesystem::directory_iterator());
+    }
+}
+
+#define TEST_CASE(name)                                                                  \
+    static void name();                                                                  \
+    static const Test::Registration name##_registration { #name, name };                 \
+    static void name()
+
+#define CHECK(expression) Test::check((expression), #expression, __FILE__, __LINE__)
+#define CHECK_EQ(a, b) Test::check_equal((a), (b), #a " == " #b, __FILE__, __LINE__)
+#define CHECK_NEAR(a, b, tolerance) Test::check_near((a), (b), (tolerance), #a " ~ " #b, __FILE__, __LINE__)
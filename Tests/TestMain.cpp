@@ -0,0 +1,20 @@
+#include <iostream>
+#include <chrono>
+
+#include "Test.hpp"
+
+int main() {
+    for ( Test::Case const& c : Test::registry() ) {
+        size_t failed_before = Test::failures();
+        auto start = std::chrono::steady_clock::now();
+        c.body();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << (Test::failures() == failed_before ? "[pass] " : "[FAIL] ") << c.name << " (" << ms << " ms)" << std::endl;
+    }
+
+    if ( Test::failures() != 0 ) {
+        std::cerr << Test::failures() << " check(s) failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,61 @@
+#include <atomic>
+#include <stdexcept>
+
+#include "Test.hpp"
+#include "ThreadPool.hpp"
+
+TEST_CASE(parallel_for_calls_every_index_once) {
+    for ( unsigned workers : { 0u, 1u, 3u } ) {
+        ThreadPool pool { workers };
+        for ( size_t count : { 0u, 1u, 7u, 1000u } ) {
+            std::vector<std::atomic<int>> calls(count);
+            parallel_for(pool, count, [&](size_t i) { calls[i] += 1; });
+            bool once = std::all_of(calls.begin(), calls.end(), [](auto const& c) { return c.load() == 1; });
+            CHECK(once);
+        }
+    }
+}
+
+TEST_CASE(parallel_for_2d_covers_the_rectangle_once) {
+    ThreadPool pool { 3 };
+    for ( auto [width, height, tile_width, tile_height] : { std::array<size_t, 4> { 333, 129, 64, 16 },
+                                                            std::array<size_t, 4> { 256, 256, 256, 256 },
+                                                            std::array<size_t, 4> { 10, 3, 0, 100 } } ) {
+        std::vector<std::atomic<int>> cover(width * height);
+        std::atomic<bool> in_bounds = true;
+        parallel_for_2d(pool, width, height, tile_width, tile_height, [&](size_t x0, size_t y0, size_t x1, size_t y1) {
+            if ( x0 >= x1 || y0 >= y1 || x1 > width || y1 > height ) in_bounds = false;
+            for ( size_t y = y0; y < y1; y += 1 )
+                for ( size_t x = x0; x < x1; x += 1 ) cover[y * width + x] += 1;
+        });
+        bool once = std::all_of(cover.begin(), cover.end(), [](auto const& c) { return c.load() == 1; });
+        CHECK(in_bounds.load());
+        CHECK(once);
+    }
+}
+
+TEST_CASE(nested_parallel_for_does_not_deadlock) {
+    ThreadPool pool { 2 };
+    std::atomic<size_t> total = 0;
+    parallel_for(pool, 8, [&](size_t) {
+        parallel_for(pool, 100, [&](size_t i) { total += i; });
+    });
+    CHECK_EQ(total.load(), 8u * 4950u);
+}
+
+TEST_CASE(parallel_for_rethrows_the_first_exception) {
+    ThreadPool pool { 2 };
+    std::atomic<size_t> ran = 0;
+    bool caught = false;
+    try {
+        parallel_for(pool, 64, [&](size_t i) {
+            ran += 1;
+            if ( i == 17 ) throw std::runtime_error("tile 17");
+        });
+    } catch ( std::runtime_error const& e ) {
+        caught = std::string(e.what()) == "tile 17";
+    }
+    CHECK(caught);
+    // the other indices still ran, so nothing was left referencing the caller's frame
+    CHECK_EQ(ran.load(), 64u);
+}
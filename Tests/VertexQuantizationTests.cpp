@@ -0,0 +1,90 @@
+#include "Test.hpp"
+#include "VertexQuantization.hpp"
+#include "ObjLoader.hpp"
+
+namespace {
+
+    /** in double precision: acos of a float dot product cannot resolve angles below ~3e-4 */
+    float angle_between(simd::float3 a, simd::float3 b) {
+        double cx = (double)a.y * b.z - (double)a.z * b.y, cy = (double)a.z * b.x - (double)a.x * b.z, cz = (double)a.x * b.y - (double)a.y * b.x;
+        double dot = (double)a.x * b.x + (double)a.y * b.y + (double)a.z * b.z;
+        return (float)std::atan2(std::sqrt(cx * cx + cy * cy + cz * cz), dot);
+    }
+}
+
+TEST_CASE(packed_vertex_is_a_third_of_vertex) {
+    CHECK_EQ(sizeof(PackedVertex), 16u);
+    CHECK_EQ(sizeof(Vertex), 48u);
+}
+
+TEST_CASE(hemisphere_round_trip_stays_within_error_bounds) {
+    std::string path = Test::asset("hemisphere.obj");
+    ObjLoader obj { path };
+    const Vertex* vertices = obj.get_vertices_data();
+    size_t count = obj.get_vertices_count();
+
+    std::vector<PackedVertex> packed;
+    PackedVertexBounds bounds = Quantization::pack(vertices, count, packed);
+    Quantization::ErrorBounds limits = Quantization::error_bounds(bounds);
+    CHECK_EQ(packed.size(), count);
+
+    simd::float3 worst_position {};
+    float worst_normal = 0.0f, worst_uv = 0.0f;
+    for ( size_t i = 0; i < count; i += 1 ) {
+        Vertex d = Quantization::decode(packed[i], bounds);
+        for ( int k = 0; k < 3; k += 1 )
+            worst_position[k] = std::max(worst_position[k], std::fabs(d.position[k] - vertices[i].position[k]));
+        if ( simd::length(vertices[i].normal) > 0.0f )
+            worst_normal = std::max(worst_normal, angle_between(d.normal, vertices[i].normal));
+        worst_uv = std::max({ worst_uv, std::fabs(d.uv.x - vertices[i].uv.x), std::fabs(d.uv.y - vertices[i].uv.y) });
+    }
+
+    for ( int k = 0; k < 3; k += 1 ) CHECK(worst_position[k] <= limits.position[k]);
+    CHECK(worst_normal <= limits.normal_radians);
+    CHECK(worst_uv <= limits.uv);
+    std::cout << "  position " << worst_position.x << " " << worst_position.y << " " << worst_position.z
+              << ", normal " << worst_normal << " rad, uv " << worst_uv << ", "
+              << count * sizeof(Vertex) / 1024 << " KB -> " << count * sizeof(PackedVertex) / 1024 << " KB" << std::endl;
+}
+
+TEST_CASE(octahedral_normals_stay_within_bound) {
+    std::mt19937 rng { 7 };
+    std::normal_distribution<float> gaussian;
+    float worst = 0.0f;
+    for ( int i = 0; i < 500000; i += 1 ) {
+        simd::float3 n = simd::normalize(simd::make_float3(gaussian(rng), gaussian(rng), gaussian(rng)));
+        simd::float2 e = Quantization::octahedral_encode(n);
+        simd::float2 q = simd::make_float2(Quantization::from_snorm16(Quantization::to_snorm16(e.x)),
+                                           Quantization::from_snorm16(Quantization::to_snorm16(e.y)));
+        worst = std::max(worst, angle_between(Quantization::octahedral_decode(q), n));
+    }
+    CHECK(worst <= Quantization::error_bounds({}).normal_radians);
+
+    // the axes land exactly on the map's corners and edges
+    for ( simd::float3 axis : { simd::make_float3(0, 0, 1), simd::make_float3(0, 0, -1), simd::make_float3(1, 0, 0), simd::make_float3(0, -1, 0) } )
+        CHECK(angle_between(Quantization::octahedral_decode(Quantization::octahedral_encode(axis)), axis) < 1e-6f);
+}
+
+TEST_CASE(half_conversion_round_trips_and_rounds_to_nearest) {
+    // every finite binary16 value survives half -> float -> half
+    bool exact = true;
+    for ( uint32_t h = 0; h < 0x10000u; h += 1 ) {
+        if ( (h & 0x7C00u) == 0x7C00u ) continue;
+        exact = exact && Quantization::float_to_half(Quantization::half_to_float((uint16_t)h)) == h;
+    }
+    CHECK(exact);
+
+    // uv range: within half an ulp, ties to even
+    std::mt19937 rng { 11 };
+    std::uniform_real_distribution<float> uv { -2.0f, 2.0f };
+    float worst = 0.0f;
+    for ( int i = 0; i < 200000; i += 1 ) {
+        float f = uv(rng);
+        float error = std::fabs(Quantization::half_to_float(Quantization::float_to_half(f)) - f);
+        worst = std::max(worst, error / std::ldexp(1.0f, std::ilogb(f) - 10));
+    }
+    CHECK(worst <= 0.5f);
+    CHECK_EQ(Quantization::float_to_half(1.0f + std::ldexp(1.0f, -11)), 0x3C00u);
+    CHECK_EQ(Quantization::float_to_half(1.0f + 3.0f * std::ldexp(1.0f, -11)), 0x3C02u);
+    CHECK_EQ(Quantization::float_to_half(1e6f), 0x7C00u);
+}
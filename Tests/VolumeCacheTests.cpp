@@ -0,0 +1,103 @@
+#include <fstream>
+#include <thread>
+#include <atomic>
+
+#include "Test.hpp"
+#include "VolumeCache.hpp"
+
+namespace {
+
+    /** small enough to bake in a few milliseconds, with every channel in use */
+    constexpr VolumeNoise::VolumeParameters small_shape = { VolumeNoise::VolumeKind::Shape, 3, 32, 4, 3, 2 };
+
+    /** mean absolute difference of channel `c` between neighbours along x, inside the volume or across its wrap */
+    double mean_step(const uint8_t* texels, uint32_t n, uint32_t c, bool across_wrap) {
+        double total = 0.0;
+        for ( uint32_t z = 0; z < n; z += 1 )
+            for ( uint32_t y = 0; y < n; y += 1 ) {
+                uint32_t x0 = across_wrap ? n - 1 : n / 2, x1 = across_wrap ? 0 : n / 2 + 1;
+                total += std::abs((int)texels[(((size_t)z * n + y) * n + x0) * 4 + c] - (int)texels[(((size_t)z * n + y) * n + x1) * 4 + c]);
+            }
+        return total / ((double)n * n);
+    }
+}
+
+TEST_CASE(volume_round_trip_maps_what_was_baked) {
+    Test::ScratchDirectory dir { "crvol" };
+    std::string cache = dir.file("shape.crvol");
+    ThreadPool pool { 2 };
+
+    CachedVolume cold { small_shape, cache, pool };
+    CHECK(!cold.is_cache_hit());
+    CachedVolume warm { small_shape, cache, pool };
+    CHECK(warm.is_cache_hit());
+
+    std::vector<uint8_t> baked = VolumeNoise::bake(small_shape, pool);
+    CHECK_EQ(warm.get_size(), small_shape.size);
+    CHECK_EQ(warm.size(), baked.size());
+    CHECK(std::equal(baked.begin(), baked.end(), warm.data()));
+    // the texels start on a page of the mapping
+    CHECK_EQ((uintptr_t)warm.data() % CRVolumeHeader::data_alignment, 0u);
+    CHECK_EQ(Test::files_in(dir.get_path()), 1u);
+}
+
+TEST_CASE(volume_changed_parameters_rebake) {
+    Test::ScratchDirectory dir { "crvol" };
+    std::string cache = dir.file("shape.crvol");
+    ThreadPool pool { 2 };
+    { CachedVolume cold { small_shape, cache, pool }; }
+
+    VolumeNoise::VolumeParameters reseeded = small_shape;
+    reseeded.seed += 1;
+    CachedVolume other { reseeded, cache, pool };
+    CHECK(!other.is_cache_hit());
+    CachedVolume warm { reseeded, cache, pool };
+    CHECK(warm.is_cache_hit());
+    std::vector<uint8_t> baked = VolumeNoise::bake(reseeded, pool);
+    CHECK(std::equal(baked.begin(), baked.end(), warm.data()));
+}
+
+TEST_CASE(volume_damaged_cache_is_rebaked) {
+    Test::ScratchDirectory dir { "crvol" };
+    std::string cache = dir.file("shape.crvol");
+    ThreadPool pool { 2 };
+    { CachedVolume cold { small_shape, cache, pool }; }
+
+    std::filesystem::resize_file(cache, CRVolumeHeader::data_alignment + 100);
+    CachedVolume truncated { small_shape, cache, pool };
+    CHECK(!truncated.is_cache_hit());
+    CachedVolume rebaked { small_shape, cache, pool };
+    CHECK(rebaked.is_cache_hit());
+}
+
+TEST_CASE(volume_concurrent_writers_do_not_collide) {
+    Test::ScratchDirectory dir { "crvol" };
+    std::string cache = dir.file("shape.crvol");
+    ThreadPool pool { 1 };
+    std::vector<uint8_t> baked = VolumeNoise::bake(small_shape, pool);
+
+    std::vector<std::thread> writers;
+    std::atomic<int> written { 0 };
+    for ( int i = 0; i < 4; i += 1 )
+        writers.emplace_back([&] { if ( CachedVolume::write(cache, small_shape, baked) ) written += 1; });
+    for ( auto& t : writers ) t.join();
+
+    CHECK_EQ(written.load(), 4);
+    CHECK_EQ(Test::files_in(dir.get_path()), 1u);
+    CachedVolume warm { small_shape, cache, pool };
+    CHECK(warm.is_cache_hit());
+    CHECK(std::equal(baked.begin(), baked.end(), warm.data()));
+}
+
+TEST_CASE(volume_tiles_without_a_seam) {
+    ThreadPool pool { 2 };
+    for ( VolumeNoise::VolumeParameters params : { small_shape, VolumeNoise::default_detail } ) {
+        std::vector<uint8_t> texels = VolumeNoise::bake(params, pool);
+        for ( uint32_t c = 0; c < 3; c += 1 ) {
+            // a seam would make the step across the wrap much larger than the one between any two neighbours
+            double inside = mean_step(texels.data(), params.size, c, false);
+            double across = mean_step(texels.data(), params.size, c, true);
+            CHECK(across < 2.0 * inside + 1.0);
+        }
+    }
+}
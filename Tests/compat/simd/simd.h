@@ -0,0 +1,101 @@
+// Stand-in for Apple's <simd/simd.h> on hosts that lack it, covering what the renderer's CPU headers use
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+/**
+ Only used by the test and benchmark builds when the system header is missing. Sizes and alignments match
+ Apple's vector types (a float3 occupies 16 bytes), so `Vertex` and the other shared structs keep the layout
+ the Metal side expects and the caches written on either platform agree.
+ */
+namespace simd {
+
+#define CR_SIMD_COMPAT_OPERATORS(T, N)                                                                      \
+    inline float& T::operator[](int i) { return (&x)[i]; }                                                  \
+    inline float T::operator[](int i) const { return (&x)[i]; }                                             \
+    inline T operator+(T a, T b) { for ( int i = 0; i < N; i += 1 ) a[i] += b[i]; return a; }              \
+    inline T operator-(T a, T b) { for ( int i = 0; i < N; i += 1 ) a[i] -= b[i]; return a; }              \
+    inline T operator*(T a, T b) { for ( int i = 0; i < N; i += 1 ) a[i] *= b[i]; return a; }              \
+    inline T operator/(T a, T b) { for ( int i = 0; i < N; i += 1 ) a[i] /= b[i]; return a; }              \
+    inline T operator*(T a, float s) { for ( int i = 0; i < N; i += 1 ) a[i] *= s; return a; }             \
+    inline T operator*(float s, T a) { return a * s; }                                                      \
+    inline T operator/(T a, float s) { for ( int i = 0; i < N; i += 1 ) a[i] /= s; return a; }             \
+    inline T operator-(T a) { for ( int i = 0; i < N; i += 1 ) a[i] = -a[i]; return a; }                   \
+    inline T& operator+=(T& a, T b) { return a = a + b; }                                                   \
+    inline T& operator-=(T& a, T b) { return a = a - b; }                                                   \
+    inline T& operator*=(T& a, T b) { return a = a * b; }                                                   \
+    inline T& operator*=(T& a, float s) { return a = a * s; }                                               \
+    inline T& operator/=(T& a, float s) { return a = a / s; }                                               \
+    inline float dot(T a, T b) { float s = 0.0f; for ( int i = 0; i < N; i += 1 ) s += a[i] * b[i]; return s; } \
+    inline float length(T a) { return std::sqrt(dot(a, a)); }                                               \
+    inline float length_squared(T a) { return dot(a, a); }                                                  \
+    inline float distance(T a, T b) { return length(a - b); }                                               \
+    inline T normalize(T a) { return a / length(a); }                                                       \
+    inline T min(T a, T b) { for ( int i = 0; i < N; i += 1 ) a[i] = std::min(a[i], b[i]); return a; }    \
+    inline T max(T a, T b) { for ( int i = 0; i < N; i += 1 ) a[i] = std::max(a[i], b[i]); return a; }    \
+    inline T abs(T a) { for ( int i = 0; i < N; i += 1 ) a[i] = std::fabs(a[i]); return a; }
+
+    struct alignas(8) float2 {
+        float x, y;
+        float& operator[](int i);
+        float operator[](int i) const;
+    };
+
+    struct alignas(16) float3 {
+        float x, y, z;
+        float& operator[](int i);
+        float operator[](int i) const;
+    };
+
+    struct alignas(16) float4 {
+        float x, y, z, w;
+        float& operator[](int i);
+        float operator[](int i) const;
+    };
+
+    CR_SIMD_COMPAT_OPERATORS(float2, 2)
+    CR_SIMD_COMPAT_OPERATORS(float3, 3)
+    CR_SIMD_COMPAT_OPERATORS(float4, 4)
+
+#undef CR_SIMD_COMPAT_OPERATORS
+
+    inline float3 cross(float3 a, float3 b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+
+    inline float2 make_float2(float x, float y) { return { x, y }; }
+    inline float3 make_float3(float x, float y, float z) { return { x, y, z }; }
+    inline float4 make_float4(float x, float y, float z, float w) { return { x, y, z, w }; }
+
+    /** column major, as `simd_float4x4` */
+    struct alignas(16) float4x4 {
+        float4 columns[4];
+
+        float4x4() : columns {} {}
+        explicit float4x4(float diagonal) : columns {} { for ( int i = 0; i < 4; i += 1 ) columns[i][i] = diagonal; }
+    };
+
+    inline float4 operator*(float4x4 const& m, float4 v) {
+        float4 r {};
+        for ( int c = 0; c < 4; c += 1 ) r = r + m.columns[c] * v[c];
+        return r;
+    }
+
+    inline float4x4 operator*(float4x4 const& a, float4x4 const& b) {
+        float4x4 r;
+        for ( int c = 0; c < 4; c += 1 ) r.columns[c] = a * b.columns[c];
+        return r;
+    }
+
+    struct alignas(8) uint2 {
+        uint32_t x, y;
+    };
+}
+
+typedef simd::float2 simd_float2;
+typedef simd::float3 simd_float3;
+typedef simd::float4 simd_float4;
+typedef simd::float4x4 simd_float4x4;
+typedef simd::uint2 simd_uint2;
+
+static_assert(sizeof(simd_float2) == 8 && sizeof(simd_float3) == 16 && sizeof(simd_float4) == 16, "Apple vector layout");